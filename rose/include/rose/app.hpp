@@ -6,6 +6,8 @@
 #define ROSE_INCLUDE_APP
 
 #include <rose/app_state.hpp>
+#include <rose/gui.hpp>
+#include <rose/snapshot.hpp>
 #include <rose/core/err.hpp>
 
 #include <backends/imgui_impl_glfw.h>
@@ -35,6 +37,21 @@ struct RoseApp {
         return {};
     }
     
+    // adds the entities of a scene snapshot, must be called after init(). whatever was loaded is shown in the gui,
+    // even when some of the snapshot's models failed to import
+    template <typename T>
+    rses load_scene(T& backend, const fs::path& path) {
+        size_t first_new = app_state.entities.size();
+        SnapshotStats stats;
+        rses err = load_snapshot(path, app_state.entities, backend.backend_state.skybox, backend.texture_manager,
+                                 backend.thread_pool, &stats);
+        gui::scene_loaded(app_state, first_new, stats);
+        if (err) {
+            return err.general("unable to load scene");
+        }
+        return {};
+    }
+    
     template <typename T>
     void run(T& backend) {
         while (!glfwWindowShouldClose(app_state.window_state.window_handle)) {
@@ -7,6 +7,7 @@
 
 #include <rose/camera.hpp>
 #include <rose/entities.hpp>
+#include <rose/streaming.hpp>
 #include <rose/core/types.hpp>
 
 #include <GLFW/glfw3.h>
@@ -39,12 +40,26 @@ struct AppState {
     WindowState window_state;
     Camera camera;
     Entities entities;
+    WorldStreamer streamer;
 
     bool bloom_enabled = true;
     f32 bloom_factor = 0.03f;
 
     bool ssao_enabled = true;
     std::vector<glm::vec4> ssao_kernel;
+
+    bool indirect_enabled = false; // submit geometry with multi-draw indirect rather than a draw per mesh
+    bool occlusion_culling_enabled = false; // cull indirect gbuffer draws against the depth pyramid on the GPU
+    bool cpu_occlusion_enabled = false;     // cull camera draws behind occluder entities on the CPU
+    bool impostors_enabled = false;         // draw distant entities as impostor cards in the camera pass
+    bool active_clusters_enabled = true;    // cache cluster bounds and cull lights only for clusters with geometry
+    bool light_tree_enabled = true;         // find the lights of each cluster through a hierarchy over the lights
+    bool cpu_clusters_enabled = false;      // build the cluster light lists on the CPU rather than in compute shaders
+    bool light_lod_enabled = false;         // merge distant groups of point lights into single lights
+    bool zbin_enabled = false;              // cull lights with depth bins and tile masks rather than the cluster grid
+    bool tiled_lighting_enabled = false;    // shade the gbuffer in tiles with a compute shader rather than a full screen pass
+    bool forward_plus_enabled = false;      // shade opaque geometry in a forward pass after a depth prepass, no impostors
+    u32 msaa_samples = 1;                   // samples per pixel of the forward+ pass, 1 disables MSAA
 };
 
 #endif
\ No newline at end of file
@@ -7,11 +7,20 @@
 
 #include <rose/app_state.hpp>
 #include <rose/camera.hpp>
+#include <rose/cpu_clusters.hpp>
+#include <rose/culling.hpp>
 #include <rose/entities.hpp>
+#include <rose/light_lod.hpp>
 #include <rose/model.hpp>
+#include <rose/occlusion.hpp>
+#include <rose/backends/gl/impostor.hpp>
+#include <rose/backends/gl/occlusion.hpp>
+#include <rose/backends/gl/render.hpp>
 #include <rose/backends/gl/shader.hpp>
 #include <rose/backends/gl/structs.hpp>
 #include <rose/core/err.hpp>
+#include <rose/core/memory.hpp>
+#include <rose/core/thread_pool.hpp>
 #include <rose/core/types.hpp>
 
 #include <GLFW/glfw3.h>
@@ -19,15 +28,49 @@
 
 namespace gl {
 
+// values available across shaders, mirrors the std140 layout of globals_ubo
+struct Globals {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec3 camera_pos;
+    u32 padding0 = 0;
+    glm::uvec3 grid_sz;         // cluster dimensions (xyz)
+    u32 tile_sz = 0;            // width and height of a cluster in pixels
+    glm::uvec2 screen_dims;     // screen [ width, height ]
+    f32 far_z = 0.0f;
+    f32 near_z = 0.0f;
+    f32 near_slice_z = 0.0f;    // far end of the first depth slice of the cluster grid
+    u32 padding1[3] = {};
+};
+
+static_assert(sizeof(Globals) == 192, "Globals must match the layout of globals_ubo");
+
 // state specific to the OpenGL backend
 struct BackendState {
     SkyBox skybox;
-    u32 global_ubo = 0; // ubo storing values available across shaders
+    Globals globals;
+    RingBuffer frame_data; // per-frame constants and draw data, rewritten every frame
     DirLight dir_light;
     PtShadowData pt_shadow_data;
+    SpotShadowData spot_shadow_data;
     std::vector<Mip> bloom_mip_chain;
     u32 ssao_noise_tex = 0;
     SSBO ssao_samples_ssbo;
+
+    // timings of the geometry passes, used to compare submission modes
+    GpuTimer shadow_timer;
+    GpuTimer gbuf_timer;
+    GpuTimer forward_timer;
+    GpuTimer cluster_timer; // building the cluster grid and culling lights against it
+    GpuTimer lighting_timer; // shading the gbuffer
+    f64 submit_ms = 0.0;    // CPU time spent recording geometry passes
+
+    // general heap allocations made while rendering the last frame, the gui pass is not included
+    u64 frame_heap_allocs = 0;
+    u64 frame_heap_bytes = 0;
+    u64 n_alloc_frames = 0; // frames that made any heap allocations
+    u64 last_alloc_allocs = 0; // allocations of the last frame that made any, kept for the readout
+    u64 last_alloc_bytes = 0;
 };
 
 
@@ -39,6 +82,15 @@ struct Backend {
     void step(AppState& app_state);
     void finish();
 
+    // compares the light lists the GPU just culled against the CPU's for the same frame. a debugging aid for the
+    // shaders, the CPU lists themselves are checked by tests/cpu_clusters_test.cpp
+    //
+    // note: stalls until the GPU has finished culling
+    void check_clusters(AppState& app_state, const glm::mat4& projection, const glm::mat4& view);
+
+    // lights uploaded for shading, either the scene's or those selected by the light LOD
+    const LightRegistry& shaded_lights(const AppState& app_state) const;
+
     // note: destruction order is important
     // entities must be destructed before texture managers
     TextureManager texture_manager;
@@ -46,10 +98,26 @@ struct Backend {
     Shaders shaders;
     Clusters clusters;
 
-    SSBO lights_ids_ssbo;   // IDs for each point light
+    DrawList draw_list;     // draws of every mesh in the scene, shared by all geometry passes
+    Culler culler;          // per-pass visibility of the draws in draw_list
+    OcclusionCuller occlusion_culler;
+    DepthPyramid depth_pyramid;
+    OcclusionBuffer occlusion_buffer;       // CPU depth of occluder entities, tested before draws are compacted
+    ImpostorRenderer impostors;             // cards drawn in place of distant entities in the camera pass
+    CpuClusters cpu_clusters;               // light lists built on the CPU, used in place of or to check the GPU's
+    ClusterLightSet cpu_lights;
+    ClusterCheck cluster_check;
+    bool cluster_check_pending = false;     // compare the GPU's light lists against the CPU's on the next frame
+    LightLod light_lod;                     // merges distant groups of lights into single lights
+    bool light_lod_active = false;          // whether the lights uploaded last frame came from light_lod
+    Arena frame_arena;      // data that only lives until the end of the frame, reset at the start of each step
+    ThreadPool thread_pool;
+    bool indirect_supported = false;
 
     FrameBuf gbuf_fbuf;     // gbuffers
     FrameBuf int_fbuf;      // intermediate
+    MsaaFrameBuf msaa_fbuf; // multisampled forward+ target, resolved into int_fbuf, created on first use
+    u32 max_msaa_samples = 1;
     FrameBuf ssao_fbuf;     // occlusion factor
     FrameBuf out_fbuf;      // output
 };
@@ -0,0 +1,106 @@
+// =============================================================================
+//   octahedral impostors for drawing distant models as cards
+// =============================================================================
+
+#ifndef ROSE_INCLUDE_BACKENDS_GL_IMPOSTOR
+#define ROSE_INCLUDE_BACKENDS_GL_IMPOSTOR
+
+#include <rose/entities.hpp>
+#include <rose/model.hpp>
+#include <rose/backends/gl/render.hpp>
+#include <rose/backends/gl/shader.hpp>
+#include <rose/backends/gl/structs.hpp>
+#include <rose/core/core.hpp>
+
+#include <glm.hpp>
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace gl {
+
+struct Globals;
+
+// a model rendered from a grid of directions over the octahedron into gbuffer-like atlases
+//
+// each tile holds the model seen from one direction with an orthographic projection fitted to its bounding
+// sphere. the position atlas stores model space positions rather than a depth, so a card can place every
+// texel exactly where the mesh would have been and write the matching depth
+struct Impostor {
+    FrameBuf atlas;                 // position, normal and roughness, color and ao, metallic
+    glm::vec3 center = { 0.0f, 0.0f, 0.0f };
+    f32 radius = 0.0f;
+    u32 n_frames = 0;               // tiles along each side of the atlas
+    u32 tile_sz = 0;
+    bool baked = false;
+};
+
+// per-instance data of a card, mirrors the std430 layout of instances in impostor.vert
+struct ImpostorInstance {
+    glm::mat4 model;
+    glm::mat4 normal_mat;
+};
+
+struct ImpostorStats {
+    u32 n_impostors = 0;        // entities drawn as cards
+    u32 n_draws_replaced = 0;   // mesh draws removed from the camera pass
+    u64 n_indices_replaced = 0;
+    u32 n_batches = 0;          // instanced card draws
+    u32 n_baked = 0;            // impostors baked since start up
+    f64 bake_ms = 0.0;          // CPU time of the last frame that baked
+};
+
+// replaces the camera draws of entities that cover little of the screen with impostor cards. shadow passes
+// still draw the full meshes
+//
+// impostors are keyed by the triangle bvhs of a model, which copies of a model share, so every copy of a
+// model uses the same atlas. an impostor is freed once the last model using it is destroyed
+struct ImpostorRenderer {
+
+    void init(RingBuffer& ring);
+
+    // removes the camera draws of entities smaller than the screen size threshold, baking impostors for models
+    // that do not have one yet. baking rebinds the globals, they are bound again from the given values
+    //
+    // note: must be called after culling and before the draw list is compacted
+    void select(Entities& entities, const DrawList& draw_list, std::vector<u32>& camera_visible, Shader& bake_shader,
+                const Globals& globals, f32 fov_y);
+
+    // draws the selected cards into the bound gbuffer
+    void draw(Shader& shader);
+
+    // fraction of the screen height below which an entity's bounding sphere is drawn as a card
+    f32 screen_threshold = 0.05f;
+    u32 n_frames = 8;
+    u32 tile_sz = 128;
+    u32 max_bakes_per_frame = 2;    // bounds the hitch when many new models become distant at once
+
+    ImpostorStats stats;
+
+    RingBuffer* ring = nullptr;
+    u32 vao = 0;                    // cards are generated from the vertex id, so it has no attributes
+
+    // entity state for the current frame, 0 if undecided, 1 if drawn as meshes and 2 if drawn as a card
+    std::vector<u8> ent_state;
+
+    struct CacheEntry {
+        std::weak_ptr<const std::vector<TriangleBVH>> geometry;   // expires with the last model using it
+        std::unique_ptr<Impostor> impostor;
+    };
+    std::unordered_map<const std::vector<TriangleBVH>*, CacheEntry> cache;
+
+    struct Card {
+        Impostor* impostor;
+        ImpostorInstance instance;
+    };
+    std::vector<Card> cards;
+    std::vector<ImpostorInstance> batch;
+
+private:
+    void bake(Impostor& impostor, const Model& model, Shader& bake_shader, const Globals& globals);
+};
+
+} // namespace gl
+
+#endif
\ No newline at end of file
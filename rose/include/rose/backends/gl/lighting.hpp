@@ -8,6 +8,15 @@
 #include <rose/core/core.hpp>
 #include <rose/backends/gl/structs.hpp>
 
+#include <glm.hpp>
+
+#include <array>
+#include <span>
+#include <vector>
+
+struct LightRange;
+struct LightRegistry;
+
 namespace gl {
 
 struct DirShadowData {
@@ -16,7 +25,7 @@ struct DirShadowData {
 
     u32 fbo = 0;
     u32 tex = 0;
-    u32 light_mats_ubo = 0; // transform matrices to directional light space
+    std::array<glm::mat4, 3> light_mats; // transform matrices to directional light space, one per cascade
     u16 resolution = 2048;
     u8 n_cascades = 3;
 };
@@ -30,11 +39,210 @@ struct PtShadowData {
     u16 resolution = 2048;
 };
 
+// a single perspective map for a shadow casting spot light, holding distances to the light like the cube map of
+// a point light
+struct SpotShadowData {
+
+    rses init();
+
+    u32 fbo = 0;
+    u32 tex = 0;
+    u16 resolution = 2048;
+};
+
+struct LightUploadStats {
+    u32 n_lights = 0;
+    u32 n_updated = 0;      // lights written this frame
+    u32 n_ranges = 0;
+    u32 n_bytes = 0;        // bytes sent to the GPU
+    bool scattered = false; // whether the lights were scattered by the compute shader
+};
+
+// GPU copy of the light registry, kept in sync by uploading only the lights changed since the last sync
+struct LightBuffers {
+
+    // constructs the buffers with space for the given number of lights
+    void init(u32 n_lights);
+
+    // grows the buffers to fit every light and uploads the changed ones. a few ranges are written in place,
+    // while many scattered changes are staged in the ring buffer and moved into place by a compute shader,
+    // rather than issuing a copy for each light
+    void sync(LightRegistry& registry, RingBuffer& ring, Shader& scatter);
+
+    gl::SSBO data_ssbo;          // light parameters for each light in the scene
+    gl::SSBO pos_ssbo;           // light positions for each light in the scene
+    gl::SSBO ids_ssbo;           // IDs for each point light
+    u32 n_lights = 0;
+
+    LightUploadStats stats;
+
+    // changed lights separated by at most this many unchanged ones are uploaded as a single range
+    static constexpr u32 max_gap = 1;
+
+    // past this many ranges, changes are scattered on the GPU
+    static constexpr u32 max_direct_ranges = 16;
+
+    std::vector<LightRange> ranges; // scratch space
+};
+
+// hierarchy over the point lights inside the view frustum, rebuilt on the GPU every frame
+//
+// a prepass moves every light into view space once and keys those inside the frustum by the Morton code of
+// their position. the keys are sorted, then leaves are formed from runs of leaf_sz lights along the curve and
+// each level above bounds branching nodes of the level below, up to a single root. clusters descend it rather
+// than testing every light, so culling scales with the lights near each cluster rather than all of them
+struct LightTree {
+
+    void init();
+
+    // builds the hierarchy over the lights in the scene's light buffers, the view is read from the globals
+    void build(u32 n_lights, Shader& prepass, Shader& sort, Shader& build_level);
+
+    // sets the layout of the levels on a shader that traverses the hierarchy
+    void bind(Shader& shader) const;
+
+    static constexpr u32 leaf_sz = 32;      // note: must match lights_tree.comp and clusters_cull.comp
+    static constexpr u32 branching = 32;
+    static constexpr u32 max_levels = 6;
+    static constexpr u32 sort_block = 1024; // keys sorted per work group, the sort is padded to a multiple of it
+
+    gl::SSBO keys_ssbo;         // [ Morton code, light ] of every slot of the sort
+    gl::SSBO view_lights_ssbo;  // view space position and radius of every light
+    gl::SSBO nodes_ssbo;        // bounds of every node, level by level from the leaves up
+    gl::SSBO sorted_ssbo;       // view space position and radius of the visible lights, in sorted order
+    gl::SSBO info_ssbo;         // number of visible lights
+
+    u32 n_slots = 0;            // keys sorted, a power of two
+    u32 n_levels = 0;
+    std::array<u32, max_levels> level_offsets = {};
+    std::array<u32, max_levels> level_sizes = {};
+};
+
+// layout of the start of the pool, written by clusters_cull.comp
+struct ClusterLightStats {
+    u32 n_used = 0;         // uints of the pool used by the most recently read back frame
+    u32 n_lists = 0;        // clusters with at least one light
+    u32 n_refs = 0;         // lights over every list
+    u32 max_lights = 0;     // lights in the longest list
+};
+
+// light lists of the clusters, each cluster owns a range of exactly as many indices as it has lights within a
+// single shared pool
+//
+// ranges are allocated on the GPU as the clusters are culled. the amount used is read back a few frames late
+// to avoid stalling, if a frame ran out of space the pool is grown and lists of the frames in between are cut
+// short. indices are stored in 16 bits while there are few enough lights
+struct ClusterLights {
+
+    ClusterLights() = default;
+
+    ClusterLights(const ClusterLights& other) = delete;
+    ClusterLights& operator=(const ClusterLights& other) = delete;
+
+    ~ClusterLights();
+
+    void init(u32 n_clusters);
+
+    // grows the pool if a previous frame ran out of space and resets the allocator, must be called before culling
+    void begin(u32 n_lights);
+
+    // copies the amount of the pool used by this frame for reading back, must be called after culling
+    void end();
+
+    // replaces the lists with ones built elsewhere, in the layout of the grid and pool
+    void upload(std::span<const glm::uvec2> grid, std::span<const u32> pool, bool packed);
+
+    // sets the layout of the indices on a shader that reads the light lists
+    void bind(Shader& shader) const;
+
+    // a pool that ran out of space is grown to this multiple of what the frame asked for, leaving room for lists
+    // to keep growing
+    static constexpr f32 grow_factor = 1.5f;
+    static constexpr u32 initial_per_cluster = 8;   // uints of indices in the pool per cluster to start with
+    static constexpr u32 max_packed_lights = 1 << 16;
+    static constexpr u32 n_frames = 4;
+
+    gl::SSBO grid_ssbo;         // [ first index, number of lights ] of each cluster
+    gl::SSBO pool_ssbo;         // uints allocated, followed by the indices of every cluster's lights
+    u32 capacity = 0;           // uints of indices the pool can hold
+    bool packed = false;        // whether indices are 16 bits, two to a uint
+    u32 n_grows = 0;            // times the pool ran out of space and was grown
+
+    // the stats of each frame in flight are copied here and read once the fence of its frame has passed
+    u32 readback = 0;
+    ClusterLightStats* readback_ptr = nullptr;
+    std::array<GLsync, n_frames> fences = {};
+    u32 frame = 0;
+
+    ClusterLightStats stats;
+};
+
+struct ZBinStats {
+    f64 cpu_ms = 0.0;       // culling, sorting and binning the lights
+    u32 n_visible = 0;      // lights inside the view frustum
+    u32 n_tiles = 0;
+    u32 data_bytes = 0;     // bins and sorted lights
+    u32 mask_bytes = 0;     // masks of every tile
+};
+
+// light culling by z binning, an alternative to the cluster grid
+//
+// the lights inside the frustum are sorted by view depth on the CPU and each of n_bins slices of the depth
+// range stores the first and last sorted light reaching it. a compute shader then sets a bit per sorted light
+// in the mask of each screen tile the light overlaps. a fragment walks only the words of its tile's mask
+// within its bin's range, so the bins take the same space however many lights there are, while the masks
+// grow with the lights and the tiles rather than with the lights per cluster
+struct ZBinLights {
+
+    void init();
+
+    // bins the lights of the registry for the view and builds the tile masks
+    void build(const LightRegistry& registry, const glm::mat4& view, const glm::mat4& projection,
+               glm::uvec2 screen_dims, f32 far_z, Shader& tiles);
+
+    // sets the layout of the bins and masks on a shader that reads them
+    void bind(Shader& shader) const;
+
+    static constexpr u32 n_bins = 1024;     // note: bins are spaced linearly from the camera to the far plane
+    static constexpr u32 tile_sz = 32;
+    static constexpr u32 empty_bin = 0xFFFFFFFF;
+
+    gl::SSBO data_ssbo;         // [ first, last ] slot of each bin, followed by the light in each slot
+    gl::SSBO masks_ssbo;        // a bit per slot for every tile
+    gl::SSBO view_lights_ssbo;  // view space position and radius of the light in each slot
+
+    glm::uvec2 n_tiles = { 0, 0 };
+    u32 n_words = 1;            // uints in the mask of a tile
+
+    // scratch space, kept between frames so steady frames do not allocate
+    struct Key {
+        f32 depth;
+        u32 light;
+    };
+    std::vector<Key> keys;
+    std::vector<u32> data;
+    std::vector<glm::vec4> view_lights;
+
+    ZBinStats stats;
+};
+
 struct ClustersData {
+
+    // sizes the per cluster buffers for a grid of the given number of clusters
+    void resize(u32 n_clusters);
+
     gl::SSBO aabb_ssbo;          // AABBs for each cluster
-    gl::SSBO lights_ssbo;        // light parameters for each light in the scene
-    gl::SSBO lights_pos_ssbo;    // light positions for each light in the scene
-    gl::SSBO clusters_ssbo;      // light for each cluster
+    gl::LightBuffers lights;     // parameters, positions and ids of each point light in the scene
+    gl::ClusterLights lists;     // lights affecting each cluster
+    gl::SSBO flags_ssbo;         // set for each cluster containing opaque fragments, cleared once compacted
+    gl::SSBO active_ssbo;        // indirect dispatch size and count, followed by the ids of the flagged clusters
+    gl::LightTree tree;          // hierarchy over the visible lights, traversed by each cluster
+    gl::ZBinLights zbins;        // depth bins and tile masks, used in place of the grid when z binning
+
+    // the AABBs only depend on these, they are rebuilt once either changes
+    glm::mat4 aabb_proj = glm::mat4(0.0f);
+    glm::uvec2 aabb_dims = { 0, 0 };
+    u32 n_aabb_builds = 0;
 };
 
 } // namespace gl
@@ -0,0 +1,89 @@
+// =============================================================================
+//   GPU occlusion culling against a hierarchical depth pyramid
+// =============================================================================
+
+#ifndef ROSE_INCLUDE_BACKENDS_GL_OCCLUSION
+#define ROSE_INCLUDE_BACKENDS_GL_OCCLUSION
+
+#include <rose/culling.hpp>
+#include <rose/backends/gl/render.hpp>
+#include <rose/backends/gl/shader.hpp>
+#include <rose/backends/gl/structs.hpp>
+#include <rose/core/core.hpp>
+
+#include <glm.hpp>
+
+#include <array>
+#include <vector>
+
+namespace gl {
+
+// mip chain of linear view space depth, where each texel holds the farthest depth of the texels it covers
+// in the level below. built from the gbuffer and shared by occlusion culling and SSAO
+struct DepthPyramid {
+
+    DepthPyramid() = default;
+
+    DepthPyramid(const DepthPyramid& other) = delete;
+    DepthPyramid& operator=(const DepthPyramid& other) = delete;
+
+    ~DepthPyramid();
+
+    void init(u32 w, u32 h);
+
+    // builds every level from the view space depth stored in the alpha channel of gbuf_pos
+    void build(Shader& shader, u32 gbuf_pos);
+
+    u32 tex = 0;
+    u32 width = 0;
+    u32 height = 0;
+    u32 n_mips = 0;
+};
+
+// tests the opaque camera draws of a DrawList against the depth pyramid on the GPU, writing compacted
+// commands that are drawn with glMultiDrawElementsIndirectCount
+//
+// culling is done in two phases. the first tests draws against the pyramid of the previous frame and
+// draws those that pass. the pyramid is then rebuilt from what was drawn and the second phase retests only
+// the draws rejected by the first, so anything that became visible this frame is drawn without popping in
+struct OcclusionCuller {
+
+    // the draw list must outlive the culler
+    void init(DrawList& draw_list);
+
+    // writes the bounds and commands of the camera pass into the current frame, should be called after
+    // DrawList::upload() and before any dispatch
+    void prepare(const CullBounds& bounds);
+
+    // culls the commands of a phase against the frustum of proj_view. the first phase tests against the
+    // pyramid built with prev_proj_view while the second tests against the pyramid built with proj_view
+    void cull(Shader& shader, const DepthPyramid& pyramid, u32 phase, const glm::mat4& proj_view, f32 near_z);
+
+    // draws the commands that survived a phase
+    void draw(Shader& shader, u32 phase);
+
+    // a command's batch and the index of the first command of that batch
+    struct CmdBatch {
+        u32 batch = 0;
+        u32 first_cmd = 0;
+    };
+
+    static constexpr u32 n_phases = 2;
+
+    std::vector<glm::vec4> bounds_data;  // [ center, extent ] pairs of every draw
+    std::vector<CmdBatch> cmd_batches;
+
+    glm::mat4 prev_proj_view = glm::mat4(1.0f);
+    bool hiz_valid = false;             // whether the pyramid holds the depth of the previous frame
+
+    u32 n_cmds = 0;
+    u32 n_batches = 0;
+    std::array<u32, n_phases> out_offsets = {};     // offsets of the commands written by each phase
+    std::array<u32, n_phases> count_offsets = {};   // offsets of the per-batch command counts of each phase
+
+    DrawList* draw_list = nullptr;
+};
+
+} // namespace gl
+
+#endif
\ No newline at end of file
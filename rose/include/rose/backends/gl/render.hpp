@@ -5,6 +5,8 @@
 #ifndef ROSE_INCLUDE_BACKENDS_GL_RENDER
 #define ROSE_INCLUDE_BACKENDS_GL_RENDER
 
+#include <rose/culling.hpp>
+#include <rose/entities.hpp>
 #include <rose/model.hpp>
 #include <rose/backends/gl/shader.hpp>
 #include <rose/backends/gl/structs.hpp>
@@ -12,6 +14,7 @@
 
 #include <glm.hpp>
 
+#include <array>
 #include <vector>
 
 namespace gl {
@@ -26,6 +29,113 @@ void render_transparent(Shader& shader, const Model& model);
 
 void render(Shader& shader, SkyBox& skybox, u32 vao);
 
+// renders every mesh of a model placed by the model's own node hierarchy, ignoring its model matrix
+void render_nodes(Shader& shader, const Model& model);
+
+// indirect submission ============================================================================
+
+// layout matches DrawElementsIndirectCommand
+struct IndirectCmd {
+    u32 count = 0;
+    u32 instance_count = 0;
+    u32 first_idx = 0;
+    i32 base_vert = 0;
+    u32 base_instance = 0; // index of the DrawRecord for this draw
+};
+
+// per-draw data, fetched in shaders through gl_BaseInstance
+struct DrawRecord {
+    u32 transform_idx = 0; // position of the mesh's scene node in the instances buffer
+    u32 matl_idx = 0;      // index into the materials buffer
+    u32 shadow_mask = 0;   // cascades (bits 0-2) and cube faces (bits 8-13) the mesh is visible in
+};
+
+enum class MatlFlags : u32 {
+    NONE            = 0,
+    HAS_ALBEDO_MAP  = bit1,
+    HAS_NORMAL_MAP  = bit2,
+    HAS_PBR_MAP     = bit3,
+    HAS_AO_MAP      = bit4,
+};
+
+} // namespace gl
+
+ENABLE_ROSE_ENUM_OPS(gl::MatlFlags);
+
+namespace gl {
+
+// material of a single mesh, textures are referenced through bindless handles
+//
+// note: padding added to meet std430 layout requirements
+struct MatlRecord {
+    u64 albedo_map = 0;
+    u64 normal_map = 0;
+    u64 pbr_map = 0;
+    u64 ao_map = 0;
+    MatlFlags flags = MatlFlags::NONE;
+    u8 padding[4] = { 0 };
+};
+
+// a range of commands which share a vertex array
+struct DrawBatch {
+    u32 vao = 0;
+    u32 first_cmd = 0;
+    u32 n_cmds = 0;
+};
+
+enum class DrawGroup { OPAQUE, TRANSPARENT, N_GROUPS };
+
+// commands of the draws that survived culling for a single pass
+struct PassCmds {
+    std::array<std::vector<IndirectCmd>, (size_t)DrawGroup::N_GROUPS> cmds;
+    std::array<std::vector<DrawBatch>, (size_t)DrawGroup::N_GROUPS> batches;
+    u32 cmds_offset = 0; // offset of the commands within the current frame of the ring buffer
+};
+
+// a draw for every mesh in the scene, built once per frame and shared by all passes. each pass is culled
+// separately, then either submitted with glMultiDrawElementsIndirect or with a draw call per mesh
+struct DrawList {
+
+    // per-frame data is streamed through the given ring buffer, materials are only recorded
+    // if bindless textures are available
+    void init(RingBuffer& ring, bool bindless);
+
+    // records a draw and world space bounds for every mesh of all live entities that are not light emitters
+    //
+    // note: entity transforms must be up to date
+    void build(Entities& entities, CullBounds& bounds);
+
+    // records the commands of each pass from the draws that survived culling
+    void compact(const Culler& culler);
+
+    // writes the commands and per-draw data into the current frame, should be called once after compact()
+    void upload();
+
+    // submits the commands of a group with multi-draw indirect
+    void draw(Shader& shader, CullPass pass, DrawGroup group);
+
+    // submits the commands of a group with a draw call per mesh
+    void draw_direct(Shader& shader, Entities& entities, CullPass pass, DrawGroup group);
+
+    std::array<PassCmds, (size_t)CullPass::N_PASSES> passes;
+
+    // draws before culling
+    std::vector<DrawRecord> draws;
+    std::vector<IndirectCmd> draw_cmds;
+    std::vector<DrawGroup> draw_groups;
+    std::vector<u32> draw_vaos;
+    std::vector<u32> draw_meshes;       // index of the mesh within its entity's model
+    std::vector<u32> draw_ents;         // entity the mesh belongs to
+
+    const SceneGraph* scene = nullptr;  // world transforms of every scene node are uploaded as instances
+    std::vector<MatlRecord> matls;      // materials of every model drawn so far
+    bool matls_dirty = false;
+    bool bindless = false;
+
+    RingBuffer* ring = nullptr;
+    SSBO matls_ssbo;                    // materials only change when new models are drawn
+};
+
 } // namespace gl
 
 #endif
@@ -28,7 +28,9 @@ struct Shader {
     Shader() = default;
     ~Shader();
 
-    rses init(const std::vector<ShaderCtx>& shader_ctxs);
+    // compiles and links the given shader stages, each define is injected as '#define <define>' directly after
+    // the #version directive of every stage, followed by the declarations of common.glsl
+    rses init(const std::vector<ShaderCtx>& shader_ctxs, const std::vector<std::string_view>& defines = {});
     void use();
 
     void set_bool(const std::string_view& name, bool value) const;
@@ -51,6 +53,9 @@ struct Shaders {
 
     rses init();
 
+    // initializes shader variants used for indirect submission, requires bindless texture support
+    rses init_indirect();
+
     Shader downsample;
     Shader upsample;
     Shader ssao;
@@ -58,7 +63,19 @@ struct Shaders {
     Shader brightness;
     Shader clusters_build;
     Shader clusters_cull;
+    Shader clusters_mark;
+    Shader clusters_compact;
+    Shader hiz_build;
+    Shader occlusion_cull;
+    Shader lights_scatter;
+    Shader lights_prepass;
+    Shader lights_sort;
+    Shader lights_tree;
+    Shader zbin_tiles;
+    Shader lighting_tiled;
     Shader gbuf;
+    Shader gbuf_prepass;            // writes only view depth and normals, for forward+
+    Shader impostor;
     Shader out;
     Shader light;
     Shader lighting_deferred;
@@ -67,6 +84,13 @@ struct Shaders {
     Shader dir_shadow;
     Shader pt_shadow;
     Shader skybox;
+
+    // variants used when submitting geometry with multi-draw indirect
+    Shader dir_shadow_indirect;
+    Shader pt_shadow_indirect;
+    Shader gbuf_indirect;
+    Shader gbuf_prepass_indirect;
+    Shader lighting_forward_indirect;
 };
 
 }
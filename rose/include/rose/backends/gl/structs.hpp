@@ -11,7 +11,12 @@
 
 #include <GL/glew.h>
 
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <limits>
 #include <span>
+#include <vector>
 
 namespace gl {
 
@@ -36,6 +41,11 @@ struct RenderData {
     u32 tangent_buf = 0;
     u32 uv_buf = 0;
     u32 indices_buf = 0;
+
+    // offset of this model's materials within the indirect material table, assigned on first indirect draw
+    // note: entries are not reclaimed when the model is destroyed
+    u32 matl_base = invalid_matl_base;
+    static constexpr u32 invalid_matl_base = std::numeric_limits<u32>::max();
 };
 
 struct FrameBufTexCtx {
@@ -78,6 +88,31 @@ struct FrameBuf {
     };
 };
 
+// multisampled colour and depth render buffers, resolved into a single sampled framebuffer once drawn
+struct MsaaFrameBuf {
+
+    ~MsaaFrameBuf();
+
+    inline void bind() {
+        glBindFramebuffer(GL_FRAMEBUFFER, frame_buf);
+        glViewport(0, 0, width, height);
+    }
+
+    rses init(i32 w, i32 h, u32 n_samples, GLenum intern_format);
+    void release();
+
+    // resolves the colour buffer into the first colour attachment of the destination
+    void resolve(const FrameBuf& dst);
+
+    u32 frame_buf = 0;
+    u32 color_buf = 0;
+    u32 depth_buf = 0;
+
+    u32 height = 0;
+    u32 width = 0;
+    u32 samples = 0;            // 0 until initialized
+};
+
 struct SSBO {
 
     // constructs ssbo given size in bytes and a binding point
@@ -88,12 +123,16 @@ struct SSBO {
 
         // check if we have exceeded the capacity of the SSBO and need to resize it
         if (data.size_bytes() > capacity) {
+            u32 new_capacity = std::max(capacity, 16u);
+            while (new_capacity < data.size_bytes()) {
+                new_capacity *= 2;
+            }
             u32 realloced_ssbo = 0;
             glCreateBuffers(1, &realloced_ssbo);
-            glNamedBufferStorage(realloced_ssbo, capacity * 2, nullptr, GL_DYNAMIC_STORAGE_BIT);
+            glNamedBufferStorage(realloced_ssbo, new_capacity, nullptr, GL_DYNAMIC_STORAGE_BIT);
             glDeleteBuffers(1, &ssbo);
             glBindBufferBase(GL_SHADER_STORAGE_BUFFER, base, realloced_ssbo);
-            capacity *= 2;
+            capacity = new_capacity;
             ssbo = realloced_ssbo;
         }
 
@@ -101,6 +140,9 @@ struct SSBO {
         glNamedBufferSubData(ssbo, 0, data.size_bytes(), static_cast<void*>(data.data()));
     }
 
+    // grows the ssbo to hold at least size bytes while keeping its contents, returns true if it was reallocated
+    bool reserve(u32 size);
+
     ~SSBO();
 
     u32 ssbo = 0;     // ssbo identifier
@@ -109,6 +151,96 @@ struct SSBO {
     u32 base = 0;     // bind idx
 };
 
+// measures the GPU time spent between a call to begin() and end()
+//
+// note: results are read back a few frames late to avoid stalling on the queries
+struct GpuTimer {
+
+    GpuTimer() = default;
+
+    GpuTimer(const GpuTimer& other) = delete;
+    GpuTimer& operator=(const GpuTimer& other) = delete;
+
+    ~GpuTimer();
+
+    void init();
+    void begin();
+    void end();
+
+    static constexpr u32 n_frames = 4;
+    std::array<u32, n_frames * 2> queries = {};
+    u32 frame = 0;
+    f64 elapsed_ms = 0.0; // most recent available measurement
+};
+
+// a range of a ring buffer reserved for the current frame
+struct RingAlloc {
+    u8* ptr = nullptr; // write location, only valid until the next allocation
+    u32 offset = 0;    // offset from the start of the current frame's region
+    u32 size = 0;
+};
+
+// persistently mapped buffer for data that is rewritten every frame. the buffer is split into a region for
+// each frame in flight, the CPU writes directly into the region of the current frame while the GPU reads
+// from the previous ones. fences prevent a region from being overwritten before the GPU is done with it.
+struct RingBuffer {
+
+    RingBuffer() = default;
+
+    RingBuffer(const RingBuffer& other) = delete;
+    RingBuffer& operator=(const RingBuffer& other) = delete;
+
+    ~RingBuffer();
+
+    // constructs the ring buffer given the size in bytes of a single frame's region
+    rses init(u32 frame_sz);
+
+    // advances to the next region, waiting on the GPU if it is still in use
+    void begin_frame();
+
+    // fences the current region, should be called after the last command using it was issued
+    void end_frame();
+
+    // reserves an aligned range within the current region, growing the buffer if the region is full
+    RingAlloc alloc(u32 size);
+
+    // reserves a range and binds it to an indexed UBO or SSBO binding point
+    //
+    // note: bindings are reissued if the buffer grows later within the frame
+    RingAlloc bind(GLenum target, u32 base, u32 size);
+
+    // copies data into the current region and binds it to an indexed UBO or SSBO binding point
+    template <typename T, size_t N>
+    RingAlloc push(GLenum target, u32 base, std::span<T, N> data) {
+        RingAlloc ret = bind(target, base, data.size_bytes());
+        if (!data.empty()) {
+            std::memcpy(ret.ptr, data.data(), data.size_bytes());
+        }
+        return ret;
+    }
+
+    // offset of the current frame's region within the buffer
+    inline u32 frame_offset() const { return frame * frame_sz; }
+
+    struct Binding {
+        GLenum target = 0;
+        u32 base = 0;
+        u32 offset = 0;
+        u32 size = 0;
+    };
+
+    static constexpr u32 n_frames = 3;
+
+    u32 buf = 0;
+    u8* mapped = nullptr;
+    u32 frame_sz = 0;          // size of a single frame's region in bytes
+    u32 frame = 0;             // index of the current region
+    u32 head = 0;              // next free byte within the current region
+    u32 alignment = 256;       // satisfies both UBO and SSBO offset alignment
+    std::array<GLsync, n_frames> fences = {};
+    std::vector<Binding> bindings; // ranges bound during the current frame
+};
+
 // represents a single mip
 struct Mip {
     u32 tex = 0;
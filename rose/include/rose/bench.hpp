@@ -0,0 +1,146 @@
+// =============================================================================
+//   benchmark harnesses, triggered from the gui and reported in its readouts
+// =============================================================================
+
+#ifndef ROSE_INCLUDE_BENCH
+#define ROSE_INCLUDE_BENCH
+
+#include <rose/app_state.hpp>
+#include <rose/core/types.hpp>
+
+#ifdef USE_OPENGL
+#include <rose/backends/gl/backend.hpp>
+#else
+static_assert("no backend selected");
+#endif
+
+#include <glm.hpp>
+
+#include <array>
+#include <vector>
+
+namespace bench {
+
+// results of the last bvh benchmark
+struct BvhBench {
+    bool ran = false;
+    u32 n_boxes = 0;
+    i32 height = 0;
+    f64 insert_ms = 0.0;
+    f64 move_ms = 0.0;      // per frame
+    u32 n_reinserts = 0;    // per frame
+    f64 query_ms = 0.0;     // per frame
+    f64 linear_ms = 0.0;    // per frame, the same queries as a linear scan
+    u32 n_hits = 0;         // per frame
+};
+
+// results of the last raycast benchmark
+struct RayBench {
+    bool ran = false;
+    u32 n_rays = 0;
+    u32 n_hits = 0;
+    u64 n_tris = 0;         // triangles in the scene
+    f64 avg_us = 0.0;
+};
+
+// results of the last light upload benchmark
+struct LightBench {
+    bool ran = false;
+    u32 n_lights = 0;
+    u32 n_animated = 0;     // lights moved per frame
+    u32 full_bytes = 0;     // per frame, every light uploaded
+    f64 full_ms = 0.0;
+    u32 partial_bytes = 0;  // per frame, only moved lights uploaded
+    f64 partial_ms = 0.0;
+    u32 n_ranges = 0;       // per frame
+    bool scattered = false;
+};
+
+// results of the last CPU cluster benchmark, a row per light count and tile size
+struct ClusterBench {
+    struct Row {
+        u32 n_lights = 0;
+        u32 tile_sz = 0;
+        u32 n_clusters = 0;
+        f64 build_ms = 0.0;
+        f64 cull_ms = 0.0;
+        f32 avg_lights = 0.0f;  // per non-empty list
+    };
+    std::vector<Row> rows;
+    u32 n_threads = 0;
+    bool simd = false;
+};
+
+// A/B comparison of the cluster grid against z binning, each rendering the scene for a phase of frames
+struct ZBinBench {
+    bool running = false;
+    bool ran = false;
+    bool restore_mode = false;  // mode in use before the benchmark
+    u32 frame = 0;
+    std::array<f64, 2> cluster_ms = {};     // per mode, grid first
+    std::array<f64, 2> lighting_ms = {};
+    std::array<u32, 2> mem_bytes = {};      // light lists or bins and masks
+
+    static constexpr u32 phase_frames = 64;
+    static constexpr u32 warmup_frames = 8; // dropped at the start of each phase, timers lag a few frames
+};
+
+// A/B comparison of the full screen lighting pass against the tiled compute pass, a phase of frames each
+struct TiledBench {
+    bool running = false;
+    bool ran = false;
+    bool restore_mode = false;  // mode in use before the benchmark
+    u32 frame = 0;
+    u32 n_lights = 0;
+    std::array<f64, 2> lighting_ms = {};    // per mode, full screen first
+
+    static constexpr u32 phase_frames = 64;
+    static constexpr u32 warmup_frames = 8; // dropped at the start of each phase, timers lag a few frames
+};
+
+// camera path across the streamed city, with the streaming metrics sampled every frame along it
+struct StreamFlight {
+    bool flying = false;
+    glm::vec3 start = { 0.0f, 0.0f, 0.0f };
+    glm::vec3 end = { 0.0f, 0.0f, 0.0f };
+    f32 travelled = 0.0f;
+    f32 speed = 40.0f;                  // units per second
+    std::vector<f32> latency_ms;        // latency of the last loaded cell
+    std::vector<f32> cpu_mb;
+    std::vector<f32> gpu_mb;
+
+    static constexpr size_t max_samples = 1024;
+};
+
+// replaces the streamed world with a city of copies of the model, scattered over a square grid of cells, and
+// lays the flight path across it. nothing is loaded until the streamer sees the camera near a cell
+void spawn_streamed_city(AppState& app_state, const fs::path& model_path, i32 side, i32 density,
+                         StreamFlight& flight);
+
+// moves the camera along the flight path and samples the streaming metrics
+void step_flight(AppState& app_state, StreamFlight& flight, f32 dt);
+
+// times a standalone bvh over 100k boxes, with a fraction of them moving every frame, against a frustum built
+// from the camera and a set of sphere queries. the same queries are also run as a linear scan for reference
+void run_bvh_benchmark(const AppState& app_state, BvhBench& bench);
+
+// casts a grid of rays across the screen and times them
+void run_ray_benchmark(const AppState& app_state, RayBench& bench);
+
+// builds light lists on the CPU for every combination of light count and tile size from the current camera,
+// with lights scattered through the nearer part of the view
+void run_cluster_benchmark(const AppState& app_state, gl::Backend& backend, ClusterBench& bench);
+
+// advances the cluster against z binning comparison by a frame, sampling the timers of the mode in use
+void step_zbin_benchmark(AppState& app_state, const gl::Backend& backend, ZBinBench& bench);
+
+// advances the full screen against tiled lighting comparison by a frame, sampling the timer of the mode in use
+void step_tiled_benchmark(AppState& app_state, const gl::Backend& backend, TiledBench& bench);
+
+// fills a standalone light registry with 50k lights and times uploading all of them every frame against
+// uploading only the 5% that moved. times include waiting on the GPU
+void run_light_benchmark(gl::Backend& backend, LightBench& bench);
+
+} // namespace bench
+
+#endif
\ No newline at end of file
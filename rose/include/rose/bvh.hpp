@@ -0,0 +1,147 @@
+// =============================================================================
+//   dynamic bounding volume hierarchy for spatial queries
+// =============================================================================
+
+#ifndef ROSE_INCLUDE_BVH
+#define ROSE_INCLUDE_BVH
+
+#include <rose/culling.hpp>
+#include <rose/raycast.hpp>
+#include <rose/core/core.hpp>
+
+#include <glm.hpp>
+
+#include <limits>
+#include <span>
+#include <vector>
+
+struct BVHNode {
+    inline bool leaf() const { return child_a == std::numeric_limits<u32>::max(); }
+
+    glm::vec3 min_pt = { 0.0f, 0.0f, 0.0f };
+    glm::vec3 max_pt = { 0.0f, 0.0f, 0.0f };
+    u32 parent = std::numeric_limits<u32>::max();   // next free node while on the free list
+    u32 child_a = std::numeric_limits<u32>::max();  // both children are invalid for leaves
+    u32 child_b = std::numeric_limits<u32>::max();
+    i32 height = 0;                                 // 0 for leaves, -1 for free nodes
+    u32 user = 0;                                   // value returned by queries, only set for leaves
+};
+
+// binary tree of boxes that is updated incrementally as boxes are added, moved and removed
+//
+// leaves store boxes grown by a margin, so an object moving within its margin does not touch the tree.
+// objects that leave it are removed and inserted again at the position that grows the tree the least, and
+// the tree is kept balanced by rotations along the path back to the root. queries append the user values of
+// intersecting leaves to a list
+struct DynamicBVH {
+
+    // adds a box and returns its proxy
+    u32 insert(const glm::vec3& min_pt, const glm::vec3& max_pt, u32 user);
+
+    void remove(u32 proxy);
+
+    // updates the box of a proxy, returns true if the box left its margin and the tree was changed
+    bool move(u32 proxy, const glm::vec3& min_pt, const glm::vec3& max_pt);
+
+    void clear();
+
+    // appends the user values of boxes intersecting the box
+    void query_aabb(const glm::vec3& min_pt, const glm::vec3& max_pt, std::vector<u32>& out) const;
+
+    // appends the user values of boxes intersecting the sphere
+    void query_sphere(const glm::vec3& center, f32 radius, std::vector<u32>& out) const;
+
+    // appends the user values of boxes intersecting the first n_planes planes of the frustum
+    void query_frustum(const Frustum& frustum, u32 n_planes, std::vector<u32>& out) const;
+
+    // queries several frusta in a single traversal, results for each frustum are appended to the matching list
+    //
+    // note: at most 32 frusta
+    void query_frusta(std::span<const Frustum> frusta, u32 n_planes, std::span<std::vector<u32>> out) const;
+
+    // visits leaves whose boxes the ray enters before max_t, nearer subtrees first. fn is called with the
+    // user value of each leaf and returns the distance of the closest hit so far, which shortens the ray
+    template <typename Fn>
+    void query_ray(const glm::vec3& origin, const glm::vec3& dir, f32 max_t, Fn&& fn) const;
+
+    inline u32 size() const { return n_leaves; }
+
+    inline i32 height() const { return root == invalid_node ? 0 : nodes[root].height; }
+
+    static constexpr u32 invalid_node = std::numeric_limits<u32>::max();
+
+    std::vector<BVHNode> nodes;
+    u32 root = invalid_node;
+    u32 free_list = invalid_node;
+    u32 n_leaves = 0;
+    f32 margin = 0.1f;      // distance boxes are grown by on each side
+
+    // the tree is balanced, so its height stays far below this for any number of leaves that fits in memory
+    static constexpr u32 max_depth = 64;
+
+private:
+    u32 alloc_node();
+    void free_node(u32 node);
+    void insert_leaf(u32 leaf);
+    void remove_leaf(u32 leaf);
+
+    // refits boxes and heights from a node up to the root, rebalancing along the way
+    void refit_up(u32 node);
+
+    // rotates the taller grandchild of an unbalanced node above it, returns the node now in its place
+    u32 balance(u32 node);
+};
+
+template <typename Fn>
+void DynamicBVH::query_ray(const glm::vec3& origin, const glm::vec3& dir, f32 max_t, Fn&& fn) const {
+
+    constexpr f32 miss = std::numeric_limits<f32>::infinity();
+
+    if (root == invalid_node) {
+        return;
+    }
+
+    glm::vec3 inv_dir = 1.0f / dir;
+    u32 stack[max_depth];
+    f32 stack_t[max_depth];     // distance at which the ray enters each node
+    u32 stack_sz = 0;
+
+    f32 root_t = ray_box(nodes[root].min_pt, nodes[root].max_pt, origin, inv_dir, max_t);
+    if (root_t != miss) {
+        stack[stack_sz] = root;
+        stack_t[stack_sz++] = root_t;
+    }
+
+    while (stack_sz > 0) {
+        --stack_sz;
+        if (stack_t[stack_sz] > max_t) {
+            continue;
+        }
+
+        const BVHNode& node = nodes[stack[stack_sz]];
+        if (node.leaf()) {
+            max_t = std::min(max_t, fn(node.user));
+            continue;
+        }
+
+        f32 t_a = ray_box(nodes[node.child_a].min_pt, nodes[node.child_a].max_pt, origin, inv_dir, max_t);
+        f32 t_b = ray_box(nodes[node.child_b].min_pt, nodes[node.child_b].max_pt, origin, inv_dir, max_t);
+        u32 near_idx = node.child_a, far_idx = node.child_b;
+        if (t_b < t_a) {
+            std::swap(near_idx, far_idx);
+            std::swap(t_a, t_b);
+        }
+
+        // the nearer child is pushed last so it is visited first
+        if (t_b != miss) {
+            stack[stack_sz] = far_idx;
+            stack_t[stack_sz++] = t_b;
+        }
+        if (t_a != miss) {
+            stack[stack_sz] = near_idx;
+            stack_t[stack_sz++] = t_a;
+        }
+    }
+}
+
+#endif
\ No newline at end of file
@@ -15,6 +15,8 @@ enum class CameraMovement { FORWARD, BACKWARD, LEFT, RIGHT, UP, DOWN };
 struct Camera {
     glm::mat4 view() const;
     glm::mat4 projection(f32 aspect_ratio) const;
+    // ray from the camera through a point of the screen, given in normalized device coordinates
+    void screen_ray(f32 aspect_ratio, const glm::vec2& ndc, glm::vec3& origin, glm::vec3& dir) const;
     void handle_keyboard(CameraMovement direction, f32 dt);
     void handle_mouse(f32 xoffset, f32 yoffset);
     void handle_scroll(f32 yoffset);
@@ -0,0 +1,41 @@
+// =============================================================================
+//   read-only memory mapping of files
+// =============================================================================
+
+#ifndef ROSE_INCLUDE_CORE_MAPPED_FILE
+#define ROSE_INCLUDE_CORE_MAPPED_FILE
+
+#include <rose/core/core.hpp>
+#include <rose/core/err.hpp>
+
+#include <filesystem>
+#include <span>
+
+// maps a whole file into memory, pages are read by the OS as they are touched rather than copied up front
+struct MappedFile {
+
+    MappedFile() = default;
+
+    MappedFile(const MappedFile& other) = delete;
+    MappedFile& operator=(const MappedFile& other) = delete;
+
+    ~MappedFile();
+
+    rses open(const fs::path& path);
+
+    void close();
+
+    inline std::span<const u8> bytes() const { return { data, size }; }
+
+    const u8* data = nullptr;
+    size_t size = 0;
+
+#ifdef _WIN32
+    void* file = nullptr;
+    void* mapping = nullptr;
+#else
+    i32 fd = -1;
+#endif
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,112 @@
+// =============================================================================
+//   arena allocators and heap instrumentation
+// =============================================================================
+
+#ifndef ROSE_INCLUDE_CORE_MEMORY
+#define ROSE_INCLUDE_CORE_MEMORY
+
+#include <rose/core/core.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// bump allocator over a list of blocks. allocations are never freed individually, instead the arena is
+// rewound to an earlier position or reset as a whole. blocks are kept when rewinding, so an arena that is
+// reset regularly stops touching the heap once it has grown to its peak use
+struct Arena {
+
+    Arena() = default;
+
+    Arena(const Arena& other) = delete;
+    Arena& operator=(const Arena& other) = delete;
+
+    ~Arena();
+
+    void* alloc(size_t size, size_t align = alignof(std::max_align_t));
+
+    template <typename T>
+    T* alloc_array(size_t n) {
+        return static_cast<T*>(alloc(sizeof(T) * n, alignof(T)));
+    }
+
+    // position within the arena, everything allocated after it is released by rewinding to it
+    struct Marker {
+        size_t block = 0;
+        size_t offset = 0;
+    };
+
+    inline Marker mark() const { return { cur, offset }; }
+
+    void rewind(Marker marker);
+
+    inline void reset() { rewind({}); }
+
+    // bytes from the start of the arena to the current position, including padding
+    size_t used() const;
+
+    struct Block {
+        u8* data = nullptr;
+        size_t size = 0;
+    };
+
+    std::vector<Block> blocks;
+    size_t cur = 0;             // block allocations are made from
+    size_t offset = 0;          // within the current block
+    size_t block_sz = 1 << 20;  // larger allocations get a block of their own size
+    size_t peak = 0;            // highest use since construction
+};
+
+// allows standard containers to allocate from an arena
+//
+// note: memory is only reclaimed when the arena is rewound, containers should reserve up front rather than grow
+template <typename T>
+struct ArenaAllocator {
+    using value_type = T;
+
+    ArenaAllocator(Arena& arena) noexcept : arena(&arena) {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept : arena(other.arena) {}
+
+    inline T* allocate(size_t n) { return arena->alloc_array<T>(n); }
+
+    inline void deallocate(T*, size_t) noexcept {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const noexcept {
+        return arena == other.arena;
+    }
+
+    Arena* arena;
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+// arena owned by the calling thread, for temporaries that do not outlive the function using them
+Arena& scratch_arena();
+
+// rewinds the calling thread's scratch arena when it goes out of scope, containers using it must be
+// declared after the scope so they are destroyed first
+struct ScratchScope {
+
+    ScratchScope() : arena(scratch_arena()), marker(arena.mark()) {}
+
+    ScratchScope(const ScratchScope& other) = delete;
+    ScratchScope& operator=(const ScratchScope& other) = delete;
+
+    ~ScratchScope() { arena.rewind(marker); }
+
+    Arena& arena;
+    Arena::Marker marker;
+};
+
+// totals of general heap allocations made through operator new on any thread since startup
+struct HeapStats {
+    u64 n_allocs = 0;
+    u64 n_bytes = 0;
+};
+
+HeapStats heap_stats();
+
+#endif
\ No newline at end of file
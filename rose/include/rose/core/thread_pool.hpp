@@ -0,0 +1,55 @@
+// =============================================================================
+//   fixed set of worker threads for data parallel work
+// =============================================================================
+
+#ifndef ROSE_INCLUDE_CORE_THREAD_POOL
+#define ROSE_INCLUDE_CORE_THREAD_POOL
+
+#include <rose/core/core.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct ThreadPool {
+
+    ThreadPool() = default;
+
+    ThreadPool(const ThreadPool& other) = delete;
+    ThreadPool& operator=(const ThreadPool& other) = delete;
+
+    ~ThreadPool();
+
+    // starts the given number of workers, zero starts one fewer than the number of hardware threads
+    void init(u32 n_threads = 0);
+
+    // runs fn for every index in [0, n) and returns once all have completed. the calling thread also
+    // takes indices, so work still completes if no workers were started
+    //
+    // note: the order indices are run in is not defined, fn should only write to data owned by its index
+    void parallel_for(u32 n, const std::function<void(u32)>& fn);
+
+    // number of threads work is spread across, including the caller
+    inline u32 size() const { return (u32)workers.size() + 1; }
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable work_cv;
+    std::condition_variable done_cv;
+
+    const std::function<void(u32)>* job = nullptr;
+    u32 job_sz = 0;
+    std::atomic<u32> next_idx = 0;
+    u32 n_busy = 0;         // workers that have not finished the current job
+    u64 generation = 0;     // incremented for every job, wakes the workers
+    bool stop = false;
+
+private:
+    void run_job();
+    void worker_loop();
+};
+
+#endif
\ No newline at end of file
@@ -34,4 +34,20 @@ struct AABB {
     glm::vec4 max_pt;
 };
 
+// bounding box and sphere of a set of points
+struct Bounds {
+    // grows the box to contain the point
+    void expand(const glm::vec3& pt);
+
+    // grows the box and sphere to contain other bounds
+    void expand(const Bounds& other);
+
+    inline bool empty() const { return min_pt.x > max_pt.x; }
+
+    glm::vec3 min_pt = constants::vec3_max;
+    glm::vec3 max_pt = constants::vec3_min;
+    glm::vec3 center = { 0.0f, 0.0f, 0.0f }; // center of the bounding sphere
+    f32 radius = 0.0f;                       // radius of the bounding sphere
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,95 @@
+// =============================================================================
+//   CPU implementation of the cluster grid build and light culling
+// =============================================================================
+
+#ifndef ROSE_INCLUDE_CPU_CLUSTERS
+#define ROSE_INCLUDE_CPU_CLUSTERS
+
+#include <rose/lighting.hpp>
+#include <rose/core/core.hpp>
+#include <rose/core/thread_pool.hpp>
+#include <rose/core/types.hpp>
+
+#include <glm.hpp>
+
+#include <span>
+#include <vector>
+
+// view space spheres of the point lights, stored as SoA so eight can be tested against a cluster at once
+//
+// note: arrays are padded to a multiple of eight, padding has a negative squared radius so it never passes
+struct ClusterLightSet {
+
+    // moves the lights of the registry into view space
+    void set(const LightRegistry& registry, const glm::mat4& view);
+
+    inline u32 size() const { return n; }
+
+    std::vector<f32> pos_x;
+    std::vector<f32> pos_y;
+    std::vector<f32> pos_z;
+    std::vector<f32> radius_sq;
+    std::vector<glm::vec4> cones;   // view space direction and outer cone cosine, tested only for spot lights
+    u32 n = 0;
+};
+
+struct CpuClusterStats {
+    f64 build_ms = 0.0;
+    f64 cull_ms = 0.0;
+    u32 n_lists = 0;        // clusters with at least one light
+    u32 n_refs = 0;         // lights over every list
+    u32 max_lights = 0;     // lights in the longest list
+};
+
+// result of comparing light lists read back from the GPU against the CPU's
+struct ClusterCheck {
+    bool ran = false;
+    u32 n_clusters = 0;
+    u32 n_different = 0;            // clusters whose lights differ
+    u32 gpu_refs = 0;               // lights over every list
+    u32 cpu_refs = 0;
+    bool overflowed = false;        // the GPU's lists were cut short, so differences are expected
+
+    std::vector<glm::uvec2> gpu_grid;
+    std::vector<u32> gpu_pool;
+};
+
+// builds the cluster AABBs and light lists on the CPU, matching clusters_build.comp and the linear path of
+// clusters_cull.comp. clusters are spread across the thread pool and each is tested against eight lights at
+// a time
+//
+// the lists are written in the layout of the clusters and light index buffers, so they can be uploaded in
+// place of the GPU's. lists are packed one after another in cluster order rather than in the order clusters
+// happen to allocate, and lights within a list are in ascending order
+struct CpuClusters {
+
+    // computes the view space bounds of every cluster of the grid
+    void build(const Clusters& clusters, glm::uvec2 screen_dims, const glm::mat4& projection, f32 near_z,
+               f32 far_z);
+
+    // finds the lights affecting every cluster, indices are stored in 16 bits if packed is set
+    void cull(const ClusterLightSet& lights, bool packed);
+
+    // compares light lists in the GPU layout against the ones last culled, ignoring the order of lights within a
+    // list. returns the number of clusters whose lights differ
+    u32 compare(std::span<const glm::uvec2> other_grid, std::span<const u32> other_pool, bool other_packed) const;
+
+    // lights of a list in the given layout, appended to out
+    static void decode(glm::uvec2 range, std::span<const u32> pool, bool packed, std::vector<u32>& out);
+
+    static constexpr u32 header_sz = 4;         // uints ahead of the indices, see gl::ClusterLightStats
+    static constexpr u32 clusters_per_job = 64;
+
+    ThreadPool* pool = nullptr;                 // runs on the calling thread if not set
+
+    std::vector<AABB> aabbs;
+    std::vector<glm::uvec2> grid;               // [ first index, number of lights ] of each cluster
+    std::vector<u32> indices;                   // header followed by the light indices of every list
+    bool packed = false;
+
+    std::vector<u32> counts;                    // lights in each cluster, scratch space
+
+    CpuClusterStats stats;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,93 @@
+// =============================================================================
+//   visibility culling of mesh instances against view volumes
+// =============================================================================
+
+#ifndef ROSE_INCLUDE_CULLING
+#define ROSE_INCLUDE_CULLING
+
+#include <rose/core/core.hpp>
+#include <rose/core/types.hpp>
+
+#include <glm.hpp>
+
+#include <array>
+#include <span>
+#include <vector>
+
+// planes of a view volume in the form dot(n, p) + w = 0, with normals pointing inwards
+//
+// note: planes are ordered left, right, bottom, top, far, near so the near plane can be
+// excluded by testing only the first five
+struct Frustum {
+    std::array<glm::vec4, 6> planes;
+};
+
+// extracts the frustum of a projection-view matrix
+Frustum make_frustum(const glm::mat4& proj_view);
+
+// world space boxes of instances, stored as SoA so eight can be tested at once
+//
+// note: arrays are padded to a multiple of eight so that SIMD loads never go out of bounds
+struct CullBounds {
+
+    void clear();
+
+    // transforms model space bounds into a world space box and appends it
+    void push(const Bounds& bounds, const glm::mat4& transform);
+
+    inline u32 size() const { return n; }
+
+    std::vector<f32> center_x;
+    std::vector<f32> center_y;
+    std::vector<f32> center_z;
+    std::vector<f32> extent_x;
+    std::vector<f32> extent_y;
+    std::vector<f32> extent_z;
+    u32 n = 0;
+};
+
+enum class CullPass { CAMERA, DIR_SHADOW, PT_SHADOW, N_PASSES };
+
+// values a frame's culling is performed against
+struct CullCtx {
+    glm::mat4 camera_mat;                       // projection-view of the camera
+    std::span<const glm::mat4> cascade_mats;    // projection-view of each shadow cascade
+    bool pt_enabled = false;                    // whether a point light is casting shadows
+    glm::vec3 pt_pos = { 0.0f, 0.0f, 0.0f };
+    f32 pt_radius = 0.0f;
+    std::span<const glm::mat4> face_mats;       // projection-view of each point shadow cube face
+};
+
+struct CullStats {
+    u32 n_tested = 0;
+    std::array<u32, (size_t)CullPass::N_PASSES> n_visible = {};
+    std::array<u32, 3> n_cascade = {};   // instances drawn into each cascade
+    std::array<u32, 6> n_face = {};      // instances drawn into each cube face
+    f64 cull_ms = 0.0;
+};
+
+struct Culler {
+
+    // tests all instances in bounds, filling the visible list of each pass
+    void cull(const CullCtx& ctx);
+
+    CullBounds bounds;
+    std::array<std::vector<u32>, (size_t)CullPass::N_PASSES> visible; // indices of visible instances per pass
+
+    // per instance masks of the cascades (bits 0-2) and cube faces (bits 8-13) an instance overlaps
+    std::vector<u32> shadow_masks;
+
+    CullStats stats;
+};
+
+// appends the indices of instances intersecting the first n_planes planes of the frustum
+void cull_frustum(const CullBounds& bounds, const Frustum& frustum, u32 n_planes, std::vector<u32>& out);
+
+// sets the given bit in the mask of every instance intersecting the first n_planes planes of the frustum
+void cull_frustum_mask(const CullBounds& bounds, const Frustum& frustum, u32 n_planes, u32 bit,
+                       std::span<u32> masks);
+
+// sets the given bit in the mask of every instance intersecting the sphere
+void cull_sphere_mask(const CullBounds& bounds, const glm::vec3& center, f32 radius, u32 bit, std::span<u32> masks);
+
+#endif
\ No newline at end of file
@@ -5,19 +5,24 @@
 #ifndef ROSE_INCLUDE_ENTITIES
 #define ROSE_INCLUDE_ENTITIES
 
+#include <rose/bvh.hpp>
 #include <rose/lighting.hpp>
 #include <rose/model.hpp>
+#include <rose/scene.hpp>
 #include <rose/core/core.hpp>
 #include <rose/core/types.hpp>
 
 #include <glm.hpp>
 
+#include <limits>
+#include <span>
 #include <vector>
 
 enum class EntityFlags : u32 { 
     NONE        = 0,     // no effect
     HIDE        = bit1,  // don't render this object
     EMIT_LIGHT  = bit2,  // make this object a light emitter
+    OCCLUDER    = bit3,  // rasterize this object into the CPU occlusion buffer
 };
 
 ENABLE_ROSE_ENUM_OPS(EntityFlags); 
@@ -32,49 +37,197 @@ struct EntityCtx {
     EntityFlags flags;
 };
 
+// stable reference to an entity. the low 32 bits select a slot and the high 32 bits hold the generation of
+// the slot, which is bumped whenever its entity is deleted so stale handles can be detected
+struct EntityHandle {
+    bool operator==(EntityHandle const& r) const = default;
+    bool operator!=(EntityHandle const& r) const = default;
+
+    inline u32 slot() const { return (u32)(val & 0xFFFFFFFF); }
+    inline u32 gen() const { return (u32)(val >> 32); }
+
+    static inline EntityHandle make(u32 slot, u32 gen) { return { ((u64)gen << 32) | slot }; }
+
+    u64 val = std::numeric_limits<u64>::max();
+};
+
+constexpr EntityHandle invalid_entity = {};
+
+// closest intersection of a ray with the triangles of the scene
+struct RayHit {
+    EntityHandle entity = invalid_entity;   // invalid if nothing was hit
+    u32 mesh = 0;                           // index of the mesh within the entity's model
+    u32 tri = 0;                            // index of the triangle within the mesh
+    f32 t = 0.0f;                           // distance along the ray, in multiples of its direction
+    glm::vec3 pos = { 0.0f, 0.0f, 0.0f };   // world space position of the hit
+};
+
+// entities are stored as a sparse set. components are packed densely, so systems only ever iterate live
+// entities, and deleting an entity moves the last one into its place. indices into the component arrays
+// are only stable until the next deletion, handles should be kept for anything that outlives that
 struct Entities {
 
     // add an entity to the scene
-    i64 add_object(TextureManager& manager, const EntityCtx& ent_def);
+    EntityHandle add_object(TextureManager& manager, const EntityCtx& ent_def);
+
+    // add an entity using an already loaded model, the context's model path is ignored
+    EntityHandle add_object(Model&& model, const EntityCtx& ent_def);
+
+    // adds an entity for each context, handles are appended to out
+    void add_objects(TextureManager& manager, std::span<const EntityCtx> ent_defs, std::vector<EntityHandle>& out);
 
-    // duplicates an existing object with the given index
-    i64 dup_object(i64 idx);
+    // duplicates an existing entity
+    EntityHandle dup_object(EntityHandle handle);
 
-    // delete the object at the given index
-    void del_object(i64 idx);
+    // duplicates an existing entity n times, handles are appended to out
+    void dup_objects(EntityHandle handle, size_t n, std::vector<EntityHandle>& out);
 
-    // returns the number of entities, both active and deleted
-    inline size_t size() const { return positions.size(); }
+    // deletes an entity, the handle is invalid afterwards
+    void del_object(EntityHandle handle);
 
-    inline bool empty() const { return positions.empty(); }
+    // deletes every entity in the list, stale handles are ignored
+    void del_objects(std::span<const EntityHandle> del_handles);
 
-    // returns true if the entity at the given index is active (i.e., not deleted)
-    inline bool is_alive(i64 idx) const { return !slot_empty[idx]; }
+    // reserves space for n entities in every component array
+    void reserve(size_t n);
+
+    // returns the number of live entities
+    inline size_t size() const { return handles.size(); }
+
+    inline bool empty() const { return handles.empty(); }
+
+    // returns true if the handle refers to a live entity
+    inline bool valid(EntityHandle handle) const {
+        return handle.slot() < generations.size() && generations[handle.slot()] == handle.gen();
+    }
+
+    // index of a live entity into the component arrays
+    inline size_t index(EntityHandle handle) const { return sparse[handle.slot()]; }
+
+    // handle of the entity at the given index
+    inline EntityHandle handle(size_t idx) const { return handles[idx]; }
 
     // returns true if the entity at the given index is a light emitter
-    inline bool is_light(i64 idx) const { return is_flag_set(flags[idx], EntityFlags::EMIT_LIGHT); }
+    inline bool is_light(size_t idx) const { return is_flag_set(flags[idx], EntityFlags::EMIT_LIGHT); }
+
+    // returns true if the entity at the given index hides the objects behind it during CPU occlusion culling
+    inline bool is_occluder(size_t idx) const { return is_flag_set(flags[idx], EntityFlags::OCCLUDER); }
 
     // return a new id and increment
     inline u64 new_id() { return id_counter++; }
 
-    // SoA of program objects, should all be equal length
+    // flags the transform of an entity to be recomputed, must be called after its position, scale or rotation changes
+    inline void mark_dirty(size_t idx) {
+        if (!transform_dirty[idx]) {
+            transform_dirty[idx] = true;
+            dirty_handles.push_back(handles[idx]);
+        }
+    }
+
+    // recomputes the transforms of entities flagged as dirty and of everything attached to them
+    void update_transforms();
+
+    // makes the entity at the given index a light emitter or stops it from emitting light
+    void set_emitter(size_t idx, bool emit);
+
+    // passes the light parameters of an entity on to the light registry, must be called after they change
+    inline void update_light(size_t idx) {
+        if (light_handles[idx] != LightRegistry::invalid_handle) {
+            lights.set_light(light_handles[idx], light_data[idx]);
+        }
+    }
+
+    // attaches an entity to a parent, so its position, scale and rotation become relative to the parent.
+    // an invalid parent detaches the entity. returns false if the parent is a descendant of the entity
+    bool set_parent(size_t idx, EntityHandle parent);
+
+    // transform of an entity in world space, only valid after update_transforms()
+    inline const NodeTransform& world(size_t idx) const { return scene.world(nodes[idx]); }
+
+    // appends the indices of entities whose world bounds intersect the box, only valid after update_transforms()
+    void query_aabb(const glm::vec3& min_pt, const glm::vec3& max_pt, std::vector<u32>& out) const;
+
+    // appends the indices of entities whose world bounds intersect the sphere
+    void query_sphere(const glm::vec3& center, f32 radius, std::vector<u32>& out) const;
+
+    // appends the indices of entities whose world bounds intersect the first n_planes planes of the frustum
+    void query_frustum(const Frustum& frustum, u32 n_planes, std::vector<u32>& out) const;
+
+    // finds the closest triangle hit by the ray before max_t, only valid after update_transforms()
+    //
+    // note: entities are found through the bvh, then the triangle bvh of each of their meshes is traversed
+    // with the ray moved into the mesh's space
+    RayHit raycast(const glm::vec3& origin, const glm::vec3& dir,
+                   f32 max_t = std::numeric_limits<f32>::infinity()) const;
+
+    // scene node a mesh of the entity's model is attached to
+    inline u32 mesh_node(size_t idx, u32 mesh_idx) const { return model_nodes[idx][models[idx].meshes[mesh_idx].node_idx]; }
+
+    // SoA of live entities, should all be equal length
+    std::vector<EntityHandle> handles;
     std::vector<u64> ids;
-    std::vector<bool> slot_empty;
     std::vector<Model> models;
     std::vector<glm::vec3> positions;
     std::vector<glm::vec3> scales;
     std::vector<glm::vec3> rotations;
     std::vector<PtLight> light_data;
     std::vector<EntityFlags> flags;
+    std::vector<EntityHandle> parents;          // entity each entity is attached to, invalid if none
+    std::vector<u32> nodes;                     // scene node of each entity
+    std::vector<std::vector<u32>> model_nodes;  // scene nodes of each node of the entity's model
+    std::vector<u8> transform_dirty;
+    std::vector<u32> proxies;                   // proxy of each entity's world bounds in the bvh
+    std::vector<u32> light_handles;             // handle of each light emitter in the light registry
+
+    // indexed by slot
+    std::vector<u32> sparse;                    // index of the slot's entity
+    std::vector<u32> generations;               // bumped when the slot's entity is deleted
+    std::vector<u32> free_slots;
+
+    std::vector<EntityHandle> dirty_handles;    // entities changed since the last update
+
+    // every entity is a node, with the nodes of its model attached to it
+    SceneGraph scene;
+    std::vector<u32> node_slots;                // slot of the entity owning each scene node, invalid for model nodes
+
+    // world bounds of every entity, leaves hold the entity's slot
+    DynamicBVH bvh;
+
+    // light emitters, with their world positions kept up to date by update_transforms()
+    LightRegistry lights;
 
     // right now, only a single point light can cast shadows
-    // this stores the index of the current caster until support
+    // this stores the handle of the current caster until support
     // is extended for multiple casters
-    u32 pt_caster_idx = 0;
+    EntityHandle pt_caster = invalid_entity;
 
     // used to assign an id to an entity, always increasing
     u64 id_counter = 0;
-    std::vector<i64> free_idxs;  // free indices
+
+private:
+    // appends an entity with the given components and returns its index
+    size_t push(Model&& model, const glm::vec3& pos, const glm::vec3& scale, const glm::vec3& rotation,
+                const PtLight& light, EntityFlags ent_flags, EntityHandle parent);
+
+    // moves the last entity into the given index
+    void swap_remove(size_t idx);
+
+    inline void set_node_slot(u32 node, u32 slot) {
+        if (node >= node_slots.size()) {
+            node_slots.resize(node + 1, SceneGraph::invalid_node);
+        }
+        node_slots[node] = slot;
+    }
+
+    // updates the world bounds of an entity in the bvh
+    void refit(size_t idx);
+
+    // replaces the slots of the entities in out from the given position onwards with their indices
+    void slots_to_indices(std::vector<u32>& out, size_t first) const;
+
+    // scratch space
+    std::vector<u32> dirty_idxs;
+    std::vector<u32> removed_nodes;
 };
 
 #endif
\ No newline at end of file
@@ -7,6 +7,7 @@
 
 #include <rose/app_state.hpp>
 #include <rose/camera.hpp>
+#include <rose/snapshot.hpp>
 
 #ifdef USE_OPENGL
 #include <rose/backends/gl/backend.hpp>
@@ -16,11 +17,10 @@ static_assert("no backend selected");
 
 namespace gui {
 
-struct GuiRet {
-    bool light_changed = false; // indicated whether a light was changed from within the GUI
-};
+void imgui(AppState& app_state, gl::Backend& backend);
 
-GuiRet imgui(AppState& app_state, gl::Backend& backend);
+// lists the entities added by a snapshot from first_new on and keeps its stats for the readout
+void scene_loaded(AppState& app_state, size_t first_new, const SnapshotStats& stats);
 
 }
 
@@ -0,0 +1,104 @@
+// =============================================================================
+//   level of detail for point lights, merging distant groups of lights
+// =============================================================================
+
+#ifndef ROSE_INCLUDE_LIGHT_LOD
+#define ROSE_INCLUDE_LIGHT_LOD
+
+#include <rose/lighting.hpp>
+#include <rose/core/core.hpp>
+#include <rose/core/types.hpp>
+
+#include <glm.hpp>
+
+#include <array>
+#include <limits>
+#include <vector>
+
+// a group of lights standing in for its members, or for the groups of the level below
+struct LightGroup {
+    u64 key = 0;            // colour bucket and Morton code of the group's cell
+    glm::vec4 pos;          // intensity weighted centre of the members
+    PtLight light;          // combined intensity, averaged colour and a radius reaching every member's
+    u32 first = 0;          // first member within the level below, or within the sorted lights for level 0
+    u32 count = 0;
+};
+
+struct LightLodStats {
+    f64 build_ms = 0.0;
+    f64 select_ms = 0.0;
+    u32 n_lights = 0;       // lights in the scene
+    u32 n_selected = 0;     // lights handed to the renderer, aggregated ones included
+    u32 n_aggregated = 0;   // groups handed to the renderer in place of their members
+    u32 n_blending = 0;     // groups between levels, drawn alongside their members
+    u32 n_builds = 0;
+    std::array<u32, 4> n_groups = {};
+};
+
+// hierarchy over the point lights by position and colour, with groups replaced by a single light far from the
+// camera
+//
+// lights are bucketed by their normalized colour and keyed by the Morton code of the cell of base_cell units
+// they fall in. after sorting, the groups of each level are runs of equal keys, with each level's cells twice
+// the size of the level below so that groups nest. a group is merged once the camera is lod_ratio of its cell
+// size away. over the following band of transition * lod_ratio cells its light fades in as its members fade
+// out, so levels change without popping
+struct LightLod {
+
+    static constexpr u32 n_levels = 4;
+
+    // rebuilds the hierarchy if any light of the registry changed and selects the lights to shade for the camera
+    void update(LightRegistry& registry, glm::vec3 camera_pos, bool rebuild = false);
+
+    f32 base_cell = 8.0f;       // size of the cells of level 0
+    f32 lod_ratio = 8.0f;       // distance at which groups start to merge, in cell sizes
+    f32 transition = 0.5f;      // fraction of lod_ratio over which a group fades in
+    u32 n_color_steps = 3;      // buckets per channel of a light's normalized colour
+
+    // note: merged lights can not be matched to a shadow casting light
+    static constexpr u32 aggregate_id = std::numeric_limits<u32>::max();
+
+    // lights to shade. entries keep their handle while selected, so only those whose weight or membership
+    // changed are written again
+    LightRegistry lights;
+
+    std::vector<u32> order;     // lights of the registry in sorted order
+    std::array<std::vector<LightGroup>, n_levels> levels;
+
+    // scratch space, kept between frames so steady frames do not allocate
+    struct Key {
+        u64 key;
+        u32 light;
+    };
+    std::vector<Key> keys;
+    std::vector<LightRange> ranges;
+    u32 n_built = 0;            // lights the hierarchy was built over
+
+    // what a group or light of the scene was last shown as within lights
+    struct Slot {
+        u32 handle = LightRegistry::invalid_handle;
+        f32 weight = 0.0f;      // negative once the light changed and has to be added again
+        u32 frame = 0;          // last frame it was selected
+    };
+    std::array<std::vector<Slot>, n_levels> group_slots;
+    std::vector<Slot> light_slots;      // indexed by the handle of the scene's light
+
+    // slots holding an entry of lights, level is n_levels for the scene's lights
+    struct Shown {
+        u32 level;
+        u32 item;
+    };
+    std::vector<Shown> shown;
+    u32 frame = 0;
+
+    LightLodStats stats;
+
+private:
+    void build(const LightRegistry& registry);
+    void select(const LightRegistry& registry, u32 level, u32 group, f32 weight, glm::vec3 camera_pos);
+    void show(Shown as, const PtLight& light, glm::vec3 pos, u32 id, f32 weight);
+    void drop_stale();
+    Slot& slot(Shown as);
+};
+
+#endif
\ No newline at end of file
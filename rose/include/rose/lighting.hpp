@@ -16,6 +16,10 @@ static_assert("no backend selected");
 
 #include <glm.hpp>
 
+#include <array>
+#include <limits>
+#include <vector>
+
 struct DirLight {
     glm::vec3 direction = { 0.0f, -0.999848f, -0.0174525f };
     glm::vec3 color = { 0.55f, 0.55f, 0.55f };
@@ -31,20 +35,110 @@ struct DirLight {
 // obtains a projection-view matrix for a directional light
 glm::mat4 get_cascade_mat(const glm::mat4& proj, const glm::mat4& view, glm::vec3 direction, f32 resolution);
 
-// state for a singular point light
-// 
-// note: padding added to meet std430 layout requirements
+// state for a singular point or spot light
+//
+// a spot light shines along direction, at full strength inside its inner cone and fading out to its outer
+// cone. cones are at most a hemisphere wide, as the culling of spot lights relies on it
+//
+// note: laid out to meet std430 layout requirements
 struct PtLight {
     glm::vec4 color = { 0.5f, 0.5f, 0.5f, 1.0f };
     f32 radius = 25.0f;
     f32 intensity = 1.0f;
-    u8 padding[8] = { 0 };
+    f32 inner_cos = -1.0f;          // cosine of the half angle of the inner cone
+    f32 outer_cos = -1.0f;          // cosine of the half angle of the outer cone, -1 for point lights
+    glm::vec4 direction = { 0.0f, -1.0f, 0.0f, 0.0f };  // world space, only used by spot lights
+
+    inline bool is_spot() const { return outer_cos > -1.0f; }
+};
+
+static_assert(sizeof(PtLight) == 48, "PtLight must match the layout of PointLight in the shaders");
+
+// range of lights [begin, end) within the registry
+struct LightRange {
+    u32 begin = 0;
+    u32 end = 0;
+};
+
+// point lights packed densely in the order shaders read them, with stable handles. removing a light moves
+// the last one into its place. every changed entry is flagged individually, so only those need to be
+// uploaded
+struct LightRegistry {
+
+    // adds a light and returns its handle, which stays valid until the light is removed
+    u32 add(const PtLight& light, const glm::vec3& pos, u32 id);
+
+    void remove(u32 handle);
+
+    void set_light(u32 handle, const PtLight& light);
+
+    // only flags the light if its position actually changed
+    void set_pos(u32 handle, const glm::vec3& pos);
+
+    // flags every light, used when the GPU copy has to be rebuilt
+    void mark_all_dirty();
+
+    // removes every light and invalidates all handles, keeping the space of the arrays
+    void clear();
+
+    // sorts the changed entries into ranges and clears their flags. ranges separated by fewer than max_gap
+    // unchanged entries are merged
+    void take_dirty_ranges(std::vector<LightRange>& ranges, u32 max_gap);
+
+    inline u32 size() const { return (u32)data.size(); }
+
+    // position of a light within the dense arrays
+    inline u32 index(u32 handle) const { return sparse[handle]; }
+
+    static constexpr u32 invalid_handle = std::numeric_limits<u32>::max();
+
+    // dense, in the layout uploaded to the GPU
+    std::vector<PtLight> data;
+    std::vector<glm::vec4> positions;
+    std::vector<u32> ids;
+    std::vector<u32> handles;       // handle of each light
+
+    std::vector<u32> sparse;        // indexed by handle
+    std::vector<u32> free_handles;
+
+    std::vector<u8> dirty;          // per light
+    std::vector<u32> dirty_idxs;    // lights flagged since the last take_dirty_ranges()
+
+private:
+    void mark_dirty(u32 idx);
 };
 
 // state used for clustered shading
+//
+// the screen is split into square tiles of tile_sz pixels and each tile into slices along the depth. the first
+// slice reaches from the near plane to near_slice_z, as slices close to the camera would otherwise be too thin
+// to hold anything, and the rest are spaced logarithmically out to the far plane so that each is about as deep
+// as it is wide. when tuning, the tile size is stepped through tile_sizes to keep the average light list of
+// the clusters close to target_lights
 struct Clusters {
-    glm::uvec3 grid_sz = { 16, 9, 24 };      // size of cluster grid (xyz)
-    u32 max_lights_in_cluster = 100;         // number of lights that will be considered for a single cluster
+
+    // derives the grid from the screen size and projection, returns true if its dimensions changed
+    bool fit(glm::uvec2 screen_dims, f32 fov_y, f32 near_z, f32 far_z);
+
+    // steps the tile size towards target_lights given the average length of the non-empty light lists of a
+    // frame, returns true if the tile size changed
+    bool tune(f32 avg_lights);
+
+    inline u32 n_clusters() const { return grid_sz.x * grid_sz.y * grid_sz.z; }
+
+    static constexpr std::array<u32, 5> tile_sizes = { 16, 32, 64, 128, 256 };
+
+    glm::uvec3 grid_sz = { 0, 0, 0 };        // size of cluster grid (xyz)
+    u32 tile_sz = 64;                        // width and height of a cluster in pixels
+    f32 near_slice_z = 5.0f;                 // far end of the first depth slice
+    f32 split_z = 0.0f;                      // near_slice_z kept within the depth range, as used by the grid
+    u32 min_slices = 8;
+    u32 max_slices = 32;                     // note: lighting_tiled.comp keeps a bit per slice, so at most 32
+
+    bool auto_tune = false;
+    f32 target_lights = 16.0f;
+    u32 tune_interval = 30;                  // frames between changes, letting the measurements settle
+    u32 frames_since_tune = 0;
 
 #ifdef USE_OPENGL
     gl::ClustersData gl_data;
@@ -11,13 +11,17 @@
 static_assert("no backend selected");
 #endif 
 
+#include <rose/raycast.hpp>
+#include <rose/scene.hpp>
 #include <rose/texture.hpp>
+#include <rose/core/types.hpp>
 
 #include <glm.hpp>
 #include <gtc/matrix_transform.hpp>
 
 #include <concepts>
 #include <filesystem>
+#include <memory>
 #include <vector>
 
 template <typename T>
@@ -59,6 +63,25 @@ struct Mesh {
     u32 matl_offset = 0;
     u32 n_matls = 0;
     MeshFlags flags = MeshFlags::NONE;
+    u32 node_idx = 0;   // node the mesh is attached to
+    Bounds bounds;      // bounds of the mesh's vertices, relative to its node
+};
+
+// a node of the model's hierarchy, as stored in the source file
+struct ModelNode {
+    NodeTransform local;    // relative to the parent node
+    i32 parent = -1;        // index of the parent node, -1 for the root
+};
+
+// textures referenced by a model, decoded on import and created when the model is finalized
+struct ModelTextures {
+    struct Slot {
+        u32 image = 0;  // index into images
+        u32 mesh = 0;   // mesh the texture belongs to
+    };
+
+    std::vector<TextureImage> images;   // one per distinct path
+    std::vector<Slot> slots;            // one per entry of Model::textures
 };
 
 struct Model {
@@ -75,23 +98,48 @@ struct Model {
 
     void load(TextureManager& manager, const std::filesystem::path& path);
 
+    // reads the geometry of a model and decodes its textures without touching the GPU, so it can be done on
+    // any thread. textures already loaded by the manager are not decoded again, the manager is only read
+    // and may be null. returns false if the file could not be imported
+    bool import(const std::filesystem::path& path, ModelTextures& tex_data, const TextureManager* manager = nullptr);
+
+    // creates the textures and GPU buffers of an imported model
+    void finalize(TextureManager& manager, ModelTextures& tex_data);
+
+    // memory used by the model's vertex and index data, which is held both on the CPU and GPU
+    u64 geometry_bytes() const;
+
+    // memory used by the model's textures
+    u64 texture_bytes() const;
+
     inline void reset() { model_mat = glm::mat4(1.0f); }
 
+    // vertex array of the model's geometry, 0 if the model was never finalized
+    inline u32 vao() const { return render_data ? render_data->vao : 0; }
+
+    // GPU buffers of the geometry, created when finalized. copies share them and their materials, so the
+    // draws of every copy can be submitted with the same vertex array
 #ifdef  USE_OPENGL
-    gl::RenderData render_data;
+    std::shared_ptr<gl::RenderData> render_data;
 #else
     static_assert("no backend selected");
 #endif 
 
     glm::mat4 model_mat = glm::mat4(1.0f);
+    fs::path path;  // file the model was imported from
     std::vector<Mesh> meshes;
+    std::vector<ModelNode> nodes;   // depth-first order, so parents precede their children
     std::vector<TextureRef> textures;
+    Bounds bounds;  // model space bounds enclosing all meshes
 
     std::vector<u32> indices;
     std::vector<glm::vec3> pos;
     std::vector<glm::vec3> norms;
     std::vector<glm::vec3> tangents;
     std::vector<glm::vec2> uvs;
+
+    // triangle bvh of each mesh, relative to its node. built on import and never changed, so copies share it
+    std::shared_ptr<const std::vector<TriangleBVH>> mesh_bvhs;
 };
 
 struct SkyBox {
@@ -113,6 +161,7 @@ struct SkyBox {
     glm::mat4 model_mat = glm::mat4(1.0f);
 
     TextureRef texture;
+    std::array<fs::path, 6> paths;  // faces of the loaded cubemap, empty for the default one
     u32 vao = 0;
     u32 verts_buf = 0;
 
@@ -0,0 +1,90 @@
+// =============================================================================
+//   CPU occlusion culling against a software rasterized depth buffer
+// =============================================================================
+
+#ifndef ROSE_INCLUDE_OCCLUSION
+#define ROSE_INCLUDE_OCCLUSION
+
+#include <rose/culling.hpp>
+#include <rose/core/core.hpp>
+#include <rose/core/thread_pool.hpp>
+
+#include <glm.hpp>
+
+#include <array>
+#include <span>
+#include <vector>
+
+// a mesh drawn into the occlusion buffer
+struct OccluderMesh {
+    std::span<const glm::vec3> pos;     // vertices the indices refer to
+    std::span<const u32> indices;
+    glm::mat4 transform;                // model matrix
+};
+
+// a triangle of an occluder after projection, ready to be rasterized
+//
+// note: edge functions are non-negative inside the triangle and are evaluated at pixel centers
+struct OccluderTri {
+    std::array<f32, 3> edge_a;
+    std::array<f32, 3> edge_b;
+    std::array<f32, 3> edge_c;
+    f32 z_dx = 0.0f;    // plane of inverse depth across the screen
+    f32 z_dy = 0.0f;
+    f32 z_0 = 0.0f;
+    i32 min_x = 0;      // pixel bounds, clamped to the buffer
+    i32 max_x = 0;
+    i32 min_y = 0;
+    i32 max_y = 0;
+};
+
+struct OcclusionStats {
+    u32 n_occluders = 0;
+    u32 n_tris = 0;
+    u32 n_tested = 0;
+    u32 n_occluded = 0;
+    f64 raster_ms = 0.0;
+    f64 test_ms = 0.0;
+};
+
+// low resolution depth buffer that occluders are rasterized into, eight pixels at a time. each pixel holds
+// the inverse depth (1 / w) of the closest occluder, so empty pixels are 0. instance bounds are then tested
+// against it before any draws are issued.
+//
+// the buffer is split into horizontal bands that are rasterized on separate threads. as each pixel only
+// keeps the maximum of the values written to it, the result does not depend on how work is scheduled
+//
+// note: does not depend on the graphics API and can run without a context
+struct OcclusionBuffer {
+
+    // width is rounded up to a multiple of eight, work is spread across the threads of the pool if given
+    void init(u32 w, u32 h, ThreadPool* pool = nullptr);
+
+    // clears the buffer and rasterizes every triangle of the occluders in front of the near plane
+    void render(std::span<const OccluderMesh> occluders, const glm::mat4& proj_view, f32 near_z);
+
+    // returns true if the box is hidden behind the rasterized occluders
+    bool occluded(const glm::vec3& center, const glm::vec3& extent) const;
+
+    // removes instances hidden behind the rasterized occluders from the list, preserving order
+    void cull(const CullBounds& bounds, std::vector<u32>& visible);
+
+    u32 width = 0;
+    u32 height = 0;
+    std::vector<f32> depth;                 // row major, inverse depth of the closest occluder
+
+    glm::mat4 proj_view = glm::mat4(1.0f);  // projection-view the current contents were rendered with
+    f32 near_z = 0.0f;
+
+    std::vector<OccluderTri> tris;
+    std::vector<std::vector<OccluderTri>> mesh_tris;   // triangles set up for each occluder
+    std::vector<u8> hidden;                             // per entry of the list being culled
+
+    ThreadPool* pool = nullptr;
+    OcclusionStats stats;
+
+    static constexpr u32 band_height = 16;  // rows rasterized by a single job
+    static constexpr u32 test_batch = 256;  // instances tested by a single job
+};
+
+#endif
\ No newline at end of file
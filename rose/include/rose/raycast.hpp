@@ -0,0 +1,79 @@
+// =============================================================================
+//   ray intersection against boxes and triangle meshes
+// =============================================================================
+
+#ifndef ROSE_INCLUDE_RAYCAST
+#define ROSE_INCLUDE_RAYCAST
+
+#include <rose/core/core.hpp>
+
+#include <glm.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <span>
+#include <vector>
+
+// returns the distance at which a ray enters a box, or infinity if it misses the box or enters it past max_t
+//
+// note: takes the reciprocal of the ray direction, so it can be computed once per ray
+inline f32 ray_box(const glm::vec3& min_pt, const glm::vec3& max_pt, const glm::vec3& origin, const glm::vec3& inv_dir,
+                   f32 max_t) {
+    glm::vec3 t0 = (min_pt - origin) * inv_dir;
+    glm::vec3 t1 = (max_pt - origin) * inv_dir;
+    glm::vec3 t_near = glm::min(t0, t1);
+    glm::vec3 t_far = glm::max(t0, t1);
+    f32 enter = std::max({ t_near.x, t_near.y, t_near.z, 0.0f });
+    f32 exit = std::min({ t_far.x, t_far.y, t_far.z, max_t });
+    return enter <= exit ? enter : std::numeric_limits<f32>::infinity();
+}
+
+// node of a flattened triangle bvh, sized and aligned so two siblings share a cache line
+//
+// note: interior nodes have a count of 0 and their children are stored next to each other at left_first
+// and left_first + 1, leaves reference count triangles starting at left_first
+struct alignas(32) TriBVHNode {
+    glm::vec3 min_pt;
+    u32 left_first = 0;
+    glm::vec3 max_pt;
+    u32 count = 0;
+};
+
+// triangle stored as a vertex and two edges, as needed by the intersection test
+struct BVHTri {
+    glm::vec3 v0;
+    glm::vec3 e1;
+    glm::vec3 e2;
+};
+
+struct TriHit {
+    f32 t = std::numeric_limits<f32>::infinity();   // only hits closer than this are reported
+    u32 tri = 0;                                    // index of the triangle within the mesh
+    f32 u = 0.0f;                                   // barycentrics of the hit relative to v1 and v2
+    f32 v = 0.0f;
+};
+
+// bounding volume hierarchy over the triangles of a mesh, built with binned SAH and stored depth-first so a
+// ray only touches the nodes and triangles along its path
+struct TriangleBVH {
+
+    // builds the hierarchy over indexed triangles, indices are relative to the start of pos
+    void build(std::span<const glm::vec3> pos, std::span<const u32> indices);
+
+    // finds the closest triangle the ray hits before hit.t, returns true and updates the hit if there is one
+    //
+    // note: triangles are hit from both sides
+    bool intersect(const glm::vec3& origin, const glm::vec3& dir, TriHit& hit) const;
+
+    inline bool empty() const { return tris.empty(); }
+
+    std::vector<TriBVHNode> nodes;
+    std::vector<BVHTri> tris;       // in leaf order
+    std::vector<u32> tri_ids;       // index of each triangle within the mesh
+
+    static constexpr u32 n_bins = 16;
+    static constexpr u32 max_leaf_sz = 8;   // leaves larger than this are split even if SAH prefers not to
+    static constexpr u32 max_depth = 64;
+};
+
+#endif
\ No newline at end of file
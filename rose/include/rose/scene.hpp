@@ -0,0 +1,96 @@
+// =============================================================================
+//   transform hierarchy of the scene
+// =============================================================================
+
+#ifndef ROSE_INCLUDE_SCENE
+#define ROSE_INCLUDE_SCENE
+
+#include <rose/core/core.hpp>
+
+#include <glm.hpp>
+
+#include <limits>
+#include <span>
+#include <vector>
+
+// a transform and the matrix used to transform normals through it
+//
+// note: layout matches the instance records read by shaders
+struct NodeTransform {
+    glm::mat4 mat = glm::mat4(1.0f);
+    glm::mat4 normal = glm::mat4(1.0f); // inverse transpose of mat, only the upper 3x3 is used
+};
+
+// range of positions in depth-first order
+struct NodeRange {
+    u32 begin = 0;
+    u32 end = 0;
+};
+
+// hierarchy of transforms where each node is placed relative to its parent
+//
+// nodes are referenced through stable handles, while world transforms are stored in depth-first order so a
+// parent always precedes its children and every subtree occupies a contiguous range. changing a node only
+// recomputes its subtree, and frames where nothing changed cost nothing. changes to the structure of the
+// hierarchy are deferred and rebuild the order once during the next update. world transforms are carried over
+// to the new order, so only the subtrees of nodes that were added, moved or detached are recomputed
+struct SceneGraph {
+
+    // adds a node under the given parent, or as a root if parent is invalid_node, and returns its handle
+    u32 add(u32 parent, const NodeTransform& local);
+
+    // removes a node, its children become roots
+    void remove(u32 node);
+
+    // removes every node in the list, children of removed nodes become roots
+    void remove(std::span<const u32> nodes);
+
+    // moves a node and its subtree under a new parent, or makes it a root if parent is invalid_node
+    void set_parent(u32 node, u32 parent);
+
+    // replaces the transform of a node relative to its parent
+    void set_local(u32 node, const NodeTransform& local);
+
+    // recomputes the world transforms of every changed subtree
+    void update();
+
+    // position of a node within the depth-first order, only valid after update()
+    inline u32 pos(u32 node) const { return node_pos[node]; }
+
+    // world transform of a node, only valid after update()
+    inline const NodeTransform& world(u32 node) const { return transforms[node_pos[node]]; }
+
+    inline u32 size() const { return (u32)order.size(); }
+
+    static constexpr u32 invalid_node = std::numeric_limits<u32>::max();
+
+    // indexed by handle
+    std::vector<u32> parents;
+    std::vector<NodeTransform> locals;
+    std::vector<u32> node_pos;
+    std::vector<u8> node_dirty;
+    std::vector<u32> free_nodes;
+
+    // indexed by position in depth-first order
+    std::vector<u32> order;             // handle of each node
+    std::vector<u32> order_parents;     // position of each node's parent
+    std::vector<u32> subtree_end;       // one past the last position of each node's subtree
+    std::vector<NodeTransform> transforms;
+
+    std::vector<u32> dirty_nodes;       // handles changed, added or moved since the last update
+    std::vector<NodeRange> updated;     // positions recomputed by the last update
+    bool structure_dirty = false;
+
+private:
+    void mark_dirty(u32 node);
+    void rebuild();
+    void update_range(u32 begin, u32 end);
+
+    std::vector<u32> child_offsets;     // scratch space used by rebuild()
+    std::vector<u32> children;
+    std::vector<u32> stack;
+    std::vector<u32> dirty_pos;
+    std::vector<u8> removed;
+};
+
+#endif
\ No newline at end of file
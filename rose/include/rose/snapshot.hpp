@@ -0,0 +1,94 @@
+// =============================================================================
+//   binary scene snapshots for fast scene start up
+// =============================================================================
+
+#ifndef ROSE_INCLUDE_SNAPSHOT
+#define ROSE_INCLUDE_SNAPSHOT
+
+#include <rose/entities.hpp>
+#include <rose/lighting.hpp>
+#include <rose/model.hpp>
+#include <rose/texture.hpp>
+#include <rose/core/core.hpp>
+#include <rose/core/err.hpp>
+#include <rose/core/thread_pool.hpp>
+
+#include <glm.hpp>
+
+#include <filesystem>
+#include <limits>
+#include <type_traits>
+
+// a snapshot is a header followed by fixed size tables, each at an 8 byte aligned offset from the start of the
+// file. assets are referenced by path through the path table, whose strings are packed in the string table
+//
+// note: values are stored in the layout of the machine that wrote them, snapshots are not meant to be portable
+struct SnapshotHeader {
+    u32 magic = 0;
+    u32 version = 0;
+    u64 file_sz = 0;
+    u32 n_entities = 0;
+    u32 n_paths = 0;
+    u64 entities_offset = 0;
+    u64 paths_offset = 0;
+    u64 strings_offset = 0;
+    u64 strings_sz = 0;
+    u32 pt_caster = 0;      // entity record of the shadow casting light, invalid_record if none
+    u32 skybox[6] = {};     // path of each cubemap face, invalid_record for the default cubemap
+};
+
+struct SnapshotPath {
+    u64 offset = 0;         // into the string table
+    u32 len = 0;
+    u32 padding = 0;
+};
+
+// entities are written in the order of the component arrays, parents refer to other records
+struct SnapshotEntity {
+    u32 model = 0;          // path of the entity's model
+    u32 parent = 0;         // invalid_record if the entity is not attached
+    EntityFlags flags = EntityFlags::NONE;
+    glm::vec3 pos = { 0.0f, 0.0f, 0.0f };
+    glm::vec3 scale = { 1.0f, 1.0f, 1.0f };
+    glm::vec3 rotation = { 0.0f, 0.0f, 0.0f };
+    PtLight light;
+};
+
+static_assert(std::is_trivially_copyable_v<SnapshotHeader> && std::is_trivially_copyable_v<SnapshotEntity>);
+
+namespace snapshot {
+
+constexpr u32 magic = 0x504E5352;   // "RSNP"
+constexpr u32 version = 2;
+constexpr u32 invalid_record = std::numeric_limits<u32>::max();
+
+} // namespace snapshot
+
+struct SnapshotStats {
+    u32 n_entities = 0;
+    u32 n_models = 0;       // distinct models referenced
+    u32 n_imported = 0;     // models imported from disk, the rest were copied from entities already in the scene
+    u32 n_failed = 0;       // models that could not be imported, their entities are skipped
+    f64 map_ms = 0.0;       // mapping and validating the file
+    f64 import_ms = 0.0;    // importing models across the thread pool
+    f64 finalize_ms = 0.0;  // uploading imported models
+    f64 instance_ms = 0.0;  // adding entities
+    f64 total_ms = 0.0;
+};
+
+// writes the entities and skybox of a scene. entities whose model was not imported from a file are left out,
+// along with the attachments to them
+rses save_snapshot(const fs::path& path, const Entities& entities, const SkyBox& skybox);
+
+// adds the entities of a snapshot to the scene and loads its skybox. the file is mapped rather than read, each
+// distinct model is then imported once, in parallel on the pool, and its entities are instanced from it. a model
+// already used by an entity in the scene is copied from that entity instead of being imported again
+//
+// entities of models that fail to import are skipped while the rest are still added, the failures are then
+// returned as an error along with the stats
+//
+// note: must be called on the thread owning the context
+rses load_snapshot(const fs::path& path, Entities& entities, SkyBox& skybox, TextureManager& manager,
+                   ThreadPool& pool, SnapshotStats* stats = nullptr);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,182 @@
+// =============================================================================
+//   streaming of world cells around the camera
+// =============================================================================
+
+#ifndef ROSE_INCLUDE_STREAMING
+#define ROSE_INCLUDE_STREAMING
+
+#include <rose/camera.hpp>
+#include <rose/entities.hpp>
+#include <rose/model.hpp>
+#include <rose/texture.hpp>
+#include <rose/core/core.hpp>
+
+#include <glm.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// limits on what the streamer keeps resident and how much it does per frame
+struct StreamBudgets {
+    u64 cpu_bytes = 2048ull << 20;  // model data held on the CPU by streamed entities and their models
+    u64 gpu_bytes = 1024ull << 20;  // buffers and textures of streamed entities and their models
+    u32 max_in_flight = 4;          // cells waiting on imports at once
+    f64 finalize_ms = 4.0;          // main thread time per frame spent uploading models and adding entities
+};
+
+enum class CellState : u8 {
+    UNLOADED,   // none of the cell's entities exist
+    LOADING,    // models of the cell are being imported
+    READY,      // models are resident, entities are waiting to be added
+    LOADED      // all entities of the cell exist
+};
+
+// square region of the world on the xz plane, listing the entities placed in it
+struct WorldCell {
+    glm::ivec2 coord = { 0, 0 };
+    std::vector<EntityCtx> ents;
+    std::vector<u32> models;            // streamed models used by the cell's entities, without duplicates
+    std::vector<u32> ent_models;        // streamed model of each entity
+
+    CellState state = CellState::UNLOADED;
+    std::vector<EntityHandle> handles;  // entities added for the cell while it is loaded
+    u32 n_pending = 0;                  // models still being imported
+    u32 load_id = 0;                    // bumped on every load request, stale import notifications are ignored
+    u64 cpu_bytes = 0;                  // memory of the cell's entities, kept after unloading as an estimate
+    f32 dist = 0.0f;                    // distance from the camera as of the last update
+    bool in_front = false;
+    std::chrono::steady_clock::time_point requested;
+};
+
+enum class StreamModelState : u8 { NONE, IMPORTING, RESIDENT, FAILED };
+
+// model shared by the cells that use it, entities are instanced from it
+struct StreamModel {
+    fs::path path;
+    Model prototype;
+    StreamModelState state = StreamModelState::NONE;
+    u32 n_users = 0;            // loading or loaded cells using the model
+    u64 cpu_bytes = 0;
+    u64 gpu_bytes = 0;
+
+    struct Waiter {
+        u32 cell;
+        u32 load_id;
+    };
+    std::vector<Waiter> waiters; // cells to notify once the import completes
+};
+
+struct StreamStats {
+    u32 n_cells = 0;
+    u32 n_loaded = 0;
+    u32 n_loading = 0;          // cells waiting on imports or on being added
+    u32 n_models = 0;           // resident streamed models
+    u32 n_entities = 0;         // entities added by the streamer
+    u64 cpu_bytes = 0;
+    u64 gpu_bytes = 0;
+    u64 peak_cpu_bytes = 0;
+    u64 peak_gpu_bytes = 0;
+    u64 n_loads = 0;            // cells loaded since the last reset
+    u64 n_unloads = 0;
+    u64 n_evictions = 0;        // cells unloaded to stay within budget rather than by distance
+    f64 last_latency_ms = 0.0;  // time from a cell being requested to all its entities existing
+    f64 avg_latency_ms = 0.0;
+    f64 max_latency_ms = 0.0;
+    f64 update_ms = 0.0;        // main thread time of the last update
+    bool budget_limited = false; // a wanted cell was not loaded as it would not fit in the budgets
+};
+
+// streams entities and their assets in and out of the scene by camera distance
+//
+// the world is split into cells on the xz plane. cells within load_dist of the camera are requested, nearest
+// and in front of the camera first, and their models are imported on worker threads. the main thread then
+// uploads each model once and instances the cell's entities from it, within a time slice per frame. loaded
+// cells are kept until they are farther than unload_dist, the gap between the two distances stops cells on
+// the boundary from being loaded and unloaded repeatedly. cells behind the camera are only wanted within
+// behind_dist, so memory goes to what is about to be seen. when a budget would be exceeded the farthest
+// loaded cells are evicted to make room for nearer ones
+struct WorldStreamer {
+
+    WorldStreamer() = default;
+
+    WorldStreamer(const WorldStreamer& other) = delete;
+    WorldStreamer& operator=(const WorldStreamer& other) = delete;
+
+    ~WorldStreamer();
+
+    // starts the import workers
+    void init(u32 n_workers = 2);
+
+    // places an entity in the cell containing its position, it is added to the scene once the cell is loaded
+    void add(const EntityCtx& ent_def);
+
+    // unloads all cells and forgets them
+    void clear(Entities& entities);
+
+    // loads and unloads cells for the camera's position, must be called on the thread owning the context
+    void update(const Camera& camera, Entities& entities, TextureManager& manager);
+
+    void reset_stats();
+
+    inline glm::ivec2 cell_coord(const glm::vec3& pos) const {
+        return { (i32)std::floor(pos.x / cell_sz), (i32)std::floor(pos.z / cell_sz) };
+    }
+
+    static inline u64 cell_key(const glm::ivec2& coord) { return ((u64)(u32)coord.x << 32) | (u32)coord.y; }
+
+    f32 cell_sz = 32.0f;
+    f32 load_dist = 160.0f;
+    f32 unload_dist = 224.0f;
+    f32 behind_dist = 48.0f;
+    StreamBudgets budgets;
+    StreamStats stats;
+
+    std::vector<WorldCell> cells;
+    std::unordered_map<u64, u32> cell_index;    // [ key, cell ]
+    std::vector<StreamModel> models;
+    std::unordered_map<fs::path, u32> model_index;
+
+    // imports run on the workers, results are handed back to update()
+    struct ImportRequest {
+        u32 model = 0;
+        fs::path path;
+    };
+
+    struct ImportResult {
+        u32 model;
+        Model prototype;
+        ModelTextures tex_data;
+        bool ok = false;
+    };
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable work_cv;
+    std::deque<ImportRequest> requests;     // guarded by mutex
+    std::vector<ImportResult> results;      // guarded by mutex
+    std::vector<ImportResult> pending;      // results taken from the workers but not yet finalized
+    bool stop = false;
+
+private:
+    void worker_loop();
+    void request_cell(u32 cell_idx);
+    void unload_cell(u32 cell_idx, Entities& entities);
+    void release_model(u32 model_idx);
+    void finish_model(ImportResult& result, TextureManager& manager);
+    void instance_cell(u32 cell_idx, Entities& entities);
+
+    std::vector<u32> ready_cells;           // cells with all models resident, in the order they became ready
+    u64 cpu_resident = 0;
+    u64 gpu_resident = 0;
+    u64 latency_sum_us = 0;
+};
+
+#endif
\ No newline at end of file
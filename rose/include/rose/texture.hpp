@@ -11,6 +11,7 @@
 #include <array>
 #include <expected>
 #include <filesystem>
+#include <memory>
 #include <optional>
 #include <unordered_map>
 
@@ -41,8 +42,16 @@ struct GL_Texture {
     u32 id = 0;
     TextureType ty = TextureType::NONE;
     TextureFlags flags = TextureFlags::NONE;
-
-    inline void free() { glDeleteTextures(1, &id); }
+    u64 handle = 0; // bindless handle, only created once the texture is used by an indirect draw
+    u64 n_bytes = 0; // size of the texture including its mips
+
+    inline void free() {
+        if (handle) {
+            glMakeTextureHandleNonResidentARB(handle);
+            handle = 0;
+        }
+        glDeleteTextures(1, &id);
+    }
 };
 
 struct TextureCount {
@@ -52,6 +61,24 @@ struct TextureCount {
 
 struct TextureManager;
 
+struct StbiDeleter {
+    void operator()(u8* data) const;
+};
+
+// pixels of a texture decoded from a file, which can be done on any thread. the texture is created from it
+// by TextureManager::upload_texture()
+struct TextureImage {
+    fs::path path;
+    TextureType ty = TextureType::NONE;
+    i32 width = 0;
+    i32 height = 0;
+    i32 n_channels = 0;                         // channels in the file, the pixels are always rgba8
+    std::unique_ptr<u8, StbiDeleter> data;      // null if the file could not be decoded
+};
+
+// decodes the texture at the given path, safe to call from any thread
+void decode_texture(const fs::path& path, TextureType ty, TextureImage& out);
+
 // reference to a texture, will reduce reference count on destruction
 struct TextureRef {
     TextureRef() = default;
@@ -75,11 +102,20 @@ struct TextureManager {
     void init();
     
     TextureRef load_texture(const fs::path& path, TextureType ty);
+
+    // creates a texture from decoded pixels, the default texture is returned if decoding failed
+    TextureRef upload_texture(const TextureImage& image);
+
     TextureRef load_cubemap(const std::array<fs::path, 6>& paths);
 
     TextureRef get_ref(const fs::path& path);
     TextureRef get_ref(u32 id);
 
+    inline bool is_loaded(const fs::path& path) const {
+        auto it = textures_index.find(path);
+        return it != textures_index.end() && loaded_textures.contains(it->second);
+    }
+
     std::unordered_map<u32, TextureCount> loaded_textures;  // [ id,  tex ]
     std::unordered_map<fs::path, u32> textures_index;       // [ path, id ]
 
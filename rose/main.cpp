@@ -10,7 +10,7 @@ static_assert("no backend selected");
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
-int main() {
+int main(int argc, char** argv) {
 
     /*
     A graphics API can be selected at compile time within Rose/CMakeLists.txt which resolves which 'backend'
@@ -36,6 +36,13 @@ int main() {
         return -1;
     }
 
+    // a scene snapshot given on the command line is loaded before the first frame
+    if (argc > 1) {
+        if (err = app.load_scene(backend, argv[1])) {
+            err::print(err);
+        }
+    }
+
     app.run(backend);
     app.finish(backend);
 
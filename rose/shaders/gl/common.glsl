@@ -0,0 +1,117 @@
+// =============================================================================
+//   declarations shared by every shader, inserted after the #version directive and defines
+// =============================================================================
+
+// note: only types, functions without side effects and buffers of the indirect path are declared here, so
+// shaders that do not use them are unaffected
+
+#ifdef INDIRECT_DRAW
+#extension GL_ARB_bindless_texture : require
+#endif
+
+// lights =========================================================================================
+
+// directional light properties
+struct DirLight {
+	vec3 direction;
+	vec3 color;
+	float ambient_strength;
+};
+
+// light parameters for a particular point or spot light
+struct PointLight {
+    vec4 color;
+    float radius;
+    float intensity;
+    float inner_cos;        // cosines of the half angles of a spot light's cones
+    float outer_cos;        // -1 for point lights
+    vec4 direction;         // world space direction of a spot light
+};
+
+// depth slice of a view space distance, the first slice ends at near_slice_z and the rest are spaced
+// logarithmically out to the far plane
+uint depth_slice(float z, float near_slice_z, float far_z, uint n_slices) {
+	if (z < near_slice_z) {
+		return 0u;
+	}
+	float t = log(z / near_slice_z) / log(far_z / near_slice_z);
+	return min(1u + uint(t * float(n_slices - 1u)), n_slices - 1u);
+}
+
+// note: like the cube map, the spot map holds distances to the light rather than depths
+float calc_spot_shadow(sampler2D shadow_map, mat4 shadow_mat, vec3 frag_pos, vec3 light_pos, float far_plane) {
+	vec4 frag_pos_ls = shadow_mat * vec4(frag_pos, 1.0);
+	vec2 coords = (frag_pos_ls.xy / frag_pos_ls.w) * 0.5 + 0.5;  // [ -1, 1 ] -> [ 0, 1 ]
+	if (frag_pos_ls.w <= 0.0 || any(lessThan(coords, vec2(0.0))) || any(greaterThan(coords, vec2(1.0)))) {
+		return 0.0;
+	}
+	float closest = texture(shadow_map, coords).r * far_plane;
+	float depth = length(frag_pos - light_pos);
+	float bias = 0.05;
+	return ((depth - bias) > closest) ? 1.0 : 0.0;
+}
+
+// materials and draws ============================================================================
+
+struct Material {
+	sampler2D	albedo_map;
+	sampler2D	normal_map;
+	sampler2D	displace_map;
+	sampler2D   pbr_map;
+	sampler2D   ao_map;
+	bool		has_albedo_map;
+	bool		has_normal_map;
+	bool		has_pbr_map;
+	bool		has_ao_map;
+};
+
+struct DrawRecord {
+	uint transform_idx;
+	uint matl_idx;
+	uint shadow_mask;
+};
+
+// material of a mesh, textures are bindless handles
+struct MaterialRecord {
+	uvec2 albedo_map;
+	uvec2 normal_map;
+	uvec2 pbr_map;
+	uvec2 ao_map;
+	uint  flags;
+	uint  padding;
+};
+
+// transforms of each entity
+struct InstanceRecord {
+	mat4 model;
+	mat4 normal_mat;	// inverse transpose of the model matrix
+};
+
+#ifdef INDIRECT_DRAW
+layout (std430, binding = 11) readonly buffer instances_ssbo {
+	InstanceRecord instances[];
+};
+
+layout (std430, binding = 12) readonly buffer draws_ssbo {
+	DrawRecord draws[];
+};
+
+layout (std430, binding = 13) readonly buffer materials_ssbo {
+	MaterialRecord materials[];
+};
+
+// note: the material index comes from per-draw data, so it is dynamically uniform within a draw
+Material fetch_material(uint matl_idx) {
+	MaterialRecord record = materials[matl_idx];
+	Material matl;
+	matl.albedo_map = sampler2D(record.albedo_map);
+	matl.normal_map = sampler2D(record.normal_map);
+	matl.pbr_map = sampler2D(record.pbr_map);
+	matl.ao_map = sampler2D(record.ao_map);
+	matl.has_albedo_map = (record.flags & 1u) != 0;
+	matl.has_normal_map = (record.flags & 2u) != 0;
+	matl.has_pbr_map = (record.flags & 4u) != 0;
+	matl.has_ao_map = (record.flags & 8u) != 0;
+	return matl;
+}
+#endif
\ No newline at end of file
@@ -23,25 +23,28 @@ in vs_data {
 	vec3  normal;			// tangent space
 	vec2  tex_coords;
 	float frag_pos_z_vs;	// view space
+#ifdef INDIRECT_DRAW
+	flat uint matl_idx;		// index into the materials buffer
+#endif
 } fs_in;
 
-struct Material {
-	sampler2D	albedo_map;
-	sampler2D	normal_map;
-	sampler2D	displace_map;
-	sampler2D   pbr_map;
-	sampler2D   ao_map;
-	bool		has_albedo_map;
-	bool		has_normal_map;
-	bool		has_pbr_map;
-	bool		has_ao_map;
-};
-
+#ifndef INDIRECT_DRAW
 uniform Material material;
+#endif
 
 void main() {
 
+#ifdef INDIRECT_DRAW
+	Material material = fetch_material(fs_in.matl_idx);
+#endif
+
 	vec3 norm = (material.has_normal_map) ? fs_in.tbn * (texture(material.normal_map, fs_in.tex_coords).rgb * 2.0f - 1.0f) : fs_in.normal;
+
+#ifdef DEPTH_PREPASS
+	// forward+ only keeps what the depth pyramid, cluster marking and SSAO read, the rest is shaded later
+	gbuf_pos = vec4(fs_in.frag_pos_ws, fs_in.frag_pos_z_vs);
+	gbuf_norm = vec4(normalize(norm), 1.0f);
+#else
 	
 	float roughness = 1.0f;
 	float ambient_occ = 1.0f;
@@ -69,4 +72,5 @@ void main() {
 	gbuf_color.a = ambient_occ;
 
 	gbuf_metallic = metallic;
+#endif
 }
\ No newline at end of file
@@ -15,8 +15,15 @@ out vs_data {
 	vec3  normal;			// tangent space
 	vec2  tex_coords;
 	float frag_pos_z_vs;	// view space z coordinate, used for clustered shading
+#ifdef INDIRECT_DRAW
+	flat uint matl_idx;		// index into the materials buffer
+#endif
 } vs_out;
 
+// note: forward+ depth tests opaque geometry drawn by lighting_forward.vert against the prepass drawn by
+// gbuf.vert, so both must place vertices identically
+invariant gl_Position;
+
 layout (std140, binding = 1) uniform globals_ubo {
 	mat4 projection;
 	mat4 view;
@@ -27,29 +34,30 @@ layout (std140, binding = 1) uniform globals_ubo {
 	float near_z;
 };
 
-struct Material {
-	sampler2D	albedo_map;
-	sampler2D	normal_map;
-	sampler2D	displace_map;
-	sampler2D   pbr_map;
-	sampler2D   ao_map;
-	bool		has_albedo_map;
-	bool		has_normal_map;
-	bool		has_pbr_map;
-	bool		has_ao_map;
-};
-
+#ifndef INDIRECT_DRAW
 uniform mat4 model;
+uniform mat4 normal_matrix;
 uniform Material material;
+#endif
 
 void main() {
+
+#ifdef INDIRECT_DRAW
+	DrawRecord draw = draws[gl_BaseInstance];
+	mat4 model = instances[draw.transform_idx].model;
+	mat3 normal_mat = mat3(instances[draw.transform_idx].normal_mat);
+	bool has_normal_map = (materials[draw.matl_idx].flags & 2u) != 0;
+	vs_out.matl_idx = draw.matl_idx;
+#else
+	mat3 normal_mat = mat3(normal_matrix);
+	bool has_normal_map = material.has_normal_map;
+#endif
 	
-	mat3 normal_mat = mat3(transpose(inverse(mat3(model))));
 	mat3 tbn = mat3(1.0);
 
 	// TODO: would much prefer to have a method for combining normal mapped
 	// and non normal mapped codepaths
-	if (material.has_normal_map) {
+	if (has_normal_map) {
 		vec3 t = normalize(normal_mat * tangent);
 		vec3 n = normalize(normal_mat * normal);
 		t = normalize(t - dot(t, n) * n);			// re-orthogonalize
@@ -0,0 +1,67 @@
+// =============================================================================
+//   fills out gbuffers from impostor atlases
+// =============================================================================
+
+#version 460 core
+
+// note: texels always lie behind the card, which keeps early depth testing against it
+layout (depth_greater) out float gl_FragDepth;
+
+layout (location = 0) out vec4  gbuf_pos;
+layout (location = 1) out vec4  gbuf_norm;
+layout (location = 2) out vec4  gbuf_color;
+layout (location = 3) out float gbuf_metallic;
+
+in vs_data {
+	vec2 tile_uv;			// position within the tile, [ 0, 1 ]
+	flat uvec2 tile;		// tile of the atlas holding the view
+	flat uint instance;
+} fs_in;
+
+layout (std140, binding = 1) uniform globals_ubo {
+	mat4 projection;
+	mat4 view;
+	vec3 camera_pos;
+	uvec3 grid_sz;				// cluster dimensions (xyz)
+	uvec2 screen_dims;			// screen [ width, height ]
+	float far_z;
+	float near_z;
+};
+
+struct ImpostorInstance {
+	mat4 model;
+	mat4 normal_mat;	// inverse transpose of the model matrix
+};
+
+layout (std430, binding = 21) readonly buffer instances_ssbo {
+	ImpostorInstance instances[];
+};
+
+// atlases share the gbuffer layout, positions and normals are in model space
+uniform sampler2D atlas_pos;
+uniform sampler2D atlas_norm;
+uniform sampler2D atlas_color;
+uniform sampler2D atlas_metallic;
+uniform uint tile_sz;
+
+void main() {
+
+	ivec2 texel = ivec2(fs_in.tile * tile_sz + min(uvec2(fs_in.tile_uv * float(tile_sz)), uvec2(tile_sz - 1)));
+
+	// texels the model did not cover were cleared to a zero normal
+	vec4 norm = texelFetch(atlas_norm, texel, 0);
+	if (dot(norm.xyz, norm.xyz) < 0.25) {
+		discard;
+	}
+
+	ImpostorInstance inst = instances[fs_in.instance];
+	vec3 pos_ws = vec3(inst.model * vec4(texelFetch(atlas_pos, texel, 0).xyz, 1.0));
+	vec4 pos_vs = view * vec4(pos_ws, 1.0);
+	vec4 pos_cs = projection * pos_vs;
+	gl_FragDepth = (pos_cs.z / pos_cs.w) * 0.5 + 0.5;
+
+	gbuf_pos = vec4(pos_ws, pos_vs.z);
+	gbuf_norm = vec4(normalize(mat3(inst.normal_mat) * norm.xyz), norm.a);
+	gbuf_color = texelFetch(atlas_color, texel, 0);
+	gbuf_metallic = texelFetch(atlas_metallic, texel, 0).r;
+}
\ No newline at end of file
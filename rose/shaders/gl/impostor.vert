@@ -0,0 +1,82 @@
+// =============================================================================
+//   expands impostor cards, facing the camera with the closest baked view
+// =============================================================================
+
+#version 460 core
+
+out vs_data {
+	vec2 tile_uv;			// position within the tile, [ 0, 1 ]
+	flat uvec2 tile;		// tile of the atlas holding the view
+	flat uint instance;
+} vs_out;
+
+layout (std140, binding = 1) uniform globals_ubo {
+	mat4 projection;
+	mat4 view;
+	vec3 camera_pos;
+	uvec3 grid_sz;				// cluster dimensions (xyz)
+	uvec2 screen_dims;			// screen [ width, height ]
+	float far_z;
+	float near_z;
+};
+
+struct ImpostorInstance {
+	mat4 model;
+	mat4 normal_mat;	// inverse transpose of the model matrix
+};
+
+layout (std430, binding = 21) readonly buffer instances_ssbo {
+	ImpostorInstance instances[];
+};
+
+uniform vec3 center;	// model space center of the bounding sphere the views were fitted to
+uniform float radius;
+uniform uint n_frames;	// tiles along each side of the atlas
+
+// note: must match oct_decode() in impostor.cpp
+vec3 oct_decode(vec2 p) {
+	vec3 dir = vec3(p.x, 1.0 - abs(p.x) - abs(p.y), p.y);
+	if (dir.y < 0.0) {
+		dir.x = (1.0 - abs(p.y)) * (p.x >= 0.0 ? 1.0 : -1.0);
+		dir.z = (1.0 - abs(p.x)) * (p.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return normalize(dir);
+}
+
+vec2 oct_encode(vec3 dir) {
+	dir /= abs(dir.x) + abs(dir.y) + abs(dir.z);
+	vec2 p = dir.xz;
+	if (dir.y < 0.0) {
+		p = (1.0 - abs(dir.zx)) * vec2(dir.x >= 0.0 ? 1.0 : -1.0, dir.z >= 0.0 ? 1.0 : -1.0);
+	}
+	return p;
+}
+
+void main() {
+
+	ImpostorInstance inst = instances[gl_InstanceID];
+
+	// direction towards the camera in model space, the transpose of the normal matrix is the inverse of
+	// the model matrix's rotation and scale
+	vec3 center_ws = vec3(inst.model * vec4(center, 1.0));
+	vec3 to_camera = normalize(transpose(mat3(inst.normal_mat)) * (camera_pos - center_ws));
+
+	// the tile baked from the closest direction
+	uvec2 tile = uvec2(clamp((oct_encode(to_camera) * 0.5 + 0.5) * float(n_frames), vec2(0.0), vec2(n_frames - 1)));
+	vec3 dir = oct_decode((vec2(tile) + 0.5) / float(n_frames) * 2.0 - 1.0);
+
+	// basis of the tile's view, as built by lookAt when baking
+	vec3 up = abs(dir.y) > 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+	vec3 s = normalize(cross(-dir, up));
+	vec3 u = cross(s, -dir);
+
+	// the card is placed at the front of the bounding sphere, texels are pushed back to their depth
+	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+	vec3 pos = center + dir * radius + (corner.x * s + corner.y * u) * radius;
+
+	vs_out.tile_uv = corner * 0.5 + 0.5;
+	vs_out.tile = tile;
+	vs_out.instance = uint(gl_InstanceID);
+
+	gl_Position = projection * view * inst.model * vec4(pos, 1.0);
+}
\ No newline at end of file
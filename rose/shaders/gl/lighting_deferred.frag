@@ -14,21 +14,16 @@ in vs_data {
 
 // struct definitions =============================================================================
 
-// directional light properties
-struct DirLight {
-	vec3 direction;
-	vec3 color;
-	float ambient_strength;
-};
-
 layout (std140, binding = 1) uniform globals_ubo {
 	mat4 projection;
 	mat4 view;
 	vec3 camera_pos;
 	uvec3 grid_sz;				// cluster dimensions (xyz)
+	uint tile_sz;				// width and height of a cluster in pixels
 	uvec2 screen_dims;			// screen [ width, height ]
 	float far_z;
 	float near_z;
+	float near_slice_z;		// far end of the first depth slice
 };
 
 const float pi = 3.14159265359;
@@ -48,21 +43,12 @@ uniform int n_cascades;					 // number of shadow cascades
 uniform float cascade_depths[3];		 // far depth of each shadow cascade
 uniform samplerCube pt_shadow_map;		 // shadow map for point lights
 uniform uint pt_caster_id;				 // id of the current shadow casting point light
+uniform bool spot_caster;				 // whether the shadow casting light is a spot light
+uniform sampler2D spot_shadow_map;		 // shadow map for a spot light
+uniform mat4 spot_shadow_mat;			 // projection-view of the spot shadow map
 uniform bool ssao_enabled;				 // indicates whether ambient occlusion is enabled	
 uniform sampler2D occlusion_tex;		 // per-fragment occlusion values
 
-// light parameters for a particular point light
-struct PointLight {
-    vec4 color;
-    float radius;
-    float intensity;
-};
-
-struct Cluster {
-    uint count;			// number of lights affecting the cluster
-    uint indices[100];	// indicies of lights up to a maximum of 100
-};
-
 // buffers ========================================================================================
 
 // global list of lights and their parameters
@@ -75,11 +61,49 @@ layout (std430, binding=4) buffer light_positions_ssbo {
     vec4 light_positions[];
 };
 
-// indices of lights affecting each cluster
-layout (std430, binding=5) buffer clusters_ssbo {
-    Cluster clusters[];
+// [ first index, number of lights ] of each cluster's range of light_indices
+layout (std430, binding=5) readonly buffer clusters_ssbo {
+    uvec2 clusters[];
+};
+
+// indices of the lights affecting each cluster, packed two to a uint when packed_indices is set
+layout (std430, binding=29) readonly buffer light_indices_ssbo {
+    uint pool_stats[4];     // allocation counter and statistics written by clusters_cull.comp
+    uint light_indices[];
+};
+
+uniform bool packed_indices;
+
+// index of the light in the given slot of light_indices
+uint cluster_light(uint slot) {
+	return packed_indices ? (light_indices[slot >> 1] >> ((slot & 1u) * 16u)) & 0xFFFFu : light_indices[slot];
+}
+
+// z binning ==========================================================================================
+
+// [ first, last ] sorted light of each depth bin, followed by the light in each sorted slot
+layout (std430, binding=30) readonly buffer zbin_data_ssbo {
+    uint zbin_data[];
+};
+
+// a bit per sorted light for each screen tile, set if the light overlaps the tile
+layout (std430, binding=31) readonly buffer zbin_masks_ssbo {
+    uint zbin_masks[];
 };
 
+uniform bool zbin_enabled;			// use z bins and tile masks rather than the cluster light lists
+uniform uint n_zbins;
+uniform uint zbin_words;			// uints in the mask of each tile
+uniform uint zbin_tile_sz;
+uniform uint zbin_tiles_x;
+
+// bits of the given word of a mask falling within the sorted lights [ first, last ]
+uint zbin_word_mask(uint word, uint first, uint last) {
+	uint lo = max(first, word * 32u) - word * 32u;
+	uint hi = min(last, word * 32u + 31u) - word * 32u;
+	return (0xFFFFFFFFu << lo) & (0xFFFFFFFFu >> (31u - hi));
+}
+
 // contains the light space matrix for each shadow map cascade
 layout(std140, binding=6) uniform light_space_mats_ubo {
 	mat4 ls_mats[3];
@@ -163,6 +187,14 @@ float calc_pt_shadow(vec3 frag_pos, vec3 light_pos, samplerCube shadow_map, floa
 	return shadow;
 }
 
+// falloff of a spot light from its inner to its outer cone, point lights are lit all around
+float calc_spot_factor(PointLight light, vec3 light_dir) {
+	if (light.outer_cos <= -1.0) {
+		return 1.0;
+	}
+	return smoothstep(light.outer_cos, light.inner_cos, dot(-light_dir, light.direction.xyz));
+}
+
 float calc_attenuation(float dist, float radius) {
 	float window = pow((max(1 - pow(dist / radius, 4), 0.0)), 2);
 	return window * (1.0 / (dist * dist + 0.001));
@@ -193,6 +225,7 @@ vec3 calc_pt_light(PointLight light, vec3 light_pos, uint light_id, vec3 frag_po
 	float attenuation = calc_attenuation(length(light_pos - frag_pos), light.radius);
 
 	vec3 light_dir = normalize(light_pos - frag_pos);
+	attenuation *= calc_spot_factor(light, light_dir);
 	vec3 view_dir = normalize(camera_pos - frag_pos);
 	vec3 half_dir = normalize(light_dir + view_dir);
 	float ndl = max(dot(normal, light_dir), 0.0);
@@ -205,7 +238,10 @@ vec3 calc_pt_light(PointLight light, vec3 light_pos, uint light_id, vec3 frag_po
 	vec3 kd = (vec3(1.0) - fres) * (1.0 - metallic);
 	vec3 radiance_out = (kd * albedo / pi + specular) * (light.color.rgb * attenuation) * ndl;
 
-	float shadow = (light_id == pt_caster_id) ? calc_pt_shadow(frag_pos, light_pos, shadow_map, far_z) : 0.0;
+	float shadow = 0.0;
+	if (light_id == pt_caster_id) {
+		shadow = spot_caster ? calc_spot_shadow(spot_shadow_map, spot_shadow_mat, frag_pos, light_pos, far_z) : calc_pt_shadow(frag_pos, light_pos, shadow_map, far_z);
+	}
 	return (1.0 - shadow) * radiance_out * light.intensity;
 }
 
@@ -226,19 +262,37 @@ void main() {
 
 	float ssao = (ssao_enabled) ? texture(occlusion_tex, fs_in.tex_coords).r : 1.0f;
 
-	// determine the cluster this fragment belongs in
-	uint cluster_z = uint((log(abs(frag_pos_z_vs) / near_z) * float(grid_sz.z)) / log(far_z / near_z));
-	vec2 cluster_sz = screen_dims / grid_sz.xy;
-	uvec3 cluster_coord = uvec3(gl_FragCoord.xy / cluster_sz, cluster_z);
-	uint cluster_idx = cluster_coord.x + (cluster_coord.y * grid_sz.x) + (cluster_coord.z * grid_sz.x * grid_sz.y);
-
 	// compute directional light contribution
 	vec3 result = calc_dir_light(frag_pos, frag_pos_z_vs, norm, albedo, roughness, metallic);
 
 	// compute contributions from point lights
-	for (uint idx = 0; idx < clusters[cluster_idx].count; ++idx) {
-		uint light_idx = clusters[cluster_idx].indices[idx];
-		result += calc_pt_light(light_data[light_idx], light_positions[light_idx].xyz, light_ids[light_idx], frag_pos, albedo, norm, roughness, metallic, pt_shadow_map);
+	if (zbin_enabled) {
+		// lights in both the depth bin's range and the tile's mask, a word of the mask at a time
+		uint bin = min(uint(abs(frag_pos_z_vs) / far_z * float(n_zbins)), n_zbins - 1u);
+		uint first = zbin_data[2u * bin];
+		uint last = zbin_data[2u * bin + 1u];
+		uvec2 tile = uvec2(gl_FragCoord.xy) / zbin_tile_sz;
+		uint mask_base = (tile.y * zbin_tiles_x + tile.x) * zbin_words;
+
+		for (uint word = first / 32u; first <= last && word <= last / 32u; ++word) {
+			uint bits = zbin_masks[mask_base + word] & zbin_word_mask(word, first, last);
+			while (bits != 0u) {
+				uint light_idx = zbin_data[2u * n_zbins + word * 32u + uint(findLSB(bits))];
+				bits &= bits - 1u;
+				result += calc_pt_light(light_data[light_idx], light_positions[light_idx].xyz, light_ids[light_idx], frag_pos, albedo, norm, roughness, metallic, pt_shadow_map);
+			}
+		}
+	} else {
+		// determine the cluster this fragment belongs in
+		uint cluster_z = depth_slice(abs(frag_pos_z_vs), near_slice_z, far_z, grid_sz.z);
+		uvec3 cluster_coord = uvec3(uvec2(gl_FragCoord.xy) / tile_sz, cluster_z);
+		uint cluster_idx = cluster_coord.x + (cluster_coord.y * grid_sz.x) + (cluster_coord.z * grid_sz.x * grid_sz.y);
+
+		uvec2 cluster = clusters[cluster_idx];
+		for (uint idx = cluster.x; idx < cluster.x + cluster.y; ++idx) {
+			uint light_idx = cluster_light(idx);
+			result += calc_pt_light(light_data[light_idx], light_positions[light_idx].xyz, light_ids[light_idx], frag_pos, albedo, norm, roughness, metallic, pt_shadow_map);
+		}
 	}
 	
 	// add ambient component
@@ -5,8 +5,21 @@ layout (location = 1) in vec3 normal;
 layout (location = 2) in vec3 tangent;
 layout (location = 3) in vec2 tex_coords;
 
+out vs_data {
+	flat uint shadow_mask;	// cascades (bits 0-2) and cube faces (bits 8-13) the mesh is visible in
+} vs_out;
+
+#ifndef INDIRECT_DRAW
 uniform mat4 model;
+uniform uint shadow_mask;
+#endif
 
 void main() {
+#ifdef INDIRECT_DRAW
+	DrawRecord draw = draws[gl_BaseInstance];
+	mat4 model = instances[draw.transform_idx].model;
+	uint shadow_mask = draw.shadow_mask;
+#endif
+	vs_out.shadow_mask = shadow_mask;
 	gl_Position = model * vec4(pos, 1.0);
 }
\ No newline at end of file
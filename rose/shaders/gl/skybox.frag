@@ -8,12 +8,6 @@ in vec3 tex_dir;
 
 out vec4 frag_color;
 
-struct DirLight {
-	vec3 direction;
-	vec3 color;
-	float ambient_strength;
-};
-
 layout (std140, binding = 1) uniform globals_ubo {
 	mat4 projection;
 	mat4 view;
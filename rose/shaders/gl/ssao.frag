@@ -23,6 +23,7 @@ layout (std140, binding = 1) uniform globals_ubo {
 uniform sampler2D gbuf_pos;
 uniform sampler2D gbuf_norms;
 uniform sampler2D noise_tex;
+uniform sampler2D hiz_tex;		// linear depth pyramid, only the first level is sampled
 uniform vec2 noise_scale;
 
 // contains identifiers for each light
@@ -50,7 +51,7 @@ void main() {
 		vec4 offset = projection * vec4(curr_sample, 1.0f);								  // [ view -> clip ]
 		offset.xyz /= offset.w; 
 		offset.xyz = offset.xyz * 0.5f + 0.5f;											  // [ -1, 1 ] -> [ 0, 1 ]
-		float sample_depth = vec3(view * vec4(texture(gbuf_pos, offset.xy).xyz, 1.0)).z;  // [ world -> view ]
+		float sample_depth = -textureLod(hiz_tex, offset.xy, 0).r;						  // [ linear -> view ]
 		float range = smoothstep(0.0f, 1.0f, radius / abs(curr_sample.z - pos.z));		  // remove values outside of radius
 		occlusion += ((sample_depth > curr_sample.z + bias) ? 1.0f : 0.0f) * range;
 	}
@@ -4,6 +4,8 @@
 
 void AppState::init()
 { 
+    streamer.init();
+
     // construct kernel for SSAO
 	std::random_device rd;
     std::mt19937 rng(rd());
@@ -13,6 +13,7 @@
 #include <stb_image.h>
 
 #include <array>
+#include <chrono>
 #include <format>
 #include <iostream>
 #include <print>
@@ -20,6 +21,27 @@
 
 namespace gl {
 
+// collects the opaque meshes of visible occluder entities
+static void gather_occluders(Entities& entities, const DrawList& draw_list, const std::vector<u32>& visible,
+                             ArenaVector<OccluderMesh>& occluders) {
+
+    occluders.reserve(visible.size());
+
+    for (u32 draw_idx : visible) {
+        u32 ent_idx = draw_list.draw_ents[draw_idx];
+        if (!entities.is_occluder(ent_idx) || draw_list.draw_groups[draw_idx] != DrawGroup::OPAQUE) {
+            continue;
+        }
+
+        const Model& model = entities.models[ent_idx];
+        const Mesh& mesh = model.meshes[draw_list.draw_meshes[draw_idx]];
+
+        occluders.push_back({ .pos = std::span<const glm::vec3>(model.pos).subspan(mesh.base_vert),
+                              .indices = std::span<const u32>(model.indices).subspan(mesh.base_idx, mesh.n_indices),
+                              .transform = entities.scene.transforms[draw_list.draws[draw_idx].transform_idx].mat });
+    }
+}
+
 static void GLAPIENTRY gl_debug_callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei len,
                                   const GLchar* msg, const void* user_param) {
     std::println("GL ERROR: type = {}, severity = {}, message = {}\n", type, severity, msg);
@@ -51,6 +73,14 @@ rses Backend::init(AppState& app_state) {
         return err.general("unable to initialize shaders");
     }
 
+    // indirect submission references textures through bindless handles
+    if (GLEW_ARB_bindless_texture) {
+        if (auto err = shaders.init_indirect()) {
+            return err.general("unable to initialize indirect shaders");
+        }
+        indirect_supported = true;
+    }
+
     texture_manager.init();
     backend_state.skybox.init();
     backend_state.skybox.texture = texture_manager.default_cubemap_ref;
@@ -81,25 +111,47 @@ rses Backend::init(AppState& app_state) {
         return err;
     }
 
+    // note: the multisampled target of forward+ is only created once MSAA is selected
+    i32 max_samples = 1;
+    glGetIntegerv(GL_MAX_SAMPLES, &max_samples);
+    max_msaa_samples = (u32)std::max(max_samples, 1);
+
     // uniform buffer initialization ==============================================================
 
-    glCreateBuffers(1, &backend_state.global_ubo);
-    glNamedBufferStorage(backend_state.global_ubo, 176, nullptr, GL_DYNAMIC_STORAGE_BIT);
-    glBindBufferBase(GL_UNIFORM_BUFFER, 1, backend_state.global_ubo);
-    glm::uvec2 screen_dims = { app_state.window_state.width, app_state.window_state.height };    
-    glNamedBufferSubData(backend_state.global_ubo, 144, 16, glm::value_ptr(clusters.grid_sz));
-    glNamedBufferSubData(backend_state.global_ubo, 160, 8, glm::value_ptr(screen_dims));
-    glNamedBufferSubData(backend_state.global_ubo, 168, 4, &app_state.camera.far_plane);
-    glNamedBufferSubData(backend_state.global_ubo, 172, 4, &app_state.camera.near_plane);
+    // note: initial size is a guess, the buffer grows if a frame needs more
+    if (auto err = backend_state.frame_data.init(1 << 20)) {
+        return err;
+    }
+
+    draw_list.init(backend_state.frame_data, indirect_supported);
+    occlusion_culler.init(draw_list);
+    impostors.init(backend_state.frame_data);
+
+    // note: the buffer only needs to be detailed enough to resolve large occluders
+    thread_pool.init();
+    occlusion_buffer.init(256, 128, &thread_pool);
+    depth_pyramid.init(app_state.window_state.width, app_state.window_state.height);
+
+    backend_state.globals.screen_dims = { app_state.window_state.width, app_state.window_state.height };
+    backend_state.globals.far_z = app_state.camera.far_plane;
+    backend_state.globals.near_z = app_state.camera.near_plane;
+    clusters.fit(backend_state.globals.screen_dims, glm::radians(app_state.camera.zoom), app_state.camera.near_plane,
+                 app_state.camera.far_plane);
+    backend_state.globals.grid_sz = clusters.grid_sz;
+    backend_state.globals.tile_sz = clusters.tile_sz;
+    backend_state.globals.near_slice_z = clusters.split_z;
 
     // ssbo initialization ========================================================================
 
-    i32 n_clusters = clusters.grid_sz.x * clusters.grid_sz.y * clusters.grid_sz.z;
+    u32 n_clusters = clusters.n_clusters();
     clusters.gl_data.aabb_ssbo.init(sizeof(AABB) * n_clusters, 2);
-    clusters.gl_data.lights_ssbo.init(sizeof(PtLight) * 1024, 3);
-    clusters.gl_data.lights_pos_ssbo.init(sizeof(glm::vec4) * 1024, 4);
-    lights_ids_ssbo.init(sizeof(u32) * 1024, 7);
-    clusters.gl_data.clusters_ssbo.init(sizeof(u32) * (1 + clusters.max_lights_in_cluster) * n_clusters, 5);
+    clusters.gl_data.lights.init(1024);
+    clusters.gl_data.lists.init(n_clusters);
+    clusters.gl_data.flags_ssbo.init(sizeof(u32) * n_clusters, 22);
+    clusters.gl_data.active_ssbo.init(sizeof(u32) * (4 + n_clusters), 23);
+    glClearNamedBufferData(clusters.gl_data.flags_ssbo.ssbo, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    clusters.gl_data.tree.init();
+    clusters.gl_data.zbins.init();
 
     // shadow map initialization ==================================================================
 
@@ -115,6 +167,12 @@ rses Backend::init(AppState& app_state) {
         return err;
     }
 
+    // ---- spot shadow map ----
+
+    if (auto err = backend_state.spot_shadow_data.init()) {
+        return err;
+    }
+
     // SSAO initialization ========================================================================
 
     // create random noise to rotate SSAO hemisphere along tangest space z-axis
@@ -141,6 +199,14 @@ rses Backend::init(AppState& app_state) {
     backend_state.ssao_samples_ssbo.init(sizeof(glm::vec4) * app_state.ssao_kernel.size(), 10);
     backend_state.ssao_samples_ssbo.update(std::span(app_state.ssao_kernel.begin(), app_state.ssao_kernel.end()));
 
+    // profiling initialization ===================================================================
+
+    backend_state.shadow_timer.init();
+    backend_state.gbuf_timer.init();
+    backend_state.forward_timer.init();
+    backend_state.cluster_timer.init();
+    backend_state.lighting_timer.init();
+
     // remaining set up ===========================================================================
 
     shaders.skybox.set_vec3("dir_light.direction", backend_state.dir_light.direction);
@@ -152,12 +218,25 @@ rses Backend::init(AppState& app_state) {
     shaders.lighting_deferred.set_vec3("dir_light.direction", backend_state.dir_light.direction);
     shaders.lighting_deferred.set_vec3("dir_light.color", backend_state.dir_light.color);
     shaders.lighting_deferred.set_f32("dir_light.ambient_strength", backend_state.dir_light.ambient_strength);
+
+    shaders.lighting_tiled.set_u32("pt_caster_id", 0);
+    shaders.lighting_tiled.set_bool("ssao_enabled", app_state.ssao_enabled);
+    shaders.lighting_tiled.set_vec3("dir_light.direction", backend_state.dir_light.direction);
+    shaders.lighting_tiled.set_vec3("dir_light.color", backend_state.dir_light.color);
+    shaders.lighting_tiled.set_f32("dir_light.ambient_strength", backend_state.dir_light.ambient_strength);
     
     shaders.lighting_forward.set_u32("pt_caster_id", 0);
     shaders.lighting_forward.set_vec3("dir_light.direction", backend_state.dir_light.direction);
     shaders.lighting_forward.set_vec3("dir_light.color", backend_state.dir_light.color);
     shaders.lighting_forward.set_f32("dir_light.ambient_strength", backend_state.dir_light.ambient_strength);
 
+    if (indirect_supported) {
+        shaders.lighting_forward_indirect.set_u32("pt_caster_id", 0);
+        shaders.lighting_forward_indirect.set_vec3("dir_light.direction", backend_state.dir_light.direction);
+        shaders.lighting_forward_indirect.set_vec3("dir_light.color", backend_state.dir_light.color);
+        shaders.lighting_forward_indirect.set_f32("dir_light.ambient_strength", backend_state.dir_light.ambient_strength);
+    }
+
     backend_state.bloom_mip_chain = create_mip_chain(app_state.window_state.width, app_state.window_state.height, 5);
     f32 ar = (f32)app_state.window_state.width / (f32)app_state.window_state.height;
     glm::vec2 filter_sz = { 0.005f, 0.005f * ar };
@@ -192,42 +271,65 @@ void Backend::step(AppState& app_state) {
 
     glEnable(GL_DEPTH_TEST);
     Entities& entities = app_state.entities;
+    bool indirect = app_state.indirect_enabled && indirect_supported;
+    bool occlusion = indirect && app_state.occlusion_culling_enabled;
 
-    f32 ar = (f32)app_state.window_state.width / (f32)app_state.window_state.height;
-    glm::mat4 projection = app_state.camera.projection(ar);
-    glm::mat4 view = app_state.camera.view();
-
-    // update ubo state
-    glNamedBufferSubData(backend_state.global_ubo, 0, 64, glm::value_ptr(projection));
-    glNamedBufferSubData(backend_state.global_ubo, 64, 64, glm::value_ptr(view));
-    glNamedBufferSubData(backend_state.global_ubo, 128, 16, glm::value_ptr(app_state.camera.position));
+    using clock = std::chrono::steady_clock;
+    std::chrono::duration<f64, std::milli> submit_time { 0.0 };
 
-    // clustered set-up ===========================================================================================
+    // cells around the camera are loaded before anything about the scene is read. loading allocates, so it
+    // is done before the frame's heap use is measured
+    app_state.streamer.update(app_state.camera, entities, texture_manager);
 
-    // determine the AABB for each cluster
-    // note: this does not need to be computed on every frame if parameters have not changed
-    shaders.clusters_build.use();
-    shaders.clusters_build.set_mat4("inv_proj", glm::inverse(projection));
+    frame_arena.reset();
+    HeapStats heap_start = heap_stats();
 
-    glDispatchCompute(clusters.grid_sz.x, clusters.grid_sz.y, clusters.grid_sz.z);
-    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-
-    // build light lists for each cluster
-    shaders.clusters_cull.use();
-    shaders.clusters_cull.set_i32("n_lights", clusters.gl_data.lights_ssbo.n_elems);
+    f32 ar = (f32)app_state.window_state.width / (f32)app_state.window_state.height;
+    glm::mat4 projection = app_state.camera.projection(ar);
+    glm::mat4 view = app_state.camera.view();
 
-    glDispatchCompute(27, 1, 1);
-    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    backend_state.frame_data.begin_frame();
 
-    // shadow pass ================================================================================================
+    // the cluster grid follows the screen, the field of view and the tile size, which is tuned from the lengths
+    // of the light lists read back from earlier frames
+    const gl::ClusterLightStats& list_stats = clusters.gl_data.lists.stats;
+    if (clusters.auto_tune && !app_state.zbin_enabled) {
+        clusters.tune(list_stats.n_lists > 0 ? (f32)list_stats.n_refs / (f32)list_stats.n_lists : 0.0f);
+    }
+    if (clusters.fit(backend_state.globals.screen_dims, glm::radians(app_state.camera.zoom),
+                     app_state.camera.near_plane, app_state.camera.far_plane)) {
+        clusters.gl_data.resize(clusters.n_clusters());
+    }
+    backend_state.globals.grid_sz = clusters.grid_sz;
+    backend_state.globals.tile_sz = clusters.tile_sz;
+    backend_state.globals.near_slice_z = clusters.split_z;
 
-    glCullFace(GL_FRONT); // prevent peter panning
+    // update ubo state
+    backend_state.globals.projection = projection;
+    backend_state.globals.view = view;
+    backend_state.globals.camera_pos = app_state.camera.position;
+    backend_state.frame_data.push(GL_UNIFORM_BUFFER, 1, std::span(&backend_state.globals, 1));
+
+    // transforms are brought up to date before anything reads a world position
+    entities.update_transforms();
+
+    // distant groups of lights are merged into single lights when using light LOD, entries of the merged set are
+    // only rewritten when their weight or membership changes. changes made while either side is in use are not
+    // seen by the other, so the hierarchy is rebuilt when LOD is turned on and the scene's lights are uploaded in
+    // full when it is turned off
+    if (app_state.light_lod_enabled) {
+        light_lod.update(entities.lights, app_state.camera.position, !light_lod_active);
+    } else if (light_lod_active) {
+        entities.lights.mark_all_dirty();
+    }
+    light_lod_active = app_state.light_lod_enabled;
+    const LightRegistry& lights = shaded_lights(app_state);
 
-    // ---- directional light ----
+    // only lights changed since the last frame are uploaded
+    clusters.gl_data.lights.sync(light_lod_active ? light_lod.lights : entities.lights, backend_state.frame_data,
+                                 shaders.lights_scatter);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, backend_state.dir_light.gl_shadow.fbo);
-    glViewport(0, 0, backend_state.dir_light.gl_shadow.resolution, backend_state.dir_light.gl_shadow.resolution);
-    glClear(GL_DEPTH_BUFFER_BIT);
+    // culling ==================================================================================================
 
     // cascades: [0.1, 10.0], [10.0, 30.0], [30.0, 100.0]
     f32 c1_far = 10.0f;
@@ -237,49 +339,39 @@ void Backend::step(AppState& app_state) {
     auto p2 = glm::perspective(glm::radians(app_state.camera.zoom), ar, c1_far, c2_far);
     auto p3 = glm::perspective(glm::radians(app_state.camera.zoom), ar, c2_far, app_state.camera.far_plane);
 
-    glm::mat4 c1_map = get_cascade_mat(p1, app_state.camera.view(), backend_state.dir_light.direction,
-                                       backend_state.dir_light.gl_shadow.resolution);
-    glm::mat4 c2_map = get_cascade_mat(p2, app_state.camera.view(), backend_state.dir_light.direction,
-                                       backend_state.dir_light.gl_shadow.resolution);
-    glm::mat4 c3_map = get_cascade_mat(p3, app_state.camera.view(), backend_state.dir_light.direction,
-                                       backend_state.dir_light.gl_shadow.resolution);
-
-    glNamedBufferSubData(backend_state.dir_light.gl_shadow.light_mats_ubo, 0, 64, glm::value_ptr(c1_map));
-    glNamedBufferSubData(backend_state.dir_light.gl_shadow.light_mats_ubo, 64, 64, glm::value_ptr(c2_map));
-    glNamedBufferSubData(backend_state.dir_light.gl_shadow.light_mats_ubo, 128, 64, glm::value_ptr(c3_map));
-
-    glEnable(GL_DEPTH_CLAMP);
-
-    // render occluders
-    for (size_t obj_idx = 0; obj_idx < entities.size(); ++obj_idx) {
-        if (entities.is_alive(obj_idx) && !entities.is_light(obj_idx)) {
-            translate(entities.models[obj_idx], entities.positions[obj_idx]);
-            scale(entities.models[obj_idx], entities.scales[obj_idx]);
-            rotate(entities.models[obj_idx], entities.rotations[obj_idx]);
-            render(shaders.dir_shadow, entities.models[obj_idx]);
-            entities.models[obj_idx].reset();
-        }
-    }
-
-    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
-    glDisable(GL_DEPTH_CLAMP);
+    std::array<glm::mat4, 3>& light_mats = backend_state.dir_light.gl_shadow.light_mats;
+    light_mats[0] = get_cascade_mat(p1, app_state.camera.view(), backend_state.dir_light.direction,
+                                    backend_state.dir_light.gl_shadow.resolution);
+    light_mats[1] = get_cascade_mat(p2, app_state.camera.view(), backend_state.dir_light.direction,
+                                    backend_state.dir_light.gl_shadow.resolution);
+    light_mats[2] = get_cascade_mat(p3, app_state.camera.view(), backend_state.dir_light.direction,
+                                    backend_state.dir_light.gl_shadow.resolution);
 
-    // ---- point lights ----
+    backend_state.frame_data.push(GL_UNIFORM_BUFFER, 6, std::span(light_mats));
 
     glm::mat4 shadow_proj =
         glm::perspective(glm::radians(90.0f),
                          (f32)backend_state.pt_shadow_data.resolution / (f32)backend_state.pt_shadow_data.resolution,
                          app_state.camera.near_plane, app_state.camera.far_plane);
 
-    std::array<glm::mat4, 6> shadow_transforms;
-
-    glBindFramebuffer(GL_FRAMEBUFFER, backend_state.pt_shadow_data.fbo);
-    glViewport(0, 0, backend_state.pt_shadow_data.resolution, backend_state.pt_shadow_data.resolution);
-    glClear(GL_DEPTH_BUFFER_BIT);
-    shaders.pt_shadow.set_f32("far_plane", app_state.camera.far_plane);
-
-    if (!entities.empty() && entities.is_alive(entities.pt_caster_idx) && entities.is_light(entities.pt_caster_idx)) {
-        glm::vec3 light_pos = entities.positions[entities.pt_caster_idx];
+    std::array<glm::mat4, 6> shadow_transforms = {};
+    bool pt_enabled = entities.valid(entities.pt_caster) && entities.is_light(entities.index(entities.pt_caster));
+    bool spot_caster = pt_enabled && entities.light_data[entities.index(entities.pt_caster)].is_spot();
+    u32 n_shadow_faces = spot_caster ? 1 : 6;
+    glm::vec3 light_pos = { 0.0f, 0.0f, 0.0f };
+
+    if (spot_caster) {
+        // a spot light only needs the face looking down its cone, which is culled and drawn as face 0
+        const PtLight& caster = entities.light_data[entities.index(entities.pt_caster)];
+        light_pos = glm::vec3(entities.world(entities.index(entities.pt_caster)).mat[3]);
+        glm::vec3 dir = glm::normalize(glm::vec3(caster.direction));
+        glm::vec3 up = std::abs(dir.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        f32 fov = std::min(2.0f * std::acos(caster.outer_cos), glm::radians(170.0f));
+        shadow_transforms[0] =
+            glm::perspective(fov, 1.0f, app_state.camera.near_plane, app_state.camera.far_plane) *
+            glm::lookAt(light_pos, light_pos + dir, up);
+    } else if (pt_enabled) {
+        light_pos = glm::vec3(entities.world(entities.index(entities.pt_caster)).mat[3]);
 
         shadow_transforms[0] =
             shadow_proj * glm::lookAt(light_pos, light_pos + glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f));
@@ -293,30 +385,113 @@ void Backend::step(AppState& app_state) {
             shadow_proj * glm::lookAt(light_pos, light_pos + glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f));
         shadow_transforms[5] = shadow_proj * glm::lookAt(light_pos, light_pos + glm::vec3(0.0f, 0.0f, -1.0f),
                                                          glm::vec3(0.0f, -1.0f, 0.0f));
+    }
 
-        shaders.pt_shadow.set_mat4("shadow_mats[0]", shadow_transforms[0]);
-        shaders.pt_shadow.set_mat4("shadow_mats[1]", shadow_transforms[1]);
-        shaders.pt_shadow.set_mat4("shadow_mats[2]", shadow_transforms[2]);
-        shaders.pt_shadow.set_mat4("shadow_mats[3]", shadow_transforms[3]);
-        shaders.pt_shadow.set_mat4("shadow_mats[4]", shadow_transforms[4]);
-        shaders.pt_shadow.set_mat4("shadow_mats[5]", shadow_transforms[5]);
-        shaders.pt_shadow.set_vec3("light_pos", light_pos);
-
-        for (size_t obj_idx = 0; obj_idx < entities.size(); ++obj_idx) {
-            if (entities.is_alive(obj_idx) && !entities.is_light(obj_idx)) {
-                translate(entities.models[obj_idx], entities.positions[obj_idx]);
-                scale(entities.models[obj_idx], entities.scales[obj_idx]);
-                rotate(entities.models[obj_idx], entities.rotations[obj_idx]);
-                render_opaque(shaders.pt_shadow, entities.models[obj_idx]);
-                entities.models[obj_idx].reset();
-            }
+    auto submit_start = clock::now();
+
+    // draws are shared by every geometry pass this frame, each pass only receives those that survive culling
+    draw_list.build(entities, culler.bounds);
+
+    culler.cull({ .camera_mat = projection * view,
+                  .cascade_mats = light_mats,
+                  .pt_enabled = pt_enabled,
+                  .pt_pos = light_pos,
+                  .pt_radius = pt_enabled ? entities.light_data[entities.index(entities.pt_caster)].radius : 0.0f,
+                  .face_mats = std::span<const glm::mat4>(shadow_transforms).first(n_shadow_faces) });
+
+    // occluders are rasterized on the worker threads while the GPU is still busy with the previous frame
+    if (app_state.cpu_occlusion_enabled) {
+        std::vector<u32>& camera_visible = culler.visible[(size_t)CullPass::CAMERA];
+        ArenaVector<OccluderMesh> occluders(frame_arena);
+        gather_occluders(entities, draw_list, camera_visible, occluders);
+        occlusion_buffer.render(occluders, projection * view, app_state.camera.near_plane);
+        occlusion_buffer.cull(culler.bounds, camera_visible);
+    }
+
+    // distant entities are drawn as impostor cards rather than meshes in the camera pass
+    // note: forward+ has no pass to shade the cards in, so they keep their meshes
+    if (app_state.impostors_enabled && !app_state.forward_plus_enabled) {
+        impostors.select(entities, draw_list, culler.visible[(size_t)CullPass::CAMERA], shaders.gbuf,
+                         backend_state.globals, glm::radians(app_state.camera.zoom));
+    }
+
+    draw_list.compact(culler);
+
+    if (indirect) {
+        draw_list.upload();
+    }
+    if (occlusion) {
+        occlusion_culler.prepare(culler.bounds);
+    }
+
+    // shadow pass ================================================================================================
+
+    backend_state.shadow_timer.begin();
+    glCullFace(GL_FRONT); // prevent peter panning
+
+    // ---- directional light ----
+
+    glBindFramebuffer(GL_FRAMEBUFFER, backend_state.dir_light.gl_shadow.fbo);
+    glViewport(0, 0, backend_state.dir_light.gl_shadow.resolution, backend_state.dir_light.gl_shadow.resolution);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    glEnable(GL_DEPTH_CLAMP);
+
+    // render occluders
+    if (indirect) {
+        draw_list.draw(shaders.dir_shadow_indirect, CullPass::DIR_SHADOW, DrawGroup::OPAQUE);
+        draw_list.draw(shaders.dir_shadow_indirect, CullPass::DIR_SHADOW, DrawGroup::TRANSPARENT);
+    } else {
+        draw_list.draw_direct(shaders.dir_shadow, entities, CullPass::DIR_SHADOW, DrawGroup::OPAQUE);
+        draw_list.draw_direct(shaders.dir_shadow, entities, CullPass::DIR_SHADOW, DrawGroup::TRANSPARENT);
+    }
+
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    glDisable(GL_DEPTH_CLAMP);
+
+    // ---- point lights ----
+
+    Shader& pt_shadow = indirect ? shaders.pt_shadow_indirect : shaders.pt_shadow;
+
+    if (spot_caster) {
+        glBindFramebuffer(GL_FRAMEBUFFER, backend_state.spot_shadow_data.fbo);
+        glViewport(0, 0, backend_state.spot_shadow_data.resolution, backend_state.spot_shadow_data.resolution);
+    } else {
+        glBindFramebuffer(GL_FRAMEBUFFER, backend_state.pt_shadow_data.fbo);
+        glViewport(0, 0, backend_state.pt_shadow_data.resolution, backend_state.pt_shadow_data.resolution);
+    }
+    glClear(GL_DEPTH_BUFFER_BIT);
+    pt_shadow.set_f32("far_plane", app_state.camera.far_plane);
+
+    if (pt_enabled) {
+        // only the faces that are drawn are uploaded, a spot light has just the one
+        static constexpr std::array<std::string_view, 6> face_names = {
+            "shadow_mats[0]", "shadow_mats[1]", "shadow_mats[2]", "shadow_mats[3]", "shadow_mats[4]", "shadow_mats[5]"
+        };
+        for (u32 face = 0; face < n_shadow_faces; ++face) {
+            pt_shadow.set_mat4(face_names[face], shadow_transforms[face]);
+        }
+        pt_shadow.set_vec3("light_pos", light_pos);
+
+        if (indirect) {
+            draw_list.draw(pt_shadow, CullPass::PT_SHADOW, DrawGroup::OPAQUE);
+        } else {
+            draw_list.draw_direct(pt_shadow, entities, CullPass::PT_SHADOW, DrawGroup::OPAQUE);
         }
     }
 
     glCullFace(GL_BACK);
+    backend_state.shadow_timer.end();
+    submit_time += clock::now() - submit_start;
 
     // geometry pass ==========================================================================
 
+    // forward+ draws the opaque geometry into the gbuffer as a prepass, keeping the depth and the attachments read
+    // before shading, then shades it with the forward shaders in place of the deferred pass
+    bool forward_plus = app_state.forward_plus_enabled;
+    Shader& gbuf = forward_plus ? shaders.gbuf_prepass : shaders.gbuf;
+    Shader& gbuf_indirect = forward_plus ? shaders.gbuf_prepass_indirect : shaders.gbuf_indirect;
+
     gbuf_fbuf.bind();
     glNamedFramebufferDrawBuffers(gbuf_fbuf.frame_buf, 4, gbuf_fbuf.attachments.data());
     glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
@@ -328,11 +503,19 @@ void Backend::step(AppState& app_state) {
     glDisable(GL_STENCIL_TEST);
     glStencilMask(0x00);
 
-    // mask out and render skybox
+    // mask out and render skybox, forward+ draws it straight into the HDR target
     glm::mat4 static_view = view;
     static_view[3] = { 0, 0, 0, 1 }; // removing translation component
     shaders.skybox.set_mat4("static_view", static_view);
-    render(shaders.skybox, backend_state.skybox, backend_state.skybox.vao);
+    if (!forward_plus) {
+        render(shaders.skybox, backend_state.skybox, backend_state.skybox.vao);
+    } else {
+        // view depth feeds the depth pyramid and cluster marking, normals are only needed by SSAO
+        const std::array<GLenum, 2> prepass_bufs = {
+            GL_COLOR_ATTACHMENT0, static_cast<GLenum>(app_state.ssao_enabled ? GL_COLOR_ATTACHMENT1 : GL_NONE)
+        };
+        glNamedFramebufferDrawBuffers(gbuf_fbuf.frame_buf, (i32)prepass_bufs.size(), prepass_bufs.data());
+    }
 
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_STENCIL_TEST);
@@ -342,15 +525,133 @@ void Backend::step(AppState& app_state) {
     glStencilMask(0xFF);
 
     // render non light emitters
-    for (size_t idx = 0; idx < entities.size(); ++idx) {
-        if (entities.is_alive(idx) && !entities.is_light(idx)) {
-            translate(entities.models[idx], entities.positions[idx]);
-            scale(entities.models[idx], entities.scales[idx]);
-            rotate(entities.models[idx], entities.rotations[idx]);
-            render_opaque(shaders.gbuf, entities.models[idx]);
-            entities.models[idx].reset();
+    submit_start = clock::now();
+    backend_state.gbuf_timer.begin();
+
+    if (occlusion) {
+        // draw what passes against last frame's depth, then retest the rest against what was just drawn
+        occlusion_culler.cull(shaders.occlusion_cull, depth_pyramid, 0, projection * view,
+                              app_state.camera.near_plane);
+        occlusion_culler.draw(gbuf_indirect, 0);
+        depth_pyramid.build(shaders.hiz_build, gbuf_fbuf.tex_bufs[0]);
+        occlusion_culler.cull(shaders.occlusion_cull, depth_pyramid, 1, projection * view,
+                              app_state.camera.near_plane);
+        occlusion_culler.draw(gbuf_indirect, 1);
+    } else if (indirect) {
+        draw_list.draw(gbuf_indirect, CullPass::CAMERA, DrawGroup::OPAQUE);
+    } else {
+        draw_list.draw_direct(gbuf, entities, CullPass::CAMERA, DrawGroup::OPAQUE);
+    }
+
+    if (app_state.impostors_enabled && !forward_plus) {
+        impostors.draw(shaders.impostor);
+    }
+
+    // the final pyramid is sampled by SSAO and is the first phase's occluder next frame
+    bool build_pyramid = occlusion || app_state.ssao_enabled;
+    if (build_pyramid) {
+        depth_pyramid.build(shaders.hiz_build, gbuf_fbuf.tex_bufs[0]);
+    }
+    occlusion_culler.hiz_valid = build_pyramid;
+    occlusion_culler.prev_proj_view = projection * view;
+
+    backend_state.gbuf_timer.end();
+    submit_time += clock::now() - submit_start;
+
+    // clustered set-up ===========================================================================================
+
+    backend_state.cluster_timer.begin();
+    ClustersData& cluster_data = clusters.gl_data;
+    u32 n_clusters = clusters.n_clusters();
+    glm::uvec2 screen_dims = backend_state.globals.screen_dims;
+
+    // a check needs every cluster culled, as clusters outside the active list keep the lists of earlier frames
+    bool active_clusters = app_state.active_clusters_enabled && !cluster_check_pending;
+
+    if (app_state.zbin_enabled) {
+        // lights are binned by depth and masked per tile in place of the cluster grid
+        cluster_data.zbins.build(lights, view, projection, screen_dims, app_state.camera.far_plane,
+                                 shaders.zbin_tiles);
+    } else if (app_state.cpu_clusters_enabled) {
+        // the lists are built on the CPU and uploaded in place of the compute passes
+        cpu_clusters.build(clusters, screen_dims, projection, app_state.camera.near_plane,
+                           app_state.camera.far_plane);
+        cpu_lights.set(lights, view);
+        cpu_clusters.cull(cpu_lights, cpu_lights.size() <= ClusterLights::max_packed_lights);
+        cluster_data.lists.upload(cpu_clusters.grid, cpu_clusters.indices, cpu_clusters.packed);
+    } else {
+        // determine the AABB for each cluster, they only change with the projection or the screen size
+        if (!active_clusters || cluster_data.aabb_proj != projection || cluster_data.aabb_dims != screen_dims) {
+            shaders.clusters_build.use();
+            shaders.clusters_build.set_mat4("inv_proj", glm::inverse(projection));
+            shaders.clusters_build.set_u32("n_clusters", n_clusters);
+
+            glDispatchCompute((n_clusters + 63) / 64, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+            cluster_data.aabb_proj = projection;
+            cluster_data.aabb_dims = screen_dims;
+            cluster_data.n_aabb_builds++;
+        }
+
+        // transparent fragments can land in clusters without opaque ones, so every cluster is culled when the
+        // forward pass has anything to draw. the same holds for forward+ with MSAA, which shades against its own
+        // depth rather than the single sampled prepass that clusters are marked from, so edge samples and surfaces
+        // behind the prepass's can fall in unmarked clusters. their lists are not rewritten and would be read
+        // stale, pointing past the lights of the frame
+        active_clusters = active_clusters &&
+                          draw_list.passes[(size_t)CullPass::CAMERA].cmds[(size_t)DrawGroup::TRANSPARENT].empty() &&
+                          !(app_state.forward_plus_enabled && app_state.msaa_samples > 1);
+
+        if (active_clusters) {
+            // flag the clusters holding opaque fragments, then compact them into a list
+            shaders.clusters_mark.use();
+            shaders.clusters_mark.set_tex("gbuf_pos", 0, gbuf_fbuf.tex_bufs[0]);
+            glDispatchCompute((screen_dims.x + 15) / 16, (screen_dims.y + 15) / 16, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+            const u32 list_header[4] = { 0, 1, 1, 0 }; // [ dispatch size, count ]
+            glNamedBufferSubData(cluster_data.active_ssbo.ssbo, 0, sizeof(list_header), list_header);
+            shaders.clusters_compact.use();
+            shaders.clusters_compact.set_u32("n_clusters", n_clusters);
+            glDispatchCompute((n_clusters + 63) / 64, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+        }
+
+        // move the lights into view space once, then build a hierarchy over those in the frustum
+        cluster_data.tree.build(cluster_data.lights.n_lights, shaders.lights_prepass, shaders.lights_sort,
+                                shaders.lights_tree);
+
+        // build light lists for each cluster
+        cluster_data.lists.begin(cluster_data.lights.n_lights);
+        shaders.clusters_cull.use();
+        shaders.clusters_cull.set_i32("n_lights", cluster_data.lights.n_lights);
+        shaders.clusters_cull.set_u32("n_clusters", n_clusters);
+        shaders.clusters_cull.set_bool("active_only", active_clusters);
+        shaders.clusters_cull.set_bool("use_tree", app_state.light_tree_enabled);
+        cluster_data.tree.bind(shaders.clusters_cull);
+        cluster_data.lists.bind(shaders.clusters_cull);
+
+        if (active_clusters) {
+            glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, cluster_data.active_ssbo.ssbo);
+            glDispatchComputeIndirect(0);
+            glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+        } else {
+            glDispatchCompute((n_clusters + 127) / 128, 1, 1);
+        }
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        cluster_data.lists.end();
+
+        // note: the check is a debugging aid, its allocations are left out of the frame's
+        if (cluster_check_pending) {
+            HeapStats check_start = heap_stats();
+            check_clusters(app_state, projection, view);
+            HeapStats check_end = heap_stats();
+            heap_start.n_allocs += check_end.n_allocs - check_start.n_allocs;
+            heap_start.n_bytes += check_end.n_bytes - check_start.n_bytes;
         }
     }
+    backend_state.cluster_timer.end();
 
     // compute ambient occlusion ==============================================================
     
@@ -363,6 +664,7 @@ void Backend::step(AppState& app_state) {
         shaders.ssao.set_tex("gbuf_pos", 0, gbuf_fbuf.tex_bufs[0]);
         shaders.ssao.set_tex("gbuf_norms", 1, gbuf_fbuf.tex_bufs[1]);
         shaders.ssao.set_tex("noise_tex", 2, backend_state.ssao_noise_tex);
+        shaders.ssao.set_tex("hiz_tex", 3, depth_pyramid.tex);
         shaders.ssao.set_vec2("noise_scale", noise_scale);
         ssao_fbuf.draw(shaders.ssao);
         // blur the output
@@ -373,70 +675,146 @@ void Backend::step(AppState& app_state) {
 
     // deferred pass ==========================================================================
 
+    // the forward shaders shade transparent geometry, and opaque geometry as well in forward+
+    Shader& lighting_forward = indirect ? shaders.lighting_forward_indirect : shaders.lighting_forward;
+    clusters.gl_data.lists.bind(lighting_forward);
+    clusters.gl_data.zbins.bind(lighting_forward);
+    lighting_forward.set_bool("zbin_enabled", app_state.zbin_enabled);
+    lighting_forward.set_tex("dir_shadow_maps", 11, backend_state.dir_light.gl_shadow.tex);
+    lighting_forward.set_tex("pt_shadow_map", 12, backend_state.pt_shadow_data.tex);
+    lighting_forward.set_tex("spot_shadow_map", 13, backend_state.spot_shadow_data.tex);
+    lighting_forward.set_bool("spot_caster", spot_caster);
+    lighting_forward.set_mat4("spot_shadow_mat", shadow_transforms[0]);
+    lighting_forward.set_i32("n_cascades", backend_state.dir_light.gl_shadow.n_cascades);
+    lighting_forward.set_f32("cascade_depths[0]", c1_far);
+    lighting_forward.set_f32("cascade_depths[1]", c2_far);
+    lighting_forward.set_f32("cascade_depths[2]", app_state.camera.far_plane);
+    lighting_forward.set_tex("occlusion_tex", 4, ssao_fbuf.tex_bufs[1]);
+
     int_fbuf.bind();
 
-    // compute lighting for all fragments with stencil value '1'
-    glDisable(GL_DEPTH_TEST);
-    glStencilFunc(GL_EQUAL, 1, 0xFF);
-    glStencilOp(GL_ZERO, GL_REPLACE, GL_REPLACE);
-
-    shaders.lighting_deferred.set_tex("gbuf_pos", 0, gbuf_fbuf.tex_bufs[0]);
-    shaders.lighting_deferred.set_tex("gbuf_norms", 1, gbuf_fbuf.tex_bufs[1]);
-    shaders.lighting_deferred.set_tex("gbuf_colors", 2, gbuf_fbuf.tex_bufs[2]);
-    shaders.lighting_deferred.set_tex("gbuf_metallic", 3, gbuf_fbuf.tex_bufs[3]);
-    shaders.lighting_deferred.set_tex("occlusion_tex", 4, ssao_fbuf.tex_bufs[1]);
-    shaders.lighting_deferred.set_tex("dir_shadow_maps", 11, backend_state.dir_light.gl_shadow.tex);
-    shaders.lighting_deferred.set_tex("pt_shadow_map", 12, backend_state.pt_shadow_data.tex);
-    shaders.lighting_deferred.set_i32("n_cascades", backend_state.dir_light.gl_shadow.n_cascades);
-    shaders.lighting_deferred.set_f32("cascade_depths[0]", c1_far);
-    shaders.lighting_deferred.set_f32("cascade_depths[1]", c2_far);
-    shaders.lighting_deferred.set_f32("cascade_depths[2]", app_state.camera.far_plane);
-
-    int_fbuf.draw(shaders.lighting_deferred);
-
-    // pass through for all fragments with stencil value '0'
-    glStencilFunc(GL_EQUAL, 0, 0xFF);
-    glStencilOp(GL_REPLACE, GL_ZERO, GL_ZERO);
-    shaders.passthrough.set_i32("gbuf_colors", 2);
-
-    int_fbuf.draw(shaders.passthrough);
+    // note: the tiled pass reads the cluster light lists, z binning keeps the full screen pass
+    bool tiled_lighting = app_state.tiled_lighting_enabled && !app_state.zbin_enabled;
+    Shader& lighting = tiled_lighting ? shaders.lighting_tiled : shaders.lighting_deferred;
+
+    cluster_data.lists.bind(lighting);
+    cluster_data.zbins.bind(lighting);
+    lighting.set_bool("zbin_enabled", app_state.zbin_enabled);
+    lighting.set_tex("gbuf_pos", 0, gbuf_fbuf.tex_bufs[0]);
+    lighting.set_tex("gbuf_norms", 1, gbuf_fbuf.tex_bufs[1]);
+    lighting.set_tex("gbuf_colors", 2, gbuf_fbuf.tex_bufs[2]);
+    lighting.set_tex("gbuf_metallic", 3, gbuf_fbuf.tex_bufs[3]);
+    lighting.set_tex("occlusion_tex", 4, ssao_fbuf.tex_bufs[1]);
+    lighting.set_tex("dir_shadow_maps", 11, backend_state.dir_light.gl_shadow.tex);
+    lighting.set_tex("pt_shadow_map", 12, backend_state.pt_shadow_data.tex);
+    lighting.set_tex("spot_shadow_map", 13, backend_state.spot_shadow_data.tex);
+    lighting.set_bool("spot_caster", spot_caster);
+    lighting.set_mat4("spot_shadow_mat", shadow_transforms[0]);
+    lighting.set_i32("n_cascades", backend_state.dir_light.gl_shadow.n_cascades);
+    lighting.set_f32("cascade_depths[0]", c1_far);
+    lighting.set_f32("cascade_depths[1]", c2_far);
+    lighting.set_f32("cascade_depths[2]", app_state.camera.far_plane);
+
+    // note: every mode is timed through to the last write of the HDR target before the transparent geometry
+    backend_state.lighting_timer.begin();
+    if (forward_plus) {
+        // opaque geometry is shaded against the depth of the prepass, so each pixel is shaded once. with MSAA it
+        // is drawn again into the multisampled target, which keeps its own depth, then resolved
+        bool msaa = app_state.msaa_samples > 1;
+        if (msaa && msaa_fbuf.samples != app_state.msaa_samples) {
+            msaa_fbuf.release();
+            if (msaa_fbuf.init(app_state.window_state.width, app_state.window_state.height, app_state.msaa_samples,
+                               GL_RGBA16F)) {
+                app_state.msaa_samples = 1;
+                msaa = false;
+            }
+        }
+
+        // note: the depth of int_fbuf is the prepass', only the colour is cleared
+        if (msaa) {
+            msaa_fbuf.bind();
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        } else {
+            glClear(GL_COLOR_BUFFER_BIT);
+        }
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_STENCIL_TEST);
+        render(shaders.skybox, backend_state.skybox, backend_state.skybox.vao);
+
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(msaa ? GL_LESS : GL_LEQUAL);
+        glDepthMask(msaa ? GL_TRUE : GL_FALSE);
+        lighting_forward.set_bool("ssao_enabled", app_state.ssao_enabled);
+
+        if (occlusion) {
+            occlusion_culler.draw(lighting_forward, 0);
+            occlusion_culler.draw(lighting_forward, 1);
+        } else if (indirect) {
+            draw_list.draw(lighting_forward, CullPass::CAMERA, DrawGroup::OPAQUE);
+        } else {
+            draw_list.draw_direct(lighting_forward, entities, CullPass::CAMERA, DrawGroup::OPAQUE);
+        }
+
+        lighting_forward.set_bool("ssao_enabled", false);
+        glDepthMask(GL_TRUE);
+        glDepthFunc(GL_LESS);
+
+        if (msaa) {
+            msaa_fbuf.resolve(int_fbuf);
+            int_fbuf.bind();
+        }
+    } else if (tiled_lighting) {
+        // every pixel is written by the tiled pass, lit or passed through, so the stencil is not needed
+        lighting.use();
+        glBindImageTexture(0, int_fbuf.tex_bufs[0], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+        glDispatchCompute((screen_dims.x + 15) / 16, (screen_dims.y + 15) / 16, 1);
+        glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+    } else {
+        // compute lighting for all fragments with stencil value '1'
+        glDisable(GL_DEPTH_TEST);
+        glStencilFunc(GL_EQUAL, 1, 0xFF);
+        glStencilOp(GL_ZERO, GL_REPLACE, GL_REPLACE);
+        int_fbuf.draw(lighting);
+
+        // pass through for all fragments with stencil value '0'
+        glStencilFunc(GL_EQUAL, 0, 0xFF);
+        glStencilOp(GL_REPLACE, GL_ZERO, GL_ZERO);
+        shaders.passthrough.set_i32("gbuf_colors", 2);
+
+        int_fbuf.draw(shaders.passthrough);
+    }
+    backend_state.lighting_timer.end();
 
     // forward pass ===========================================================================
 
     glEnable(GL_DEPTH_TEST);
     glDisable(GL_STENCIL_TEST);
 
-    shaders.lighting_forward.set_tex("dir_shadow_maps", 11, backend_state.dir_light.gl_shadow.tex);
-    shaders.lighting_forward.set_tex("pt_shadow_map", 12, backend_state.pt_shadow_data.tex);
-    shaders.lighting_forward.set_i32("n_cascades", backend_state.dir_light.gl_shadow.n_cascades);
-    shaders.lighting_forward.set_f32("cascade_depths[0]", c1_far);
-    shaders.lighting_forward.set_f32("cascade_depths[1]", c2_far);
-    shaders.lighting_forward.set_f32("cascade_depths[2]", app_state.camera.far_plane);
+    submit_start = clock::now();
+    backend_state.forward_timer.begin();
+
+    // draw transparent components
+    if (indirect) {
+        draw_list.draw(lighting_forward, CullPass::CAMERA, DrawGroup::TRANSPARENT);
+    } else {
+        draw_list.draw_direct(lighting_forward, entities, CullPass::CAMERA, DrawGroup::TRANSPARENT);
+    }
 
     for (size_t idx = 0; idx < entities.size(); ++idx) {
-        if (!entities.is_alive(idx)) {
-            continue;
-        }
         if (entities.is_light(idx)) {
             // draw light emitters
-            translate(entities.models[idx], entities.positions[idx]);
-            scale(entities.models[idx], entities.scales[idx]);
-            rotate(entities.models[idx], entities.rotations[idx]);
+            entities.models[idx].model_mat = entities.world(idx).mat;
             shaders.light.set_vec4("color", entities.light_data[idx].color);
             shaders.light.set_f32("intensity", entities.light_data[idx].intensity);
             render(shaders.light, entities.models[idx]);
             entities.models[idx].reset();
-        } 
-        else {
-            // draw transparent components
-            translate(entities.models[idx], entities.positions[idx]);
-            scale(entities.models[idx], entities.scales[idx]);
-            rotate(entities.models[idx], entities.rotations[idx]);
-            render_transparent(shaders.lighting_forward, entities.models[idx]);
-            entities.models[idx].reset();
         }
     }
 
+    backend_state.forward_timer.end();
+    submit_time += clock::now() - submit_start;
+    backend_state.submit_ms = submit_time.count();
+
     // post processing ========================================================================
 
     // compute bloom
@@ -501,36 +879,56 @@ void Backend::step(AppState& app_state) {
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     glNamedFramebufferTexture(gbuf_fbuf.frame_buf, GL_COLOR_ATTACHMENT0, gbuf_fbuf.tex_bufs[0], 0);
+
+    backend_state.frame_data.end_frame();
+
+    // steady state frames are expected to only allocate from the frame arena and persistent containers
+    HeapStats heap_end = heap_stats();
+    backend_state.frame_heap_allocs = heap_end.n_allocs - heap_start.n_allocs;
+    backend_state.frame_heap_bytes = heap_end.n_bytes - heap_start.n_bytes;
+    if (backend_state.frame_heap_allocs > 0) {
+        backend_state.n_alloc_frames++;
+        backend_state.last_alloc_allocs = backend_state.frame_heap_allocs;
+        backend_state.last_alloc_bytes = backend_state.frame_heap_bytes;
+    }
     
     // gui pass ===================================================================================
 
-    gui::GuiRet gui_ret = gui::imgui(app_state, *this);
-
-    // if a light was changed within the gui, we need to update our GPU buffers to reflect these changes
-    if (gui_ret.light_changed) {
-        static std::vector<PtLight> pt_light_data;
-        static std::vector<glm::vec4> pt_lights_pos;
-        static std::vector<u32> pt_lights_ids;
-
-        // note: linear search, probably not a big deal for now
-        for (size_t idx = 0; idx < entities.size(); ++idx) {
-            if (entities.is_alive(idx) && entities.is_light(idx)) {
-                pt_lights_pos.push_back(glm::vec4(entities.positions[idx], 1.0f));
-                pt_light_data.push_back(entities.light_data[idx]);
-                // note: using u32 ids for now, can use the u64 extension
-                pt_lights_ids.push_back(static_cast<u32>(entities.ids[idx]));
-            }
-        }
+    gui::imgui(app_state, *this);
+ };
 
-        clusters.gl_data.lights_ssbo.update(std::span(pt_light_data.begin(), pt_light_data.end()));
-        clusters.gl_data.lights_pos_ssbo.update(std::span(pt_lights_pos.begin(), pt_lights_pos.end()));
-        lights_ids_ssbo.update(std::span(pt_lights_ids.begin(), pt_lights_ids.end()));
+void Backend::check_clusters(AppState& app_state, const glm::mat4& projection, const glm::mat4& view) {
+
+    cluster_check_pending = false;
+    ClusterLights& lists = clusters.gl_data.lists;
+    u32 n_clusters = clusters.n_clusters();
+
+    // note: waits for the culling pass to finish
+    cluster_check.gpu_grid.resize(n_clusters);
+    glGetNamedBufferSubData(lists.grid_ssbo.ssbo, 0, sizeof(glm::uvec2) * n_clusters, cluster_check.gpu_grid.data());
+
+    ClusterLightStats gpu_stats;
+    glGetNamedBufferSubData(lists.pool_ssbo.ssbo, 0, sizeof(gpu_stats), &gpu_stats);
+    u32 n_words = CpuClusters::header_sz + std::min(gpu_stats.n_used, lists.capacity);
+    cluster_check.gpu_pool.resize(n_words);
+    glGetNamedBufferSubData(lists.pool_ssbo.ssbo, 0, sizeof(u32) * n_words, cluster_check.gpu_pool.data());
+
+    cpu_clusters.build(clusters, backend_state.globals.screen_dims, projection, app_state.camera.near_plane,
+                       app_state.camera.far_plane);
+    cpu_lights.set(shaded_lights(app_state), view);
+    cpu_clusters.cull(cpu_lights, lists.packed);
+
+    cluster_check.ran = true;
+    cluster_check.n_clusters = n_clusters;
+    cluster_check.n_different = cpu_clusters.compare(cluster_check.gpu_grid, cluster_check.gpu_pool, lists.packed);
+    cluster_check.gpu_refs = gpu_stats.n_refs;
+    cluster_check.cpu_refs = cpu_clusters.stats.n_refs;
+    cluster_check.overflowed = gpu_stats.n_used > lists.capacity;
+}
 
-        pt_light_data.resize(0);
-        pt_lights_pos.resize(0);
-        pt_lights_ids.resize(0);
-    }
- };
+const LightRegistry& Backend::shaded_lights(const AppState& app_state) const {
+    return light_lod_active ? light_lod.lights : app_state.entities.lights;
+}
 
 void Backend::finish() { ImGui_ImplOpenGL3_Shutdown(); };
 
@@ -0,0 +1,204 @@
+#include <rose/backends/gl/backend.hpp>
+#include <rose/backends/gl/impostor.hpp>
+
+#include <GL/glew.h>
+#include <gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace gl {
+
+// maps a point of the octahedron unfolded onto [-1, 1]^2 to a direction, the upper hemisphere fills the
+// inner diamond and the lower one the corners
+//
+// note: must match oct_decode() in impostor.vert
+static glm::vec3 oct_decode(glm::vec2 p) {
+    glm::vec3 dir = { p.x, 1.0f - std::abs(p.x) - std::abs(p.y), p.y };
+    if (dir.y < 0.0f) {
+        dir.x = (1.0f - std::abs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f);
+        dir.z = (1.0f - std::abs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return glm::normalize(dir);
+}
+
+void ImpostorRenderer::init(RingBuffer& ring) {
+    this->ring = &ring;
+    glCreateVertexArrays(1, &vao);
+}
+
+void ImpostorRenderer::bake(Impostor& impostor, const Model& model, Shader& bake_shader, const Globals& globals) {
+
+    impostor.center = model.bounds.center;
+    impostor.radius = model.bounds.radius;
+    impostor.n_frames = n_frames;
+    impostor.tile_sz = tile_sz;
+
+    // same layout as the gbuffer, so the gbuffer shader can be used as is
+    u32 atlas_sz = n_frames * tile_sz;
+    if (impostor.atlas.init(atlas_sz, atlas_sz, true, { { GL_RGBA16F }, { GL_RGBA16F }, { GL_RGBA8 }, { GL_R16F } })) {
+        return;
+    }
+    for (u32 tex : impostor.atlas.tex_bufs) {
+        // note: texels are fetched directly, blending across silhouettes or tiles would produce garbage
+        glTextureParameteri(tex, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTextureParameteri(tex, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+
+    bool stencil = glIsEnabled(GL_STENCIL_TEST);
+    glDisable(GL_STENCIL_TEST);
+
+    impostor.atlas.bind();
+    glNamedFramebufferDrawBuffers(impostor.atlas.frame_buf, 4, impostor.atlas.attachments.data());
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // each tile is an orthographic view of the bounding sphere from the direction at the tile's center
+    f32 r = impostor.radius;
+    Globals frame_globals = globals;
+    frame_globals.projection = glm::ortho(-r, r, -r, r, 0.0f, 4.0f * r);
+
+    for (u32 y = 0; y < n_frames; ++y) {
+        for (u32 x = 0; x < n_frames; ++x) {
+            glm::vec2 oct = (glm::vec2(x, y) + 0.5f) / (f32)n_frames * 2.0f - 1.0f;
+            glm::vec3 dir = oct_decode(oct);
+            glm::vec3 up = std::abs(dir.y) > 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+
+            frame_globals.view = glm::lookAt(impostor.center + dir * 2.0f * r, impostor.center, up);
+            frame_globals.camera_pos = impostor.center + dir * 2.0f * r;
+            ring->push(GL_UNIFORM_BUFFER, 1, std::span(&frame_globals, 1));
+
+            glViewport(x * tile_sz, y * tile_sz, tile_sz, tile_sz);
+            render_nodes(bake_shader, model);
+        }
+    }
+
+    ring->push(GL_UNIFORM_BUFFER, 1, std::span(&globals, 1));
+    if (stencil) {
+        glEnable(GL_STENCIL_TEST);
+    }
+
+    impostor.baked = true;
+    stats.n_baked++;
+}
+
+void ImpostorRenderer::select(Entities& entities, const DrawList& draw_list, std::vector<u32>& camera_visible,
+                              Shader& bake_shader, const Globals& globals, f32 fov_y) {
+
+    stats.n_impostors = 0;
+    stats.n_draws_replaced = 0;
+    stats.n_indices_replaced = 0;
+    cards.resize(0);
+
+    // impostors of models that no longer exist are freed
+    std::erase_if(cache, [](const auto& entry) { return entry.second.geometry.expired(); });
+
+    ent_state.assign(entities.size(), 0);
+    f32 tan_half_fov = std::tan(fov_y * 0.5f);
+    u32 n_bakes = 0;
+    auto bake_start = std::chrono::steady_clock::now();
+
+    auto decide = [&](u32 ent_idx) -> u8 {
+        const Model& model = entities.models[ent_idx];
+        if (model.bounds.empty() || model.bounds.radius <= 0.0f || !model.mesh_bvhs) {
+            return 1;
+        }
+
+        const NodeTransform& world = entities.world(ent_idx);
+        glm::vec3 center = glm::vec3(world.mat * glm::vec4(model.bounds.center, 1.0f));
+        f32 max_scale = std::max({ glm::length(glm::vec3(world.mat[0])), glm::length(glm::vec3(world.mat[1])),
+                                   glm::length(glm::vec3(world.mat[2])) });
+        f32 radius = model.bounds.radius * max_scale;
+        f32 dist = glm::distance(center, globals.camera_pos);
+
+        // fraction of the screen height covered by the bounding sphere
+        if (dist <= radius || radius / (dist * tan_half_fov) >= screen_threshold) {
+            return 1;
+        }
+
+        CacheEntry& entry = cache[model.mesh_bvhs.get()];
+        entry.geometry = model.mesh_bvhs;
+        if (!entry.impostor) {
+            if (n_bakes >= max_bakes_per_frame) {
+                return 1;
+            }
+            entry.impostor = std::make_unique<Impostor>();
+            bake(*entry.impostor, model, bake_shader, globals);
+            ++n_bakes;
+        }
+
+        if (!entry.impostor->baked) {
+            return 1;
+        }
+
+        cards.push_back({ .impostor = entry.impostor.get(), .instance = { .model = world.mat, .normal_mat = world.normal } });
+        stats.n_impostors++;
+        return 2;
+    };
+
+    // draws of entities drawn as cards are removed, keeping the list in ascending order
+    size_t n_kept = 0;
+    for (u32 draw_idx : camera_visible) {
+        u32 ent_idx = draw_list.draw_ents[draw_idx];
+        if (ent_state[ent_idx] == 0) {
+            ent_state[ent_idx] = decide(ent_idx);
+        }
+
+        if (ent_state[ent_idx] == 1) {
+            camera_visible[n_kept++] = draw_idx;
+        } else {
+            stats.n_draws_replaced++;
+            stats.n_indices_replaced += draw_list.draw_cmds[draw_idx].count;
+        }
+    }
+    camera_visible.resize(n_kept);
+
+    if (n_bakes > 0) {
+        stats.bake_ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - bake_start).count();
+    }
+}
+
+void ImpostorRenderer::draw(Shader& shader) {
+
+    stats.n_batches = 0;
+    if (cards.empty()) {
+        return;
+    }
+
+    std::sort(cards.begin(), cards.end(), [](const Card& a, const Card& b) { return a.impostor < b.impostor; });
+
+    // cards face the camera, their winding depends on the tile they show
+    glDisable(GL_CULL_FACE);
+    shader.use();
+    glBindVertexArray(vao);
+
+    size_t first = 0;
+    while (first < cards.size()) {
+        const Impostor& impostor = *cards[first].impostor;
+
+        batch.resize(0);
+        size_t last = first;
+        while (last < cards.size() && cards[last].impostor == &impostor) {
+            batch.push_back(cards[last++].instance);
+        }
+
+        ring->push(GL_SHADER_STORAGE_BUFFER, 21, std::span(batch));
+        shader.set_vec3("center", impostor.center);
+        shader.set_f32("radius", impostor.radius);
+        shader.set_u32("n_frames", impostor.n_frames);
+        shader.set_u32("tile_sz", impostor.tile_sz);
+        shader.set_tex("atlas_pos", 0, impostor.atlas.tex_bufs[0]);
+        shader.set_tex("atlas_norm", 1, impostor.atlas.tex_bufs[1]);
+        shader.set_tex("atlas_color", 2, impostor.atlas.tex_bufs[2]);
+        shader.set_tex("atlas_metallic", 3, impostor.atlas.tex_bufs[3]);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)batch.size());
+
+        stats.n_batches++;
+        first = last;
+    }
+
+    glEnable(GL_CULL_FACE);
+}
+
+} // namespace gl
\ No newline at end of file
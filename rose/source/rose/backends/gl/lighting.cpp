@@ -1,5 +1,11 @@
 #include <rose/backends/gl/lighting.hpp>
+#include <rose/culling.hpp>
+#include <rose/lighting.hpp>
 #include <rose/core/err.hpp>
+#include <rose/core/types.hpp>
+
+#include <algorithm>
+#include <chrono>
 
 namespace gl {
 
@@ -12,9 +18,6 @@ rses DirShadowData::init() {
     if (tex) {
         glDeleteTextures(1, &tex);
     }
-    if (light_mats_ubo) {
-        glDeleteBuffers(1, &light_mats_ubo);
-    }
 
     glCreateFramebuffers(1, &fbo);
     glBindFramebuffer(GL_FRAMEBUFFER, fbo);
@@ -41,10 +44,6 @@ rses DirShadowData::init() {
         return rses().gl("directional shadow framebuffer is incomplete");
     }
 
-    glCreateBuffers(1, &light_mats_ubo);
-    glNamedBufferStorage(light_mats_ubo, 192, nullptr, GL_DYNAMIC_STORAGE_BIT);
-    glBindBufferBase(GL_UNIFORM_BUFFER, 6, light_mats_ubo);
-
     return {};
 }
 
@@ -82,4 +81,379 @@ rses PtShadowData::init() {
     return {};
 }
 
+rses SpotShadowData::init() {
+    // free existing data
+    if (fbo) {
+        glDeleteFramebuffers(1, &fbo);
+    }
+    if (tex) {
+        glDeleteTextures(1, &tex);
+    }
+
+    glCreateFramebuffers(1, &fbo);
+    glCreateTextures(GL_TEXTURE_2D, 1, &tex);
+
+    glTextureStorage2D(tex, 1, GL_DEPTH_COMPONENT32F, resolution, resolution);
+
+    glTextureParameteri(tex, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTextureParameteri(tex, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTextureParameteri(tex, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(tex, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glNamedFramebufferTexture(fbo, GL_DEPTH_ATTACHMENT, tex, 0);
+    glNamedFramebufferDrawBuffer(fbo, GL_NONE);
+    glNamedFramebufferReadBuffer(fbo, GL_NONE);
+
+    if (glCheckNamedFramebufferStatus(fbo, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        return rses().gl("spot shadow framebuffer is incomplete");
+    }
+
+    return {};
+}
+
+// layout of a staged light read by the scatter shader
+struct LightUpdate {
+    u32 idx;
+    u32 id;
+    u32 padding[2] = {};
+    glm::vec4 pos;
+    PtLight light;
+};
+
+static_assert(sizeof(LightUpdate) == 80);
+
+void LightBuffers::init(u32 n_lights) {
+    data_ssbo.init(sizeof(PtLight) * n_lights, 3);
+    pos_ssbo.init(sizeof(glm::vec4) * n_lights, 4);
+    ids_ssbo.init(sizeof(u32) * n_lights, 7);
+}
+
+void LightBuffers::sync(LightRegistry& registry, RingBuffer& ring, Shader& scatter) {
+
+    stats = { .n_lights = registry.size() };
+    n_lights = registry.size();
+
+    // contents are kept when growing, so only changed lights have to be written
+    data_ssbo.reserve(sizeof(PtLight) * n_lights);
+    pos_ssbo.reserve(sizeof(glm::vec4) * n_lights);
+    ids_ssbo.reserve(sizeof(u32) * n_lights);
+    data_ssbo.n_elems = n_lights;
+    pos_ssbo.n_elems = n_lights;
+    ids_ssbo.n_elems = n_lights;
+
+    registry.take_dirty_ranges(ranges, max_gap);
+    if (ranges.empty()) {
+        return;
+    }
+
+    for (const auto& range : ranges) {
+        stats.n_updated += range.end - range.begin;
+    }
+    stats.n_ranges = (u32)ranges.size();
+
+    if (ranges.size() <= max_direct_ranges) {
+        for (const auto& range : ranges) {
+            u32 count = range.end - range.begin;
+            glNamedBufferSubData(data_ssbo.ssbo, sizeof(PtLight) * range.begin, sizeof(PtLight) * count,
+                                 &registry.data[range.begin]);
+            glNamedBufferSubData(pos_ssbo.ssbo, sizeof(glm::vec4) * range.begin, sizeof(glm::vec4) * count,
+                                 &registry.positions[range.begin]);
+            glNamedBufferSubData(ids_ssbo.ssbo, sizeof(u32) * range.begin, sizeof(u32) * count,
+                                 &registry.ids[range.begin]);
+        }
+        stats.n_bytes = stats.n_updated * (sizeof(PtLight) + sizeof(glm::vec4) + sizeof(u32));
+        return;
+    }
+
+    // note: bound to 14, which is otherwise unused
+    RingAlloc alloc = ring.bind(GL_SHADER_STORAGE_BUFFER, 14, sizeof(LightUpdate) * stats.n_updated);
+    LightUpdate* updates = reinterpret_cast<LightUpdate*>(alloc.ptr);
+
+    u32 n_updates = 0;
+    for (const auto& range : ranges) {
+        for (u32 idx = range.begin; idx < range.end; ++idx) {
+            updates[n_updates++] = { .idx = idx,
+                                     .id = registry.ids[idx],
+                                     .pos = registry.positions[idx],
+                                     .light = registry.data[idx] };
+        }
+    }
+
+    scatter.use();
+    scatter.set_u32("n_updates", n_updates);
+    glDispatchCompute((n_updates + 63) / 64, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    stats.n_bytes = n_updates * sizeof(LightUpdate);
+    stats.scattered = true;
+}
+
+void LightTree::init() {
+    keys_ssbo.init(sizeof(glm::uvec2) * sort_block, 24);
+    view_lights_ssbo.init(sizeof(glm::vec4) * sort_block, 25);
+    nodes_ssbo.init(sizeof(glm::vec4) * 2 * (sort_block / leaf_sz + 1), 26);
+    sorted_ssbo.init(sizeof(glm::vec4) * sort_block, 27);
+    info_ssbo.init(sizeof(u32) * 4, 28);
+}
+
+void LightTree::build(u32 n_lights, Shader& prepass, Shader& sort, Shader& build_level) {
+
+    n_slots = sort_block;
+    while (n_slots < n_lights) {
+        n_slots *= 2;
+    }
+
+    // the levels are laid out for every light being visible, nodes past the visible lights are left empty
+    n_levels = 0;
+    u32 n_nodes = 0;
+    u32 level_sz = std::max((n_lights + leaf_sz - 1) / leaf_sz, 1u);
+    while (true) {
+        level_offsets[n_levels] = n_nodes;
+        level_sizes[n_levels] = level_sz;
+        n_nodes += level_sz;
+        n_levels++;
+        if (level_sz == 1 || n_levels == max_levels) {
+            break;
+        }
+        level_sz = (level_sz + branching - 1) / branching;
+    }
+
+    // note: contents are rebuilt every frame, growing only needs the space
+    keys_ssbo.reserve(sizeof(glm::uvec2) * n_slots);
+    view_lights_ssbo.reserve(sizeof(glm::vec4) * std::max(n_lights, 1u));
+    sorted_ssbo.reserve(sizeof(glm::vec4) * std::max(n_lights, 1u));
+    nodes_ssbo.reserve(sizeof(glm::vec4) * 2 * n_nodes);
+
+    const u32 n_visible = 0;
+    glNamedBufferSubData(info_ssbo.ssbo, 0, sizeof(u32), &n_visible);
+
+    prepass.use();
+    prepass.set_u32("n_lights", n_lights);
+    prepass.set_u32("n_slots", n_slots);
+    glDispatchCompute(n_slots / 64, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // bitonic sort, steps comparing keys less than a work group apart are done in shared memory
+    u32 n_groups = n_slots / sort_block;
+    sort.use();
+    sort.set_u32("mode", 0);
+    glDispatchCompute(n_groups, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    for (u32 k = sort_block * 2; k <= n_slots; k *= 2) {
+        sort.set_u32("k", k);
+        sort.set_u32("mode", 1);
+        for (u32 j = k / 2; j >= sort_block; j /= 2) {
+            sort.set_u32("j", j);
+            glDispatchCompute(n_groups, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+        sort.set_u32("mode", 2);
+        glDispatchCompute(n_groups, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    build_level.use();
+    for (u32 level = 0; level < n_levels; ++level) {
+        build_level.set_u32("level", level);
+        build_level.set_u32("n_nodes", level_sizes[level]);
+        build_level.set_u32("node_offset", level_offsets[level]);
+        build_level.set_u32("n_children", level > 0 ? level_sizes[level - 1] : 0);
+        build_level.set_u32("child_offset", level > 0 ? level_offsets[level - 1] : 0);
+        glDispatchCompute((level_sizes[level] + 63) / 64, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+}
+
+void LightTree::bind(Shader& shader) const {
+    // note: names are spelled out so binding does not allocate every frame
+    static constexpr std::array<const char*, max_levels> offset_names = {
+        "level_offsets[0]", "level_offsets[1]", "level_offsets[2]",
+        "level_offsets[3]", "level_offsets[4]", "level_offsets[5]"
+    };
+    static constexpr std::array<const char*, max_levels> size_names = {
+        "level_sizes[0]", "level_sizes[1]", "level_sizes[2]", "level_sizes[3]", "level_sizes[4]", "level_sizes[5]"
+    };
+
+    shader.set_u32("n_levels", n_levels);
+    for (u32 level = 0; level < max_levels; ++level) {
+        shader.set_u32(offset_names[level], level_offsets[level]);
+        shader.set_u32(size_names[level], level_sizes[level]);
+    }
+}
+
+ClusterLights::~ClusterLights() {
+    for (auto& fence : fences) {
+        if (fence) {
+            glDeleteSync(fence);
+        }
+    }
+    if (readback) {
+        glUnmapNamedBuffer(readback);
+        glDeleteBuffers(1, &readback);
+    }
+}
+
+void ClusterLights::init(u32 n_clusters) {
+    grid_ssbo.init(sizeof(glm::uvec2) * n_clusters, 5);
+    capacity = n_clusters * initial_per_cluster;
+    pool_ssbo.init(sizeof(ClusterLightStats) + sizeof(u32) * capacity, 29);
+
+    constexpr GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, &readback);
+    glNamedBufferStorage(readback, sizeof(ClusterLightStats) * n_frames, nullptr, flags);
+    readback_ptr = reinterpret_cast<ClusterLightStats*>(
+        glMapNamedBufferRange(readback, 0, sizeof(ClusterLightStats) * n_frames, flags));
+}
+
+void ClusterLights::begin(u32 n_lights) {
+    u32 slot = frame % n_frames;
+
+    // read back the amount used the last time this slot was used, skipping it if the GPU is not done yet
+    if (fences[slot]) {
+        GLenum ret = glClientWaitSync(fences[slot], 0, 0);
+        if (ret == GL_ALREADY_SIGNALED || ret == GL_CONDITION_SATISFIED) {
+            stats = readback_ptr[slot];
+            if (stats.n_used > capacity) {
+                // note: the lists are rebuilt every frame, growing only needs the space
+                u32 wanted = (u32)(stats.n_used * grow_factor);
+                pool_ssbo.reserve(sizeof(ClusterLightStats) + sizeof(u32) * wanted);
+                capacity = (pool_ssbo.capacity - sizeof(ClusterLightStats)) / sizeof(u32);
+                n_grows++;
+            }
+        }
+        glDeleteSync(fences[slot]);
+        fences[slot] = nullptr;
+    }
+
+    packed = n_lights <= max_packed_lights;
+
+    const ClusterLightStats cleared;
+    glNamedBufferSubData(pool_ssbo.ssbo, 0, sizeof(cleared), &cleared);
+}
+
+void ClusterLights::end() {
+    u32 slot = frame % n_frames;
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glCopyNamedBufferSubData(pool_ssbo.ssbo, readback, 0, sizeof(ClusterLightStats) * slot,
+                             sizeof(ClusterLightStats));
+    fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    ++frame;
+}
+
+void ClusterLights::upload(std::span<const glm::uvec2> grid, std::span<const u32> pool, bool packed) {
+    grid_ssbo.reserve((u32)grid.size_bytes());
+    glNamedBufferSubData(grid_ssbo.ssbo, 0, grid.size_bytes(), grid.data());
+
+    pool_ssbo.reserve((u32)pool.size_bytes());
+    capacity = (pool_ssbo.capacity - sizeof(ClusterLightStats)) / sizeof(u32);
+    glNamedBufferSubData(pool_ssbo.ssbo, 0, pool.size_bytes(), pool.data());
+    // the pool starts with the same header the cull shader writes
+    stats = { .n_used = pool[0], .n_lists = pool[1], .n_refs = pool[2], .max_lights = pool[3] };
+    this->packed = packed;
+}
+
+void ClusterLights::bind(Shader& shader) const {
+    shader.set_bool("packed_indices", packed);
+    shader.set_u32("pool_capacity", capacity);
+}
+
+void ZBinLights::init() {
+    data_ssbo.init(sizeof(u32) * 2 * n_bins, 30);
+    masks_ssbo.init(sizeof(u32), 31);
+    view_lights_ssbo.init(sizeof(glm::vec4), 32);
+}
+
+void ZBinLights::build(const LightRegistry& registry, const glm::mat4& view, const glm::mat4& projection,
+                       glm::uvec2 screen_dims, f32 far_z, Shader& tiles) {
+
+    auto start = std::chrono::steady_clock::now();
+
+    // keep the lights inside the frustum, keyed by their view depth
+    Frustum frustum = make_frustum(projection);
+    keys.clear();
+    for (u32 idx = 0; idx < registry.size(); ++idx) {
+        glm::vec3 pos = glm::vec3(view * registry.positions[idx]);
+        f32 radius = registry.data[idx].radius;
+        bool inside = true;
+        for (const auto& plane : frustum.planes) {
+            inside = inside && glm::dot(glm::vec3(plane), pos) + plane.w >= -radius;
+        }
+        if (inside) {
+            keys.push_back({ -pos.z, idx });
+        }
+    }
+    std::sort(keys.begin(), keys.end(), [](const Key& a, const Key& b) { return a.depth < b.depth; });
+
+    u32 n_visible = (u32)keys.size();
+    data.assign(2 * n_bins + n_visible, 0);
+    view_lights.resize(std::max(n_visible, 1u));
+    for (u32 bin = 0; bin < n_bins; ++bin) {
+        data[2 * bin] = empty_bin;
+    }
+
+    // slots are visited in ascending order, so the first to reach a bin is its lowest and the last its highest
+    f32 bin_scale = (f32)n_bins / far_z;
+    for (u32 slot = 0; slot < n_visible; ++slot) {
+        u32 light = keys[slot].light;
+        f32 radius = registry.data[light].radius;
+        glm::vec3 pos = glm::vec3(view * registry.positions[light]);
+        view_lights[slot] = glm::vec4(pos, radius);
+        data[2 * n_bins + slot] = light;
+
+        u32 first_bin = std::min((u32)(std::max(keys[slot].depth - radius, 0.0f) * bin_scale), n_bins - 1);
+        u32 last_bin = std::min((u32)(std::max(keys[slot].depth + radius, 0.0f) * bin_scale), n_bins - 1);
+        for (u32 bin = first_bin; bin <= last_bin; ++bin) {
+            if (data[2 * bin] == empty_bin) {
+                data[2 * bin] = slot;
+            }
+            data[2 * bin + 1] = slot;
+        }
+    }
+
+    stats.cpu_ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    n_tiles = (screen_dims + tile_sz - 1u) / tile_sz;
+    n_words = std::max((n_visible + 31) / 32, 1u);
+
+    data_ssbo.update(std::span(data));
+    view_lights_ssbo.update(std::span(view_lights));
+    // note: the masks are rewritten in full every frame, growing only needs the space
+    masks_ssbo.reserve(sizeof(u32) * n_words * n_tiles.x * n_tiles.y);
+
+    tiles.use();
+    tiles.set_mat4("inv_proj", glm::inverse(projection));
+    tiles.set_u32("n_lights", n_visible);
+    tiles.set_u32("n_words", n_words);
+    tiles.set_u32("zbin_tile_sz", tile_sz);
+    tiles.set_u32("n_tiles_x", n_tiles.x);
+    glDispatchCompute(n_tiles.x, n_tiles.y, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    stats.n_visible = n_visible;
+    stats.n_tiles = n_tiles.x * n_tiles.y;
+    stats.data_bytes = (u32)(sizeof(u32) * data.size());
+    stats.mask_bytes = sizeof(u32) * n_words * stats.n_tiles;
+}
+
+void ZBinLights::bind(Shader& shader) const {
+    shader.set_u32("n_zbins", n_bins);
+    shader.set_u32("zbin_words", n_words);
+    shader.set_u32("zbin_tile_sz", tile_sz);
+    shader.set_u32("zbin_tiles_x", n_tiles.x);
+}
+
+void ClustersData::resize(u32 n_clusters) {
+    aabb_ssbo.reserve(sizeof(AABB) * n_clusters);
+    flags_ssbo.reserve(sizeof(u32) * n_clusters);
+    active_ssbo.reserve(sizeof(u32) * (4 + n_clusters));
+    lists.grid_ssbo.reserve(sizeof(glm::uvec2) * n_clusters);
+
+    // note: compaction only clears the flags it finds set, so new space has to start cleared
+    glClearNamedBufferData(flags_ssbo.ssbo, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+    // forces the AABBs to be rebuilt for the new grid
+    aabb_proj = glm::mat4(0.0f);
+}
+
 } // namespace gl
\ No newline at end of file
@@ -0,0 +1,163 @@
+#include <rose/backends/gl/occlusion.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <string_view>
+
+namespace gl {
+
+DepthPyramid::~DepthPyramid() {
+    if (tex) {
+        glDeleteTextures(1, &tex);
+    }
+}
+
+void DepthPyramid::init(u32 w, u32 h) {
+
+    width = w;
+    height = h;
+    n_mips = std::bit_width(std::max(w, h));
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &tex);
+    glTextureStorage2D(tex, n_mips, GL_R32F, w, h);
+
+    // note: levels are read individually with textureLod, filtering between texels would underestimate depth
+    glTextureParameteri(tex, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTextureParameteri(tex, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTextureParameteri(tex, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(tex, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+void DepthPyramid::build(Shader& shader, u32 gbuf_pos) {
+
+    shader.use();
+    shader.set_tex("gbuf_pos", 0, gbuf_pos);
+
+    for (u32 level = 0; level < n_mips; ++level) {
+        u32 mip_w = std::max(width >> level, 1u);
+        u32 mip_h = std::max(height >> level, 1u);
+
+        // note: the first level reads from the gbuffer, the source image is bound but never accessed
+        glBindImageTexture(0, tex, level == 0 ? 0 : level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+        glBindImageTexture(1, tex, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        shader.set_i32("mip_level", level);
+
+        glDispatchCompute((mip_w + 7) / 8, (mip_h + 7) / 8, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    }
+
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+void OcclusionCuller::init(DrawList& draw_list) { this->draw_list = &draw_list; }
+
+void OcclusionCuller::prepare(const CullBounds& bounds) {
+
+    RingBuffer& ring = *draw_list->ring;
+    const PassCmds& pass = draw_list->passes[(size_t)CullPass::CAMERA];
+    const auto& cmds = pass.cmds[(size_t)DrawGroup::OPAQUE];
+    const auto& batches = pass.batches[(size_t)DrawGroup::OPAQUE];
+
+    n_cmds = (u32)cmds.size();
+    n_batches = (u32)batches.size();
+
+    bounds_data.resize(bounds.size() * 2);
+    for (u32 idx = 0; idx < bounds.size(); ++idx) {
+        bounds_data[idx * 2] = { bounds.center_x[idx], bounds.center_y[idx], bounds.center_z[idx], 0.0f };
+        bounds_data[idx * 2 + 1] = { bounds.extent_x[idx], bounds.extent_y[idx], bounds.extent_z[idx], 0.0f };
+    }
+
+    cmd_batches.resize(n_cmds);
+    for (u32 batch_idx = 0; batch_idx < n_batches; ++batch_idx) {
+        const DrawBatch& batch = batches[batch_idx];
+        for (u32 cmd_idx = batch.first_cmd; cmd_idx < batch.first_cmd + batch.n_cmds; ++cmd_idx) {
+            cmd_batches[cmd_idx] = { .batch = batch_idx, .first_cmd = batch.first_cmd };
+        }
+    }
+
+    ring.push(GL_SHADER_STORAGE_BUFFER, 15, std::span(bounds_data.begin(), bounds_data.end()));
+    ring.push(GL_SHADER_STORAGE_BUFFER, 16, std::span(cmds.begin(), cmds.end()));
+    ring.push(GL_SHADER_STORAGE_BUFFER, 17, std::span(cmd_batches.begin(), cmd_batches.end()));
+    ring.bind(GL_SHADER_STORAGE_BUFFER, 18, n_cmds * sizeof(u32));
+
+    // each phase writes into its own range, so the commands of the first phase are still intact when
+    // the second is culled
+    for (u32 phase = 0; phase < n_phases; ++phase) {
+        out_offsets[phase] = ring.alloc(std::max(n_cmds, 1u) * sizeof(IndirectCmd)).offset;
+
+        RingAlloc counts = ring.alloc(std::max(n_batches, 1u) * sizeof(u32));
+        std::memset(counts.ptr, 0, counts.size);
+        count_offsets[phase] = counts.offset;
+    }
+}
+
+void OcclusionCuller::cull(Shader& shader, const DepthPyramid& pyramid, u32 phase, const glm::mat4& proj_view,
+                           f32 near_z) {
+
+    if (n_cmds == 0) {
+        return;
+    }
+
+    RingBuffer& ring = *draw_list->ring;
+    Frustum frustum = make_frustum(proj_view);
+
+    shader.use();
+    shader.set_u32("n_cmds", n_cmds);
+    shader.set_u32("phase", phase);
+    shader.set_bool("hiz_valid", hiz_valid);
+    shader.set_mat4("cull_mat", phase == 0 ? prev_proj_view : proj_view);
+    shader.set_f32("near_z", near_z);
+    shader.set_tex("hiz_tex", 0, pyramid.tex);
+
+    // note: names are spelled out rather than formatted, which would allocate every frame
+    static constexpr std::array<std::string_view, 6> plane_names = { "frustum_planes[0]", "frustum_planes[1]",
+                                                                      "frustum_planes[2]", "frustum_planes[3]",
+                                                                      "frustum_planes[4]", "frustum_planes[5]" };
+    for (u32 idx = 0; idx < frustum.planes.size(); ++idx) {
+        shader.set_vec4(plane_names[idx], frustum.planes[idx]);
+    }
+
+    // note: nothing is allocated from the ring buffer between prepare() and here, so the offsets still
+    // refer to the current buffer
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 19, ring.buf, ring.frame_offset() + out_offsets[phase],
+                      std::max(n_cmds, 1u) * sizeof(IndirectCmd));
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 20, ring.buf, ring.frame_offset() + count_offsets[phase],
+                      std::max(n_batches, 1u) * sizeof(u32));
+
+    glDispatchCompute((n_cmds + 63) / 64, 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void OcclusionCuller::draw(Shader& shader, u32 phase) {
+
+    if (n_cmds == 0) {
+        return;
+    }
+
+    RingBuffer& ring = *draw_list->ring;
+    const auto& batches = draw_list->passes[(size_t)CullPass::CAMERA].batches[(size_t)DrawGroup::OPAQUE];
+
+    size_t cmds_start = ring.frame_offset() + out_offsets[phase];
+    size_t counts_start = ring.frame_offset() + count_offsets[phase];
+
+    shader.use();
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, ring.buf);
+    glBindBuffer(GL_PARAMETER_BUFFER, ring.buf);
+
+    // the number of commands written for a batch is only known to the GPU, the batch size is an upper bound
+    for (u32 batch_idx = 0; batch_idx < n_batches; ++batch_idx) {
+        const DrawBatch& batch = batches[batch_idx];
+        glBindVertexArray(batch.vao);
+        glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                         (void*)(cmds_start + sizeof(IndirectCmd) * batch.first_cmd),
+                                         (GLintptr)(counts_start + sizeof(u32) * batch_idx), batch.n_cmds,
+                                         sizeof(IndirectCmd));
+    }
+
+    glBindBuffer(GL_PARAMETER_BUFFER, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+} // namespace gl
\ No newline at end of file
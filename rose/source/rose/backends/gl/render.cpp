@@ -1,5 +1,10 @@
 #include <rose/backends/gl/render.hpp>
 #include <rose/model.hpp>
+#include <rose/core/memory.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
 
 namespace gl {
 
@@ -42,7 +47,7 @@ static void render_mesh(Shader& shader, const Mesh& mesh, const std::vector<Text
 void render(Shader& shader, const Model& model) {
     shader.use();
     shader.set_mat4("model", model.model_mat);
-    glBindVertexArray(model.render_data.vao);
+    glBindVertexArray(model.vao());
     for (const auto& mesh : model.meshes) {
         render_mesh(shader, mesh, model.textures);
     }
@@ -51,7 +56,7 @@ void render(Shader& shader, const Model& model) {
 void render_opaque(Shader& shader, const Model& model) {
     shader.use();
     shader.set_mat4("model", model.model_mat);
-    glBindVertexArray(model.render_data.vao);
+    glBindVertexArray(model.vao());
     for (auto& mesh : model.meshes) {
         if (!is_flag_set(mesh.flags, MeshFlags::TRANSPARENT)) {
             render_mesh(shader, mesh, model.textures);
@@ -62,7 +67,7 @@ void render_opaque(Shader& shader, const Model& model) {
 void render_transparent(Shader& shader, const Model& model) {
     shader.use();
     shader.set_mat4("model", model.model_mat);
-    glBindVertexArray(model.render_data.vao);
+    glBindVertexArray(model.vao());
     for (auto& mesh : model.meshes) {
         if (is_flag_set(mesh.flags, MeshFlags::TRANSPARENT)) {
             render_mesh(shader, mesh, model.textures);
@@ -80,5 +85,239 @@ void render(Shader& shader, SkyBox& skybox, u32 vao) {
     glDepthMask(GL_TRUE);
 }
 
+void render_nodes(Shader& shader, const Model& model) {
+    shader.use();
+    glBindVertexArray(model.vao());
+
+    ScratchScope scratch;
+    ArenaVector<glm::mat4> node_mats(model.nodes.size(), scratch.arena);
+    for (size_t idx = 0; idx < model.nodes.size(); ++idx) {
+        const ModelNode& node = model.nodes[idx];
+        node_mats[idx] = node.parent < 0 ? node.local.mat : node_mats[node.parent] * node.local.mat;
+    }
+
+    for (const auto& mesh : model.meshes) {
+        const glm::mat4& mat = node_mats[mesh.node_idx];
+        shader.set_mat4("model", mat);
+        shader.set_mat4("normal_matrix", glm::mat4(glm::transpose(glm::inverse(glm::mat3(mat)))));
+        render_mesh(shader, mesh, model.textures);
+    }
+}
+
+// returns the bindless handle of a texture, making it resident on first use
+static u64 get_handle(GL_Texture* texture) {
+    if (!texture->handle) {
+        texture->handle = glGetTextureHandleARB(texture->id);
+        glMakeTextureHandleResidentARB(texture->handle);
+    }
+    return texture->handle;
+}
+
+static MatlRecord make_matl(const Mesh& mesh, const std::vector<TextureRef>& textures) {
+    MatlRecord matl;
+
+    for (u32 idx = mesh.matl_offset; idx < mesh.matl_offset + mesh.n_matls; ++idx) {
+        switch (textures[idx].ref->ty) {
+        case TextureType::ALBEDO:
+            matl.flags |= MatlFlags::HAS_ALBEDO_MAP;
+            matl.albedo_map = get_handle(textures[idx].ref);
+            break;
+        case TextureType::GLTF_PBR:
+            matl.flags |= MatlFlags::HAS_PBR_MAP;
+            matl.pbr_map = get_handle(textures[idx].ref);
+            break;
+        case TextureType::NORMAL:
+            matl.flags |= MatlFlags::HAS_NORMAL_MAP;
+            matl.normal_map = get_handle(textures[idx].ref);
+            break;
+        case TextureType::AMBIENT_OCCLUSION:
+            matl.flags |= MatlFlags::HAS_AO_MAP;
+            matl.ao_map = get_handle(textures[idx].ref);
+            break;
+        default:
+            break;
+        }
+    }
+
+    return matl;
+}
+
+void DrawList::init(RingBuffer& ring, bool bindless) {
+    this->ring = &ring;
+    this->bindless = bindless;
+    if (bindless) {
+        matls_ssbo.init(sizeof(MatlRecord) * 1024, 13);
+    }
+}
+
+void DrawList::build(Entities& entities, CullBounds& bounds) {
+
+    draws.resize(0);
+    draw_cmds.resize(0);
+    draw_groups.resize(0);
+    draw_vaos.resize(0);
+    draw_meshes.resize(0);
+    draw_ents.resize(0);
+    scene = &entities.scene;
+    bounds.clear();
+
+    // entities are visited grouped by vertex array, so the draws of copies of a model are adjacent and stay
+    // in a single batch after culling
+    ScratchScope scratch;
+    ArenaVector<std::pair<u32, u32>> ent_order(scratch.arena);
+    ent_order.reserve(entities.size());
+    for (size_t ent_idx = 0; ent_idx < entities.size(); ++ent_idx) {
+        if (!entities.is_light(ent_idx) && entities.models[ent_idx].render_data) {
+            ent_order.push_back({ entities.models[ent_idx].vao(), (u32)ent_idx });
+        }
+    }
+    std::sort(ent_order.begin(), ent_order.end());
+
+    for (auto [vao, ent_idx] : ent_order) {
+        Model& model = entities.models[ent_idx];
+
+        // register the materials of models which have not been drawn indirectly before
+        if (bindless && model.render_data->matl_base == RenderData::invalid_matl_base) {
+            model.render_data->matl_base = (u32)matls.size();
+            for (const auto& mesh : model.meshes) {
+                matls.push_back(make_matl(mesh, model.textures));
+            }
+            matls_dirty = true;
+        }
+
+        for (size_t mesh_idx = 0; mesh_idx < model.meshes.size(); ++mesh_idx) {
+            const Mesh& mesh = model.meshes[mesh_idx];
+            u32 node_pos = entities.scene.pos(entities.mesh_node(ent_idx, (u32)mesh_idx));
+
+            draw_cmds.push_back({ .count = (u32)mesh.n_indices,
+                                  .instance_count = 1,
+                                  .first_idx = (u32)mesh.base_idx,
+                                  .base_vert = (i32)mesh.base_vert,
+                                  .base_instance = (u32)draws.size() });
+
+            draws.push_back({ .transform_idx = node_pos, .matl_idx = model.render_data->matl_base + (u32)mesh_idx });
+            draw_groups.push_back(is_flag_set(mesh.flags, MeshFlags::TRANSPARENT) ? DrawGroup::TRANSPARENT
+                                                                                  : DrawGroup::OPAQUE);
+            draw_vaos.push_back(vao);
+            draw_meshes.push_back((u32)mesh_idx);
+            draw_ents.push_back(ent_idx);
+            bounds.push(mesh.bounds, entities.scene.transforms[node_pos].mat);
+        }
+    }
+}
+
+void DrawList::compact(const Culler& culler) {
+
+    for (size_t draw_idx = 0; draw_idx < draws.size(); ++draw_idx) {
+        draws[draw_idx].shadow_mask = culler.shadow_masks[draw_idx];
+    }
+
+    for (size_t pass_idx = 0; pass_idx < passes.size(); ++pass_idx) {
+        PassCmds& pass = passes[pass_idx];
+
+        for (size_t group = 0; group < pass.cmds.size(); ++group) {
+            pass.cmds[group].resize(0);
+            pass.batches[group].resize(0);
+        }
+
+        // visible lists are in ascending order, so draws sharing a vertex array are adjacent
+        for (u32 draw_idx : culler.visible[pass_idx]) {
+            size_t group = (size_t)draw_groups[draw_idx];
+            auto& batches = pass.batches[group];
+
+            if (batches.empty() || batches.back().vao != draw_vaos[draw_idx]) {
+                batches.push_back({ .vao = draw_vaos[draw_idx], .first_cmd = (u32)pass.cmds[group].size(), .n_cmds = 0 });
+            }
+
+            pass.cmds[group].push_back(draw_cmds[draw_idx]);
+            batches.back().n_cmds++;
+        }
+    }
+}
+
+void DrawList::upload() {
+
+    ring->push(GL_SHADER_STORAGE_BUFFER, 11, std::span(scene->transforms.begin(), scene->transforms.end()));
+    ring->push(GL_SHADER_STORAGE_BUFFER, 12, std::span(draws.begin(), draws.end()));
+
+    // commands of each group within a pass are written back to back
+    for (auto& pass : passes) {
+        u32 cmds_sz = 0;
+        for (const auto& group_cmds : pass.cmds) {
+            cmds_sz += (u32)(group_cmds.size() * sizeof(IndirectCmd));
+        }
+
+        RingAlloc cmds_alloc = ring->alloc(cmds_sz);
+        pass.cmds_offset = cmds_alloc.offset;
+        for (const auto& group_cmds : pass.cmds) {
+            if (!group_cmds.empty()) {
+                std::memcpy(cmds_alloc.ptr, group_cmds.data(), group_cmds.size() * sizeof(IndirectCmd));
+                cmds_alloc.ptr += group_cmds.size() * sizeof(IndirectCmd);
+            }
+        }
+    }
+
+    if (matls_dirty) {
+        matls_ssbo.update(std::span(matls.begin(), matls.end()));
+        matls_dirty = false;
+    }
+}
+
+void DrawList::draw(Shader& shader, CullPass pass, DrawGroup group) {
+
+    const PassCmds& pass_cmds = passes[(size_t)pass];
+
+    if (pass_cmds.batches[(size_t)group].empty()) {
+        return;
+    }
+
+    u32 group_offset = 0;
+    for (size_t idx = 0; idx < (size_t)group; ++idx) {
+        group_offset += (u32)pass_cmds.cmds[idx].size();
+    }
+
+    // note: the ring buffer may have been replaced since upload(), so it is looked up at draw time
+    size_t cmds_start = ring->frame_offset() + pass_cmds.cmds_offset;
+
+    shader.use();
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, ring->buf);
+
+    for (const auto& batch : pass_cmds.batches[(size_t)group]) {
+        glBindVertexArray(batch.vao);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                    (void*)(cmds_start + sizeof(IndirectCmd) * (group_offset + batch.first_cmd)),
+                                    batch.n_cmds, sizeof(IndirectCmd));
+    }
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void DrawList::draw_direct(Shader& shader, Entities& entities, CullPass pass, DrawGroup group) {
+
+    const PassCmds& pass_cmds = passes[(size_t)pass];
+
+    shader.use();
+    u32 prev_transform = std::numeric_limits<u32>::max();
+
+    for (const auto& batch : pass_cmds.batches[(size_t)group]) {
+        glBindVertexArray(batch.vao);
+
+        for (u32 cmd_idx = batch.first_cmd; cmd_idx < batch.first_cmd + batch.n_cmds; ++cmd_idx) {
+            u32 draw_idx = pass_cmds.cmds[(size_t)group][cmd_idx].base_instance;
+            const DrawRecord& draw = draws[draw_idx];
+            const Model& model = entities.models[draw_ents[draw_idx]];
+
+            if (draw.transform_idx != prev_transform) {
+                shader.set_mat4("model", scene->transforms[draw.transform_idx].mat);
+                shader.set_mat4("normal_matrix", scene->transforms[draw.transform_idx].normal);
+                prev_transform = draw.transform_idx;
+            }
+
+            shader.set_u32("shadow_mask", draw.shadow_mask);
+            render_mesh(shader, model.meshes[draw_meshes[draw_idx]], model.textures);
+        }
+    }
+}
+
 
 }
\ No newline at end of file
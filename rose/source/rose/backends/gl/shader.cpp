@@ -4,15 +4,52 @@
 #include <glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
+#include <format>
 #include <optional>
 
 namespace gl {
 
-rses Shader::init(const std::vector<ShaderCtx>& shader_ctxs) {
+// declarations shared by every shader
+static constexpr const char* prelude_path = SOURCE_DIR "/rose/shaders/gl/common.glsl";
+
+// inserts a '#define' line for each define directly after the #version directive, followed by the shared
+// prelude. a #line directive afterwards keeps compile errors pointing at the lines of the original file
+static void inject_prelude(std::string& shader_code, const std::vector<std::string_view>& defines,
+                           const std::string& prelude) {
+
+    size_t insert_pos = 0;
+    if (size_t version_pos = shader_code.find("#version"); version_pos != std::string::npos) {
+        insert_pos = shader_code.find('\n', version_pos);
+        insert_pos = (insert_pos == std::string::npos) ? shader_code.size() : insert_pos + 1;
+    }
+    size_t next_line = std::count(shader_code.begin(), shader_code.begin() + insert_pos, '\n') + 1;
+
+    std::string block;
+    for (const auto& define : defines) {
+        block += "#define ";
+        block += define;
+        block += '\n';
+    }
+    block += prelude;
+    block += std::format("\n#line {}\n", next_line);
+
+    shader_code.insert(insert_pos, block);
+}
+
+rses Shader::init(const std::vector<ShaderCtx>& shader_ctxs, const std::vector<std::string_view>& defines) {
     
     i32 success = 0;
     char info_log[512];
 
+    std::ifstream prelude_file(prelude_path);
+    if (!prelude_file) {
+        return rses().io("Unable to open shader at path: {}", prelude_path);
+    }
+    std::stringstream prelude_buf;
+    prelude_buf << prelude_file.rdbuf();
+    std::string prelude = prelude_buf.str();
+
     prg = glCreateProgram();
     std::vector<u32> shaders;
 
@@ -32,6 +69,7 @@ rses Shader::init(const std::vector<ShaderCtx>& shader_ctxs) {
         std::stringstream shader_code_buf;
         shader_code_buf << shader_file.rdbuf();
         std::string shader_code_str = shader_code_buf.str();
+        inject_prelude(shader_code_str, defines, prelude);
         const char* shader_code = shader_code_str.c_str();
         u32 curr_shader = 0;
 
@@ -162,10 +200,49 @@ rses Shaders::init() {
     if (err = clusters_cull.init({ { SOURCE_DIR "/rose/shaders/gl/compute/clusters_cull.comp", GL_COMPUTE_SHADER } })) {
         return err;
     }
+    if (err = clusters_mark.init({ { SOURCE_DIR "/rose/shaders/gl/compute/clusters_mark.comp", GL_COMPUTE_SHADER } })) {
+        return err;
+    }
+    if (err = clusters_compact.init({ { SOURCE_DIR "/rose/shaders/gl/compute/clusters_compact.comp", GL_COMPUTE_SHADER } })) {
+        return err;
+    }
+    if (err = hiz_build.init({ { SOURCE_DIR "/rose/shaders/gl/compute/hiz_build.comp", GL_COMPUTE_SHADER } })) {
+        return err;
+    }
+    if (err = occlusion_cull.init({ { SOURCE_DIR "/rose/shaders/gl/compute/occlusion_cull.comp", GL_COMPUTE_SHADER } })) {
+        return err;
+    }
+    if (err = lights_scatter.init({ { SOURCE_DIR "/rose/shaders/gl/compute/lights_scatter.comp", GL_COMPUTE_SHADER } })) {
+        return err;
+    }
+    if (err = lights_prepass.init({ { SOURCE_DIR "/rose/shaders/gl/compute/lights_prepass.comp", GL_COMPUTE_SHADER } })) {
+        return err;
+    }
+    if (err = lights_sort.init({ { SOURCE_DIR "/rose/shaders/gl/compute/lights_sort.comp", GL_COMPUTE_SHADER } })) {
+        return err;
+    }
+    if (err = lights_tree.init({ { SOURCE_DIR "/rose/shaders/gl/compute/lights_tree.comp", GL_COMPUTE_SHADER } })) {
+        return err;
+    }
+    if (err = zbin_tiles.init({ { SOURCE_DIR "/rose/shaders/gl/compute/zbin_tiles.comp", GL_COMPUTE_SHADER } })) {
+        return err;
+    }
+    if (err = lighting_tiled.init({ { SOURCE_DIR "/rose/shaders/gl/compute/lighting_tiled.comp", GL_COMPUTE_SHADER } })) {
+        return err;
+    }
     if (err = gbuf.init({ { SOURCE_DIR "/rose/shaders/gl/gbuf.vert", GL_VERTEX_SHADER   },
                           { SOURCE_DIR "/rose/shaders/gl/gbuf.frag", GL_FRAGMENT_SHADER } })) {
         return err;
     }
+    if (err = gbuf_prepass.init({ { SOURCE_DIR "/rose/shaders/gl/gbuf.vert", GL_VERTEX_SHADER   },
+                                  { SOURCE_DIR "/rose/shaders/gl/gbuf.frag", GL_FRAGMENT_SHADER } },
+                                { "DEPTH_PREPASS" })) {
+        return err;
+    }
+    if (err = impostor.init({ { SOURCE_DIR "/rose/shaders/gl/impostor.vert", GL_VERTEX_SHADER   },
+                              { SOURCE_DIR "/rose/shaders/gl/impostor.frag", GL_FRAGMENT_SHADER } })) {
+        return err;
+    }
     if (err = out.init({ { SOURCE_DIR "/rose/shaders/gl/quad.vert", GL_VERTEX_SHADER   },
                          { SOURCE_DIR "/rose/shaders/gl/out.frag", GL_FRAGMENT_SHADER } })) {
         return err;
@@ -204,4 +281,39 @@ rses Shaders::init() {
     return err;
 }
 
+rses Shaders::init_indirect() {
+
+    rses err;
+
+    if (err = dir_shadow_indirect.init({ { SOURCE_DIR "/rose/shaders/gl/shadow/shadow.vert", GL_VERTEX_SHADER },
+                                         { SOURCE_DIR "/rose/shaders/gl/shadow/dir_shadow.frag", GL_FRAGMENT_SHADER },
+                                         { SOURCE_DIR "/rose/shaders/gl/shadow/dir_shadow.geom", GL_GEOMETRY_SHADER } },
+                                       { "INDIRECT_DRAW" })) {
+        return err;
+    }
+    if (err = pt_shadow_indirect.init({ { SOURCE_DIR "/rose/shaders/gl/shadow/shadow.vert", GL_VERTEX_SHADER },
+                                        { SOURCE_DIR "/rose/shaders/gl/shadow/pt_shadow.frag", GL_FRAGMENT_SHADER },
+                                        { SOURCE_DIR "/rose/shaders/gl/shadow/pt_shadow.geom", GL_GEOMETRY_SHADER } },
+                                      { "INDIRECT_DRAW" })) {
+        return err;
+    }
+    if (err = gbuf_indirect.init({ { SOURCE_DIR "/rose/shaders/gl/gbuf.vert", GL_VERTEX_SHADER },
+                                   { SOURCE_DIR "/rose/shaders/gl/gbuf.frag", GL_FRAGMENT_SHADER } },
+                                 { "INDIRECT_DRAW" })) {
+        return err;
+    }
+    if (err = gbuf_prepass_indirect.init({ { SOURCE_DIR "/rose/shaders/gl/gbuf.vert", GL_VERTEX_SHADER },
+                                           { SOURCE_DIR "/rose/shaders/gl/gbuf.frag", GL_FRAGMENT_SHADER } },
+                                         { "INDIRECT_DRAW", "DEPTH_PREPASS" })) {
+        return err;
+    }
+    if (err = lighting_forward_indirect.init({ { SOURCE_DIR "/rose/shaders/gl/lighting_forward.vert", GL_VERTEX_SHADER },
+                                               { SOURCE_DIR "/rose/shaders/gl/lighting_forward.frag", GL_FRAGMENT_SHADER } },
+                                             { "INDIRECT_DRAW" })) {
+        return err;
+    }
+
+    return err;
+}
+
 } // namespace gl
@@ -48,6 +48,7 @@ RenderData::RenderData(RenderData&& other) noexcept {
     tangent_buf = other.tangent_buf;
     uv_buf = other.uv_buf;
     indices_buf = other.indices_buf;
+    matl_base = other.matl_base;
 
     other.vao = 0;
     other.pos_buf = 0;
@@ -55,6 +56,7 @@ RenderData::RenderData(RenderData&& other) noexcept {
     other.tangent_buf = 0;
     other.uv_buf = 0;
     other.indices_buf = 0;
+    other.matl_base = invalid_matl_base;
 }
 
 RenderData& RenderData::operator=(RenderData&& other) noexcept {
@@ -139,6 +141,48 @@ FrameBuf::~FrameBuf() {
     }
 }
 
+rses MsaaFrameBuf::init(i32 w, i32 h, u32 n_samples, GLenum intern_format) {
+
+    glCreateFramebuffers(1, &frame_buf);
+    glCreateRenderbuffers(1, &color_buf);
+    glCreateRenderbuffers(1, &depth_buf);
+
+    glNamedRenderbufferStorageMultisample(color_buf, n_samples, intern_format, w, h);
+    glNamedRenderbufferStorageMultisample(depth_buf, n_samples, GL_DEPTH24_STENCIL8, w, h);
+    glNamedFramebufferRenderbuffer(frame_buf, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_buf);
+    glNamedFramebufferRenderbuffer(frame_buf, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth_buf);
+
+    width = static_cast<u32>(w);
+    height = static_cast<u32>(h);
+
+    if (glCheckNamedFramebufferStatus(frame_buf, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        release();
+        return rses().gl("multisampled framebuffer is incomplete");
+    }
+
+    samples = n_samples;
+    return {};
+}
+
+void MsaaFrameBuf::release() {
+    glDeleteFramebuffers(1, &frame_buf);
+    glDeleteRenderbuffers(1, &color_buf);
+    glDeleteRenderbuffers(1, &depth_buf);
+    frame_buf = 0;
+    color_buf = 0;
+    depth_buf = 0;
+    samples = 0;
+}
+
+void MsaaFrameBuf::resolve(const FrameBuf& dst) {
+    glBlitNamedFramebuffer(frame_buf, dst.frame_buf, 0, 0, width, height, 0, 0, dst.width, dst.height,
+                           GL_COLOR_BUFFER_BIT, GL_NEAREST);
+}
+
+MsaaFrameBuf::~MsaaFrameBuf() {
+    release();
+}
+
 bool SSBO::init(u32 size, u32 base) { 
 	glCreateBuffers(1, &ssbo);
     glNamedBufferStorage(ssbo, size, nullptr, GL_DYNAMIC_STORAGE_BIT);
@@ -149,8 +193,174 @@ bool SSBO::init(u32 size, u32 base) {
     return true;
 }
 
+bool SSBO::reserve(u32 size) {
+
+    if (size <= capacity) {
+        return false;
+    }
+
+    u32 new_capacity = std::max(capacity, 16u);
+    while (new_capacity < size) {
+        new_capacity *= 2;
+    }
+
+    u32 realloced_ssbo = 0;
+    glCreateBuffers(1, &realloced_ssbo);
+    glNamedBufferStorage(realloced_ssbo, new_capacity, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    if (capacity > 0) {
+        glCopyNamedBufferSubData(ssbo, realloced_ssbo, 0, 0, capacity);
+    }
+    glDeleteBuffers(1, &ssbo);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, base, realloced_ssbo);
+    capacity = new_capacity;
+    ssbo = realloced_ssbo;
+    return true;
+}
+
 SSBO::~SSBO() { glDeleteBuffers(1, &ssbo); }
 
+void GpuTimer::init() {
+    glCreateQueries(GL_TIMESTAMP, queries.size(), queries.data());
+}
+
+GpuTimer::~GpuTimer() {
+    if (queries[0]) {
+        glDeleteQueries(queries.size(), queries.data());
+    }
+}
+
+void GpuTimer::begin() {
+    u32 slot = frame % n_frames;
+
+    // read back the measurement made the last time this slot was used
+    if (frame >= n_frames) {
+        i32 available = 0;
+        glGetQueryObjectiv(queries[slot * 2 + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            u64 start_ns = 0;
+            u64 end_ns = 0;
+            glGetQueryObjectui64v(queries[slot * 2], GL_QUERY_RESULT, &start_ns);
+            glGetQueryObjectui64v(queries[slot * 2 + 1], GL_QUERY_RESULT, &end_ns);
+            elapsed_ms = (f64)(end_ns - start_ns) / 1'000'000.0;
+        }
+    }
+
+    glQueryCounter(queries[slot * 2], GL_TIMESTAMP);
+}
+
+void GpuTimer::end() {
+    glQueryCounter(queries[(frame % n_frames) * 2 + 1], GL_TIMESTAMP);
+    ++frame;
+}
+
+static constexpr GLbitfield ring_flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+// blocks until the GPU has passed the fence, then releases it
+static void wait_fence(GLsync& fence) {
+    if (!fence) {
+        return;
+    }
+    while (true) {
+        GLenum ret = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000);
+        if (ret == GL_ALREADY_SIGNALED || ret == GL_CONDITION_SATISFIED || ret == GL_WAIT_FAILED) {
+            break;
+        }
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+RingBuffer::~RingBuffer() {
+    for (auto& fence : fences) {
+        if (fence) {
+            glDeleteSync(fence);
+        }
+    }
+    if (buf) {
+        glUnmapNamedBuffer(buf);
+        glDeleteBuffers(1, &buf);
+    }
+}
+
+rses RingBuffer::init(u32 frame_sz) {
+
+    i32 ubo_alignment = 0;
+    i32 ssbo_alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &ubo_alignment);
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &ssbo_alignment);
+    alignment = std::max({ (u32)ubo_alignment, (u32)ssbo_alignment, 16u });
+
+    this->frame_sz = (frame_sz + alignment - 1) & ~(alignment - 1);
+
+    glCreateBuffers(1, &buf);
+    glNamedBufferStorage(buf, this->frame_sz * n_frames, nullptr, ring_flags);
+    mapped = static_cast<u8*>(glMapNamedBufferRange(buf, 0, this->frame_sz * n_frames, ring_flags));
+
+    if (!mapped) {
+        return rses().gl("unable to persistently map ring buffer");
+    }
+
+    return {};
+}
+
+void RingBuffer::begin_frame() {
+    frame = (frame + 1) % n_frames;
+    head = 0;
+    bindings.resize(0);
+    wait_fence(fences[frame]);
+}
+
+void RingBuffer::end_frame() {
+    fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+RingAlloc RingBuffer::alloc(u32 size) {
+
+    u32 offset = (head + alignment - 1) & ~(alignment - 1);
+
+    // the region is full, replace the buffer with a larger one. this is expected to happen only a few times
+    // while the scene grows, so simply wait for the GPU to release every region
+    if (offset + size > frame_sz) {
+        u32 new_frame_sz = frame_sz * 2;
+        while (new_frame_sz < offset + size) {
+            new_frame_sz *= 2;
+        }
+
+        for (auto& fence : fences) {
+            wait_fence(fence);
+        }
+
+        u32 new_buf = 0;
+        glCreateBuffers(1, &new_buf);
+        glNamedBufferStorage(new_buf, new_frame_sz * n_frames, nullptr, ring_flags);
+        u8* new_mapped = static_cast<u8*>(glMapNamedBufferRange(new_buf, 0, new_frame_sz * n_frames, ring_flags));
+
+        // carry over what has already been written this frame, offsets are relative to the region so remain valid
+        std::memcpy(new_mapped + frame * new_frame_sz, mapped + frame * frame_sz, head);
+
+        glUnmapNamedBuffer(buf);
+        glDeleteBuffers(1, &buf);
+        buf = new_buf;
+        mapped = new_mapped;
+        frame_sz = new_frame_sz;
+
+        for (const auto& binding : bindings) {
+            glBindBufferRange(binding.target, binding.base, buf, frame_offset() + binding.offset, binding.size);
+        }
+    }
+
+    head = offset + size;
+    return { .ptr = mapped + frame_offset() + offset, .offset = offset, .size = size };
+}
+
+RingAlloc RingBuffer::bind(GLenum target, u32 base, u32 size) {
+    // note: empty ranges can not be bound
+    RingAlloc ret = alloc(std::max(size, 16u));
+    glBindBufferRange(target, base, buf, frame_offset() + ret.offset, ret.size);
+    bindings.push_back({ .target = target, .base = base, .offset = ret.offset, .size = ret.size });
+    return ret;
+}
+
 std::vector<Mip> create_mip_chain(u32 w, u32 h, u32 n_mips) {
 
     glm::vec2 mip_sz = { w, h };
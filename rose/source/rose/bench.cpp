@@ -0,0 +1,364 @@
+#include <rose/bench.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+namespace bench {
+
+void spawn_streamed_city(AppState& app_state, const fs::path& model_path, i32 side, i32 density,
+                         StreamFlight& flight) {
+    WorldStreamer& streamer = app_state.streamer;
+    streamer.clear(app_state.entities);
+    streamer.reset_stats();
+
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<f32> offset_dist(0.0f, streamer.cell_sz);
+    std::uniform_real_distribution<f32> angle_dist(0.0f, 360.0f);
+    std::uniform_real_distribution<f32> scale_dist(0.75f, 1.5f);
+
+    for (i32 cell_x = 0; cell_x < side; ++cell_x) {
+        for (i32 cell_z = 0; cell_z < side; ++cell_z) {
+            glm::vec3 origin = glm::vec3(cell_x, 0.0f, cell_z) * streamer.cell_sz;
+            for (i32 ent = 0; ent < density; ++ent) {
+                f32 scale = scale_dist(rng);
+                streamer.add({ .model_path = model_path,
+                               .pos = origin + glm::vec3(offset_dist(rng), 0.0f, offset_dist(rng)),
+                               .scale = { scale, scale, scale },
+                               .rotation = { 0.0f, angle_dist(rng), 0.0f },
+                               .light_data = PtLight(),
+                               .flags = EntityFlags::NONE });
+            }
+        }
+    }
+
+    // the path crosses the city along its diagonal
+    f32 extent = side * streamer.cell_sz;
+    flight = { .start = { 0.0f, 10.0f, 0.0f }, .end = { extent, 10.0f, extent }, .latency_ms = {}, .cpu_mb = {},
+               .gpu_mb = {} };
+}
+
+void step_flight(AppState& app_state, StreamFlight& flight, f32 dt) {
+
+    glm::vec3 path = flight.end - flight.start;
+    f32 length = glm::length(path);
+    flight.travelled = std::min(flight.travelled + flight.speed * dt, length);
+    flight.flying = flight.travelled < length;
+
+    Camera& camera = app_state.camera;
+    glm::vec3 dir = path / length;
+    camera.position = flight.start + dir * flight.travelled;
+    camera.yaw = glm::degrees(std::atan2(dir.z, dir.x));
+    camera.pitch = -10.0f;
+    camera.handle_mouse(0.0f, 0.0f);
+
+    const StreamStats& stats = app_state.streamer.stats;
+    auto sample = [](std::vector<f32>& samples, f32 val) {
+        if (samples.size() == StreamFlight::max_samples) {
+            samples.erase(samples.begin());
+        }
+        samples.push_back(val);
+    };
+    sample(flight.latency_ms, (f32)stats.last_latency_ms);
+    sample(flight.cpu_mb, stats.cpu_bytes / (1024.0f * 1024.0f));
+    sample(flight.gpu_mb, stats.gpu_bytes / (1024.0f * 1024.0f));
+}
+
+void run_bvh_benchmark(const AppState& app_state, BvhBench& bench) {
+
+    using clock = std::chrono::steady_clock;
+    constexpr u32 n_boxes = 100000;
+    constexpr u32 n_moving = n_boxes / 20;
+    constexpr u32 n_frames = 60;
+    constexpr u32 n_spheres = 16;
+    constexpr f32 world_sz = 500.0f;
+
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<f32> pos_dist(-world_sz, world_sz);
+    std::uniform_real_distribution<f32> sz_dist(0.25f, 2.0f);
+    std::uniform_real_distribution<f32> vel_dist(-0.5f, 0.5f);
+
+    std::vector<glm::vec3> mins(n_boxes);
+    std::vector<glm::vec3> maxs(n_boxes);
+    std::vector<u32> proxies(n_boxes);
+    DynamicBVH bvh;
+
+    bench = { .ran = true, .n_boxes = n_boxes };
+
+    auto start = clock::now();
+    for (u32 idx = 0; idx < n_boxes; ++idx) {
+        glm::vec3 center = { pos_dist(rng), pos_dist(rng), pos_dist(rng) };
+        f32 sz = sz_dist(rng);
+        mins[idx] = center - sz;
+        maxs[idx] = center + sz;
+        proxies[idx] = bvh.insert(mins[idx], maxs[idx], idx);
+    }
+    bench.insert_ms = std::chrono::duration<f64, std::milli>(clock::now() - start).count();
+
+    f32 aspect = (f32)app_state.window_state.width / (f32)std::max(app_state.window_state.height, 1u);
+    Frustum frustum = make_frustum(app_state.camera.projection(aspect) * app_state.camera.view());
+
+    std::vector<glm::vec3> velocities(n_moving);
+    for (auto& vel : velocities) {
+        vel = { vel_dist(rng), vel_dist(rng), vel_dist(rng) };
+    }
+
+    std::vector<u32> hits;
+    f64 move_ms = 0.0, query_ms = 0.0, linear_ms = 0.0;
+    u64 n_reinserts = 0, n_hits = 0;
+
+    for (u32 frame = 0; frame < n_frames; ++frame) {
+
+        start = clock::now();
+        for (u32 idx = 0; idx < n_moving; ++idx) {
+            mins[idx] = mins[idx] + velocities[idx];
+            maxs[idx] = maxs[idx] + velocities[idx];
+            n_reinserts += bvh.move(proxies[idx], mins[idx], maxs[idx]);
+        }
+        move_ms += std::chrono::duration<f64, std::milli>(clock::now() - start).count();
+
+        std::array<glm::vec3, n_spheres> centers;
+        for (auto& center : centers) {
+            center = { pos_dist(rng), pos_dist(rng), pos_dist(rng) };
+        }
+        constexpr f32 radius = 25.0f;
+
+        start = clock::now();
+        hits.resize(0);
+        bvh.query_frustum(frustum, 6, hits);
+        for (const auto& center : centers) {
+            bvh.query_sphere(center, radius, hits);
+        }
+        query_ms += std::chrono::duration<f64, std::milli>(clock::now() - start).count();
+        n_hits += hits.size();
+
+        start = clock::now();
+        hits.resize(0);
+        for (u32 idx = 0; idx < n_boxes; ++idx) {
+            glm::vec3 center = (mins[idx] + maxs[idx]) * 0.5f;
+            glm::vec3 extent = (maxs[idx] - mins[idx]) * 0.5f;
+            bool inside = true;
+            for (const auto& plane : frustum.planes) {
+                glm::vec3 normal = glm::vec3(plane);
+                inside &= glm::dot(normal, center) + plane.w + glm::dot(glm::abs(normal), extent) >= 0.0f;
+            }
+            if (inside) {
+                hits.push_back(idx);
+            }
+            for (const auto& sphere_center : centers) {
+                glm::vec3 offset = glm::clamp(sphere_center, mins[idx], maxs[idx]) - sphere_center;
+                if (glm::dot(offset, offset) <= radius * radius) {
+                    hits.push_back(idx);
+                }
+            }
+        }
+        linear_ms += std::chrono::duration<f64, std::milli>(clock::now() - start).count();
+    }
+
+    bench.height = bvh.height();
+    bench.move_ms = move_ms / n_frames;
+    bench.n_reinserts = (u32)(n_reinserts / n_frames);
+    bench.query_ms = query_ms / n_frames;
+    bench.linear_ms = linear_ms / n_frames;
+    bench.n_hits = (u32)(n_hits / n_frames);
+}
+
+void run_ray_benchmark(const AppState& app_state, RayBench& bench) {
+
+    constexpr u32 grid_sz = 128;
+    const Entities& entities = app_state.entities;
+
+    bench = { .ran = true, .n_rays = grid_sz * grid_sz };
+    for (size_t idx = 0; idx < entities.size(); ++idx) {
+        for (const auto& mesh : entities.models[idx].meshes) {
+            bench.n_tris += mesh.n_indices / 3;
+        }
+    }
+
+    f32 aspect = (f32)app_state.window_state.width / (f32)std::max(app_state.window_state.height, 1u);
+    std::vector<glm::vec3> origins(bench.n_rays);
+    std::vector<glm::vec3> dirs(bench.n_rays);
+    for (u32 y = 0; y < grid_sz; ++y) {
+        for (u32 x = 0; x < grid_sz; ++x) {
+            glm::vec2 ndc = { ((f32)x + 0.5f) / grid_sz * 2.0f - 1.0f, ((f32)y + 0.5f) / grid_sz * 2.0f - 1.0f };
+            app_state.camera.screen_ray(aspect, ndc, origins[y * grid_sz + x], dirs[y * grid_sz + x]);
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (u32 ray = 0; ray < bench.n_rays; ++ray) {
+        bench.n_hits += entities.raycast(origins[ray], dirs[ray]).entity != invalid_entity;
+    }
+    bench.avg_us = std::chrono::duration<f64, std::micro>(std::chrono::steady_clock::now() - start).count() / bench.n_rays;
+}
+
+void run_cluster_benchmark(const AppState& app_state, gl::Backend& backend, ClusterBench& bench) {
+
+    constexpr std::array<u32, 4> light_counts = { 1024, 4096, 16384, 65536 };
+    constexpr std::array<u32, 4> tile_sizes = { 16, 32, 64, 128 };
+    constexpr u32 n_runs = 5;
+
+    const Camera& camera = app_state.camera;
+    glm::uvec2 screen_dims = { app_state.window_state.width, app_state.window_state.height };
+    f32 ar = (f32)screen_dims.x / (f32)screen_dims.y;
+    f32 tan_half_fov = std::tan(glm::radians(camera.zoom) * 0.5f);
+    glm::mat4 projection = camera.projection(ar);
+    glm::mat4 view = camera.view();
+    glm::mat4 inv_view = glm::inverse(view);
+
+#ifdef __AVX2__
+    bench = { .rows = {}, .n_threads = backend.thread_pool.size(), .simd = true };
+#else
+    bench = { .rows = {}, .n_threads = backend.thread_pool.size(), .simd = false };
+#endif
+
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<f32> ndc_dist(-1.0f, 1.0f);
+    std::uniform_real_distribution<f32> depth_dist(camera.near_plane, camera.far_plane * 0.5f);
+    std::uniform_real_distribution<f32> radius_dist(1.0f, 6.0f);
+
+    CpuClusters cpu;
+    cpu.pool = &backend.thread_pool;
+    ClusterLightSet lights;
+    Clusters clusters;
+
+    for (u32 n_lights : light_counts) {
+        LightRegistry registry;
+        for (u32 idx = 0; idx < n_lights; ++idx) {
+            f32 depth = depth_dist(rng);
+            glm::vec4 pos_vs = { ndc_dist(rng) * depth * tan_half_fov * ar, ndc_dist(rng) * depth * tan_half_fov,
+                                 -depth, 1.0f };
+            registry.add({ .radius = radius_dist(rng) }, glm::vec3(inv_view * pos_vs), idx);
+        }
+
+        for (u32 tile_sz : tile_sizes) {
+            clusters.tile_sz = tile_sz;
+            clusters.fit(screen_dims, glm::radians(camera.zoom), camera.near_plane, camera.far_plane);
+
+            ClusterBench::Row row = { .n_lights = n_lights, .tile_sz = tile_sz,
+                                                 .n_clusters = clusters.n_clusters(), .build_ms = 0.0,
+                                                 .cull_ms = 0.0, .avg_lights = 0.0f };
+            for (u32 run = 0; run < n_runs; ++run) {
+                cpu.build(clusters, screen_dims, projection, camera.near_plane, camera.far_plane);
+                lights.set(registry, view);
+                cpu.cull(lights, n_lights <= gl::ClusterLights::max_packed_lights);
+                row.build_ms += cpu.stats.build_ms / n_runs;
+                row.cull_ms += cpu.stats.cull_ms / n_runs;
+            }
+            row.avg_lights = cpu.stats.n_lists ? (f32)cpu.stats.n_refs / cpu.stats.n_lists : 0.0f;
+            bench.rows.push_back(row);
+        }
+    }
+}
+
+void step_zbin_benchmark(AppState& app_state, const gl::Backend& backend, ZBinBench& bench) {
+
+    constexpr u32 n_samples = ZBinBench::phase_frames - ZBinBench::warmup_frames;
+    u32 phase = bench.frame / ZBinBench::phase_frames;
+    if (bench.frame % ZBinBench::phase_frames >= ZBinBench::warmup_frames) {
+        bench.cluster_ms[phase] += backend.backend_state.cluster_timer.elapsed_ms / n_samples;
+        bench.lighting_ms[phase] += backend.backend_state.lighting_timer.elapsed_ms / n_samples;
+    }
+
+    const gl::ClustersData& cluster_data = backend.clusters.gl_data;
+    if (phase == 0) {
+        bench.mem_bytes[0] = cluster_data.lists.grid_ssbo.capacity + cluster_data.lists.pool_ssbo.capacity;
+    } else {
+        bench.mem_bytes[1] = cluster_data.zbins.stats.data_bytes + cluster_data.zbins.stats.mask_bytes;
+    }
+
+    ++bench.frame;
+    if (bench.frame == 2 * ZBinBench::phase_frames) {
+        bench.running = false;
+        bench.ran = true;
+        app_state.zbin_enabled = bench.restore_mode;
+    } else {
+        app_state.zbin_enabled = bench.frame >= ZBinBench::phase_frames;
+    }
+}
+
+void step_tiled_benchmark(AppState& app_state, const gl::Backend& backend, TiledBench& bench) {
+
+    constexpr u32 n_samples = TiledBench::phase_frames - TiledBench::warmup_frames;
+    u32 phase = bench.frame / TiledBench::phase_frames;
+    if (bench.frame % TiledBench::phase_frames >= TiledBench::warmup_frames) {
+        bench.lighting_ms[phase] += backend.backend_state.lighting_timer.elapsed_ms / n_samples;
+    }
+    bench.n_lights = backend.clusters.gl_data.lights.n_lights;
+
+    ++bench.frame;
+    if (bench.frame == 2 * TiledBench::phase_frames) {
+        bench.running = false;
+        bench.ran = true;
+        app_state.tiled_lighting_enabled = bench.restore_mode;
+    } else {
+        app_state.tiled_lighting_enabled = bench.frame >= TiledBench::phase_frames;
+    }
+}
+
+void run_light_benchmark(gl::Backend& backend, LightBench& bench) {
+
+    using clock = std::chrono::steady_clock;
+    constexpr u32 n_lights = 50000;
+    constexpr u32 n_animated = n_lights / 20;
+    constexpr u32 n_frames = 30;
+
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<f32> pos_dist(-100.0f, 100.0f);
+    std::uniform_int_distribution<u32> light_dist(0, n_lights - 1);
+
+    LightRegistry registry;
+    std::vector<u32> handles(n_lights);
+    for (u32 idx = 0; idx < n_lights; ++idx) {
+        handles[idx] = registry.add(PtLight(), { pos_dist(rng), pos_dist(rng), pos_dist(rng) }, idx);
+    }
+
+    // note: these are bound in place of the scene's light buffers until the benchmark is over
+    gl::LightBuffers buffers;
+    buffers.init(n_lights);
+    gl::RingBuffer& ring = backend.backend_state.frame_data;
+
+    bench = { .ran = true, .n_lights = n_lights, .n_animated = n_animated };
+
+    f64 full_ms = 0.0, partial_ms = 0.0;
+    u64 partial_bytes = 0, n_ranges = 0;
+
+    for (u32 frame = 0; frame < n_frames; ++frame) {
+        ring.begin_frame();
+
+        registry.mark_all_dirty();
+        glFinish();
+        auto start = clock::now();
+        buffers.sync(registry, ring, backend.shaders.lights_scatter);
+        glFinish();
+        full_ms += std::chrono::duration<f64, std::milli>(clock::now() - start).count();
+        bench.full_bytes = buffers.stats.n_bytes;
+
+        for (u32 idx = 0; idx < n_animated; ++idx) {
+            registry.set_pos(handles[light_dist(rng)], { pos_dist(rng), pos_dist(rng), pos_dist(rng) });
+        }
+
+        start = clock::now();
+        buffers.sync(registry, ring, backend.shaders.lights_scatter);
+        glFinish();
+        partial_ms += std::chrono::duration<f64, std::milli>(clock::now() - start).count();
+        partial_bytes += buffers.stats.n_bytes;
+        n_ranges += buffers.stats.n_ranges;
+        bench.scattered = buffers.stats.scattered;
+
+        ring.end_frame();
+    }
+
+    bench.full_ms = full_ms / n_frames;
+    bench.partial_ms = partial_ms / n_frames;
+    bench.partial_bytes = (u32)(partial_bytes / n_frames);
+    bench.n_ranges = (u32)(n_ranges / n_frames);
+
+    const gl::LightBuffers& scene_lights = backend.clusters.gl_data.lights;
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, scene_lights.data_ssbo.base, scene_lights.data_ssbo.ssbo);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, scene_lights.pos_ssbo.base, scene_lights.pos_ssbo.ssbo);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, scene_lights.ids_ssbo.base, scene_lights.ids_ssbo.ssbo);
+}
+
+} // namespace bench
\ No newline at end of file
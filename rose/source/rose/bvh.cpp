@@ -0,0 +1,365 @@
+#include <rose/bvh.hpp>
+
+#include <algorithm>
+#include <bit>
+
+// half the surface area of a box, the cost of a node is proportional to the chance a query visits it
+static inline f32 half_area(const glm::vec3& min_pt, const glm::vec3& max_pt) {
+    glm::vec3 d = max_pt - min_pt;
+    return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+static inline bool contains(const BVHNode& node, const glm::vec3& min_pt, const glm::vec3& max_pt) {
+    return glm::all(glm::lessThanEqual(node.min_pt, min_pt)) && glm::all(glm::greaterThanEqual(node.max_pt, max_pt));
+}
+
+static inline bool overlaps(const BVHNode& node, const glm::vec3& min_pt, const glm::vec3& max_pt) {
+    return glm::all(glm::lessThanEqual(node.min_pt, max_pt)) && glm::all(glm::greaterThanEqual(node.max_pt, min_pt));
+}
+
+static inline void merge(BVHNode& node, const BVHNode& a, const BVHNode& b) {
+    node.min_pt = glm::min(a.min_pt, b.min_pt);
+    node.max_pt = glm::max(a.max_pt, b.max_pt);
+    node.height = 1 + std::max(a.height, b.height);
+}
+
+// returns true if the box is not entirely outside any of the first n_planes planes
+static inline bool in_frustum(const BVHNode& node, const Frustum& frustum, u32 n_planes) {
+    glm::vec3 center = (node.min_pt + node.max_pt) * 0.5f;
+    glm::vec3 extent = (node.max_pt - node.min_pt) * 0.5f;
+    for (u32 plane_idx = 0; plane_idx < n_planes; ++plane_idx) {
+        const glm::vec4& plane = frustum.planes[plane_idx];
+        glm::vec3 normal = glm::vec3(plane);
+        if (glm::dot(normal, center) + plane.w + glm::dot(glm::abs(normal), extent) < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+u32 DynamicBVH::alloc_node() {
+    if (free_list == invalid_node) {
+        nodes.emplace_back();
+        return (u32)nodes.size() - 1;
+    }
+
+    u32 node = free_list;
+    free_list = nodes[node].parent;
+    nodes[node] = BVHNode();
+    return node;
+}
+
+void DynamicBVH::free_node(u32 node) {
+    nodes[node].parent = free_list;
+    nodes[node].height = -1;
+    free_list = node;
+}
+
+u32 DynamicBVH::insert(const glm::vec3& min_pt, const glm::vec3& max_pt, u32 user) {
+    u32 leaf = alloc_node();
+    nodes[leaf].min_pt = min_pt - margin;
+    nodes[leaf].max_pt = max_pt + margin;
+    nodes[leaf].user = user;
+    insert_leaf(leaf);
+    ++n_leaves;
+    return leaf;
+}
+
+void DynamicBVH::remove(u32 proxy) {
+    remove_leaf(proxy);
+    free_node(proxy);
+    --n_leaves;
+}
+
+bool DynamicBVH::move(u32 proxy, const glm::vec3& min_pt, const glm::vec3& max_pt) {
+    if (contains(nodes[proxy], min_pt, max_pt)) {
+        return false;
+    }
+
+    remove_leaf(proxy);
+    nodes[proxy].min_pt = min_pt - margin;
+    nodes[proxy].max_pt = max_pt + margin;
+    insert_leaf(proxy);
+    return true;
+}
+
+void DynamicBVH::clear() {
+    nodes.resize(0);
+    root = invalid_node;
+    free_list = invalid_node;
+    n_leaves = 0;
+}
+
+void DynamicBVH::insert_leaf(u32 leaf) {
+
+    if (root == invalid_node) {
+        root = leaf;
+        nodes[leaf].parent = invalid_node;
+        return;
+    }
+
+    const glm::vec3 leaf_min = nodes[leaf].min_pt;
+    const glm::vec3 leaf_max = nodes[leaf].max_pt;
+
+    // descend towards the sibling that grows the tree the least, every ancestor of the new parent grows by
+    // the same amount regardless of which child is taken, so that cost is carried down as inheritance
+    u32 node = root;
+    while (!nodes[node].leaf()) {
+        const BVHNode& cur = nodes[node];
+
+        f32 area = half_area(cur.min_pt, cur.max_pt);
+        f32 merged_area = half_area(glm::min(cur.min_pt, leaf_min), glm::max(cur.max_pt, leaf_max));
+        f32 cost = 2.0f * merged_area;
+        f32 inheritance = 2.0f * (merged_area - area);
+
+        auto descend_cost = [&](u32 child_idx) {
+            const BVHNode& child = nodes[child_idx];
+            f32 child_merged = half_area(glm::min(child.min_pt, leaf_min), glm::max(child.max_pt, leaf_max));
+            return child.leaf() ? child_merged + inheritance
+                                : child_merged - half_area(child.min_pt, child.max_pt) + inheritance;
+        };
+
+        f32 cost_a = descend_cost(cur.child_a);
+        f32 cost_b = descend_cost(cur.child_b);
+
+        if (cost < cost_a && cost < cost_b) {
+            break;
+        }
+        node = cost_a < cost_b ? cur.child_a : cur.child_b;
+    }
+
+    // the sibling and the new leaf share a new parent in the sibling's place
+    u32 sibling = node;
+    u32 old_parent = nodes[sibling].parent;
+    u32 new_parent = alloc_node();
+
+    nodes[new_parent].parent = old_parent;
+    nodes[new_parent].child_a = sibling;
+    nodes[new_parent].child_b = leaf;
+    merge(nodes[new_parent], nodes[sibling], nodes[leaf]);
+
+    if (old_parent == invalid_node) {
+        root = new_parent;
+    } else if (nodes[old_parent].child_a == sibling) {
+        nodes[old_parent].child_a = new_parent;
+    } else {
+        nodes[old_parent].child_b = new_parent;
+    }
+
+    nodes[sibling].parent = new_parent;
+    nodes[leaf].parent = new_parent;
+
+    refit_up(new_parent);
+}
+
+void DynamicBVH::remove_leaf(u32 leaf) {
+
+    if (leaf == root) {
+        root = invalid_node;
+        return;
+    }
+
+    // the sibling takes the place of the parent
+    u32 parent = nodes[leaf].parent;
+    u32 grand_parent = nodes[parent].parent;
+    u32 sibling = nodes[parent].child_a == leaf ? nodes[parent].child_b : nodes[parent].child_a;
+
+    nodes[sibling].parent = grand_parent;
+    free_node(parent);
+
+    if (grand_parent == invalid_node) {
+        root = sibling;
+        return;
+    }
+
+    if (nodes[grand_parent].child_a == parent) {
+        nodes[grand_parent].child_a = sibling;
+    } else {
+        nodes[grand_parent].child_b = sibling;
+    }
+
+    refit_up(grand_parent);
+}
+
+void DynamicBVH::refit_up(u32 node) {
+    while (node != invalid_node) {
+        node = balance(node);
+        BVHNode& cur = nodes[node];
+        merge(cur, nodes[cur.child_a], nodes[cur.child_b]);
+        node = cur.parent;
+    }
+}
+
+u32 DynamicBVH::balance(u32 a_idx) {
+
+    BVHNode& a = nodes[a_idx];
+    if (a.leaf() || a.height < 2) {
+        return a_idx;
+    }
+
+    // rotates child c_idx of a above it, a takes the shorter child of c in c's place
+    auto rotate = [&](u32 c_idx, bool c_is_b) {
+        BVHNode& c = nodes[c_idx];
+        u32 f_idx = c.child_a;
+        u32 g_idx = c.child_b;
+
+        c.child_a = a_idx;
+        c.parent = a.parent;
+        a.parent = c_idx;
+
+        if (c.parent == invalid_node) {
+            root = c_idx;
+        } else if (nodes[c.parent].child_a == a_idx) {
+            nodes[c.parent].child_a = c_idx;
+        } else {
+            nodes[c.parent].child_b = c_idx;
+        }
+
+        // the taller grandchild stays with c, the shorter one moves under a
+        u32 keep = nodes[f_idx].height > nodes[g_idx].height ? f_idx : g_idx;
+        u32 give = keep == f_idx ? g_idx : f_idx;
+
+        c.child_b = keep;
+        if (c_is_b) {
+            a.child_b = give;
+        } else {
+            a.child_a = give;
+        }
+        nodes[give].parent = a_idx;
+
+        merge(a, nodes[a.child_a], nodes[a.child_b]);
+        merge(c, a, nodes[keep]);
+        return c_idx;
+    };
+
+    i32 skew = nodes[a.child_b].height - nodes[a.child_a].height;
+    if (skew > 1) {
+        return rotate(a.child_b, true);
+    }
+    if (skew < -1) {
+        return rotate(a.child_a, false);
+    }
+    return a_idx;
+}
+
+void DynamicBVH::query_aabb(const glm::vec3& min_pt, const glm::vec3& max_pt, std::vector<u32>& out) const {
+
+    if (root == invalid_node) {
+        return;
+    }
+
+    u32 stack[max_depth];
+    u32 stack_sz = 0;
+    stack[stack_sz++] = root;
+
+    while (stack_sz > 0) {
+        const BVHNode& node = nodes[stack[--stack_sz]];
+        if (!overlaps(node, min_pt, max_pt)) {
+            continue;
+        }
+
+        if (node.leaf()) {
+            out.push_back(node.user);
+        } else {
+            stack[stack_sz++] = node.child_a;
+            stack[stack_sz++] = node.child_b;
+        }
+    }
+}
+
+void DynamicBVH::query_sphere(const glm::vec3& center, f32 radius, std::vector<u32>& out) const {
+
+    if (root == invalid_node) {
+        return;
+    }
+
+    u32 stack[max_depth];
+    u32 stack_sz = 0;
+    stack[stack_sz++] = root;
+
+    while (stack_sz > 0) {
+        const BVHNode& node = nodes[stack[--stack_sz]];
+
+        // distance from the center to the closest point of the box
+        glm::vec3 closest = glm::clamp(center, node.min_pt, node.max_pt);
+        glm::vec3 offset = closest - center;
+        if (glm::dot(offset, offset) > radius * radius) {
+            continue;
+        }
+
+        if (node.leaf()) {
+            out.push_back(node.user);
+        } else {
+            stack[stack_sz++] = node.child_a;
+            stack[stack_sz++] = node.child_b;
+        }
+    }
+}
+
+void DynamicBVH::query_frustum(const Frustum& frustum, u32 n_planes, std::vector<u32>& out) const {
+
+    if (root == invalid_node) {
+        return;
+    }
+
+    u32 stack[max_depth];
+    u32 stack_sz = 0;
+    stack[stack_sz++] = root;
+
+    while (stack_sz > 0) {
+        const BVHNode& node = nodes[stack[--stack_sz]];
+        if (!in_frustum(node, frustum, n_planes)) {
+            continue;
+        }
+
+        if (node.leaf()) {
+            out.push_back(node.user);
+        } else {
+            stack[stack_sz++] = node.child_a;
+            stack[stack_sz++] = node.child_b;
+        }
+    }
+}
+
+void DynamicBVH::query_frusta(std::span<const Frustum> frusta, u32 n_planes, std::span<std::vector<u32>> out) const {
+
+    if (root == invalid_node || frusta.empty()) {
+        return;
+    }
+
+    // each entry carries the frusta its parent intersected, a subtree is dropped once none remain
+    u32 stack[max_depth];
+    u32 masks[max_depth];
+    u32 stack_sz = 0;
+    stack[stack_sz] = root;
+    masks[stack_sz++] = frusta.size() >= 32 ? ~0u : (1u << frusta.size()) - 1;
+
+    while (stack_sz > 0) {
+        --stack_sz;
+        const BVHNode& node = nodes[stack[stack_sz]];
+        u32 parent_mask = masks[stack_sz];
+
+        u32 mask = 0;
+        for (u32 bits = parent_mask; bits != 0; bits &= bits - 1) {
+            u32 frustum_idx = (u32)std::countr_zero(bits);
+            if (in_frustum(node, frusta[frustum_idx], n_planes)) {
+                mask |= 1u << frustum_idx;
+            }
+        }
+
+        if (mask == 0) {
+            continue;
+        }
+
+        if (node.leaf()) {
+            for (u32 bits = mask; bits != 0; bits &= bits - 1) {
+                out[std::countr_zero(bits)].push_back(node.user);
+            }
+        } else {
+            stack[stack_sz] = node.child_a;
+            masks[stack_sz++] = mask;
+            stack[stack_sz] = node.child_b;
+            masks[stack_sz++] = mask;
+        }
+    }
+}
@@ -9,6 +9,14 @@ glm::mat4 Camera::projection(f32 aspect_ratio) const {
     return glm::perspective(glm::radians(zoom), aspect_ratio, near_plane, far_plane);
 }
 
+void Camera::screen_ray(f32 aspect_ratio, const glm::vec2& ndc, glm::vec3& origin, glm::vec3& dir) const {
+    glm::mat4 inv_proj_view = glm::inverse(projection(aspect_ratio) * view());
+    glm::vec4 near_pt = inv_proj_view * glm::vec4(ndc.x, ndc.y, -1.0f, 1.0f);
+    glm::vec4 far_pt = inv_proj_view * glm::vec4(ndc.x, ndc.y, 1.0f, 1.0f);
+    origin = glm::vec3(near_pt) / near_pt.w;
+    dir = glm::normalize(glm::vec3(far_pt) / far_pt.w - origin);
+}
+
 void Camera::handle_keyboard(CameraMovement direction, f32 dt) {
     f32 velocity = speed * dt;
     switch (direction) {
@@ -0,0 +1,94 @@
+#include <rose/core/mapped_file.hpp>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() { 
+    close(); 
+}
+
+rses MappedFile::open(const fs::path& path) {
+    close();
+
+#ifdef _WIN32
+    HANDLE file_handle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                     FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file_handle == INVALID_HANDLE_VALUE) {
+        return rses().io("unable to open {}", path.generic_string());
+    }
+    file = file_handle;
+
+    LARGE_INTEGER file_sz;
+    if (!GetFileSizeEx(file_handle, &file_sz) || file_sz.QuadPart == 0) {
+        close();
+        return rses().io("unable to map {}, the file is empty", path.generic_string());
+    }
+
+    mapping = CreateFileMappingW(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        close();
+        return rses().io("unable to map {}", path.generic_string());
+    }
+
+    data = static_cast<const u8*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!data) {
+        close();
+        return rses().io("unable to map {}", path.generic_string());
+    }
+    size = (size_t)file_sz.QuadPart;
+#else
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return rses().io("unable to open {}", path.generic_string());
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+        close();
+        return rses().io("unable to map {}, the file is empty", path.generic_string());
+    }
+
+    void* ptr = mmap(nullptr, (size_t)file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (ptr == MAP_FAILED) {
+        close();
+        return rses().io("unable to map {}", path.generic_string());
+    }
+    data = static_cast<const u8*>(ptr);
+    size = (size_t)file_stat.st_size;
+#endif
+
+    return {};
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+    if (data) {
+        UnmapViewOfFile(data);
+    }
+    if (mapping) {
+        CloseHandle(mapping);
+    }
+    if (file) {
+        CloseHandle(file);
+    }
+    file = nullptr;
+    mapping = nullptr;
+#else
+    if (data) {
+        munmap(const_cast<u8*>(data), size);
+    }
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    fd = -1;
+#endif
+    data = nullptr;
+    size = 0;
+}
\ No newline at end of file
@@ -0,0 +1,113 @@
+#include <rose/core/memory.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+Arena::~Arena() {
+    for (auto& block : blocks) {
+        ::operator delete(block.data);
+    }
+}
+
+void* Arena::alloc(size_t size, size_t align) {
+
+    while (true) {
+        if (cur < blocks.size()) {
+            const Block& block = blocks[cur];
+            uintptr_t base = reinterpret_cast<uintptr_t>(block.data);
+            size_t start = ((base + offset + align - 1) & ~(uintptr_t)(align - 1)) - base;
+            if (start + size <= block.size) {
+                offset = start + size;
+                peak = std::max(peak, used());
+                return block.data + start;
+            }
+
+            // the rest of the block is skipped, later blocks may already be large enough
+            if (cur + 1 < blocks.size() || offset > 0) {
+                ++cur;
+                offset = 0;
+                continue;
+            }
+        }
+
+        // note: also replaces an empty trailing block that was too small for this allocation
+        size_t new_sz = std::max(block_sz, size + align);
+        Block new_block = { .data = static_cast<u8*>(::operator new(new_sz)), .size = new_sz };
+        if (cur < blocks.size()) {
+            ::operator delete(blocks[cur].data);
+            blocks[cur] = new_block;
+        } else {
+            blocks.push_back(new_block);
+        }
+        offset = 0;
+    }
+}
+
+void Arena::rewind(Marker marker) {
+    cur = marker.block;
+    offset = marker.offset;
+}
+
+size_t Arena::used() const {
+    size_t ret = offset;
+    for (size_t idx = 0; idx < cur && idx < blocks.size(); ++idx) {
+        ret += blocks[idx].size;
+    }
+    return ret;
+}
+
+Arena& scratch_arena() {
+    thread_local Arena arena;
+    return arena;
+}
+
+// heap instrumentation ===========================================================================
+
+static std::atomic<u64> n_heap_allocs = 0;
+static std::atomic<u64> n_heap_bytes = 0;
+
+HeapStats heap_stats() {
+    return { .n_allocs = n_heap_allocs.load(std::memory_order_relaxed),
+             .n_bytes = n_heap_bytes.load(std::memory_order_relaxed) };
+}
+
+// note: the remaining forms of new and delete are specified to forward to these
+void* operator new(size_t size) {
+    n_heap_allocs.fetch_add(1, std::memory_order_relaxed);
+    n_heap_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+
+void* operator new(size_t size, std::align_val_t align) {
+    n_heap_allocs.fetch_add(1, std::memory_order_relaxed);
+    n_heap_bytes.fetch_add(size, std::memory_order_relaxed);
+    size_t alignment = (size_t)align;
+#ifdef _WIN32
+    void* ptr = _aligned_malloc(size ? size : 1, alignment);
+#else
+    void* ptr = std::aligned_alloc(alignment, ((size ? size : 1) + alignment - 1) & ~(alignment - 1));
+#endif
+    if (ptr) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t align) noexcept { ::operator delete(ptr, align); }
@@ -0,0 +1,76 @@
+#include <rose/core/thread_pool.hpp>
+
+#include <algorithm>
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(mutex);
+        stop = true;
+    }
+    work_cv.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::init(u32 n_threads) {
+    if (n_threads == 0) {
+        n_threads = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    }
+    for (u32 idx = 0; idx < n_threads; ++idx) {
+        workers.emplace_back(&ThreadPool::worker_loop, this);
+    }
+}
+
+void ThreadPool::parallel_for(u32 n, const std::function<void(u32)>& fn) {
+
+    if (n == 0) {
+        return;
+    }
+
+    {
+        std::lock_guard lock(mutex);
+        job = &fn;
+        job_sz = n;
+        next_idx = 0;
+        n_busy = (u32)workers.size();
+        ++generation;
+    }
+    work_cv.notify_all();
+
+    run_job();
+
+    std::unique_lock lock(mutex);
+    done_cv.wait(lock, [this] { return n_busy == 0; });
+    job = nullptr;
+}
+
+void ThreadPool::run_job() {
+    for (u32 idx = next_idx.fetch_add(1); idx < job_sz; idx = next_idx.fetch_add(1)) {
+        (*job)(idx);
+    }
+}
+
+void ThreadPool::worker_loop() {
+
+    u64 seen = 0;
+
+    while (true) {
+        {
+            std::unique_lock lock(mutex);
+            work_cv.wait(lock, [&] { return stop || generation != seen; });
+            if (stop) {
+                return;
+            }
+            seen = generation;
+        }
+
+        run_job();
+
+        {
+            std::lock_guard lock(mutex);
+            --n_busy;
+        }
+        done_cv.notify_one();
+    }
+}
\ No newline at end of file
@@ -7,3 +7,39 @@ bool Rectf::contains(f32 x, f32 y) {
 bool Rectf::contains(vec2f xy) {
     return ((x_min <= xy.x && xy.x <= x_max) && (y_min <= xy.y && xy.y <= y_max));
 }
+
+
+void Bounds::expand(const glm::vec3& pt) {
+    min_pt = glm::min(min_pt, pt);
+    max_pt = glm::max(max_pt, pt);
+}
+
+void Bounds::expand(const Bounds& other) {
+    if (other.empty()) {
+        return;
+    }
+    if (empty()) {
+        *this = other;
+        return;
+    }
+
+    min_pt = glm::min(min_pt, other.min_pt);
+    max_pt = glm::max(max_pt, other.max_pt);
+
+    // smallest sphere enclosing both spheres
+    glm::vec3 offset = other.center - center;
+    f32 dist = glm::length(offset);
+
+    if (dist + other.radius <= radius) {
+        return;
+    }
+    if (dist + radius <= other.radius) {
+        center = other.center;
+        radius = other.radius;
+        return;
+    }
+
+    f32 new_radius = (dist + radius + other.radius) * 0.5f;
+    center += offset * ((new_radius - radius) / dist);
+    radius = new_radius;
+}
\ No newline at end of file
@@ -0,0 +1,244 @@
+#include <rose/cpu_clusters.hpp>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <functional>
+
+template <typename Fn>
+static void run_jobs(ThreadPool* pool, u32 n, const Fn& fn) {
+    if (pool) {
+        pool->parallel_for(n, std::cref(fn));
+    } else {
+        for (u32 idx = 0; idx < n; ++idx) {
+            fn(idx);
+        }
+    }
+}
+
+void ClusterLightSet::set(const LightRegistry& registry, const glm::mat4& view) {
+
+    n = registry.size();
+    u32 n_padded = (n + 7) & ~7u;
+    pos_x.resize(n_padded);
+    pos_y.resize(n_padded);
+    pos_z.resize(n_padded);
+    radius_sq.assign(n_padded, -1.0f);
+    cones.resize(n);
+
+    for (u32 idx = 0; idx < n; ++idx) {
+        const PtLight& light = registry.data[idx];
+        glm::vec3 pos = glm::vec3(view * registry.positions[idx]);
+        pos_x[idx] = pos.x;
+        pos_y[idx] = pos.y;
+        pos_z[idx] = pos.z;
+        radius_sq[idx] = light.radius * light.radius;
+        cones[idx] = glm::vec4(glm::mat3(view) * glm::vec3(light.direction), light.outer_cos);
+    }
+}
+
+// returns a bit per lane for the eight lights starting at idx, set if the light's sphere overlaps the box
+static u32 test_lights8(const ClusterLightSet& lights, u32 idx, const AABB& box) {
+#ifdef __AVX2__
+    __m256 zero = _mm256_setzero_ps();
+    __m256 px = _mm256_loadu_ps(&lights.pos_x[idx]);
+    __m256 py = _mm256_loadu_ps(&lights.pos_y[idx]);
+    __m256 pz = _mm256_loadu_ps(&lights.pos_z[idx]);
+
+    // distance from each light to the closest point of the box along each axis
+    __m256 dx = _mm256_add_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_set1_ps(box.min_pt.x), px), zero),
+                              _mm256_max_ps(_mm256_sub_ps(px, _mm256_set1_ps(box.max_pt.x)), zero));
+    __m256 dy = _mm256_add_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_set1_ps(box.min_pt.y), py), zero),
+                              _mm256_max_ps(_mm256_sub_ps(py, _mm256_set1_ps(box.max_pt.y)), zero));
+    __m256 dz = _mm256_add_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_set1_ps(box.min_pt.z), pz), zero),
+                              _mm256_max_ps(_mm256_sub_ps(pz, _mm256_set1_ps(box.max_pt.z)), zero));
+    __m256 dist_sq = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz)));
+
+    return (u32)_mm256_movemask_ps(_mm256_cmp_ps(dist_sq, _mm256_loadu_ps(&lights.radius_sq[idx]), _CMP_LE_OQ));
+#else
+    u32 mask = 0;
+    for (u32 lane = 0; lane < 8; ++lane) {
+        u32 light = idx + lane;
+        f32 dx = std::max(box.min_pt.x - lights.pos_x[light], 0.0f) +
+                 std::max(lights.pos_x[light] - box.max_pt.x, 0.0f);
+        f32 dy = std::max(box.min_pt.y - lights.pos_y[light], 0.0f) +
+                 std::max(lights.pos_y[light] - box.max_pt.y, 0.0f);
+        f32 dz = std::max(box.min_pt.z - lights.pos_z[light], 0.0f) +
+                 std::max(lights.pos_z[light] - box.max_pt.z, 0.0f);
+        mask |= (u32)(dx * dx + dy * dy + dz * dz <= lights.radius_sq[light]) << lane;
+    }
+    return mask;
+#endif
+}
+
+// tests the cone of a spot light against the sphere bounding the box, for a light already overlapping the box
+//
+// note: must match cone_aabb_test() in clusters_cull.comp
+static bool cone_overlaps(const ClusterLightSet& lights, u32 light, const AABB& box) {
+    glm::vec4 cone = lights.cones[light];
+    glm::vec3 center = (glm::vec3(box.min_pt) + glm::vec3(box.max_pt)) * 0.5f;
+    f32 radius = glm::length(glm::vec3(box.max_pt) - center);
+    glm::vec3 to_center = center - glm::vec3(lights.pos_x[light], lights.pos_y[light], lights.pos_z[light]);
+    f32 along = glm::dot(to_center, glm::vec3(cone));
+    f32 across = std::sqrt(std::max(glm::dot(to_center, to_center) - along * along, 0.0f));
+    f32 outer_sin = std::sqrt(std::max(1.0f - cone.w * cone.w, 0.0f));
+    return cone.w * across - along * outer_sin <= radius && along >= -radius;
+}
+
+// calls fn with every light overlapping the box, in ascending order. spot lights are few, so their cones are
+// tested one at a time once their spheres pass
+template <typename Fn>
+static void for_each_light(const ClusterLightSet& lights, const AABB& box, const Fn& fn) {
+    for (u32 idx = 0; idx < lights.size(); idx += 8) {
+        u32 mask = test_lights8(lights, idx, box);
+        while (mask) {
+            u32 light = idx + std::countr_zero(mask);
+            if (lights.cones[light].w <= -1.0f || cone_overlaps(lights, light, box)) {
+                fn(light);
+            }
+            mask &= mask - 1;
+        }
+    }
+}
+
+void CpuClusters::build(const Clusters& clusters, glm::uvec2 screen_dims, const glm::mat4& projection, f32 near_z,
+                        f32 far_z) {
+
+    auto start = std::chrono::steady_clock::now();
+
+    u32 n_clusters = clusters.n_clusters();
+    aabbs.resize(n_clusters);
+    glm::mat4 inv_proj = glm::inverse(projection);
+
+    // note: must match clusters_build.comp
+    auto screen_to_view = [&](glm::vec2 screen_pt) {
+        glm::vec2 coord = screen_pt / glm::vec2(screen_dims);
+        glm::vec4 view = inv_proj * glm::vec4(2.0f * coord.x - 1.0f, 2.0f * coord.y - 1.0f, -1.0f, 1.0f);
+        return glm::vec3(view) / view.w;
+    };
+
+    // point along the ray from the camera through pt at the given distance in front of it
+    auto at_depth = [](glm::vec3 pt, f32 z_dist) { return pt * (-z_dist / pt.z); };
+
+    glm::uvec3 grid_sz = clusters.grid_sz;
+    f32 split_z = clusters.split_z;
+    f32 n_log = (f32)(grid_sz.z - 1);
+    u32 n_jobs = (n_clusters + clusters_per_job - 1) / clusters_per_job;
+
+    run_jobs(pool, n_jobs, [&](u32 job) {
+        u32 last = std::min((job + 1) * clusters_per_job, n_clusters);
+        for (u32 cluster = job * clusters_per_job; cluster < last; ++cluster) {
+            glm::uvec3 coord = { cluster % grid_sz.x, (cluster / grid_sz.x) % grid_sz.y,
+                                 cluster / (grid_sz.x * grid_sz.y) };
+            glm::uvec2 tile = { coord.x, coord.y };
+
+            glm::vec3 min_vs = screen_to_view(glm::vec2(tile * clusters.tile_sz));
+            glm::vec3 max_vs = screen_to_view(glm::vec2(glm::min((tile + 1u) * clusters.tile_sz, screen_dims)));
+
+            f32 z_near = coord.z == 0 ? near_z : split_z * std::pow(far_z / split_z, (f32)(coord.z - 1) / n_log);
+            f32 z_far = split_z * std::pow(far_z / split_z, (f32)coord.z / n_log);
+
+            aabbs[cluster].min_pt = glm::vec4(glm::min(at_depth(min_vs, z_near), at_depth(min_vs, z_far)), 0.0f);
+            aabbs[cluster].max_pt = glm::vec4(glm::max(at_depth(max_vs, z_near), at_depth(max_vs, z_far)), 0.0f);
+        }
+    });
+
+    stats.build_ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void CpuClusters::cull(const ClusterLightSet& lights, bool packed) {
+
+    auto start = std::chrono::steady_clock::now();
+
+    this->packed = packed;
+    u32 n_clusters = (u32)aabbs.size();
+    u32 n_jobs = (n_clusters + clusters_per_job - 1) / clusters_per_job;
+    counts.resize(n_clusters);
+    grid.resize(n_clusters);
+
+    // count the lights of each cluster, then lay the lists out one after another before writing them
+    run_jobs(pool, n_jobs, [&](u32 job) {
+        u32 last = std::min((job + 1) * clusters_per_job, n_clusters);
+        for (u32 cluster = job * clusters_per_job; cluster < last; ++cluster) {
+            u32 count = 0;
+            for_each_light(lights, aabbs[cluster], [&](u32) { ++count; });
+            counts[cluster] = count;
+        }
+    });
+
+    stats.n_lists = 0;
+    stats.n_refs = 0;
+    stats.max_lights = 0;
+
+    // note: as in clusters_cull.comp, packed lists start on a whole uint
+    u32 n_used = 0;
+    for (u32 cluster = 0; cluster < n_clusters; ++cluster) {
+        u32 count = counts[cluster];
+        grid[cluster] = { packed ? n_used * 2 : n_used, count };
+        n_used += packed ? (count + 1) / 2 : count;
+
+        stats.n_lists += count > 0;
+        stats.n_refs += count;
+        stats.max_lights = std::max(stats.max_lights, count);
+    }
+
+    indices.assign(header_sz + n_used, 0);
+    indices[0] = n_used;
+    indices[1] = stats.n_lists;
+    indices[2] = stats.n_refs;
+    indices[3] = stats.max_lights;
+    u32* pool_data = indices.data() + header_sz;
+
+    run_jobs(pool, n_jobs, [&](u32 job) {
+        u32 last = std::min((job + 1) * clusters_per_job, n_clusters);
+        for (u32 cluster = job * clusters_per_job; cluster < last; ++cluster) {
+            u32 slot = grid[cluster].x;
+            for_each_light(lights, aabbs[cluster], [&](u32 light) {
+                if (packed) {
+                    // note: the even slot of a pair is the low half, as read by cluster_light() in the shaders
+                    pool_data[slot >> 1] |= light << ((slot & 1) * 16);
+                } else {
+                    pool_data[slot] = light;
+                }
+                ++slot;
+            });
+        }
+    });
+
+    stats.cull_ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void CpuClusters::decode(glm::uvec2 range, std::span<const u32> pool, bool packed, std::vector<u32>& out) {
+    std::span<const u32> pool_data = pool.subspan(std::min((size_t)header_sz, pool.size()));
+    for (u32 slot = range.x; slot < range.x + range.y; ++slot) {
+        u32 word = packed ? slot >> 1 : slot;
+        if (word >= pool_data.size()) {
+            break;
+        }
+        out.push_back(packed ? (pool_data[word] >> ((slot & 1) * 16)) & 0xFFFF : pool_data[word]);
+    }
+}
+
+u32 CpuClusters::compare(std::span<const glm::uvec2> other_grid, std::span<const u32> other_pool,
+                         bool other_packed) const {
+
+    u32 n_different = 0;
+    std::vector<u32> ours, theirs;
+
+    for (u32 cluster = 0; cluster < std::min(grid.size(), other_grid.size()); ++cluster) {
+        ours.resize(0);
+        theirs.resize(0);
+        decode(grid[cluster], indices, packed, ours);
+        decode(other_grid[cluster], other_pool, other_packed, theirs);
+        std::sort(theirs.begin(), theirs.end());
+        n_different += ours != theirs;
+    }
+
+    // clusters missing from either side count as different
+    return n_different + (u32)(std::max(grid.size(), other_grid.size()) - std::min(grid.size(), other_grid.size()));
+}
\ No newline at end of file
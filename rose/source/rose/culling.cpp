@@ -0,0 +1,229 @@
+#include <rose/culling.hpp>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+
+Frustum make_frustum(const glm::mat4& proj_view) {
+
+    // rows of the matrix, glm is column major
+    glm::vec4 row0 = { proj_view[0][0], proj_view[1][0], proj_view[2][0], proj_view[3][0] };
+    glm::vec4 row1 = { proj_view[0][1], proj_view[1][1], proj_view[2][1], proj_view[3][1] };
+    glm::vec4 row2 = { proj_view[0][2], proj_view[1][2], proj_view[2][2], proj_view[3][2] };
+    glm::vec4 row3 = { proj_view[0][3], proj_view[1][3], proj_view[2][3], proj_view[3][3] };
+
+    Frustum frustum = { .planes = { row3 + row0, row3 - row0, row3 + row1, row3 - row1, row3 - row2, row3 + row2 } };
+
+    for (auto& plane : frustum.planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+
+    return frustum;
+}
+
+void CullBounds::clear() { n = 0; }
+
+void CullBounds::push(const Bounds& bounds, const glm::mat4& transform) {
+
+    // grow in blocks of eight, padding is never read as an instance
+    if (n == center_x.size()) {
+        for (auto* arr : { &center_x, &center_y, &center_z, &extent_x, &extent_y, &extent_z }) {
+            arr->resize(n + 8, 0.0f);
+        }
+    }
+
+    glm::vec3 center = (bounds.min_pt + bounds.max_pt) * 0.5f;
+    glm::vec3 extent = (bounds.max_pt - bounds.min_pt) * 0.5f;
+
+    // the extent of a transformed box is the extent projected onto each axis
+    glm::vec3 world_center = glm::vec3(transform * glm::vec4(center, 1.0f));
+    glm::vec3 world_extent = glm::abs(glm::vec3(transform[0])) * extent.x +
+                             glm::abs(glm::vec3(transform[1])) * extent.y +
+                             glm::abs(glm::vec3(transform[2])) * extent.z;
+
+    center_x[n] = world_center.x;
+    center_y[n] = world_center.y;
+    center_z[n] = world_center.z;
+    extent_x[n] = world_extent.x;
+    extent_y[n] = world_extent.y;
+    extent_z[n] = world_extent.z;
+    ++n;
+}
+
+// returns a bit per lane for the eight instances starting at idx, set if the instance is not outside any plane
+static u32 test_frustum8(const CullBounds& bounds, u32 idx, const Frustum& frustum, u32 n_planes) {
+#ifdef __AVX2__
+    __m256 cx = _mm256_loadu_ps(&bounds.center_x[idx]);
+    __m256 cy = _mm256_loadu_ps(&bounds.center_y[idx]);
+    __m256 cz = _mm256_loadu_ps(&bounds.center_z[idx]);
+    __m256 ex = _mm256_loadu_ps(&bounds.extent_x[idx]);
+    __m256 ey = _mm256_loadu_ps(&bounds.extent_y[idx]);
+    __m256 ez = _mm256_loadu_ps(&bounds.extent_z[idx]);
+    __m256 zero = _mm256_setzero_ps();
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+    for (u32 plane_idx = 0; plane_idx < n_planes; ++plane_idx) {
+        const glm::vec4& plane = frustum.planes[plane_idx];
+
+        // signed distance of the center and projected radius of the box along the plane normal
+        __m256 dist = _mm256_fmadd_ps(_mm256_set1_ps(plane.x), cx,
+                      _mm256_fmadd_ps(_mm256_set1_ps(plane.y), cy,
+                      _mm256_fmadd_ps(_mm256_set1_ps(plane.z), cz, _mm256_set1_ps(plane.w))));
+        __m256 rad = _mm256_fmadd_ps(_mm256_set1_ps(std::abs(plane.x)), ex,
+                     _mm256_fmadd_ps(_mm256_set1_ps(std::abs(plane.y)), ey,
+                     _mm256_mul_ps(_mm256_set1_ps(std::abs(plane.z)), ez)));
+
+        inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(dist, rad), zero, _CMP_GE_OQ));
+    }
+
+    return (u32)_mm256_movemask_ps(inside);
+#else
+    u32 mask = 0;
+    for (u32 lane = 0; lane < 8; ++lane) {
+        u32 inst = idx + lane;
+        bool inside = true;
+        for (u32 plane_idx = 0; plane_idx < n_planes && inside; ++plane_idx) {
+            const glm::vec4& plane = frustum.planes[plane_idx];
+            f32 dist = plane.x * bounds.center_x[inst] + plane.y * bounds.center_y[inst] +
+                       plane.z * bounds.center_z[inst] + plane.w;
+            f32 rad = std::abs(plane.x) * bounds.extent_x[inst] + std::abs(plane.y) * bounds.extent_y[inst] +
+                      std::abs(plane.z) * bounds.extent_z[inst];
+            inside = dist + rad >= 0.0f;
+        }
+        mask |= (u32)inside << lane;
+    }
+    return mask;
+#endif
+}
+
+// returns a bit per lane for the eight instances starting at idx, set if the instance overlaps the sphere
+static u32 test_sphere8(const CullBounds& bounds, u32 idx, const glm::vec3& center, f32 radius) {
+#ifdef __AVX2__
+    __m256 zero = _mm256_setzero_ps();
+    __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+
+    // distance from the sphere center to the closest point of each box along each axis
+    auto axis_dist = [&](const std::vector<f32>& centers, const std::vector<f32>& extents, f32 sphere_center) {
+        __m256 offset = _mm256_sub_ps(_mm256_loadu_ps(&centers[idx]), _mm256_set1_ps(sphere_center));
+        return _mm256_max_ps(_mm256_sub_ps(_mm256_and_ps(offset, abs_mask), _mm256_loadu_ps(&extents[idx])), zero);
+    };
+
+    __m256 dx = axis_dist(bounds.center_x, bounds.extent_x, center.x);
+    __m256 dy = axis_dist(bounds.center_y, bounds.extent_y, center.y);
+    __m256 dz = axis_dist(bounds.center_z, bounds.extent_z, center.z);
+    __m256 dist2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz)));
+
+    return (u32)_mm256_movemask_ps(_mm256_cmp_ps(dist2, _mm256_set1_ps(radius * radius), _CMP_LE_OQ));
+#else
+    u32 mask = 0;
+    for (u32 lane = 0; lane < 8; ++lane) {
+        u32 inst = idx + lane;
+        f32 dx = std::max(std::abs(bounds.center_x[inst] - center.x) - bounds.extent_x[inst], 0.0f);
+        f32 dy = std::max(std::abs(bounds.center_y[inst] - center.y) - bounds.extent_y[inst], 0.0f);
+        f32 dz = std::max(std::abs(bounds.center_z[inst] - center.z) - bounds.extent_z[inst], 0.0f);
+        mask |= (u32)(dx * dx + dy * dy + dz * dz <= radius * radius) << lane;
+    }
+    return mask;
+#endif
+}
+
+// clears the bits of lanes past the last instance
+static inline u32 tail_mask(const CullBounds& bounds, u32 idx) {
+    u32 remaining = bounds.size() - idx;
+    return remaining >= 8 ? 0xFF : (1u << remaining) - 1;
+}
+
+void cull_frustum(const CullBounds& bounds, const Frustum& frustum, u32 n_planes, std::vector<u32>& out) {
+    for (u32 idx = 0; idx < bounds.size(); idx += 8) {
+        u32 mask = test_frustum8(bounds, idx, frustum, n_planes) & tail_mask(bounds, idx);
+        while (mask) {
+            out.push_back(idx + std::countr_zero(mask));
+            mask &= mask - 1;
+        }
+    }
+}
+
+void cull_frustum_mask(const CullBounds& bounds, const Frustum& frustum, u32 n_planes, u32 bit,
+                       std::span<u32> masks) {
+    for (u32 idx = 0; idx < bounds.size(); idx += 8) {
+        u32 mask = test_frustum8(bounds, idx, frustum, n_planes) & tail_mask(bounds, idx);
+        while (mask) {
+            masks[idx + std::countr_zero(mask)] |= bit;
+            mask &= mask - 1;
+        }
+    }
+}
+
+void cull_sphere_mask(const CullBounds& bounds, const glm::vec3& center, f32 radius, u32 bit, std::span<u32> masks) {
+    for (u32 idx = 0; idx < bounds.size(); idx += 8) {
+        u32 mask = test_sphere8(bounds, idx, center, radius) & tail_mask(bounds, idx);
+        while (mask) {
+            masks[idx + std::countr_zero(mask)] |= bit;
+            mask &= mask - 1;
+        }
+    }
+}
+
+void Culler::cull(const CullCtx& ctx) {
+
+    auto start = std::chrono::steady_clock::now();
+
+    u32 n = bounds.size();
+    for (auto& pass_visible : visible) {
+        pass_visible.resize(0);
+    }
+    shadow_masks.assign(n, 0);
+
+    stats = {};
+    stats.n_tested = n;
+
+    cull_frustum(bounds, make_frustum(ctx.camera_mat), 6, visible[(size_t)CullPass::CAMERA]);
+
+    // note: the near planes of shadow volumes are not tested, occluders behind them still cast shadows
+    // as their depth is clamped
+    for (u32 cascade = 0; cascade < ctx.cascade_mats.size(); ++cascade) {
+        cull_frustum_mask(bounds, make_frustum(ctx.cascade_mats[cascade]), 5, 1u << cascade, shadow_masks);
+    }
+
+    // an instance outside of the light's radius can not occlude anything the light reaches. for cube faces,
+    // only the side planes need to be tested as the radius already bounds the distance
+    constexpr u32 in_radius_bit = bit32;
+    if (ctx.pt_enabled) {
+        cull_sphere_mask(bounds, ctx.pt_pos, ctx.pt_radius, in_radius_bit, shadow_masks);
+        for (u32 face = 0; face < ctx.face_mats.size(); ++face) {
+            cull_frustum_mask(bounds, make_frustum(ctx.face_mats[face]), 4, 1u << (8 + face), shadow_masks);
+        }
+    }
+
+    for (u32 idx = 0; idx < n; ++idx) {
+        u32& mask = shadow_masks[idx];
+        if (!(mask & in_radius_bit)) {
+            mask &= 0xFF;
+        }
+        mask &= ~in_radius_bit;
+
+        if (mask & 0xFF) {
+            visible[(size_t)CullPass::DIR_SHADOW].push_back(idx);
+        }
+        if (mask & 0xFF00) {
+            visible[(size_t)CullPass::PT_SHADOW].push_back(idx);
+        }
+        for (u32 cascade = 0; cascade < stats.n_cascade.size(); ++cascade) {
+            stats.n_cascade[cascade] += (mask >> cascade) & 1;
+        }
+        for (u32 face = 0; face < stats.n_face.size(); ++face) {
+            stats.n_face[face] += (mask >> (8 + face)) & 1;
+        }
+    }
+
+    for (size_t pass = 0; pass < visible.size(); ++pass) {
+        stats.n_visible[pass] = (u32)visible[pass].size();
+    }
+
+    stats.cull_ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
\ No newline at end of file
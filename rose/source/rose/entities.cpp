@@ -1,72 +1,446 @@
 #include <rose/entities.hpp>
 
-i64 Entities::add_object(TextureManager& manager, const EntityCtx& ent_def) {
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+
+EntityHandle Entities::add_object(TextureManager& manager, const EntityCtx& ent_def) {
     Model model;
     model.load(manager, ent_def.model_path);
-    i64 ret = 0;
-
-    if (free_idxs.empty()) {
-        ids.push_back(new_id());
-        slot_empty.push_back(false);
-        models.push_back(std::move(model));
-        positions.push_back(ent_def.pos);
-        scales.push_back(ent_def.scale);
-        rotations.push_back(ent_def.rotation);
-        light_data.push_back(ent_def.light_data);
-        flags.push_back(ent_def.flags);
-        ret = (i64)size() - 1;
-    } 
-    else {
-        auto new_idx = free_idxs.back();
-        ids[new_idx] = new_id();
-        slot_empty[new_idx] = false;
-        models[new_idx] = std::move(model);
-        positions[new_idx] = ent_def.pos;
-        scales[new_idx] = ent_def.scale;
-        rotations[new_idx] = ent_def.rotation;
-        light_data[new_idx] = ent_def.light_data;
-        flags[new_idx] = ent_def.flags;
-        free_idxs.pop_back();
-        ret = new_idx;
-    }
-
-    return ret;
-}
-
-i64 Entities::dup_object(i64 dup_idx) { 
-    i64 ret = 0;
-    
-    if (free_idxs.empty()) {
-        ids.push_back(new_id());
-        slot_empty.push_back(false);
-        // TODO: this copies all buffers of the model, could instead
-        // store an index to reduce memory duplication
-        models.push_back(models[dup_idx].copy());
-        positions.push_back(positions[dup_idx] + glm::vec3(0.25f, 0.25f, 0.25f));
-        scales.push_back(scales[dup_idx]);
-        rotations.push_back(rotations[dup_idx]);
-        light_data.push_back(light_data[dup_idx]);
-        flags.push_back(flags[dup_idx]);
-        ret = (i64)size() - 1;
+    return add_object(std::move(model), ent_def);
+}
+
+EntityHandle Entities::add_object(Model&& model, const EntityCtx& ent_def) {
+    size_t idx = push(std::move(model), ent_def.pos, ent_def.scale, ent_def.rotation, ent_def.light_data,
+                      ent_def.flags, invalid_entity);
+    return handles[idx];
+}
+
+void Entities::add_objects(TextureManager& manager, std::span<const EntityCtx> ent_defs,
+                           std::vector<EntityHandle>& out) {
+    reserve(size() + ent_defs.size());
+    for (const auto& ent_def : ent_defs) {
+        out.push_back(add_object(manager, ent_def));
+    }
+}
+
+EntityHandle Entities::dup_object(EntityHandle handle) { 
+    size_t src_idx = index(handle);
+
+    // TODO: GPU buffers and mesh BVHs are shared with the source, but the CPU copies of the
+    // vertex and index arrays are still duplicated and could be shared as well
+    Model model = models[src_idx].copy();
+    glm::vec3 pos = positions[src_idx] + glm::vec3(0.25f, 0.25f, 0.25f);
+    glm::vec3 scale = scales[src_idx];
+    glm::vec3 rotation = rotations[src_idx];
+    PtLight light = light_data[src_idx];
+
+    // the duplicate is placed alongside the original, under the same parent
+    size_t idx = push(std::move(model), pos, scale, rotation, light, flags[src_idx], parents[src_idx]);
+    return handles[idx];
+}
+
+void Entities::dup_objects(EntityHandle handle, size_t n, std::vector<EntityHandle>& out) {
+    reserve(size() + n);
+    for (size_t copy = 0; copy < n; ++copy) {
+        out.push_back(dup_object(handle));
+    }
+}
+
+void Entities::del_object(EntityHandle handle) {
+    del_objects(std::span(&handle, 1));
+}
+
+void Entities::del_objects(std::span<const EntityHandle> del_handles) {
+
+    removed_nodes.resize(0);
+
+    for (EntityHandle handle : del_handles) {
+        // note: also skips handles listed more than once
+        if (!valid(handle)) {
+            continue;
+        }
+
+        size_t idx = index(handle);
+        removed_nodes.push_back(nodes[idx]);
+        removed_nodes.insert(removed_nodes.end(), model_nodes[idx].begin(), model_nodes[idx].end());
+        if (proxies[idx] != DynamicBVH::invalid_node) {
+            bvh.remove(proxies[idx]);
+        }
+        if (light_handles[idx] != LightRegistry::invalid_handle) {
+            lights.remove(light_handles[idx]);
+        }
+
+        generations[handle.slot()]++;
+        free_slots.push_back(handle.slot());
+        swap_remove(idx);
+    }
+
+    if (removed_nodes.empty()) {
+        return;
+    }
+
+    scene.remove(removed_nodes);
+
+    // entities attached to a deleted one are detached rather than deleted, their nodes are already roots
+    for (auto& parent : parents) {
+        if (parent != invalid_entity && !valid(parent)) {
+            parent = invalid_entity;
+        }
+    }
+}
+
+size_t Entities::push(Model&& model, const glm::vec3& pos, const glm::vec3& scale, const glm::vec3& rotation,
+                      const PtLight& light, EntityFlags ent_flags, EntityHandle parent) {
+
+    u32 slot = 0;
+    if (free_slots.empty()) {
+        slot = (u32)sparse.size();
+        sparse.push_back(0);
+        generations.push_back(0);
     } 
     else {
-        auto new_idx = free_idxs.back();
-        ids[new_idx] = new_id();
-        slot_empty[new_idx] = false;
-        models[new_idx] = std::move(models[dup_idx].copy());
-        positions[new_idx] = positions[dup_idx] + glm::vec3(0.25f, 0.25f, 0.25f);
-        scales[new_idx] = scales[dup_idx];
-        rotations[new_idx] = rotations[dup_idx];
-        light_data[new_idx] = light_data[dup_idx];
-        flags[new_idx] = flags[dup_idx];
-        free_idxs.pop_back();
-        ret = new_idx;
+        slot = free_slots.back();
+        free_slots.pop_back();
+    }
+
+    size_t idx = size();
+    sparse[slot] = (u32)idx;
+
+    handles.push_back(EntityHandle::make(slot, generations[slot]));
+    ids.push_back(new_id());
+    models.push_back(std::move(model));
+    positions.push_back(pos);
+    scales.push_back(scale);
+    rotations.push_back(rotation);
+    light_data.push_back(light);
+    flags.push_back(ent_flags);
+    parents.push_back(valid(parent) ? parent : invalid_entity);
+    transform_dirty.push_back(false);
+    proxies.push_back(DynamicBVH::invalid_node);
+    light_handles.push_back(is_flag_set(ent_flags, EntityFlags::EMIT_LIGHT) ? lights.add(light, pos, (u32)ids[idx])
+                                                                            : LightRegistry::invalid_handle);
+
+    nodes.push_back(scene.add(valid(parent) ? nodes[index(parent)] : SceneGraph::invalid_node, {}));
+    set_node_slot(nodes[idx], slot);
+    mark_dirty(idx);
+
+    // nodes of the model never change, so they are only set once
+    const auto& model_hierarchy = models[idx].nodes;
+    auto& ent_nodes = model_nodes.emplace_back(model_hierarchy.size());
+    for (size_t node_idx = 0; node_idx < model_hierarchy.size(); ++node_idx) {
+        i32 model_parent = model_hierarchy[node_idx].parent;
+        u32 parent_node = model_parent < 0 ? nodes[idx] : ent_nodes[model_parent];
+        ent_nodes[node_idx] = scene.add(parent_node, model_hierarchy[node_idx].local);
+        set_node_slot(ent_nodes[node_idx], SceneGraph::invalid_node);
+    }
+
+    return idx;
+}
+
+void Entities::swap_remove(size_t idx) {
+
+    size_t last = size() - 1;
+
+    if (idx != last) {
+        handles[idx] = handles[last];
+        ids[idx] = ids[last];
+        models[idx] = std::move(models[last]);
+        positions[idx] = positions[last];
+        scales[idx] = scales[last];
+        rotations[idx] = rotations[last];
+        light_data[idx] = light_data[last];
+        flags[idx] = flags[last];
+        parents[idx] = parents[last];
+        nodes[idx] = nodes[last];
+        model_nodes[idx] = std::move(model_nodes[last]);
+        transform_dirty[idx] = transform_dirty[last];
+        proxies[idx] = proxies[last];
+        light_handles[idx] = light_handles[last];
+        sparse[handles[idx].slot()] = (u32)idx;
+    }
+
+    handles.pop_back();
+    ids.pop_back();
+    models.pop_back();
+    positions.pop_back();
+    scales.pop_back();
+    rotations.pop_back();
+    light_data.pop_back();
+    flags.pop_back();
+    parents.pop_back();
+    nodes.pop_back();
+    model_nodes.pop_back();
+    transform_dirty.pop_back();
+    proxies.pop_back();
+    light_handles.pop_back();
+}
+
+void Entities::reserve(size_t n) {
+    handles.reserve(n);
+    ids.reserve(n);
+    models.reserve(n);
+    positions.reserve(n);
+    scales.reserve(n);
+    rotations.reserve(n);
+    light_data.reserve(n);
+    flags.reserve(n);
+    parents.reserve(n);
+    nodes.reserve(n);
+    model_nodes.reserve(n);
+    transform_dirty.reserve(n);
+    proxies.reserve(n);
+    light_handles.reserve(n);
+}
+
+void Entities::set_emitter(size_t idx, bool emit) {
+
+    if (emit == (light_handles[idx] != LightRegistry::invalid_handle)) {
+        return;
+    }
+
+    // note: set_flag clears the flag and unset_flag sets it
+    if (emit) {
+        unset_flag(flags[idx], EntityFlags::EMIT_LIGHT);
+        light_handles[idx] = lights.add(light_data[idx], glm::vec3(world(idx).mat[3]), (u32)ids[idx]);
+    } else {
+        set_flag(flags[idx], EntityFlags::EMIT_LIGHT);
+        lights.remove(light_handles[idx]);
+        light_handles[idx] = LightRegistry::invalid_handle;
+    }
+}
+
+bool Entities::set_parent(size_t idx, EntityHandle parent) {
+
+    for (EntityHandle ancestor = parent; valid(ancestor); ancestor = parents[index(ancestor)]) {
+        if (ancestor == handles[idx]) {
+            return false;
+        }
+    }
+
+    bool attach = valid(parent);
+    parents[idx] = attach ? parent : invalid_entity;
+    scene.set_parent(nodes[idx], attach ? nodes[index(parent)] : SceneGraph::invalid_node);
+    return true;
+}
+
+// inputs and outputs of eight transforms, stored as SoA so they can be composed at once
+struct TransformBatch {
+    alignas(32) f32 sin_x[8], cos_x[8], sin_y[8], cos_y[8], sin_z[8], cos_z[8];
+    alignas(32) f32 scale_x[8], scale_y[8], scale_z[8];
+    alignas(32) f32 world[9][8];     // upper 3x3 of the world matrix, column major
+    alignas(32) f32 normal[9][8];    // normal matrix, column major
+};
+
+// composes translate * scale * rotate_x * rotate_y * rotate_z for each lane. the normal matrix of a scale
+// followed by a rotation is the rotation with the inverse scale applied, so no inverse is needed
+static void compose_batch(TransformBatch& batch) {
+#ifdef __AVX2__
+    __m256 sx = _mm256_load_ps(batch.sin_x), cx = _mm256_load_ps(batch.cos_x);
+    __m256 sy = _mm256_load_ps(batch.sin_y), cy = _mm256_load_ps(batch.cos_y);
+    __m256 sz = _mm256_load_ps(batch.sin_z), cz = _mm256_load_ps(batch.cos_z);
+    __m256 zero = _mm256_setzero_ps();
+    __m256 one = _mm256_set1_ps(1.0f);
+
+    __m256 sx_sy = _mm256_mul_ps(sx, sy);
+    __m256 cx_sy = _mm256_mul_ps(cx, sy);
+
+    // rows of the rotation
+    __m256 rot[3][3] = {
+        { _mm256_mul_ps(cy, cz), _mm256_sub_ps(zero, _mm256_mul_ps(cy, sz)), sy },
+        { _mm256_fmadd_ps(sx_sy, cz, _mm256_mul_ps(cx, sz)), _mm256_fnmadd_ps(sx_sy, sz, _mm256_mul_ps(cx, cz)),
+          _mm256_sub_ps(zero, _mm256_mul_ps(sx, cy)) },
+        { _mm256_fnmadd_ps(cx_sy, cz, _mm256_mul_ps(sx, sz)), _mm256_fmadd_ps(cx_sy, sz, _mm256_mul_ps(sx, cz)),
+          _mm256_mul_ps(cx, cy) },
+    };
+
+    __m256 scale[3] = { _mm256_load_ps(batch.scale_x), _mm256_load_ps(batch.scale_y), _mm256_load_ps(batch.scale_z) };
+
+    for (u32 row = 0; row < 3; ++row) {
+        __m256 inv_scale = _mm256_div_ps(one, scale[row]);
+        for (u32 col = 0; col < 3; ++col) {
+            _mm256_store_ps(batch.world[col * 3 + row], _mm256_mul_ps(rot[row][col], scale[row]));
+            _mm256_store_ps(batch.normal[col * 3 + row], _mm256_mul_ps(rot[row][col], inv_scale));
+        }
+    }
+#else
+    for (u32 lane = 0; lane < 8; ++lane) {
+        f32 sx = batch.sin_x[lane], cx = batch.cos_x[lane];
+        f32 sy = batch.sin_y[lane], cy = batch.cos_y[lane];
+        f32 sz = batch.sin_z[lane], cz = batch.cos_z[lane];
+
+        f32 rot[3][3] = {
+            { cy * cz, -cy * sz, sy },
+            { sx * sy * cz + cx * sz, cx * cz - sx * sy * sz, -sx * cy },
+            { sx * sz - cx * sy * cz, cx * sy * sz + sx * cz, cx * cy },
+        };
+        f32 scale[3] = { batch.scale_x[lane], batch.scale_y[lane], batch.scale_z[lane] };
+
+        for (u32 row = 0; row < 3; ++row) {
+            for (u32 col = 0; col < 3; ++col) {
+                batch.world[col * 3 + row][lane] = rot[row][col] * scale[row];
+                batch.normal[col * 3 + row][lane] = rot[row][col] / scale[row];
+            }
+        }
+    }
+#endif
+}
+
+void Entities::update_transforms() {
+
+    // entities deleted after being changed are skipped
+    dirty_idxs.resize(0);
+    for (EntityHandle handle : dirty_handles) {
+        if (valid(handle)) {
+            size_t idx = index(handle);
+            transform_dirty[idx] = false;
+            dirty_idxs.push_back((u32)idx);
+        }
+    }
+    dirty_handles.resize(0);
+
+    TransformBatch batch;
+
+    for (size_t first = 0; first < dirty_idxs.size(); first += 8) {
+        u32 n_lanes = (u32)std::min<size_t>(8, dirty_idxs.size() - first);
+
+        for (u32 lane = 0; lane < 8; ++lane) {
+            // note: unused lanes repeat the last entity so they never divide by zero
+            u32 idx = dirty_idxs[first + std::min(lane, n_lanes - 1)];
+            glm::vec3 angles = glm::radians(rotations[idx]);
+            batch.sin_x[lane] = std::sin(angles.x);
+            batch.cos_x[lane] = std::cos(angles.x);
+            batch.sin_y[lane] = std::sin(angles.y);
+            batch.cos_y[lane] = std::cos(angles.y);
+            batch.sin_z[lane] = std::sin(angles.z);
+            batch.cos_z[lane] = std::cos(angles.z);
+            batch.scale_x[lane] = scales[idx].x;
+            batch.scale_y[lane] = scales[idx].y;
+            batch.scale_z[lane] = scales[idx].z;
+        }
+
+        compose_batch(batch);
+
+        for (u32 lane = 0; lane < n_lanes; ++lane) {
+            u32 idx = dirty_idxs[first + lane];
+            NodeTransform local;
+
+            for (u32 col = 0; col < 3; ++col) {
+                for (u32 row = 0; row < 3; ++row) {
+                    local.mat[col][row] = batch.world[col * 3 + row][lane];
+                    local.normal[col][row] = batch.normal[col * 3 + row][lane];
+                }
+            }
+            local.mat[3] = glm::vec4(positions[idx], 1.0f);
+            scene.set_local(nodes[idx], local);
+        }
     }
 
-    return ret;
+    dirty_idxs.resize(0);
+
+    // only the subtrees of changed entities are recomputed
+    scene.update();
+
+    // world bounds and light positions only change for entities within the recomputed subtrees
+    for (const auto& range : scene.updated) {
+        for (u32 pos = range.begin; pos < range.end; ++pos) {
+            u32 slot = node_slots[scene.order[pos]];
+            if (slot != SceneGraph::invalid_node) {
+                size_t idx = sparse[slot];
+                refit(idx);
+                if (light_handles[idx] != LightRegistry::invalid_handle) {
+                    lights.set_pos(light_handles[idx], glm::vec3(world(idx).mat[3]));
+                }
+            }
+        }
+    }
+}
+
+void Entities::refit(size_t idx) {
+
+    const glm::mat4& mat = world(idx).mat;
+    const Bounds& bounds = models[idx].bounds;
+    glm::vec3 center = glm::vec3(mat[3]);
+    glm::vec3 extent = { 0.0f, 0.0f, 0.0f };
+
+    // the extent of a transformed box is the extent projected onto each axis
+    if (!bounds.empty()) {
+        glm::vec3 local_center = (bounds.min_pt + bounds.max_pt) * 0.5f;
+        glm::vec3 local_extent = (bounds.max_pt - bounds.min_pt) * 0.5f;
+        center = glm::vec3(mat * glm::vec4(local_center, 1.0f));
+        extent = glm::abs(glm::vec3(mat[0])) * local_extent.x + glm::abs(glm::vec3(mat[1])) * local_extent.y +
+                 glm::abs(glm::vec3(mat[2])) * local_extent.z;
+    }
+
+    if (proxies[idx] == DynamicBVH::invalid_node) {
+        proxies[idx] = bvh.insert(center - extent, center + extent, handles[idx].slot());
+    } else {
+        bvh.move(proxies[idx], center - extent, center + extent);
+    }
+}
+
+void Entities::slots_to_indices(std::vector<u32>& out, size_t first) const {
+    for (size_t idx = first; idx < out.size(); ++idx) {
+        out[idx] = sparse[out[idx]];
+    }
+}
+
+void Entities::query_aabb(const glm::vec3& min_pt, const glm::vec3& max_pt, std::vector<u32>& out) const {
+    size_t first = out.size();
+    bvh.query_aabb(min_pt, max_pt, out);
+    slots_to_indices(out, first);
+}
+
+void Entities::query_sphere(const glm::vec3& center, f32 radius, std::vector<u32>& out) const {
+    size_t first = out.size();
+    bvh.query_sphere(center, radius, out);
+    slots_to_indices(out, first);
+}
+
+RayHit Entities::raycast(const glm::vec3& origin, const glm::vec3& dir, f32 max_t) const {
+
+    RayHit hit;
+    TriHit tri_hit = { .t = max_t };
+
+    bvh.query_ray(origin, dir, max_t, [&](u32 slot) {
+        size_t idx = sparse[slot];
+        const Model& model = models[idx];
+        if (!model.mesh_bvhs) {
+            return tri_hit.t;
+        }
+
+        for (u32 mesh_idx = 0; mesh_idx < model.meshes.size(); ++mesh_idx) {
+            const TriangleBVH& mesh_bvh = (*model.mesh_bvhs)[mesh_idx];
+            if (mesh_bvh.empty()) {
+                continue;
+            }
+
+            // transforms are affine, so distances along the moved ray are the same as along the original
+            glm::mat4 to_mesh = glm::inverse(scene.world(mesh_node(idx, mesh_idx)).mat);
+            glm::vec3 mesh_origin = glm::vec3(to_mesh * glm::vec4(origin, 1.0f));
+            glm::vec3 mesh_dir = glm::vec3(to_mesh * glm::vec4(dir, 0.0f));
+
+            if (mesh_bvh.intersect(mesh_origin, mesh_dir, tri_hit)) {
+                hit.entity = handles[idx];
+                hit.mesh = mesh_idx;
+                hit.tri = tri_hit.tri;
+            }
+        }
+        return tri_hit.t;
+    });
+
+    if (hit.entity != invalid_entity) {
+        hit.t = tri_hit.t;
+        hit.pos = origin + dir * hit.t;
+    }
+    return hit;
 }
 
-void Entities::del_object(i64 idx) { 
-    slot_empty[idx] = true;    
-    free_idxs.push_back(idx);
+void Entities::query_frustum(const Frustum& frustum, u32 n_planes, std::vector<u32>& out) const {
+    size_t first = out.size();
+    bvh.query_frustum(frustum, n_planes, out);
+    slots_to_indices(out, first);
 }
@@ -1,5 +1,7 @@
+#include <rose/bench.hpp>
 #include <rose/camera.hpp>
 #include <rose/gui.hpp>
+#include <rose/snapshot.hpp>
 
 #ifdef USE_OPENGL
 #include <rose/backends/gl/backend.hpp>
@@ -11,7 +13,12 @@ static_assert("no backend selected");
 #include <imgui_internal.h>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <numbers>
+#include <random>
 
 #define NOMINMAX
 #include <windows.h>
@@ -35,7 +42,31 @@ static char bottom_path[256] = "";
 static char front_path[256] = "";
 static char back_path[256] = "";
 
-std::vector<i64> ent_traverse = { }; // entity indices in order of object insertion
+static i32 stress_meshes = 50000; // number of meshes to reach when spawning a stress grid
+static i32 field_lights = 4096;   // number of lights to reach when spawning a light field
+
+// entity picked in the viewport
+static RayHit pick;
+static f64 pick_us = 0.0;
+static bool pick_changed = false;   // opens the picked entity in the tree
+
+// results of the benchmarks run from the gui
+static bench::BvhBench bvh_bench;
+static bench::RayBench ray_bench;
+static bench::LightBench light_bench;
+static bench::ClusterBench cluster_bench;
+static bench::ZBinBench zbin_bench;
+static bench::TiledBench tiled_bench;
+
+static bench::StreamFlight flight;
+static i32 city_side = 48;      // cells along each side of the streamed city
+static i32 city_density = 8;    // entities per cell
+
+// timings of the last snapshot loaded
+static SnapshotStats snapshot_stats;
+static bool snapshot_loaded = false;
+
+std::vector<EntityHandle> ent_traverse = { }; // entities in order of insertion
 
 } // namespace gui_state
 
@@ -79,9 +110,137 @@ static fs::path WIN32_open_any() {
     return "";
 }
 
+static fs::path WIN32_open_snapshot() {
+    OPENFILENAME ofn;
+    TCHAR szFile[260] = { 0 };
+    ZeroMemory(&ofn, sizeof(ofn));
+    ofn.lStructSize = sizeof(ofn);
+    ofn.hwndOwner = NULL;
+    ofn.lpstrFile = szFile;
+    ofn.nMaxFile = sizeof(szFile);
+    ofn.lpstrFilter = "Scene Snapshots(*.rsnp)\0*.rsnp\0";
+    ofn.nFilterIndex = 1;
+    ofn.lpstrFileTitle = NULL;
+    ofn.nMaxFileTitle = 0;
+    ofn.lpstrInitialDir = NULL;
+    ofn.Flags = OFN_PATHMUSTEXIST | OFN_FILEMUSTEXIST;
+    if (GetOpenFileName(&ofn) == TRUE) {
+        return fs::path(ofn.lpstrFile);
+    }
+    return "";
+}
+
+static fs::path WIN32_save_snapshot() {
+    OPENFILENAME ofn;
+    TCHAR szFile[260] = { 0 };
+    ZeroMemory(&ofn, sizeof(ofn));
+    ofn.lStructSize = sizeof(ofn);
+    ofn.hwndOwner = NULL;
+    ofn.lpstrFile = szFile;
+    ofn.nMaxFile = sizeof(szFile);
+    ofn.lpstrFilter = "Scene Snapshots(*.rsnp)\0*.rsnp\0";
+    ofn.nFilterIndex = 1;
+    ofn.lpstrDefExt = "rsnp";
+    ofn.lpstrFileTitle = NULL;
+    ofn.nMaxFileTitle = 0;
+    ofn.lpstrInitialDir = NULL;
+    ofn.Flags = OFN_PATHMUSTEXIST | OFN_OVERWRITEPROMPT;
+    if (GetSaveFileName(&ofn) == TRUE) {
+        return fs::path(ofn.lpstrFile);
+    }
+    return "";
+}
+
+// fills the scene with copies of the first non light entity, laid out on a grid, until the number of meshes in
+// the scene reaches the target. used to compare the cost of submitting large scenes
+static void spawn_stress_grid(AppState& app_state, i32 target_meshes) {
+    Entities& entities = app_state.entities;
+
+    i64 src_idx = -1;
+    size_t n_meshes = 0;
+    for (size_t idx = 0; idx < entities.size(); ++idx) {
+        if (!entities.is_light(idx)) {
+            if (src_idx == -1) {
+                src_idx = idx;
+            }
+            n_meshes += entities.models[idx].meshes.size();
+        }
+    }
+
+    if (src_idx == -1 || entities.models[src_idx].meshes.empty() || n_meshes >= (size_t)target_meshes) {
+        return;
+    }
+
+    size_t meshes_per_ent = entities.models[src_idx].meshes.size();
+    size_t n_copies = ((size_t)target_meshes - n_meshes + meshes_per_ent - 1) / meshes_per_ent;
+    i64 side = (i64)std::ceil(std::cbrt((f64)n_copies));
+    f32 spacing = 2.0f * std::max(entities.scales[src_idx].x, 1.0f);
+    glm::vec3 origin = entities.positions[src_idx];
+
+    size_t first_copy = gui_state::ent_traverse.size();
+    entities.dup_objects(entities.handle(src_idx), n_copies, gui_state::ent_traverse);
+
+    for (size_t copy = 0; copy < n_copies; ++copy) {
+        size_t new_idx = entities.index(gui_state::ent_traverse[first_copy + copy]);
+        glm::vec3 cell = { (f32)((i64)copy % side), (f32)(((i64)copy / side) % side), (f32)((i64)copy / (side * side)) };
+        entities.positions[new_idx] = origin + spacing * (cell + glm::vec3(1.0f, 0.0f, 0.0f));
+        entities.mark_dirty(new_idx);
+    }
+}
+
+// fills the space in front of the camera with copies of the first light entity, with random colours and radii,
+// until the scene holds the target number of lights. used to load the lighting passes
+static void spawn_light_field(AppState& app_state, i32 target_lights) {
+    Entities& entities = app_state.entities;
+
+    i64 src_idx = -1;
+    size_t n_lights = 0;
+    for (size_t idx = 0; idx < entities.size(); ++idx) {
+        if (entities.is_light(idx)) {
+            if (src_idx == -1) {
+                src_idx = idx;
+            }
+            ++n_lights;
+        }
+    }
+
+    if (src_idx == -1 || n_lights >= (size_t)target_lights) {
+        return;
+    }
+
+    constexpr f32 extent = 200.0f;
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<f32> pos_dist(-0.5f * extent, 0.5f * extent);
+    std::uniform_real_distribution<f32> color_dist(0.2f, 1.0f);
+    std::uniform_real_distribution<f32> radius_dist(2.0f, 10.0f);
+    glm::vec3 center = app_state.camera.position + app_state.camera.front * (0.5f * extent);
+
+    size_t n_copies = (size_t)target_lights - n_lights;
+    size_t first_copy = gui_state::ent_traverse.size();
+    entities.dup_objects(entities.handle(src_idx), n_copies, gui_state::ent_traverse);
+
+    for (size_t copy = 0; copy < n_copies; ++copy) {
+        size_t new_idx = entities.index(gui_state::ent_traverse[first_copy + copy]);
+        entities.positions[new_idx] = center + glm::vec3(pos_dist(rng), pos_dist(rng), pos_dist(rng));
+        entities.mark_dirty(new_idx);
+        entities.light_data[new_idx].color = glm::vec4(color_dist(rng), color_dist(rng), color_dist(rng), 1.0f);
+        entities.light_data[new_idx].radius = radius_dist(rng);
+        entities.update_light(new_idx);
+    }
+}
+
+
+void scene_loaded(AppState& app_state, size_t first_new, const SnapshotStats& stats) {
+    for (size_t idx = first_new; idx < app_state.entities.size(); ++idx) {
+        gui_state::ent_traverse.push_back(app_state.entities.handle(idx));
+    }
+    gui_state::snapshot_stats = stats;
+    gui_state::snapshot_loaded = true;
+}
+
 // TODO: ideally, this shouldn't be coupled with the graphics API, but I haven't created a clean delineation between
 // systems that are dependant/non-dependant on API, and therefore can not decouple it yet
-GuiRet imgui(AppState& app_state, gl::Backend& backend) {
+void imgui(AppState& app_state, gl::Backend& backend) {
     ImGuiIO& io = ImGui::GetIO();
     ImGuiID skybox_popup_id = ImHashStr("import_skybox_popup");
 
@@ -106,6 +265,25 @@ GuiRet imgui(AppState& app_state, gl::Backend& backend) {
                 ImGui::OpenPopup("import_skybox_popup");
                 ImGui::PopID();
             }
+            ImGui::Separator();
+            if (ImGui::MenuItem("Save Scene")) {
+                if (fs::path snapshot_path = WIN32_save_snapshot(); snapshot_path != "") {
+                    if (rses err = save_snapshot(snapshot_path, app_state.entities, backend.backend_state.skybox)) {
+                        err::print(err);
+                    }
+                }
+            }
+            if (ImGui::MenuItem("Load Scene")) {
+                if (fs::path snapshot_path = WIN32_open_snapshot(); snapshot_path != "") {
+                    size_t first_new = app_state.entities.size();
+                    SnapshotStats stats;
+                    if (rses err = load_snapshot(snapshot_path, app_state.entities, backend.backend_state.skybox,
+                                                 backend.texture_manager, backend.thread_pool, &stats)) {
+                        err::print(err);
+                    }
+                    scene_loaded(app_state, first_new, stats);
+                }
+            }
             ImGui::EndMenu();
         }
         ImGui::EndMainMenuBar();
@@ -169,9 +347,8 @@ GuiRet imgui(AppState& app_state, gl::Backend& backend) {
 
     // global controls ============================================================================
 
-    bool light_changed = false; // TODO: Not a huge fan of this but not a big deal right now
     bool obj_deleted = false;
-    std::vector<i64>::iterator del_iter;
+    i64 del_traverse_idx = 0;
 
     ImGui::Begin("controls", &gui_state::controls_open, ImGuiWindowFlags_AlwaysAutoResize);
     ImGui::Text("FPS: %.2f (%.2f ms)", io.Framerate, 1000.0f / io.Framerate);
@@ -184,6 +361,7 @@ GuiRet imgui(AppState& app_state, gl::Backend& backend) {
     }
     if (ImGui::Checkbox("ambient occlusion", &app_state.ssao_enabled)) {
         backend.shaders.lighting_deferred.set_bool("ssao_enabled", app_state.ssao_enabled);
+        backend.shaders.lighting_tiled.set_bool("ssao_enabled", app_state.ssao_enabled);
     }
     if (ImGui::Checkbox("bloom", &app_state.bloom_enabled)) {
         backend.shaders.out.set_bool("bloom_enabled", app_state.bloom_enabled);
@@ -192,6 +370,321 @@ GuiRet imgui(AppState& app_state, gl::Backend& backend) {
     ImGui::SliderFloat("bloom factor", &app_state.bloom_factor, 0.005f, 0.25f);
     ImGui::EndDisabled();
 
+    // profiling ==================================================================================
+
+    ImGui::SeparatorText("profiling");
+    ImGui::BeginDisabled(!backend.indirect_supported);
+    ImGui::Checkbox("indirect draws", &app_state.indirect_enabled);
+    ImGui::BeginDisabled(!app_state.indirect_enabled);
+    ImGui::Checkbox("occlusion culling", &app_state.occlusion_culling_enabled);
+    ImGui::EndDisabled();
+    ImGui::EndDisabled();
+    ImGui::Checkbox("cpu occlusion culling", &app_state.cpu_occlusion_enabled);
+    ImGui::Text("shadow: %.3f ms", backend.backend_state.shadow_timer.elapsed_ms);
+    ImGui::Text("gbuffer: %.3f ms", backend.backend_state.gbuf_timer.elapsed_ms);
+    ImGui::Text("forward: %.3f ms", backend.backend_state.forward_timer.elapsed_ms);
+    ImGui::Text("clusters: %.3f ms (grid built %u times)", backend.backend_state.cluster_timer.elapsed_ms,
+                backend.clusters.gl_data.n_aabb_builds);
+    ImGui::Checkbox("active clusters only", &app_state.active_clusters_enabled);
+    ImGui::Checkbox("light tree", &app_state.light_tree_enabled);
+    const gl::ClusterLights& cluster_lists = backend.clusters.gl_data.lists;
+    ImGui::Text("light lists: %u / %u uints (%u KiB, %s indices, grown %u times)", cluster_lists.stats.n_used,
+                cluster_lists.capacity, (u32)(cluster_lists.pool_ssbo.capacity / 1024),
+                cluster_lists.packed ? "16 bit" : "32 bit", cluster_lists.n_grows);
+    ImGui::Text("lights per list: %.1f average, %u max (%u lists)",
+                cluster_lists.stats.n_lists ? (f32)cluster_lists.stats.n_refs / cluster_lists.stats.n_lists : 0.0f,
+                cluster_lists.stats.max_lights, cluster_lists.stats.n_lists);
+
+    ImGui::Checkbox("cpu clusters", &app_state.cpu_clusters_enabled);
+    ImGui::BeginDisabled(app_state.cpu_clusters_enabled);
+    if (ImGui::Button("check clusters against cpu")) {
+        backend.cluster_check_pending = true;
+    }
+    ImGui::EndDisabled();
+    if (backend.cluster_check.ran) {
+        const ClusterCheck& check = backend.cluster_check;
+        ImGui::Text("%u / %u clusters differ (gpu %u lights, cpu %u lights%s)", check.n_different, check.n_clusters,
+                    check.gpu_refs, check.cpu_refs, check.overflowed ? ", gpu lists overflowed" : "");
+    }
+    if (ImGui::Button("run cpu cluster benchmark")) {
+        bench::run_cluster_benchmark(app_state, backend, gui_state::cluster_bench);
+    }
+    if (!gui_state::cluster_bench.rows.empty()) {
+        const auto& bench = gui_state::cluster_bench;
+        ImGui::Text("%u threads, %s", bench.n_threads, bench.simd ? "avx2" : "scalar");
+        for (const auto& row : bench.rows) {
+            ImGui::Text("%5u lights, %3u px (%5u clusters): build %.3f ms, cull %.3f ms, %.1f per list", row.n_lights,
+                        row.tile_sz, row.n_clusters, row.build_ms, row.cull_ms, row.avg_lights);
+        }
+    }
+
+    ImGui::Checkbox("light lod", &app_state.light_lod_enabled);
+    if (app_state.light_lod_enabled) {
+        LightLod& light_lod = backend.light_lod;
+        ImGui::SliderFloat("lod distance (cells)", &light_lod.lod_ratio, 1.0f, 32.0f);
+        ImGui::SliderFloat("lod transition", &light_lod.transition, 0.05f, 1.0f);
+        const LightLodStats& lod_stats = light_lod.stats;
+        ImGui::Text("light lod: %u -> %u lights (%u merged, %u blending)", lod_stats.n_lights, lod_stats.n_selected,
+                    lod_stats.n_aggregated, lod_stats.n_blending);
+        ImGui::Text("groups: %u / %u / %u / %u (built %u times, %.3f ms build, %.3f ms select)",
+                    lod_stats.n_groups[0], lod_stats.n_groups[1], lod_stats.n_groups[2], lod_stats.n_groups[3],
+                    lod_stats.n_builds, lod_stats.build_ms, lod_stats.select_ms);
+    }
+
+    ImGui::BeginDisabled(gui_state::zbin_bench.running);
+    ImGui::Checkbox("z binning", &app_state.zbin_enabled);
+    ImGui::EndDisabled();
+    if (app_state.zbin_enabled) {
+        const gl::ZBinStats& zbin_stats = backend.clusters.gl_data.zbins.stats;
+        ImGui::Text("z bins: %u visible lights, %u tiles (%.3f ms cpu)", zbin_stats.n_visible, zbin_stats.n_tiles,
+                    zbin_stats.cpu_ms);
+        ImGui::Text("z bin memory: %u KiB bins, %u KiB masks", zbin_stats.data_bytes / 1024,
+                    zbin_stats.mask_bytes / 1024);
+    }
+    ImGui::Text("lighting: %.3f ms", backend.backend_state.lighting_timer.elapsed_ms);
+
+    ImGui::BeginDisabled(gui_state::tiled_bench.running || app_state.zbin_enabled);
+    ImGui::Checkbox("tiled compute lighting", &app_state.tiled_lighting_enabled);
+    ImGui::EndDisabled();
+    ImGui::InputInt("target lights", &gui_state::field_lights);
+    if (ImGui::Button("spawn light field")) {
+        spawn_light_field(app_state, gui_state::field_lights);
+    }
+    if (gui_state::tiled_bench.running) {
+        bench::step_tiled_benchmark(app_state, backend, gui_state::tiled_bench);
+        ImGui::Text("comparing lighting passes... %u / %u frames", gui_state::tiled_bench.frame,
+                    2 * bench::TiledBench::phase_frames);
+    } else if (!app_state.zbin_enabled && ImGui::Button("compare full screen and tiled lighting")) {
+        gui_state::tiled_bench = { .running = true, .restore_mode = app_state.tiled_lighting_enabled };
+        app_state.tiled_lighting_enabled = false;
+    }
+    if (gui_state::tiled_bench.ran) {
+        const auto& bench = gui_state::tiled_bench;
+        ImGui::Text("%u lights: full screen %.3f ms, tiled %.3f ms", bench.n_lights, bench.lighting_ms[0],
+                    bench.lighting_ms[1]);
+    }
+
+    ImGui::Checkbox("forward+", &app_state.forward_plus_enabled);
+    if (app_state.forward_plus_enabled) {
+        // samples are stepped through powers of two up to what the driver supports
+        i32 max_step = 0;
+        while ((2u << max_step) <= std::min(backend.max_msaa_samples, 8u)) {
+            ++max_step;
+        }
+        i32 msaa_step = 0;
+        while ((1u << msaa_step) < app_state.msaa_samples && msaa_step < max_step) {
+            ++msaa_step;
+        }
+        char msaa_label[16] = "off";
+        if (msaa_step > 0) {
+            std::snprintf(msaa_label, sizeof(msaa_label), "%ux", 1u << msaa_step);
+        }
+        if (ImGui::SliderInt("msaa", &msaa_step, 0, max_step, msaa_label)) {
+            app_state.msaa_samples = 1u << msaa_step;
+        }
+        ImGui::Text("prepass: %.3f ms, shading: %.3f ms", backend.backend_state.gbuf_timer.elapsed_ms,
+                    backend.backend_state.lighting_timer.elapsed_ms);
+    }
+    if (gui_state::zbin_bench.running) {
+        bench::step_zbin_benchmark(app_state, backend, gui_state::zbin_bench);
+        ImGui::Text("comparing light culling... %u / %u frames", gui_state::zbin_bench.frame,
+                    2 * bench::ZBinBench::phase_frames);
+    } else if (ImGui::Button("compare clusters and z binning")) {
+        gui_state::zbin_bench = { .running = true, .restore_mode = app_state.zbin_enabled };
+        app_state.zbin_enabled = false;
+    }
+    if (gui_state::zbin_bench.ran) {
+        const auto& bench = gui_state::zbin_bench;
+        ImGui::Text("clusters: cull %.3f ms, lighting %.3f ms, %u KiB", bench.cluster_ms[0], bench.lighting_ms[0],
+                    bench.mem_bytes[0] / 1024);
+        ImGui::Text("z bins:   cull %.3f ms, lighting %.3f ms, %u KiB", bench.cluster_ms[1], bench.lighting_ms[1],
+                    bench.mem_bytes[1] / 1024);
+    }
+
+    Clusters& clusters = backend.clusters;
+    ImGui::Text("cluster grid: %u x %u x %u (%u px tiles)", clusters.grid_sz.x, clusters.grid_sz.y, clusters.grid_sz.z,
+                clusters.tile_sz);
+    ImGui::Checkbox("tune tile size", &clusters.auto_tune);
+    if (clusters.auto_tune) {
+        ImGui::SliderFloat("target lights per list", &clusters.target_lights, 1.0f, 64.0f);
+    } else {
+        i32 tile_idx = 0;
+        while (tile_idx + 1 < (i32)clusters.tile_sizes.size() && clusters.tile_sizes[tile_idx] < clusters.tile_sz) {
+            ++tile_idx;
+        }
+        char tile_label[16];
+        std::snprintf(tile_label, sizeof(tile_label), "%u px", clusters.tile_sizes[tile_idx]);
+        if (ImGui::SliderInt("tile size", &tile_idx, 0, (i32)clusters.tile_sizes.size() - 1, tile_label)) {
+            clusters.tile_sz = clusters.tile_sizes[tile_idx];
+        }
+    }
+    ImGui::Text("cpu submit: %.3f ms", backend.backend_state.submit_ms);
+    ImGui::Text("frame heap: %llu allocs (%llu bytes), arena %.1f / %.1f KiB",
+                (unsigned long long)backend.backend_state.frame_heap_allocs,
+                (unsigned long long)backend.backend_state.frame_heap_bytes, backend.frame_arena.used() / 1024.0,
+                backend.frame_arena.peak / 1024.0);
+    // note: counting is restarted once the scene settles, steady frames should leave it at zero
+    ImGui::Text("frames with heap allocations: %llu (last %llu allocs, %llu bytes)",
+                (unsigned long long)backend.backend_state.n_alloc_frames,
+                (unsigned long long)backend.backend_state.last_alloc_allocs,
+                (unsigned long long)backend.backend_state.last_alloc_bytes);
+    ImGui::SameLine();
+    if (ImGui::Button("reset##heap")) {
+        backend.backend_state.n_alloc_frames = 0;
+        backend.backend_state.last_alloc_allocs = 0;
+        backend.backend_state.last_alloc_bytes = 0;
+    }
+
+    const CullStats& cull_stats = backend.culler.stats;
+    ImGui::Text("culling: %u meshes (%.3f ms)", cull_stats.n_tested, cull_stats.cull_ms);
+    ImGui::Text("camera: %u", cull_stats.n_visible[(size_t)CullPass::CAMERA]);
+    ImGui::Text("cascades: %u / %u / %u", cull_stats.n_cascade[0], cull_stats.n_cascade[1], cull_stats.n_cascade[2]);
+    ImGui::Text("point shadow: %u (faces %u / %u / %u / %u / %u / %u)",
+                cull_stats.n_visible[(size_t)CullPass::PT_SHADOW], cull_stats.n_face[0], cull_stats.n_face[1],
+                cull_stats.n_face[2], cull_stats.n_face[3], cull_stats.n_face[4], cull_stats.n_face[5]);
+
+    if (app_state.cpu_occlusion_enabled) {
+        const OcclusionStats& occlusion_stats = backend.occlusion_buffer.stats;
+        ImGui::Text("occluders: %u (%u tris, %.3f ms)", occlusion_stats.n_occluders, occlusion_stats.n_tris,
+                    occlusion_stats.raster_ms);
+        ImGui::Text("occluded: %u / %u (%.3f ms)", occlusion_stats.n_occluded, occlusion_stats.n_tested,
+                    occlusion_stats.test_ms);
+    }
+
+    ImGui::Checkbox("impostors", &app_state.impostors_enabled);
+    if (app_state.impostors_enabled) {
+        const gl::ImpostorStats& impostor_stats = backend.impostors.stats;
+        ImGui::SliderFloat("impostor screen size", &backend.impostors.screen_threshold, 0.005f, 0.5f);
+        ImGui::Text("impostors: %u entities in %u draws, replacing %u draws (%llu indices)",
+                    impostor_stats.n_impostors, impostor_stats.n_batches, impostor_stats.n_draws_replaced,
+                    (unsigned long long)impostor_stats.n_indices_replaced);
+        ImGui::Text("baked: %u (last %.3f ms)", impostor_stats.n_baked, impostor_stats.bake_ms);
+    }
+
+    if (gui_state::snapshot_loaded) {
+        const SnapshotStats& snapshot_stats = gui_state::snapshot_stats;
+        ImGui::Text("snapshot: %u entities, %u models (%u imported, %u failed) in %.3f ms",
+                    snapshot_stats.n_entities, snapshot_stats.n_models, snapshot_stats.n_imported,
+                    snapshot_stats.n_failed, snapshot_stats.total_ms);
+        ImGui::Text("map %.3f ms, import %.3f ms, finalize %.3f ms, instance %.3f ms", snapshot_stats.map_ms,
+                    snapshot_stats.import_ms, snapshot_stats.finalize_ms, snapshot_stats.instance_ms);
+    }
+
+    ImGui::InputInt("target meshes", &gui_state::stress_meshes);
+    if (ImGui::Button("spawn stress grid")) {
+        spawn_stress_grid(app_state, gui_state::stress_meshes);
+    }
+
+    ImGui::Text("bvh: %u entities (height %d)", app_state.entities.bvh.size(), app_state.entities.bvh.height());
+    if (ImGui::Button("run bvh benchmark")) {
+        bench::run_bvh_benchmark(app_state, gui_state::bvh_bench);
+    }
+    if (gui_state::bvh_bench.ran) {
+        const auto& bench = gui_state::bvh_bench;
+        ImGui::Text("%u boxes, height %d, built in %.3f ms", bench.n_boxes, bench.height, bench.insert_ms);
+        ImGui::Text("move: %.3f ms (%u reinserted)", bench.move_ms, bench.n_reinserts);
+        ImGui::Text("queries: %.3f ms, linear %.3f ms (%u hits)", bench.query_ms, bench.linear_ms, bench.n_hits);
+    }
+
+    if (ImGui::Button("run raycast benchmark")) {
+        bench::run_ray_benchmark(app_state, gui_state::ray_bench);
+    }
+    if (gui_state::ray_bench.ran) {
+        const auto& bench = gui_state::ray_bench;
+        ImGui::Text("%u rays, %u hits, %llu tris: %.3f us per ray", bench.n_rays, bench.n_hits,
+                    (unsigned long long)bench.n_tris, bench.avg_us);
+    }
+
+    const gl::LightUploadStats& light_stats = backend.clusters.gl_data.lights.stats;
+    ImGui::Text("lights: %u, uploaded %u (%u ranges, %u bytes%s)", light_stats.n_lights, light_stats.n_updated,
+                light_stats.n_ranges, light_stats.n_bytes, light_stats.scattered ? ", scattered" : "");
+    if (ImGui::Button("run light upload benchmark")) {
+        bench::run_light_benchmark(backend, gui_state::light_bench);
+    }
+    if (gui_state::light_bench.ran) {
+        const auto& bench = gui_state::light_bench;
+        ImGui::Text("%u lights: full %u bytes (%.3f ms)", bench.n_lights, bench.full_bytes, bench.full_ms);
+        ImGui::Text("%u moved: %u bytes in %u ranges%s (%.3f ms)", bench.n_animated, bench.partial_bytes,
+                    bench.n_ranges, bench.scattered ? ", scattered" : "", bench.partial_ms);
+    }
+
+    // streaming ==================================================================================
+
+    ImGui::SeparatorText("streaming");
+    WorldStreamer& streamer = app_state.streamer;
+    ImGui::InputInt("city side", &gui_state::city_side);
+    ImGui::InputInt("entities per cell", &gui_state::city_density);
+    if (ImGui::Button("stream city")) {
+        if (fs::path model_path = WIN32_open_gltf(); model_path != "") {
+            bench::spawn_streamed_city(app_state, model_path, std::max(gui_state::city_side, 1),
+                                       std::max(gui_state::city_density, 1), gui_state::flight);
+        }
+    }
+    ImGui::SameLine();
+    ImGui::BeginDisabled(streamer.cells.empty());
+    if (ImGui::Button(gui_state::flight.flying ? "stop flight" : "fly across")) {
+        if (!gui_state::flight.flying) {
+            gui_state::flight.travelled = 0.0f;
+            gui_state::flight.latency_ms.clear();
+            gui_state::flight.cpu_mb.clear();
+            gui_state::flight.gpu_mb.clear();
+            streamer.reset_stats();
+        }
+        gui_state::flight.flying = !gui_state::flight.flying;
+    }
+    ImGui::EndDisabled();
+    if (gui_state::flight.flying) {
+        bench::step_flight(app_state, gui_state::flight, io.DeltaTime);
+    }
+
+    f32 load_dist = streamer.load_dist;
+    f32 hysteresis = streamer.unload_dist - streamer.load_dist;
+    if (ImGui::SliderFloat("load distance", &load_dist, streamer.cell_sz, 1000.0f)) {
+        streamer.load_dist = load_dist;
+        streamer.unload_dist = load_dist + hysteresis;
+    }
+    if (ImGui::SliderFloat("hysteresis", &hysteresis, 0.0f, 256.0f)) {
+        streamer.unload_dist = streamer.load_dist + hysteresis;
+    }
+    ImGui::SliderFloat("behind distance", &streamer.behind_dist, 0.0f, streamer.load_dist);
+    i32 cpu_budget_mb = (i32)(streamer.budgets.cpu_bytes >> 20);
+    i32 gpu_budget_mb = (i32)(streamer.budgets.gpu_bytes >> 20);
+    if (ImGui::InputInt("cpu budget (MiB)", &cpu_budget_mb)) {
+        streamer.budgets.cpu_bytes = (u64)std::max(cpu_budget_mb, 1) << 20;
+    }
+    if (ImGui::InputInt("gpu budget (MiB)", &gpu_budget_mb)) {
+        streamer.budgets.gpu_bytes = (u64)std::max(gpu_budget_mb, 1) << 20;
+    }
+
+    const StreamStats& stream_stats = streamer.stats;
+    ImGui::Text("cells: %u / %u loaded, %u loading, %u models, %u entities (%.3f ms)", stream_stats.n_loaded,
+                stream_stats.n_cells, stream_stats.n_loading, stream_stats.n_models, stream_stats.n_entities,
+                stream_stats.update_ms);
+    ImGui::Text("memory: cpu %.1f MiB (peak %.1f), gpu %.1f MiB (peak %.1f)%s", stream_stats.cpu_bytes / 1048576.0,
+                stream_stats.peak_cpu_bytes / 1048576.0, stream_stats.gpu_bytes / 1048576.0,
+                stream_stats.peak_gpu_bytes / 1048576.0, stream_stats.budget_limited ? ", over budget" : "");
+    ImGui::Text("latency: last %.1f ms, avg %.1f ms, max %.1f ms", stream_stats.last_latency_ms,
+                stream_stats.avg_latency_ms, stream_stats.max_latency_ms);
+    ImGui::Text("loads: %llu, unloads %llu, evictions %llu", (unsigned long long)stream_stats.n_loads,
+                (unsigned long long)stream_stats.n_unloads, (unsigned long long)stream_stats.n_evictions);
+    if (!gui_state::flight.latency_ms.empty()) {
+        const auto& flight = gui_state::flight;
+        ImGui::PlotLines("latency (ms)", flight.latency_ms.data(), (i32)flight.latency_ms.size(), 0, nullptr, 0.0f,
+                         FLT_MAX, ImVec2(0, 60));
+        ImGui::PlotLines("cpu (MiB)", flight.cpu_mb.data(), (i32)flight.cpu_mb.size(), 0, nullptr, 0.0f, FLT_MAX,
+                         ImVec2(0, 60));
+        ImGui::PlotLines("gpu (MiB)", flight.gpu_mb.data(), (i32)flight.gpu_mb.size(), 0, nullptr, 0.0f, FLT_MAX,
+                         ImVec2(0, 60));
+    }
+
+    // note: right click in the viewport to pick, as left click captures the camera
+    if (app_state.entities.valid(gui_state::pick.entity)) {
+        const RayHit& pick = gui_state::pick;
+        ImGui::Text("picked: ent %llu, mesh %u, tri %u at %.3f (%.3f us)",
+                    (unsigned long long)app_state.entities.ids[app_state.entities.index(pick.entity)], pick.mesh,
+                    pick.tri, pick.t, gui_state::pick_us);
+    }
+
     // directional light ==========================================================================
 
     ImGui::SeparatorText("global light");
@@ -201,17 +694,29 @@ GuiRet imgui(AppState& app_state, gl::Backend& backend) {
         backend.backend_state.dir_light.direction = glm::normalize(backend.backend_state.dir_light.direction);
         backend.shaders.skybox.set_vec3("dir_light.direction", backend.backend_state.dir_light.direction);
         backend.shaders.lighting_deferred.set_vec3("dir_light.direction", backend.backend_state.dir_light.direction);
+        backend.shaders.lighting_tiled.set_vec3("dir_light.direction", backend.backend_state.dir_light.direction);
         backend.shaders.lighting_forward.set_vec3("dir_light.direction", backend.backend_state.dir_light.direction);
+        if (backend.indirect_supported) {
+            backend.shaders.lighting_forward_indirect.set_vec3("dir_light.direction", backend.backend_state.dir_light.direction);
+        }
     }
     if (ImGui::SliderFloat("ambient strength", &backend.backend_state.dir_light.ambient_strength, 0.0f, 1.0f)) {
         backend.shaders.skybox.set_f32("dir_light.ambient_strength", backend.backend_state.dir_light.ambient_strength);
         backend.shaders.lighting_deferred.set_f32("dir_light.ambient_strength", backend.backend_state.dir_light.ambient_strength);
+        backend.shaders.lighting_tiled.set_f32("dir_light.ambient_strength", backend.backend_state.dir_light.ambient_strength);
         backend.shaders.lighting_forward.set_f32("dir_light.ambient_strength", backend.backend_state.dir_light.ambient_strength);
+        if (backend.indirect_supported) {
+            backend.shaders.lighting_forward_indirect.set_f32("dir_light.ambient_strength", backend.backend_state.dir_light.ambient_strength);
+        }
     }
     if (ImGui::ColorEdit3("color", glm::value_ptr(backend.backend_state.dir_light.color))) {
         backend.shaders.skybox.set_vec3("dir_light.color", backend.backend_state.dir_light.color);
         backend.shaders.lighting_deferred.set_vec3("dir_light.color", backend.backend_state.dir_light.color);
+        backend.shaders.lighting_tiled.set_vec3("dir_light.color", backend.backend_state.dir_light.color);
         backend.shaders.lighting_forward.set_vec3("dir_light.color", backend.backend_state.dir_light.color);
+        if (backend.indirect_supported) {
+            backend.shaders.lighting_forward_indirect.set_vec3("dir_light.color", backend.backend_state.dir_light.color);
+        }
     }
     
     // entities ===================================================================================
@@ -220,72 +725,121 @@ GuiRet imgui(AppState& app_state, gl::Backend& backend) {
     if (ImGui::TreeNode("entities")) {
         for (i64 traverse_idx = 0; traverse_idx < gui_state::ent_traverse.size(); ++traverse_idx) {
 
-            i64 ent_idx = gui_state::ent_traverse[traverse_idx];
+            EntityHandle ent_handle = gui_state::ent_traverse[traverse_idx];
 
-            if (!app_state.entities.is_alive(ent_idx)) {
+            if (!app_state.entities.valid(ent_handle)) {
                 continue;
             }
+
+            size_t ent_idx = app_state.entities.index(ent_handle);
+
+            if (gui_state::pick_changed && ent_handle == gui_state::pick.entity) {
+                ImGui::SetNextItemOpen(true);
+            }
             
-            if (ImGui::TreeNode((void*)(intptr_t)ent_idx, "ent %d", app_state.entities.ids[ent_idx])) {
+            if (ImGui::TreeNode((void*)(intptr_t)ent_handle.val, "ent %d", app_state.entities.ids[ent_idx])) {
                 
                 if (ImGui::Button("+")) {  // duplicate
-                    if (app_state.entities.is_light(ent_idx)) {
-                        light_changed = true;
-                    }
-                    gui_state::ent_traverse.push_back(app_state.entities.dup_object(ent_idx));
+                    gui_state::ent_traverse.push_back(app_state.entities.dup_object(ent_handle));
                 }
                 ImGui::SameLine();
                 if (ImGui::Button("-")) {  // delete
-                    if (app_state.entities.is_light(ent_idx)) {
-                        light_changed = true;
-                    }
-
+                    // note: deleted once the tree is drawn, as deleting moves another entity into this index
                     obj_deleted = true;
-                    del_iter = gui_state::ent_traverse.begin() + traverse_idx;
-                    app_state.entities.del_object(ent_idx);
+                    del_traverse_idx = traverse_idx;
                 }
                 
                 if (ImGui::SliderFloat3("position", glm::value_ptr(app_state.entities.positions[ent_idx]), -30.0f, 30.0f)) {
-                    if (app_state.entities.is_light(ent_idx)) {
-                        light_changed = true;
-                    }
+                    app_state.entities.mark_dirty(ent_idx);
                 }
                 if (ImGui::SliderFloat3("rotation", glm::value_ptr(app_state.entities.rotations[ent_idx]), 0.0f, 360.0f)) {
-                    if (app_state.entities.is_light(ent_idx)) {
-                        light_changed = true;
-                    }
+                    app_state.entities.mark_dirty(ent_idx);
                 }
                 if (ImGui::SliderFloat("scale", &app_state.entities.scales[ent_idx].x, 0.025f, 10.0f)) {
                     // note: using a single float slider to set all values in a vec3
                     app_state.entities.scales[ent_idx] = { app_state.entities.scales[ent_idx].x,
                                                       app_state.entities.scales[ent_idx].x,
                                                       app_state.entities.scales[ent_idx].x };
+                    app_state.entities.mark_dirty(ent_idx);
+                }
+
+                // id of the entity this one is attached to, -1 if none
+                EntityHandle parent_handle = app_state.entities.parents[ent_idx];
+                i32 parent_id = app_state.entities.valid(parent_handle)
+                                    ? (i32)app_state.entities.ids[app_state.entities.index(parent_handle)]
+                                    : -1;
+                if (ImGui::InputInt("parent", &parent_id)) {
+                    // note: linear search, only done when the field is edited
+                    parent_handle = invalid_entity;
+                    for (size_t idx = 0; idx < app_state.entities.size(); ++idx) {
+                        if ((i32)app_state.entities.ids[idx] == parent_id) {
+                            parent_handle = app_state.entities.handle(idx);
+                        }
+                    }
+                    app_state.entities.set_parent(ent_idx, parent_handle);
                 }
 
                 if (ImGui::Button("toggle light")) {
-                    if (app_state.entities.is_light(ent_idx)) {
-                        set_flag(app_state.entities.flags[ent_idx], EntityFlags::EMIT_LIGHT);
+                    app_state.entities.set_emitter(ent_idx, !app_state.entities.is_light(ent_idx));
+                } 
+
+                ImGui::SameLine();
+                if (ImGui::Button("toggle occluder")) {
+                    if (app_state.entities.is_occluder(ent_idx)) {
+                        set_flag(app_state.entities.flags[ent_idx], EntityFlags::OCCLUDER);
                     } 
                     else {
-                        unset_flag(app_state.entities.flags[ent_idx], EntityFlags::EMIT_LIGHT);
+                        unset_flag(app_state.entities.flags[ent_idx], EntityFlags::OCCLUDER);
                     }
-                    light_changed = true;
-                } 
+                }
 
                 ImGui::BeginDisabled(!app_state.entities.is_light(ent_idx));
                 if (ImGui::Button("cast shadows")) {
-                    app_state.entities.pt_caster_idx = ent_idx;
-                    backend.shaders.lighting_deferred.set_u32("pt_caster_id", app_state.entities.ids[app_state.entities.pt_caster_idx]);
-                    backend.shaders.lighting_forward.set_u32("pt_caster_id", app_state.entities.ids[app_state.entities.pt_caster_idx]);
+                    app_state.entities.pt_caster = ent_handle;
+                    backend.shaders.lighting_deferred.set_u32("pt_caster_id", app_state.entities.ids[ent_idx]);
+                    backend.shaders.lighting_tiled.set_u32("pt_caster_id", app_state.entities.ids[ent_idx]);
+                    backend.shaders.lighting_forward.set_u32("pt_caster_id", app_state.entities.ids[ent_idx]);
+                    if (backend.indirect_supported) {
+                        backend.shaders.lighting_forward_indirect.set_u32("pt_caster_id", app_state.entities.ids[ent_idx]);
+                    }
                 }
                 if (ImGui::ColorEdit3("color", &app_state.entities.light_data[ent_idx].color.x)) {
-                    light_changed = true;
+                    app_state.entities.update_light(ent_idx);
                 }
                 if (ImGui::SliderFloat("radius", &app_state.entities.light_data[ent_idx].radius, 0.1, 100.0f)) {
-                    light_changed = true;
+                    app_state.entities.update_light(ent_idx);
                 }
                 if (ImGui::SliderFloat("intensity", &app_state.entities.light_data[ent_idx].intensity, 1.0f, 10.0f)) {
-                    light_changed = true;
+                    app_state.entities.update_light(ent_idx);
+                }
+
+                PtLight& light = app_state.entities.light_data[ent_idx];
+                bool spot = light.is_spot();
+                if (ImGui::Checkbox("spot light", &spot)) {
+                    light.inner_cos = spot ? std::cos(glm::radians(25.0f)) : -1.0f;
+                    light.outer_cos = spot ? std::cos(glm::radians(35.0f)) : -1.0f;
+                    app_state.entities.update_light(ent_idx);
+                }
+                if (spot) {
+                    // angles are edited as degrees from the axis, the light keeps their cosines
+                    f32 outer_deg = glm::degrees(std::acos(light.outer_cos));
+                    f32 inner_deg = glm::degrees(std::acos(light.inner_cos));
+                    if (ImGui::SliderFloat("outer angle", &outer_deg, 1.0f, 85.0f)) {
+                        light.outer_cos = std::cos(glm::radians(outer_deg));
+                        light.inner_cos = std::cos(glm::radians(std::min(inner_deg, outer_deg - 0.5f)));
+                        app_state.entities.update_light(ent_idx);
+                    }
+                    if (ImGui::SliderFloat("inner angle", &inner_deg, 0.0f, outer_deg - 0.5f)) {
+                        light.inner_cos = std::cos(glm::radians(inner_deg));
+                        app_state.entities.update_light(ent_idx);
+                    }
+                    if (ImGui::SliderFloat3("direction", &light.direction.x, -1.0f, 1.0f)) {
+                        glm::vec3 dir = glm::vec3(light.direction);
+                        if (glm::dot(dir, dir) > 1e-6f) {
+                            light.direction = glm::vec4(glm::normalize(dir), 0.0f);
+                        }
+                        app_state.entities.update_light(ent_idx);
+                    }
                 }
                 ImGui::EndDisabled();
                 ImGui::TreePop();
@@ -314,6 +868,24 @@ GuiRet imgui(AppState& app_state, gl::Backend& backend) {
     
     ImGui::Image(static_cast<ImTextureID>(backend.out_fbuf.tex_bufs[0]), 
         { scale * (f32)app_state.window_state.width, scale * (f32)app_state.window_state.height }, { 0, 1 }, { 1, 0 });
+
+    // pick the entity under the cursor
+    gui_state::pick_changed = false;
+    if (ImGui::IsItemHovered() && ImGui::IsMouseClicked(ImGuiMouseButton_Right) && !app_state.window_state.vp_captured) {
+        ImVec2 img_min = ImGui::GetItemRectMin();
+        ImVec2 img_sz = ImGui::GetItemRectSize();
+        glm::vec2 ndc = { (io.MousePos.x - img_min.x) / img_sz.x * 2.0f - 1.0f,
+                          1.0f - (io.MousePos.y - img_min.y) / img_sz.y * 2.0f };
+
+        f32 aspect = (f32)app_state.window_state.width / (f32)std::max(app_state.window_state.height, 1u);
+        glm::vec3 origin, dir;
+        app_state.camera.screen_ray(aspect, ndc, origin, dir);
+
+        auto start = std::chrono::steady_clock::now();
+        gui_state::pick = app_state.entities.raycast(origin, dir);
+        gui_state::pick_us = std::chrono::duration<f64, std::micro>(std::chrono::steady_clock::now() - start).count();
+        gui_state::pick_changed = true;
+    }
     
     ImGui::End();
 
@@ -333,10 +905,9 @@ GuiRet imgui(AppState& app_state, gl::Backend& backend) {
     }
 
     if (obj_deleted) {
-        gui_state::ent_traverse.erase(del_iter);
+        app_state.entities.del_object(gui_state::ent_traverse[del_traverse_idx]);
+        gui_state::ent_traverse.erase(gui_state::ent_traverse.begin() + del_traverse_idx);
     }
-
-    return { .light_changed = light_changed };
 }
 
 } // namespace gui
\ No newline at end of file
@@ -0,0 +1,242 @@
+#include <rose/light_lod.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+static constexpr u32 cell_bits = 19;    // per axis, cells are offset so negative coordinates stay ordered
+static constexpr u32 bucket_shift = 3 * cell_bits;
+
+// spreads the low bits of v so there are two zero bits between each
+static u64 spread_bits(u64 v) {
+    v &= 0x1FFFFF;
+    v = (v | (v << 32)) & 0x1F00000000FFFF;
+    v = (v | (v << 16)) & 0x1F0000FF0000FF;
+    v = (v | (v << 8)) & 0x100F00F00F00F00F;
+    v = (v | (v << 4)) & 0x10C30C30C30C30C3;
+    v = (v | (v << 2)) & 0x1249249249249249;
+    return v;
+}
+
+// key of a level's group, the colour bucket is kept while the cell is coarsened by a bit per axis and level
+static u64 group_key(u64 key, u32 level) {
+    constexpr u64 cell_mask = (1ull << bucket_shift) - 1;
+    return (key & ~cell_mask) | ((key & cell_mask) >> (3 * level));
+}
+
+// combines members into a light reaching everything they reached, colour and position are weighted by intensity
+//
+// note: the merged light is a point light, a spot light adds its intensity scaled by the fraction of the sphere
+// its cone covers
+template <typename Fn>
+static void aggregate(LightGroup& group, const Fn& member) {
+
+    f32 intensity = 0.0f;
+    f32 total_weight = 0.0f;
+    glm::vec3 color = { 0.0f, 0.0f, 0.0f };
+    glm::vec3 pos = { 0.0f, 0.0f, 0.0f };
+    for (u32 idx = 0; idx < group.count; ++idx) {
+        auto [member_pos, member_light] = member(group.first + idx);
+        f32 member_intensity = member_light.intensity * (1.0f - member_light.outer_cos) * 0.5f;
+        f32 weight = std::max(member_intensity, 1e-6f);
+        intensity += member_intensity;
+        total_weight += weight;
+        color += glm::vec3(member_light.color) * weight;
+        pos += glm::vec3(member_pos) * weight;
+    }
+    group.pos = glm::vec4(pos / total_weight, 1.0f);
+    group.light.color = glm::vec4(color / total_weight, 1.0f);
+    group.light.intensity = intensity;
+
+    f32 radius = 0.0f;
+    for (u32 idx = 0; idx < group.count; ++idx) {
+        auto [member_pos, member_light] = member(group.first + idx);
+        radius = std::max(radius, glm::length(glm::vec3(member_pos) - glm::vec3(group.pos)) + member_light.radius);
+    }
+    group.light.radius = radius;
+}
+
+void LightLod::build(const LightRegistry& registry) {
+
+    u32 n = registry.size();
+    keys.resize(n);
+
+    for (u32 idx = 0; idx < n; ++idx) {
+        // note: colours are normalized so a dim and a bright light of the same hue share a bucket
+        glm::vec3 color = glm::vec3(registry.data[idx].color);
+        f32 max_channel = std::max({ color.r, color.g, color.b, 1e-6f });
+        glm::uvec3 steps = glm::min(glm::uvec3(color / max_channel * (f32)n_color_steps),
+                                    glm::uvec3(n_color_steps - 1));
+        u64 bucket = (steps.r * n_color_steps + steps.g) * n_color_steps + steps.b;
+
+        glm::ivec3 cell = glm::ivec3(glm::floor(glm::vec3(registry.positions[idx]) / base_cell));
+        cell = glm::clamp(cell + (1 << (cell_bits - 1)), glm::ivec3(0), glm::ivec3((1 << cell_bits) - 1));
+        u64 morton = spread_bits(cell.x) | (spread_bits(cell.y) << 1) | (spread_bits(cell.z) << 2);
+
+        keys[idx] = { (bucket << bucket_shift) | morton, idx };
+    }
+    std::sort(keys.begin(), keys.end(), [](const Key& a, const Key& b) { return a.key < b.key; });
+
+    order.resize(n);
+    for (u32 slot = 0; slot < n; ++slot) {
+        order[slot] = keys[slot].light;
+    }
+
+    // each level's groups are the runs of equal keys among the groups of the level below
+    for (u32 level = 0; level < n_levels; ++level) {
+        std::vector<LightGroup>& groups = levels[level];
+        groups.clear();
+        u32 n_below = level == 0 ? n : (u32)levels[level - 1].size();
+
+        for (u32 below = 0; below < n_below; ++below) {
+            u64 key = group_key(level == 0 ? keys[below].key : levels[level - 1][below].key, level == 0 ? 0 : 1);
+            if (groups.empty() || groups.back().key != key) {
+                groups.push_back({ .key = key, .pos = glm::vec4(0.0f), .light = PtLight(), .first = below, .count = 0 });
+            }
+            groups.back().count++;
+        }
+
+        for (auto& group : groups) {
+            if (level == 0) {
+                aggregate(group, [&](u32 slot) {
+                    return std::pair(registry.positions[order[slot]], registry.data[order[slot]]);
+                });
+            } else {
+                aggregate(group, [&](u32 below) {
+                    return std::pair(levels[level - 1][below].pos, levels[level - 1][below].light);
+                });
+            }
+        }
+        stats.n_groups[level] = (u32)groups.size();
+        group_slots[level].assign(groups.size(), Slot());
+    }
+
+    n_built = n;
+    stats.n_builds++;
+}
+
+void LightLod::select(const LightRegistry& registry, u32 level, u32 group_idx, f32 weight, glm::vec3 camera_pos) {
+
+    const LightGroup& group = levels[level][group_idx];
+    f32 cell = base_cell * (f32)(1u << level);
+    f32 dist = glm::length(glm::vec3(group.pos) - camera_pos) / cell;
+    f32 blend = std::clamp((dist - lod_ratio) / (lod_ratio * transition), 0.0f, 1.0f);
+
+    // a group of one gains nothing from merging
+    if (group.count == 1 && level == 0) {
+        blend = 0.0f;
+    }
+
+    if (blend > 0.0f) {
+        show({ level, group_idx }, group.light, glm::vec3(group.pos), aggregate_id, weight * blend);
+        stats.n_aggregated++;
+        stats.n_blending += blend < 1.0f;
+    }
+    if (blend >= 1.0f) {
+        return;
+    }
+
+    weight *= 1.0f - blend;
+    for (u32 member = group.first; member < group.first + group.count; ++member) {
+        if (level == 0) {
+            u32 light_idx = order[member];
+            show({ n_levels, registry.handles[light_idx] }, registry.data[light_idx],
+                 glm::vec3(registry.positions[light_idx]), registry.ids[light_idx], weight);
+        } else {
+            select(registry, level - 1, member, weight, camera_pos);
+        }
+    }
+}
+
+LightLod::Slot& LightLod::slot(Shown as) {
+    return as.level == n_levels ? light_slots[as.item] : group_slots[as.level][as.item];
+}
+
+void LightLod::show(Shown as, const PtLight& light, glm::vec3 pos, u32 id, f32 weight) {
+
+    Slot& shown_slot = slot(as);
+    shown_slot.frame = frame;
+    if (shown_slot.handle != LightRegistry::invalid_handle && shown_slot.weight == weight) {
+        return;
+    }
+
+    PtLight scaled = light;
+    scaled.intensity *= weight;
+    if (shown_slot.handle == LightRegistry::invalid_handle) {
+        shown_slot.handle = lights.add(scaled, pos, id);
+        shown.push_back(as);
+    } else {
+        lights.set_light(shown_slot.handle, scaled);
+    }
+    shown_slot.weight = weight;
+}
+
+// removes the entries of groups, which are replaced when rebuilding, and of lights that changed
+void LightLod::drop_stale() {
+    u32 n_kept = 0;
+    for (Shown as : shown) {
+        Slot& stale = slot(as);
+        if (as.level == n_levels && stale.weight >= 0.0f) {
+            shown[n_kept++] = as;
+            continue;
+        }
+        lights.remove(stale.handle);
+        stale.handle = LightRegistry::invalid_handle;
+    }
+    shown.resize(n_kept);
+}
+
+void LightLod::update(LightRegistry& registry, glm::vec3 camera_pos, bool rebuild) {
+
+    using clock = std::chrono::steady_clock;
+    auto start = clock::now();
+
+    // note: the registry's changes are otherwise taken when it is uploaded, which is skipped while lights are
+    // selected from here
+    if (rebuild) {
+        lights.clear();
+        shown.clear();
+        light_slots.clear();
+    }
+    if (rebuild || !registry.dirty_idxs.empty() || registry.size() != n_built) {
+        registry.take_dirty_ranges(ranges, 0);
+
+        // a changed light is added again rather than updated in place, as its handle may belong to a new light
+        // note: never shrunk, entries of lights that are gone are removed once they are not selected
+        light_slots.resize(std::max(light_slots.size(), registry.sparse.size()));
+        for (const auto& range : ranges) {
+            for (u32 idx = range.begin; idx < range.end; ++idx) {
+                light_slots[registry.handles[idx]].weight = -1.0f;
+            }
+        }
+        drop_stale();
+        build(registry);
+    }
+    auto built = clock::now();
+
+    stats.n_lights = registry.size();
+    stats.n_aggregated = 0;
+    stats.n_blending = 0;
+
+    ++frame;
+    for (u32 group = 0; group < levels[n_levels - 1].size(); ++group) {
+        select(registry, n_levels - 1, group, 1.0f, camera_pos);
+    }
+
+    // entries not selected this frame belong to lights that were removed or merged into a group
+    u32 n_kept = 0;
+    for (Shown as : shown) {
+        Slot& kept = slot(as);
+        if (kept.frame == frame) {
+            shown[n_kept++] = as;
+        } else {
+            lights.remove(kept.handle);
+            kept.handle = LightRegistry::invalid_handle;
+        }
+    }
+    shown.resize(n_kept);
+    stats.n_selected = lights.size();
+
+    stats.build_ms = std::chrono::duration<f64, std::milli>(built - start).count();
+    stats.select_ms = std::chrono::duration<f64, std::milli>(clock::now() - built).count();
+}
\ No newline at end of file
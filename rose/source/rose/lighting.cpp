@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <array>
+#include <cmath>
 
 #include <glm.hpp>
 #include <gtc/matrix_transform.hpp>
@@ -51,3 +52,155 @@ glm::mat4 get_cascade_mat(const glm::mat4& proj, const glm::mat4& view, glm::vec
 
     return light_proj * light_view;
 }
+
+u32 LightRegistry::add(const PtLight& light, const glm::vec3& pos, u32 id) {
+
+    u32 handle = 0;
+    if (free_handles.empty()) {
+        handle = (u32)sparse.size();
+        sparse.push_back(0);
+    } else {
+        handle = free_handles.back();
+        free_handles.pop_back();
+    }
+
+    u32 idx = size();
+    sparse[handle] = idx;
+    data.push_back(light);
+    positions.push_back(glm::vec4(pos, 1.0f));
+    ids.push_back(id);
+    handles.push_back(handle);
+    dirty.push_back(false);
+    mark_dirty(idx);
+
+    return handle;
+}
+
+void LightRegistry::remove(u32 handle) {
+
+    u32 idx = sparse[handle];
+    u32 last = size() - 1;
+
+    // the last light takes the place of the removed one, so only its entry has to be uploaded again
+    if (idx != last) {
+        data[idx] = data[last];
+        positions[idx] = positions[last];
+        ids[idx] = ids[last];
+        handles[idx] = handles[last];
+        sparse[handles[idx]] = idx;
+        mark_dirty(idx);
+    }
+
+    data.pop_back();
+    positions.pop_back();
+    ids.pop_back();
+    handles.pop_back();
+    dirty.pop_back();
+
+    free_handles.push_back(handle);
+}
+
+void LightRegistry::set_light(u32 handle, const PtLight& light) {
+    u32 idx = sparse[handle];
+    data[idx] = light;
+    mark_dirty(idx);
+}
+
+void LightRegistry::set_pos(u32 handle, const glm::vec3& pos) {
+    u32 idx = sparse[handle];
+    if (glm::vec3(positions[idx]) != pos) {
+        positions[idx] = glm::vec4(pos, 1.0f);
+        mark_dirty(idx);
+    }
+}
+
+void LightRegistry::mark_all_dirty() {
+    for (u32 idx = 0; idx < size(); ++idx) {
+        mark_dirty(idx);
+    }
+}
+
+void LightRegistry::clear() {
+    data.clear();
+    positions.clear();
+    ids.clear();
+    handles.clear();
+    sparse.clear();
+    free_handles.clear();
+    dirty.clear();
+    dirty_idxs.clear();
+}
+
+void LightRegistry::mark_dirty(u32 idx) {
+    if (!dirty[idx]) {
+        dirty[idx] = true;
+        dirty_idxs.push_back(idx);
+    }
+}
+
+void LightRegistry::take_dirty_ranges(std::vector<LightRange>& ranges, u32 max_gap) {
+
+    ranges.resize(0);
+
+    // lights removed after being flagged may now be past the end
+    u32 n_dirty = 0;
+    for (u32 idx : dirty_idxs) {
+        if (idx < size()) {
+            dirty[idx] = false;
+            dirty_idxs[n_dirty++] = idx;
+        }
+    }
+    dirty_idxs.resize(n_dirty);
+    std::sort(dirty_idxs.begin(), dirty_idxs.end());
+
+    for (u32 idx : dirty_idxs) {
+        if (!ranges.empty() && idx <= ranges.back().end + max_gap) {
+            ranges.back().end = idx + 1;
+        } else {
+            ranges.push_back({ .begin = idx, .end = idx + 1 });
+        }
+    }
+
+    dirty_idxs.resize(0);
+}
+
+bool Clusters::fit(glm::uvec2 screen_dims, f32 fov_y, f32 near_z, f32 far_z) {
+
+    glm::uvec3 prev_sz = grid_sz;
+    grid_sz.x = std::max((screen_dims.x + tile_sz - 1) / tile_sz, 1u);
+    grid_sz.y = std::max((screen_dims.y + tile_sz - 1) / tile_sz, 1u);
+
+    // a tile spans a constant fraction of its distance, so slices as deep as they are wide grow by a constant
+    // ratio from one to the next
+    split_z = std::clamp(near_slice_z, near_z * 2.0f, far_z * 0.5f);
+    f32 tile_width = 2.0f * std::tan(fov_y * 0.5f) * (f32)tile_sz / (f32)std::max(screen_dims.y, 1u);
+    u32 n_log = (u32)std::ceil(std::log(far_z / split_z) / std::log(1.0f + tile_width));
+    grid_sz.z = std::clamp(n_log + 1, min_slices, max_slices);
+
+    return grid_sz != prev_sz;
+}
+
+bool Clusters::tune(f32 avg_lights) {
+
+    if (++frames_since_tune < tune_interval || avg_lights <= 0.0f) {
+        return false;
+    }
+
+    size_t size_idx = 0;
+    while (size_idx + 1 < tile_sizes.size() && tile_sizes[size_idx] < tile_sz) {
+        ++size_idx;
+    }
+
+    // the bands leave room for a change to move the average without immediately being undone
+    if (avg_lights > target_lights * 1.5f && size_idx > 0) {
+        --size_idx;
+    } else if (avg_lights < target_lights * 0.5f && size_idx + 1 < tile_sizes.size()) {
+        ++size_idx;
+    } else if (tile_sizes[size_idx] == tile_sz) {
+        return false;
+    }
+
+    tile_sz = tile_sizes[size_idx];
+    frames_since_tune = 0;
+    return true;
+}
\ No newline at end of file
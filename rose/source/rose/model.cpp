@@ -1,5 +1,6 @@
 #include <rose/model.hpp>
 #include <rose/core/err.hpp>
+#include <rose/core/memory.hpp>
 
 #ifdef USE_OPENGL
 #include <rose/backends/gl/backend.hpp>
@@ -14,6 +15,7 @@ static_assert("no backend selected");
 #include <assimp/GltfMaterial.h>
 #include <assimp/material.h>
 
+#include <algorithm>
 #include <format>
 #include <unordered_map>
 
@@ -28,8 +30,12 @@ Model::Model(Model&& other) noexcept {
     tangents = std::move(other.tangents);
     uvs = std::move(other.uvs);
     indices = std::move(other.indices);
+    path = std::move(other.path);
     textures = std::move(other.textures);
     meshes = std::move(other.meshes);
+    nodes = std::move(other.nodes);
+    bounds = other.bounds;
+    mesh_bvhs = std::move(other.mesh_bvhs);
 }
 
 Model& Model::operator=(Model&& other) noexcept {
@@ -39,50 +45,47 @@ Model& Model::operator=(Model&& other) noexcept {
     return *this;
 }
 
-static void load_matl_textures(TextureManager& manager, Model& model, aiMaterial* mat, aiTextureType ty,
-                               const fs::path& root_path, u32 mesh_idx) {
+static void collect_matl_textures(ModelTextures& tex_data, std::unordered_map<fs::path, u32>& image_idxs,
+                                  aiMaterial* mat, aiTextureType ty, const fs::path& root_path, u32 mesh_idx) {
+
+    TextureType tex_ty = TextureType::NONE;
+    switch (ty) {
+    case aiTextureType_BASE_COLOR:
+        tex_ty = TextureType::ALBEDO;
+        break;
+    case aiTextureType_GLTF_METALLIC_ROUGHNESS:
+        // NOTE: in the GLTF file format, ao (R), roughness (G) and metallic values (B) are combined
+        // into a single texture
+        tex_ty = TextureType::GLTF_PBR;
+        break;
+    case aiTextureType_AMBIENT_OCCLUSION:
+        tex_ty = TextureType::AMBIENT_OCCLUSION;
+        break;
+    case aiTextureType_HEIGHT:
+        tex_ty = TextureType::NORMAL;
+        break;
+    case aiTextureType_NORMALS:
+        tex_ty = TextureType::NORMAL;
+        break;
+    case aiTextureType_DISPLACEMENT:
+        tex_ty = TextureType::DISPLACE;
+        break;
+    default:
+        return;
+    }
     
     for (u32 idx = 0; idx < mat->GetTextureCount(ty); ++idx) {
         aiString ai_str;
         mat->GetTexture(ty, idx, &ai_str);
         fs::path texture_path = root_path / std::string(ai_str.C_Str());
-        TextureRef texture;
-
-        switch (ty) {
-        case aiTextureType_BASE_COLOR:
-            texture = manager.load_texture(texture_path, TextureType::ALBEDO);
-            model.textures.push_back(texture);
-            break;
-        case aiTextureType_GLTF_METALLIC_ROUGHNESS:
-            // NOTE: in the GLTF file format, ao (R), roughness (G) and metallic values (B) are combined
-            // into a single texture
-            texture = manager.load_texture(texture_path, TextureType::GLTF_PBR);
-            model.textures.push_back(texture);
-            break;
-        case aiTextureType_AMBIENT_OCCLUSION:
-            texture = manager.load_texture(texture_path, TextureType::AMBIENT_OCCLUSION);
-            model.textures.push_back(texture);
-            break;
-        case aiTextureType_HEIGHT:
-            texture = manager.load_texture(texture_path, TextureType::NORMAL);
-            model.textures.push_back(texture);
-            break;
-        case aiTextureType_NORMALS:
-            texture = manager.load_texture(texture_path, TextureType::NORMAL);
-            model.textures.push_back(texture);
-            break;
-        case aiTextureType_DISPLACEMENT:
-            texture = manager.load_texture(texture_path, TextureType::DISPLACE);
-            model.textures.push_back(texture);
-            break;
-        default:
-            break;
-        }
 
-        // TODO: a bit hacky, would like to refactor model loading to better handle these sorts of cases
-        if (texture.ref && is_flag_set(texture.ref->flags, TextureFlags::TRANSPARENT)) {
-            model.meshes[mesh_idx].flags |= MeshFlags::TRANSPARENT;
+        auto [it, inserted] = image_idxs.try_emplace(texture_path, (u32)tex_data.images.size());
+        if (inserted) {
+            TextureImage& image = tex_data.images.emplace_back();
+            image.path = texture_path;
+            image.ty = tex_ty;
         }
+        tex_data.slots.push_back({ .image = it->second, .mesh = mesh_idx });
     }
 }
 
@@ -104,7 +107,9 @@ static void init_meshes(aiNode* ai_node, const aiScene* ai_scene, Model& model,
                       .base_idx = n_indices,
                       .matl_offset = n_textures,
                       .n_matls = 0,
-                      .flags = MeshFlags::NONE };
+                      .flags = MeshFlags::NONE,
+                      .node_idx = 0,
+                      .bounds = {} };
 
         model.meshes.push_back(mesh);
         n_verts += ai_mesh->mNumVertices;
@@ -125,13 +130,29 @@ static void init_meshes(aiNode* ai_node, const aiScene* ai_scene, Model& model,
     }
 }
 
-static void process_assimp_node(TextureManager& manager, aiNode* ai_node, const aiScene* ai_scene, Model& model,
-                                const fs::path& root_path, u32& mesh_offset) {
+static void process_assimp_node(ModelTextures& tex_data, std::unordered_map<fs::path, u32>& image_idxs, aiNode* ai_node,
+                                const aiScene* ai_scene, Model& model, const fs::path& root_path, u32& mesh_offset,
+                                i32 parent_idx) {
+
+    // note: assimp matrices are row major
+    const aiMatrix4x4& ai_mat = ai_node->mTransformation;
+    glm::mat4 local = glm::transpose(glm::mat4({ ai_mat.a1, ai_mat.a2, ai_mat.a3, ai_mat.a4 },
+                                               { ai_mat.b1, ai_mat.b2, ai_mat.b3, ai_mat.b4 },
+                                               { ai_mat.c1, ai_mat.c2, ai_mat.c3, ai_mat.c4 },
+                                               { ai_mat.d1, ai_mat.d2, ai_mat.d3, ai_mat.d4 }));
+
+    i32 node_idx = (i32)model.nodes.size();
+    model.nodes.push_back({ .local = { .mat = local, .normal = glm::mat4(glm::transpose(glm::inverse(glm::mat3(local)))) },
+                            .parent = parent_idx });
+
     for (u32 mesh_idx = 0; mesh_idx < ai_node->mNumMeshes; ++mesh_idx) {
         aiMesh* ai_mesh = ai_scene->mMeshes[ai_node->mMeshes[mesh_idx]];
+        model.meshes[mesh_offset + mesh_idx].node_idx = (u32)node_idx;
+        Bounds& bounds = model.meshes[mesh_offset + mesh_idx].bounds;
 
         for (int vert_idx = 0; vert_idx < ai_mesh->mNumVertices; ++vert_idx) {
             model.pos.push_back({ ai_mesh->mVertices[vert_idx].x, ai_mesh->mVertices[vert_idx].y, ai_mesh->mVertices[vert_idx].z });
+            bounds.expand(model.pos.back());
             model.norms.push_back({ ai_mesh->mNormals[vert_idx].x, ai_mesh->mNormals[vert_idx].y, ai_mesh->mNormals[vert_idx].z });
             // note: right now I am just using nil values for these if not present
             // can be changed in the future to reduce memory consumption
@@ -147,6 +168,14 @@ static void process_assimp_node(TextureManager& manager, aiNode* ai_node, const
             model.uvs.push_back(uv);
         }
 
+        // note: the sphere is centered on the box, which is not minimal but is cheap and tight enough for culling
+        if (!bounds.empty()) {
+            bounds.center = (bounds.min_pt + bounds.max_pt) * 0.5f;
+            for (auto vert = model.pos.end() - ai_mesh->mNumVertices; vert != model.pos.end(); ++vert) {
+                bounds.radius = std::max(bounds.radius, glm::distance(bounds.center, *vert));
+            }
+        }
+
         for (u32 face_idx = 0; face_idx < ai_mesh->mNumFaces; ++face_idx) {
             aiFace face = ai_mesh->mFaces[face_idx];
             for (int ind_idx = 0; ind_idx < face.mNumIndices; ++ind_idx) {
@@ -154,38 +183,67 @@ static void process_assimp_node(TextureManager& manager, aiNode* ai_node, const
             }
         }
 
-        // Loading material textures
+        // Collecting material textures, they are decoded once the whole hierarchy has been read
         if (ai_mesh->mMaterialIndex >= 0) {
             aiMaterial* matl = ai_scene->mMaterials[ai_mesh->mMaterialIndex];
-            load_matl_textures(manager, model, matl, aiTextureType_BASE_COLOR, root_path, mesh_offset + mesh_idx);
-            load_matl_textures(manager, model, matl, aiTextureType_GLTF_METALLIC_ROUGHNESS, root_path, mesh_offset + mesh_idx);
-            load_matl_textures(manager, model, matl, aiTextureType_AMBIENT_OCCLUSION, root_path, mesh_offset + mesh_idx);
-            load_matl_textures(manager, model, matl, aiTextureType_HEIGHT, root_path, mesh_offset + mesh_idx);
-            load_matl_textures(manager, model, matl, aiTextureType_NORMALS, root_path, mesh_offset + mesh_idx);
-            load_matl_textures(manager, model, matl, aiTextureType_DISPLACEMENT, root_path, mesh_offset + mesh_idx);
+            collect_matl_textures(tex_data, image_idxs, matl, aiTextureType_BASE_COLOR, root_path, mesh_offset + mesh_idx);
+            collect_matl_textures(tex_data, image_idxs, matl, aiTextureType_GLTF_METALLIC_ROUGHNESS, root_path, mesh_offset + mesh_idx);
+            collect_matl_textures(tex_data, image_idxs, matl, aiTextureType_AMBIENT_OCCLUSION, root_path, mesh_offset + mesh_idx);
+            collect_matl_textures(tex_data, image_idxs, matl, aiTextureType_HEIGHT, root_path, mesh_offset + mesh_idx);
+            collect_matl_textures(tex_data, image_idxs, matl, aiTextureType_NORMALS, root_path, mesh_offset + mesh_idx);
+            collect_matl_textures(tex_data, image_idxs, matl, aiTextureType_DISPLACEMENT, root_path, mesh_offset + mesh_idx);
         }
     }
 
     mesh_offset += ai_node->mNumMeshes;
 
     for (u32 idx = 0; idx < ai_node->mNumChildren; ++idx) {
-        process_assimp_node(manager, ai_node->mChildren[idx], ai_scene, model, root_path, mesh_offset);
+        process_assimp_node(tex_data, image_idxs, ai_node->mChildren[idx], ai_scene, model, root_path, mesh_offset,
+                            node_idx);
     }
 }
 
+// returns bounds enclosing the given bounds after a transform
+static Bounds transform_bounds(const Bounds& bounds, const glm::mat4& mat) {
+
+    Bounds ret;
+    if (bounds.empty()) {
+        return ret;
+    }
+
+    for (u32 corner = 0; corner < 8; ++corner) {
+        glm::vec3 pt = { (corner & 1) ? bounds.max_pt.x : bounds.min_pt.x, (corner & 2) ? bounds.max_pt.y : bounds.min_pt.y,
+                         (corner & 4) ? bounds.max_pt.z : bounds.min_pt.z };
+        ret.expand(glm::vec3(mat * glm::vec4(pt, 1.0f)));
+    }
+
+    f32 max_scale = std::max({ glm::length(glm::vec3(mat[0])), glm::length(glm::vec3(mat[1])), glm::length(glm::vec3(mat[2])) });
+    ret.center = glm::vec3(mat * glm::vec4(bounds.center, 1.0f));
+    ret.radius = bounds.radius * max_scale;
+    return ret;
+}
+
 void Model::load(TextureManager& manager, const fs::path& path) {
-    Assimp::Importer import;
+    ModelTextures tex_data;
+    if (import(path, tex_data, &manager)) {
+        finalize(manager, tex_data);
+    }
+}
+
+bool Model::import(const fs::path& path, ModelTextures& tex_data, const TextureManager* manager) {
+    Assimp::Importer importer;
 
     auto flags = aiProcess_GenSmoothNormals | aiProcess_Triangulate | aiProcess_CalcTangentSpace |
                  aiProcess_JoinIdenticalVertices | aiProcess_FlipUVs;
 
     const aiScene* scene =
-        import.ReadFile(path.generic_string(), flags);
+        importer.ReadFile(path.generic_string(), flags);
 
     if (!scene) {
-        return;
+        return false;
     }
 
+    this->path = path;
     fs::path root_path = path.parent_path();
 
     // 1. determine number of meshes to reserve their space
@@ -204,35 +262,102 @@ void Model::load(TextureManager& manager, const fs::path& path) {
     norms.reserve(n_verts);
     tangents.reserve(n_verts);
     uvs.reserve(n_verts);
-    textures.reserve(n_textures);
+    tex_data.slots.reserve(n_textures);
 
-    // 3. fill out buffers and initialize renderer data
+    // 3. fill out buffers
     u32 mesh_offset = 0;
-    process_assimp_node(manager, scene->mRootNode, scene, *this, root_path, mesh_offset);
+    std::unordered_map<fs::path, u32> image_idxs;
+    process_assimp_node(tex_data, image_idxs, scene->mRootNode, scene, *this, root_path, mesh_offset, -1);
+
+    for (TextureImage& image : tex_data.images) {
+        if (!manager || !manager->is_loaded(image.path)) {
+            decode_texture(image.path, image.ty, image);
+        }
+    }
+
+    // transforms of each node relative to the model, used to place mesh bounds
+    ScratchScope scratch;
+    ArenaVector<glm::mat4> node_mats(nodes.size(), scratch.arena);
+    for (size_t idx = 0; idx < nodes.size(); ++idx) {
+        node_mats[idx] = nodes[idx].parent < 0 ? nodes[idx].local.mat : node_mats[nodes[idx].parent] * nodes[idx].local.mat;
+    }
+
+    for (const auto& mesh : meshes) {
+        bounds.expand(transform_bounds(mesh.bounds, node_mats[mesh.node_idx]));
+    }
+
+    auto bvhs = std::make_shared<std::vector<TriangleBVH>>(meshes.size());
+    for (size_t mesh_idx = 0; mesh_idx < meshes.size(); ++mesh_idx) {
+        const Mesh& mesh = meshes[mesh_idx];
+        (*bvhs)[mesh_idx].build(std::span<const glm::vec3>(pos).subspan(mesh.base_vert),
+                                std::span<const u32>(indices).subspan(mesh.base_idx, mesh.n_indices));
+    }
+    mesh_bvhs = std::move(bvhs);
+
+    return true;
+}
+
+void Model::finalize(TextureManager& manager, ModelTextures& tex_data) {
+
+    // textures already loaded are shared, the rest are created from their decoded pixels
+    std::vector<TextureRef> refs;
+    refs.reserve(tex_data.images.size());
+    for (TextureImage& image : tex_data.images) {
+        refs.push_back(manager.is_loaded(image.path) ? manager.get_ref(image.path) : manager.upload_texture(image));
+        image.data.reset();
+    }
+
+    textures.reserve(tex_data.slots.size());
+    for (const ModelTextures::Slot& slot : tex_data.slots) {
+        textures.push_back(refs[slot.image]);
+        if (is_flag_set(refs[slot.image]->flags, TextureFlags::TRANSPARENT)) {
+            meshes[slot.mesh].flags |= MeshFlags::TRANSPARENT;
+        }
+    }
 
 #ifdef USE_OPENGL
-    render_data.init(pos, norms, tangents, uvs, indices);
+    render_data = std::make_shared<gl::RenderData>();
+    render_data->init(pos, norms, tangents, uvs, indices);
 #else
     static_assert("no backend selected");
 #endif 
+}
+
+u64 Model::geometry_bytes() const {
+    return indices.size() * sizeof(u32) + pos.size() * sizeof(glm::vec3) + norms.size() * sizeof(glm::vec3) +
+           tangents.size() * sizeof(glm::vec3) + uvs.size() * sizeof(glm::vec2);
+}
 
-    return;
+u64 Model::texture_bytes() const {
+    u64 n_bytes = 0;
+    std::vector<u32> seen;
+    for (const TextureRef& texture : textures) {
+        if (texture.ref && std::find(seen.begin(), seen.end(), texture.ref->id) == seen.end()) {
+            seen.push_back(texture.ref->id);
+            n_bytes += texture.ref->n_bytes;
+        }
+    }
+    return n_bytes;
 }
 
 Model Model::copy() { 
     
     Model model;
     model.model_mat = model_mat;
+    model.path = path;
     model.meshes = meshes;
+    model.nodes = nodes;
     model.textures = textures;
+    model.bounds = bounds;
     model.indices = indices;
     model.pos = pos;
     model.norms = norms;
     model.tangents = tangents;
     model.uvs = uvs;
+    model.mesh_bvhs = mesh_bvhs;
 
 #ifdef USE_OPENGL
-    model.render_data.init(pos, norms, tangents, uvs, indices);
+    model.render_data = render_data;
 #else
     static_assert("no backend selected");
 #endif 
@@ -246,6 +371,7 @@ SkyBox::SkyBox(SkyBox&& other) noexcept {
     verts_buf = other.verts_buf;
     other.verts_buf = 0;
     texture = std::move(other.texture);
+    paths = std::move(other.paths);
     verts = std::move(other.verts);
     model_mat = std::move(other.model_mat);
 }
@@ -276,4 +402,5 @@ void SkyBox::init() {
 
 void SkyBox::load(TextureManager& manager, const std::array<fs::path, 6>& paths) {
     texture = manager.load_cubemap(paths);
+    this->paths = paths;
 }
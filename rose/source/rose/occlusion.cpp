@@ -0,0 +1,299 @@
+#include <rose/occlusion.hpp>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+
+// runs fn for every index in [0, n), on the pool's threads if available
+//
+// note: fn is passed by reference, so wrapping it in a std::function never allocates
+template <typename Fn>
+static void run_jobs(ThreadPool* pool, u32 n, const Fn& fn) {
+    if (pool) {
+        pool->parallel_for(n, std::cref(fn));
+    } else {
+        for (u32 idx = 0; idx < n; ++idx) {
+            fn(idx);
+        }
+    }
+}
+
+// projects the triangles of an occluder to the screen, triangles crossing the near plane are dropped
+static void setup_tris(const OccluderMesh& mesh, const glm::mat4& proj_view, f32 near_z, u32 width, u32 height,
+                       std::vector<OccluderTri>& out) {
+
+    glm::mat4 clip_mat = proj_view * mesh.transform;
+
+    for (size_t idx = 0; idx + 2 < mesh.indices.size(); idx += 3) {
+        std::array<f32, 3> xs, ys, inv_ws;
+        bool behind = false;
+
+        for (u32 vert = 0; vert < 3; ++vert) {
+            glm::vec4 clip = clip_mat * glm::vec4(mesh.pos[mesh.indices[idx + vert]], 1.0f);
+            if (clip.w < near_z) {
+                behind = true;
+                break;
+            }
+            inv_ws[vert] = 1.0f / clip.w;
+            xs[vert] = (clip.x * inv_ws[vert] * 0.5f + 0.5f) * (f32)width;
+            ys[vert] = (clip.y * inv_ws[vert] * 0.5f + 0.5f) * (f32)height;
+        }
+
+        if (behind) {
+            continue;
+        }
+
+        f32 area = (xs[1] - xs[0]) * (ys[2] - ys[0]) - (xs[2] - xs[0]) * (ys[1] - ys[0]);
+        if (std::abs(area) < 1e-6f) {
+            continue;
+        }
+
+        // both faces are rasterized, so wind every triangle the same way
+        if (area < 0.0f) {
+            std::swap(xs[1], xs[2]);
+            std::swap(ys[1], ys[2]);
+            std::swap(inv_ws[1], inv_ws[2]);
+            area = -area;
+        }
+
+        // pixels whose centers fall within the triangle's bounds
+        OccluderTri tri;
+        tri.min_x = std::max((i32)std::ceil(std::min({ xs[0], xs[1], xs[2] }) - 0.5f), 0);
+        tri.max_x = std::min((i32)std::floor(std::max({ xs[0], xs[1], xs[2] }) - 0.5f), (i32)width - 1);
+        tri.min_y = std::max((i32)std::ceil(std::min({ ys[0], ys[1], ys[2] }) - 0.5f), 0);
+        tri.max_y = std::min((i32)std::floor(std::max({ ys[0], ys[1], ys[2] }) - 0.5f), (i32)height - 1);
+
+        if (tri.min_x > tri.max_x || tri.min_y > tri.max_y) {
+            continue;
+        }
+
+        // edge k is opposite vertex k, divided by the area it gives the barycentric weight of that vertex
+        f32 inv_area = 1.0f / area;
+        tri.z_dx = 0.0f;
+        tri.z_dy = 0.0f;
+        tri.z_0 = 0.0f;
+
+        for (u32 edge = 0; edge < 3; ++edge) {
+            u32 v0 = (edge + 1) % 3;
+            u32 v1 = (edge + 2) % 3;
+            tri.edge_a[edge] = ys[v0] - ys[v1];
+            tri.edge_b[edge] = xs[v1] - xs[v0];
+            tri.edge_c[edge] = xs[v0] * ys[v1] - xs[v1] * ys[v0];
+
+            tri.z_dx += tri.edge_a[edge] * inv_area * inv_ws[edge];
+            tri.z_dy += tri.edge_b[edge] * inv_area * inv_ws[edge];
+            tri.z_0 += tri.edge_c[edge] * inv_area * inv_ws[edge];
+        }
+
+        out.push_back(tri);
+    }
+}
+
+// rasterizes the rows of a triangle within [row_begin, row_end), keeping the closest depth of each pixel
+static void raster_tri(const OccluderTri& tri, u32 row_begin, u32 row_end, u32 width, f32* depth) {
+
+    i32 y_begin = std::max(tri.min_y, (i32)row_begin);
+    i32 y_end = std::min(tri.max_y + 1, (i32)row_end);
+    i32 x_begin = tri.min_x & ~7;
+
+    for (i32 y = y_begin; y < y_end; ++y) {
+        f32 py = (f32)y + 0.5f;
+        f32* row = depth + (size_t)y * width;
+
+#ifdef __AVX2__
+        const __m256 lane_offsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+        const __m256 zero = _mm256_setzero_ps();
+
+        __m256 row_e0 = _mm256_set1_ps(tri.edge_b[0] * py + tri.edge_c[0]);
+        __m256 row_e1 = _mm256_set1_ps(tri.edge_b[1] * py + tri.edge_c[1]);
+        __m256 row_e2 = _mm256_set1_ps(tri.edge_b[2] * py + tri.edge_c[2]);
+        __m256 row_z = _mm256_set1_ps(tri.z_dy * py + tri.z_0);
+
+        for (i32 x = x_begin; x <= tri.max_x; x += 8) {
+            __m256 px = _mm256_add_ps(_mm256_set1_ps((f32)x), lane_offsets);
+
+            __m256 e0 = _mm256_fmadd_ps(_mm256_set1_ps(tri.edge_a[0]), px, row_e0);
+            __m256 e1 = _mm256_fmadd_ps(_mm256_set1_ps(tri.edge_a[1]), px, row_e1);
+            __m256 e2 = _mm256_fmadd_ps(_mm256_set1_ps(tri.edge_a[2]), px, row_e2);
+            __m256 inside = _mm256_and_ps(_mm256_cmp_ps(e0, zero, _CMP_GE_OQ),
+                            _mm256_and_ps(_mm256_cmp_ps(e1, zero, _CMP_GE_OQ), _mm256_cmp_ps(e2, zero, _CMP_GE_OQ)));
+
+            if (_mm256_movemask_ps(inside) == 0) {
+                continue;
+            }
+
+            __m256 z = _mm256_fmadd_ps(_mm256_set1_ps(tri.z_dx), px, row_z);
+            __m256 dst = _mm256_loadu_ps(row + x);
+            _mm256_storeu_ps(row + x, _mm256_blendv_ps(dst, _mm256_max_ps(dst, z), inside));
+        }
+#else
+        for (i32 x = x_begin; x <= tri.max_x; x += 8) {
+            for (i32 lane = 0; lane < 8; ++lane) {
+                f32 px = (f32)(x + lane) + 0.5f;
+                bool inside = true;
+                for (u32 edge = 0; edge < 3; ++edge) {
+                    inside &= tri.edge_a[edge] * px + (tri.edge_b[edge] * py + tri.edge_c[edge]) >= 0.0f;
+                }
+                if (inside) {
+                    f32 z = tri.z_dx * px + (tri.z_dy * py + tri.z_0);
+                    row[x + lane] = std::max(row[x + lane], z);
+                }
+            }
+        }
+#endif
+    }
+}
+
+void OcclusionBuffer::init(u32 w, u32 h, ThreadPool* pool) {
+    width = (w + 7) & ~7u;
+    height = h;
+    depth.assign((size_t)width * height, 0.0f);
+    this->pool = pool;
+}
+
+void OcclusionBuffer::render(std::span<const OccluderMesh> occluders, const glm::mat4& proj_view, f32 near_z) {
+
+    auto start = std::chrono::steady_clock::now();
+
+    this->proj_view = proj_view;
+    this->near_z = near_z;
+
+    // triangles of each occluder are set up independently, then gathered in order
+    // note: lists are never shrunk, so their storage is reused when the number of occluders changes
+    if (mesh_tris.size() < occluders.size()) {
+        mesh_tris.resize(occluders.size());
+    }
+    run_jobs(pool, (u32)occluders.size(), [&](u32 idx) {
+        mesh_tris[idx].resize(0);
+        setup_tris(occluders[idx], proj_view, near_z, width, height, mesh_tris[idx]);
+    });
+
+    tris.resize(0);
+    for (size_t idx = 0; idx < occluders.size(); ++idx) {
+        tris.insert(tris.end(), mesh_tris[idx].begin(), mesh_tris[idx].end());
+    }
+
+    std::fill(depth.begin(), depth.end(), 0.0f);
+
+    // every band rasterizes every triangle overlapping it, so no two jobs write the same pixel
+    u32 n_bands = (height + band_height - 1) / band_height;
+    run_jobs(pool, n_bands, [&](u32 band) {
+        u32 row_begin = band * band_height;
+        u32 row_end = std::min(row_begin + band_height, height);
+        for (const auto& tri : tris) {
+            if (tri.max_y >= (i32)row_begin && tri.min_y < (i32)row_end) {
+                raster_tri(tri, row_begin, row_end, width, depth.data());
+            }
+        }
+    });
+
+    stats.n_occluders = (u32)occluders.size();
+    stats.n_tris = (u32)tris.size();
+    stats.raster_ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool OcclusionBuffer::occluded(const glm::vec3& center, const glm::vec3& extent) const {
+
+    f32 min_x = constants::f32_max;
+    f32 min_y = constants::f32_max;
+    f32 max_x = constants::f32_min;
+    f32 max_y = constants::f32_min;
+    f32 min_w = constants::f32_max;
+
+    for (u32 corner = 0; corner < 8; ++corner) {
+        glm::vec3 offset = { (corner & 1) ? extent.x : -extent.x, (corner & 2) ? extent.y : -extent.y,
+                             (corner & 4) ? extent.z : -extent.z };
+        glm::vec4 clip = proj_view * glm::vec4(center + offset, 1.0f);
+
+        // boxes crossing the near plane can not be projected safely
+        if (clip.w <= near_z) {
+            return false;
+        }
+
+        f32 inv_w = 1.0f / clip.w;
+        f32 x = (clip.x * inv_w * 0.5f + 0.5f) * (f32)width;
+        f32 y = (clip.y * inv_w * 0.5f + 0.5f) * (f32)height;
+        min_x = std::min(min_x, x);
+        min_y = std::min(min_y, y);
+        max_x = std::max(max_x, x);
+        max_y = std::max(max_y, y);
+        min_w = std::min(min_w, clip.w);
+    }
+
+    // every pixel the box's screen rectangle touches must hold an occluder closer than the box's nearest point
+    i32 x_begin = std::max((i32)std::floor(min_x), 0);
+    i32 x_end = std::min((i32)std::ceil(max_x), (i32)width);
+    i32 y_begin = std::max((i32)std::floor(min_y), 0);
+    i32 y_end = std::min((i32)std::ceil(max_y), (i32)height);
+
+    if (x_begin >= x_end || y_begin >= y_end) {
+        return false;
+    }
+
+    f32 box_z = 1.0f / min_w;
+
+    for (i32 y = y_begin; y < y_end; ++y) {
+        const f32* row = depth.data() + (size_t)y * width;
+
+#ifdef __AVX2__
+        const __m256i lane_idxs = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        __m256 box = _mm256_set1_ps(box_z);
+        __m256i first = _mm256_set1_epi32(x_begin - 1);
+        __m256i last = _mm256_set1_epi32(x_end);
+
+        for (i32 x = x_begin & ~7; x < x_end; x += 8) {
+            __m256i idxs = _mm256_add_epi32(_mm256_set1_epi32(x), lane_idxs);
+            __m256 in_rect = _mm256_castsi256_ps(
+                _mm256_and_si256(_mm256_cmpgt_epi32(idxs, first), _mm256_cmpgt_epi32(last, idxs)));
+            __m256 behind = _mm256_cmp_ps(_mm256_loadu_ps(row + x), box, _CMP_GT_OQ);
+
+            if (_mm256_movemask_ps(_mm256_andnot_ps(behind, in_rect)) != 0) {
+                return false;
+            }
+        }
+#else
+        for (i32 x = x_begin; x < x_end; ++x) {
+            if (!(row[x] > box_z)) {
+                return false;
+            }
+        }
+#endif
+    }
+
+    return true;
+}
+
+void OcclusionBuffer::cull(const CullBounds& bounds, std::vector<u32>& visible) {
+
+    auto start = std::chrono::steady_clock::now();
+
+    u32 n = (u32)visible.size();
+    hidden.assign(n, 0);
+
+    u32 n_batches = (n + test_batch - 1) / test_batch;
+    run_jobs(pool, n_batches, [&](u32 batch) {
+        for (u32 idx = batch * test_batch; idx < std::min((batch + 1) * test_batch, n); ++idx) {
+            u32 inst = visible[idx];
+            glm::vec3 center = { bounds.center_x[inst], bounds.center_y[inst], bounds.center_z[inst] };
+            glm::vec3 extent = { bounds.extent_x[inst], bounds.extent_y[inst], bounds.extent_z[inst] };
+            hidden[idx] = occluded(center, extent);
+        }
+    });
+
+    u32 n_kept = 0;
+    for (u32 idx = 0; idx < n; ++idx) {
+        if (!hidden[idx]) {
+            visible[n_kept++] = visible[idx];
+        }
+    }
+    visible.resize(n_kept);
+
+    stats.n_tested = n;
+    stats.n_occluded = n - n_kept;
+    stats.test_ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
\ No newline at end of file
@@ -0,0 +1,267 @@
+#include <rose/raycast.hpp>
+#include <rose/core/memory.hpp>
+
+#include <cmath>
+
+// half the surface area of a box, proportional to the chance a ray passes through it
+static inline f32 half_area(const glm::vec3& min_pt, const glm::vec3& max_pt) {
+    glm::vec3 d = max_pt - min_pt;
+    return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+void TriangleBVH::build(std::span<const glm::vec3> pos, std::span<const u32> indices) {
+
+    u32 n_tris = (u32)(indices.size() / 3);
+
+    nodes.resize(0);
+    tris.resize(0);
+    tri_ids.resize(n_tris);
+
+    if (n_tris == 0) {
+        return;
+    }
+
+    ScratchScope scratch;
+    ArenaVector<glm::vec3> tri_min(n_tris, scratch.arena);
+    ArenaVector<glm::vec3> tri_max(n_tris, scratch.arena);
+    ArenaVector<glm::vec3> centroids(n_tris, scratch.arena);
+
+    for (u32 tri = 0; tri < n_tris; ++tri) {
+        const glm::vec3& v0 = pos[indices[tri * 3 + 0]];
+        const glm::vec3& v1 = pos[indices[tri * 3 + 1]];
+        const glm::vec3& v2 = pos[indices[tri * 3 + 2]];
+        tri_min[tri] = glm::min(v0, glm::min(v1, v2));
+        tri_max[tri] = glm::max(v0, glm::max(v1, v2));
+        centroids[tri] = (tri_min[tri] + tri_max[tri]) * 0.5f;
+        tri_ids[tri] = tri;
+    }
+
+    auto fit = [&](TriBVHNode& node) {
+        node.min_pt = constants::vec3_max;
+        node.max_pt = constants::vec3_min;
+        for (u32 idx = node.left_first; idx < node.left_first + node.count; ++idx) {
+            node.min_pt = glm::min(node.min_pt, tri_min[tri_ids[idx]]);
+            node.max_pt = glm::max(node.max_pt, tri_max[tri_ids[idx]]);
+        }
+    };
+
+    // a binary tree with single triangle leaves has 2n - 1 nodes
+    nodes.reserve(2 * n_tris);
+    nodes.push_back({ .min_pt = glm::vec3(0.0f), .left_first = 0, .max_pt = glm::vec3(0.0f), .count = n_tris });
+    fit(nodes[0]);
+
+    struct BuildTask {
+        u32 node;
+        u32 depth;
+    };
+    // note: traversal is depth first, so only a couple of tasks are ever pending per level
+    ArenaVector<BuildTask> tasks(scratch.arena);
+    tasks.reserve(2 * max_depth);
+    tasks.push_back({ 0, 0 });
+
+    struct Bin {
+        glm::vec3 min_pt = constants::vec3_max;
+        glm::vec3 max_pt = constants::vec3_min;
+        u32 count = 0;
+    };
+
+    while (!tasks.empty()) {
+        BuildTask task = tasks.back();
+        tasks.pop_back();
+
+        TriBVHNode node = nodes[task.node];
+        if (node.count <= 2 || task.depth + 1 >= max_depth) {
+            continue;
+        }
+
+        glm::vec3 centroid_min = constants::vec3_max;
+        glm::vec3 centroid_max = constants::vec3_min;
+        for (u32 idx = node.left_first; idx < node.left_first + node.count; ++idx) {
+            centroid_min = glm::min(centroid_min, centroids[tri_ids[idx]]);
+            centroid_max = glm::max(centroid_max, centroids[tri_ids[idx]]);
+        }
+
+        // bin the centroids along each axis, then sweep the bins from both sides to find the cheapest split
+        f32 best_cost = std::numeric_limits<f32>::max();
+        u32 best_axis = 0;
+        u32 best_split = 0;
+
+        for (u32 axis = 0; axis < 3; ++axis) {
+            f32 extent = centroid_max[axis] - centroid_min[axis];
+            if (extent <= 0.0f) {
+                continue;
+            }
+
+            Bin bins[n_bins];
+            f32 bin_scale = (f32)n_bins / extent;
+            for (u32 idx = node.left_first; idx < node.left_first + node.count; ++idx) {
+                u32 tri = tri_ids[idx];
+                u32 bin_idx = std::min(n_bins - 1, (u32)((centroids[tri][axis] - centroid_min[axis]) * bin_scale));
+                bins[bin_idx].min_pt = glm::min(bins[bin_idx].min_pt, tri_min[tri]);
+                bins[bin_idx].max_pt = glm::max(bins[bin_idx].max_pt, tri_max[tri]);
+                bins[bin_idx].count++;
+            }
+
+            f32 left_area[n_bins - 1], right_area[n_bins - 1];
+            u32 left_count[n_bins - 1], right_count[n_bins - 1];
+            Bin left, right;
+
+            for (u32 split = 0; split < n_bins - 1; ++split) {
+                const Bin& lb = bins[split];
+                left.min_pt = glm::min(left.min_pt, lb.min_pt);
+                left.max_pt = glm::max(left.max_pt, lb.max_pt);
+                left.count += lb.count;
+                left_count[split] = left.count;
+                left_area[split] = left.count ? half_area(left.min_pt, left.max_pt) : 0.0f;
+
+                const Bin& rb = bins[n_bins - 1 - split];
+                right.min_pt = glm::min(right.min_pt, rb.min_pt);
+                right.max_pt = glm::max(right.max_pt, rb.max_pt);
+                right.count += rb.count;
+                right_count[n_bins - 2 - split] = right.count;
+                right_area[n_bins - 2 - split] = right.count ? half_area(right.min_pt, right.max_pt) : 0.0f;
+            }
+
+            for (u32 split = 0; split < n_bins - 1; ++split) {
+                if (left_count[split] == 0 || right_count[split] == 0) {
+                    continue;
+                }
+                f32 cost = left_count[split] * left_area[split] + right_count[split] * right_area[split];
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_split = split;
+                }
+            }
+        }
+
+        // all centroids coincide, there is nothing to split on
+        if (best_cost == std::numeric_limits<f32>::max()) {
+            continue;
+        }
+
+        f32 leaf_cost = node.count * half_area(node.min_pt, node.max_pt);
+        if (best_cost >= leaf_cost && node.count <= max_leaf_sz) {
+            continue;
+        }
+
+        // partition the triangles around the split plane
+        f32 extent = centroid_max[best_axis] - centroid_min[best_axis];
+        f32 bin_scale = (f32)n_bins / extent;
+        u32 first = node.left_first;
+        u32 last = node.left_first + node.count;
+        u32 mid = first;
+        for (u32 idx = first; idx < last; ++idx) {
+            u32 tri = tri_ids[idx];
+            u32 bin_idx = std::min(n_bins - 1, (u32)((centroids[tri][best_axis] - centroid_min[best_axis]) * bin_scale));
+            if (bin_idx <= best_split) {
+                std::swap(tri_ids[idx], tri_ids[mid++]);
+            }
+        }
+
+        u32 left_idx = (u32)nodes.size();
+        nodes.push_back({ .min_pt = glm::vec3(0.0f), .left_first = first, .max_pt = glm::vec3(0.0f),
+                          .count = mid - first });
+        nodes.push_back({ .min_pt = glm::vec3(0.0f), .left_first = mid, .max_pt = glm::vec3(0.0f),
+                          .count = last - mid });
+        fit(nodes[left_idx]);
+        fit(nodes[left_idx + 1]);
+
+        nodes[task.node].left_first = left_idx;
+        nodes[task.node].count = 0;
+
+        tasks.push_back({ left_idx, task.depth + 1 });
+        tasks.push_back({ left_idx + 1, task.depth + 1 });
+    }
+
+    // triangles are copied in leaf order, so a leaf reads a contiguous range
+    tris.resize(n_tris);
+    for (u32 idx = 0; idx < n_tris; ++idx) {
+        u32 tri = tri_ids[idx];
+        const glm::vec3& v0 = pos[indices[tri * 3 + 0]];
+        tris[idx] = { .v0 = v0, .e1 = pos[indices[tri * 3 + 1]] - v0, .e2 = pos[indices[tri * 3 + 2]] - v0 };
+    }
+}
+
+bool TriangleBVH::intersect(const glm::vec3& origin, const glm::vec3& dir, TriHit& hit) const {
+
+    if (nodes.empty()) {
+        return false;
+    }
+
+    glm::vec3 inv_dir = 1.0f / dir;
+    if (ray_box(nodes[0].min_pt, nodes[0].max_pt, origin, inv_dir, hit.t) == std::numeric_limits<f32>::infinity()) {
+        return false;
+    }
+
+    bool found = false;
+    u32 stack[max_depth];
+    u32 stack_sz = 0;
+    u32 node_idx = 0;
+
+    while (true) {
+        const TriBVHNode& node = nodes[node_idx];
+
+        if (node.count > 0) {
+            // Moller-Trumbore
+            for (u32 idx = node.left_first; idx < node.left_first + node.count; ++idx) {
+                const BVHTri& tri = tris[idx];
+                glm::vec3 p = glm::cross(dir, tri.e2);
+                f32 det = glm::dot(tri.e1, p);
+                if (std::abs(det) < 1e-12f) {
+                    continue;
+                }
+
+                f32 inv_det = 1.0f / det;
+                glm::vec3 s = origin - tri.v0;
+                f32 u = glm::dot(s, p) * inv_det;
+                if (u < 0.0f || u > 1.0f) {
+                    continue;
+                }
+
+                glm::vec3 q = glm::cross(s, tri.e1);
+                f32 v = glm::dot(dir, q) * inv_det;
+                if (v < 0.0f || u + v > 1.0f) {
+                    continue;
+                }
+
+                f32 t = glm::dot(tri.e2, q) * inv_det;
+                if (t > 0.0f && t < hit.t) {
+                    hit = { .t = t, .tri = tri_ids[idx], .u = u, .v = v };
+                    found = true;
+                }
+            }
+        } else {
+            // visit the nearer child first, the farther one is skipped if a closer hit is found in the meantime
+            u32 near_idx = node.left_first;
+            u32 far_idx = node.left_first + 1;
+            f32 near_t = ray_box(nodes[near_idx].min_pt, nodes[near_idx].max_pt, origin, inv_dir, hit.t);
+            f32 far_t = ray_box(nodes[far_idx].min_pt, nodes[far_idx].max_pt, origin, inv_dir, hit.t);
+            if (far_t < near_t) {
+                std::swap(near_idx, far_idx);
+                std::swap(near_t, far_t);
+            }
+
+            if (near_t != std::numeric_limits<f32>::infinity()) {
+                if (far_t != std::numeric_limits<f32>::infinity()) {
+                    stack[stack_sz++] = far_idx;
+                }
+                node_idx = near_idx;
+                continue;
+            }
+        }
+
+        // pop until a node that can still hold a closer hit is found
+        bool next = false;
+        while (stack_sz > 0 && !next) {
+            node_idx = stack[--stack_sz];
+            next = ray_box(nodes[node_idx].min_pt, nodes[node_idx].max_pt, origin, inv_dir, hit.t) !=
+                   std::numeric_limits<f32>::infinity();
+        }
+        if (!next) {
+            break;
+        }
+    }
+
+    return found;
+}
\ No newline at end of file
@@ -0,0 +1,208 @@
+#include <rose/scene.hpp>
+#include <rose/core/memory.hpp>
+
+#include <algorithm>
+
+u32 SceneGraph::add(u32 parent, const NodeTransform& local) {
+
+    u32 node = 0;
+
+    if (free_nodes.empty()) {
+        node = (u32)parents.size();
+        parents.push_back(parent);
+        locals.push_back(local);
+        node_pos.push_back(invalid_node);
+        node_dirty.push_back(false);
+    }
+    else {
+        node = free_nodes.back();
+        free_nodes.pop_back();
+        parents[node] = parent;
+        locals[node] = local;
+    }
+
+    structure_dirty = true;
+    mark_dirty(node);
+    return node;
+}
+
+void SceneGraph::remove(u32 node) {
+    remove(std::span(&node, 1));
+}
+
+void SceneGraph::remove(std::span<const u32> nodes) {
+
+    removed.assign(parents.size(), false);
+    for (u32 node : nodes) {
+        removed[node] = true;
+        parents[node] = invalid_node;
+        node_pos[node] = invalid_node;
+        free_nodes.push_back(node);
+    }
+
+    // a single pass over every node, however many are removed. children become roots, so their subtrees move
+    for (u32 node = 0; node < (u32)parents.size(); ++node) {
+        if (parents[node] != invalid_node && removed[parents[node]]) {
+            parents[node] = invalid_node;
+            mark_dirty(node);
+        }
+    }
+
+    structure_dirty = true;
+}
+
+void SceneGraph::set_parent(u32 node, u32 parent) {
+    parents[node] = parent;
+    structure_dirty = true;
+    mark_dirty(node);
+}
+
+void SceneGraph::set_local(u32 node, const NodeTransform& local) {
+    locals[node] = local;
+    mark_dirty(node);
+}
+
+void SceneGraph::mark_dirty(u32 node) {
+    if (!node_dirty[node]) {
+        node_dirty[node] = true;
+        dirty_nodes.push_back(node);
+    }
+}
+
+void SceneGraph::update() {
+
+    updated.resize(0);
+
+    // nodes that were added or moved are flagged like changed ones, so after reordering only their subtrees
+    // are recomputed
+    if (structure_dirty) {
+        rebuild();
+    }
+    if (!dirty_nodes.empty()) {
+
+        // visiting changed nodes in depth-first order means a subtree is finished before any node after it,
+        // so nodes within an already updated subtree can be skipped
+        dirty_pos.resize(0);
+        for (u32 node : dirty_nodes) {
+            if (node_pos[node] != invalid_node) {
+                dirty_pos.push_back(node_pos[node]);
+            }
+        }
+        std::sort(dirty_pos.begin(), dirty_pos.end());
+
+        u32 updated_end = 0;
+        for (u32 begin : dirty_pos) {
+            if (begin >= updated_end) {
+                updated_end = subtree_end[begin];
+                update_range(begin, updated_end);
+                updated.push_back({ .begin = begin, .end = updated_end });
+            }
+        }
+    }
+
+    for (u32 node : dirty_nodes) {
+        node_dirty[node] = false;
+    }
+    dirty_nodes.resize(0);
+}
+
+void SceneGraph::update_range(u32 begin, u32 end) {
+    for (u32 pos = begin; pos < end; ++pos) {
+        const NodeTransform& local = locals[order[pos]];
+        u32 parent_pos = order_parents[pos];
+
+        if (parent_pos == invalid_node) {
+            transforms[pos] = local;
+        } else {
+            const NodeTransform& parent = transforms[parent_pos];
+            transforms[pos] = { .mat = parent.mat * local.mat, .normal = parent.normal * local.normal };
+        }
+    }
+}
+
+void SceneGraph::rebuild() {
+
+    u32 n_handles = (u32)parents.size();
+
+    ScratchScope scratch;
+
+    // world transforms are carried over to the new order, they are only stale for flagged subtrees
+    ArenaVector<NodeTransform> prev_world(n_handles, NodeTransform(), scratch.arena);
+    for (u32 pos = 0; pos < (u32)order.size(); ++pos) {
+        prev_world[order[pos]] = transforms[pos];
+    }
+
+    // note: nodes which can not be reached from a root are left without a position
+    std::fill(node_pos.begin(), node_pos.end(), invalid_node);
+
+    ArenaVector<u8> is_free(n_handles, false, scratch.arena);
+    for (u32 node : free_nodes) {
+        is_free[node] = true;
+    }
+
+    // group the children of each node, in order of their handles
+    child_offsets.assign(n_handles + 1, 0);
+    for (u32 node = 0; node < n_handles; ++node) {
+        if (!is_free[node] && parents[node] != invalid_node) {
+            child_offsets[parents[node] + 1]++;
+        }
+    }
+    for (u32 node = 0; node < n_handles; ++node) {
+        child_offsets[node + 1] += child_offsets[node];
+    }
+
+    children.resize(child_offsets[n_handles]);
+    ArenaVector<u32> n_placed(n_handles, 0, scratch.arena);
+    for (u32 node = 0; node < n_handles; ++node) {
+        if (!is_free[node] && parents[node] != invalid_node) {
+            u32 parent = parents[node];
+            children[child_offsets[parent] + n_placed[parent]++] = node;
+        }
+    }
+
+    // pre-order traversal from every root
+    order.resize(0);
+    order_parents.resize(0);
+
+    for (u32 root = 0; root < n_handles; ++root) {
+        if (is_free[root] || parents[root] != invalid_node) {
+            continue;
+        }
+
+        stack.push_back(root);
+        while (!stack.empty()) {
+            u32 node = stack.back();
+            stack.pop_back();
+
+            node_pos[node] = (u32)order.size();
+            order.push_back(node);
+            order_parents.push_back(parents[node] == invalid_node ? invalid_node : node_pos[parents[node]]);
+
+            // pushed in reverse so children are visited in order
+            for (u32 idx = child_offsets[node + 1]; idx > child_offsets[node]; --idx) {
+                stack.push_back(children[idx - 1]);
+            }
+        }
+    }
+
+    // children always follow their parent, so sizes can be accumulated back to front
+    u32 n = (u32)order.size();
+    subtree_end.resize(n);
+    for (u32 pos = 0; pos < n; ++pos) {
+        subtree_end[pos] = 1;
+    }
+    for (u32 pos = n; pos-- > 0;) {
+        if (order_parents[pos] != invalid_node) {
+            subtree_end[order_parents[pos]] += subtree_end[pos];
+        }
+    }
+    for (u32 pos = 0; pos < n; ++pos) {
+        subtree_end[pos] += pos;
+    }
+
+    transforms.resize(n);
+    for (u32 pos = 0; pos < n; ++pos) {
+        transforms[pos] = prev_world[order[pos]];
+    }
+    structure_dirty = false;
+}
\ No newline at end of file
@@ -0,0 +1,286 @@
+#include <rose/snapshot.hpp>
+#include <rose/core/mapped_file.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+static inline u64 align8(u64 offset) { return (offset + 7) & ~7ull; }
+
+static inline f64 ms_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// true if a table of n elements of the given size starting at offset lies within the file
+static inline bool in_bounds(u64 offset, u64 n, u64 elem_sz, u64 file_sz) {
+    return offset <= file_sz && n <= (file_sz - offset) / elem_sz;
+}
+
+rses save_snapshot(const fs::path& path, const Entities& entities, const SkyBox& skybox) {
+
+    std::vector<std::string> path_strs;
+    std::unordered_map<fs::path, u32> path_idxs;
+    auto add_path = [&](const fs::path& asset_path) -> u32 {
+        auto [it, inserted] = path_idxs.try_emplace(asset_path, (u32)path_strs.size());
+        if (inserted) {
+            path_strs.push_back(asset_path.generic_string());
+        }
+        return it->second;
+    };
+
+    // record of each entity, entities without a model file have none
+    std::vector<u32> records(entities.size(), snapshot::invalid_record);
+    std::vector<SnapshotEntity> ents;
+    ents.reserve(entities.size());
+
+    for (size_t idx = 0; idx < entities.size(); ++idx) {
+        if (entities.models[idx].path.empty()) {
+            continue;
+        }
+        records[idx] = (u32)ents.size();
+        ents.push_back({ .model = add_path(entities.models[idx].path),
+                         .parent = snapshot::invalid_record,
+                         .flags = entities.flags[idx],
+                         .pos = entities.positions[idx],
+                         .scale = entities.scales[idx],
+                         .rotation = entities.rotations[idx],
+                         .light = entities.light_data[idx] });
+    }
+
+    for (size_t idx = 0; idx < entities.size(); ++idx) {
+        EntityHandle parent = entities.parents[idx];
+        if (records[idx] != snapshot::invalid_record && entities.valid(parent)) {
+            ents[records[idx]].parent = records[entities.index(parent)];
+        }
+    }
+
+    SnapshotHeader header = { .magic = snapshot::magic, .version = snapshot::version };
+    header.n_entities = (u32)ents.size();
+    header.pt_caster = entities.valid(entities.pt_caster) ? records[entities.index(entities.pt_caster)]
+                                                          : snapshot::invalid_record;
+
+    bool custom_skybox = std::none_of(skybox.paths.begin(), skybox.paths.end(),
+                                      [](const fs::path& face) { return face.empty(); });
+    for (u32 face = 0; face < 6; ++face) {
+        header.skybox[face] = custom_skybox ? add_path(skybox.paths[face]) : snapshot::invalid_record;
+    }
+
+    std::vector<SnapshotPath> paths(path_strs.size());
+    u64 strings_sz = 0;
+    for (size_t idx = 0; idx < path_strs.size(); ++idx) {
+        paths[idx] = { .offset = strings_sz, .len = (u32)path_strs[idx].size() };
+        strings_sz += path_strs[idx].size();
+    }
+
+    header.n_paths = (u32)paths.size();
+    header.entities_offset = align8(sizeof(SnapshotHeader));
+    header.paths_offset = align8(header.entities_offset + ents.size() * sizeof(SnapshotEntity));
+    header.strings_offset = align8(header.paths_offset + paths.size() * sizeof(SnapshotPath));
+    header.strings_sz = strings_sz;
+    header.file_sz = header.strings_offset + strings_sz;
+
+    // the file is assembled in memory and written at once
+    std::vector<u8> buf(header.file_sz, 0);
+    std::memcpy(buf.data(), &header, sizeof(header));
+    if (!ents.empty()) {
+        std::memcpy(buf.data() + header.entities_offset, ents.data(), ents.size() * sizeof(SnapshotEntity));
+    }
+    if (!paths.empty()) {
+        std::memcpy(buf.data() + header.paths_offset, paths.data(), paths.size() * sizeof(SnapshotPath));
+    }
+    for (size_t idx = 0; idx < path_strs.size(); ++idx) {
+        std::memcpy(buf.data() + header.strings_offset + paths[idx].offset, path_strs[idx].data(), paths[idx].len);
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        return rses().io("unable to open {} for writing", path.generic_string());
+    }
+    file.write(reinterpret_cast<const char*>(buf.data()), (std::streamsize)buf.size());
+    if (!file) {
+        return rses().io("unable to write snapshot {}", path.generic_string());
+    }
+
+    return {};
+}
+
+rses load_snapshot(const fs::path& path, Entities& entities, SkyBox& skybox, TextureManager& manager,
+                   ThreadPool& pool, SnapshotStats* stats) {
+
+    SnapshotStats local_stats;
+    SnapshotStats& load_stats = stats ? *stats : local_stats;
+    load_stats = {};
+
+    auto start = std::chrono::steady_clock::now();
+    auto phase_start = start;
+
+    MappedFile file;
+    if (rses err = file.open(path)) {
+        return err.io("unable to load snapshot {}", path.generic_string());
+    }
+
+    SnapshotHeader header;
+    if (file.size < sizeof(SnapshotHeader)) {
+        return rses().io("{} is not a scene snapshot", path.generic_string());
+    }
+    std::memcpy(&header, file.data, sizeof(header));
+
+    if (header.magic != snapshot::magic) {
+        return rses().io("{} is not a scene snapshot", path.generic_string());
+    }
+    if (header.version != snapshot::version) {
+        return rses().io("snapshot {} has version {}, expected {}", path.generic_string(), header.version,
+                         snapshot::version);
+    }
+    if (header.file_sz != file.size ||
+        !in_bounds(header.entities_offset, header.n_entities, sizeof(SnapshotEntity), file.size) ||
+        !in_bounds(header.paths_offset, header.n_paths, sizeof(SnapshotPath), file.size) ||
+        !in_bounds(header.strings_offset, header.strings_sz, 1, file.size)) {
+        return rses().io("snapshot {} is truncated", path.generic_string());
+    }
+
+    const char* strings = reinterpret_cast<const char*>(file.data + header.strings_offset);
+    std::vector<fs::path> paths(header.n_paths);
+    for (u32 idx = 0; idx < header.n_paths; ++idx) {
+        SnapshotPath entry;
+        std::memcpy(&entry, file.data + header.paths_offset + idx * sizeof(SnapshotPath), sizeof(entry));
+        if (!in_bounds(entry.offset, entry.len, 1, header.strings_sz)) {
+            return rses().io("snapshot {} has a corrupt path table", path.generic_string());
+        }
+        paths[idx] = fs::path(std::string_view(strings + entry.offset, entry.len));
+    }
+
+    std::vector<SnapshotEntity> records(header.n_entities);
+    if (!records.empty()) {
+        std::memcpy(records.data(), file.data + header.entities_offset, records.size() * sizeof(SnapshotEntity));
+    }
+    file.close();
+
+    // users of each model, so the last one can take the imported model rather than copy it
+    std::vector<u32> n_users(header.n_paths, 0);
+    for (const SnapshotEntity& record : records) {
+        if (record.model >= header.n_paths ||
+            (record.parent != snapshot::invalid_record && record.parent >= header.n_entities)) {
+            return rses().io("snapshot {} has a corrupt entity table", path.generic_string());
+        }
+        n_users[record.model]++;
+    }
+
+    load_stats.map_ms = ms_since(phase_start);
+    phase_start = std::chrono::steady_clock::now();
+
+    // models already in the scene are copied from the first entity using them
+    std::unordered_map<fs::path, u32> resident;
+    for (size_t idx = 0; idx < entities.size(); ++idx) {
+        if (!entities.models[idx].path.empty()) {
+            resident.try_emplace(entities.models[idx].path, (u32)idx);
+        }
+    }
+
+    struct Resolved {
+        Model model;
+        ModelTextures tex_data;
+        u32 src = snapshot::invalid_record;     // entity to copy the model from
+        bool ok = false;
+    };
+    std::vector<Resolved> resolved(header.n_paths);
+    std::vector<u32> to_import;
+
+    for (u32 path_idx = 0; path_idx < header.n_paths; ++path_idx) {
+        if (n_users[path_idx] == 0) {
+            continue;
+        }
+        load_stats.n_models++;
+        if (auto it = resident.find(paths[path_idx]); it != resident.end()) {
+            resolved[path_idx].src = it->second;
+            resolved[path_idx].ok = true;
+        } else {
+            to_import.push_back(path_idx);
+        }
+    }
+
+    // note: the manager is only read while importing, textures it already holds are not decoded again
+    pool.parallel_for((u32)to_import.size(), [&](u32 idx) {
+        Resolved& entry = resolved[to_import[idx]];
+        entry.ok = entry.model.import(paths[to_import[idx]], entry.tex_data, &manager);
+    });
+
+    load_stats.import_ms = ms_since(phase_start);
+    phase_start = std::chrono::steady_clock::now();
+
+    rses import_err;
+    for (u32 path_idx : to_import) {
+        Resolved& entry = resolved[path_idx];
+        if (entry.ok) {
+            entry.model.finalize(manager, entry.tex_data);
+            load_stats.n_imported++;
+        } else {
+            import_err.io("unable to import {}", paths[path_idx].generic_string());
+            load_stats.n_failed++;
+        }
+    }
+
+    load_stats.finalize_ms = ms_since(phase_start);
+    phase_start = std::chrono::steady_clock::now();
+
+    entities.reserve(entities.size() + records.size());
+    std::vector<EntityHandle> handles(records.size(), invalid_entity);
+
+    for (size_t rec_idx = 0; rec_idx < records.size(); ++rec_idx) {
+        const SnapshotEntity& record = records[rec_idx];
+        Resolved& entry = resolved[record.model];
+        if (!entry.ok) {
+            continue;
+        }
+
+        Model model;
+        if (entry.src != snapshot::invalid_record) {
+            model = entities.models[entry.src].copy();
+        } else if (--n_users[record.model] == 0) {
+            model = std::move(entry.model);
+        } else {
+            model = entry.model.copy();
+        }
+
+        handles[rec_idx] = entities.add_object(std::move(model), { .model_path = paths[record.model],
+                                                                   .pos = record.pos,
+                                                                   .scale = record.scale,
+                                                                   .rotation = record.rotation,
+                                                                   .light_data = record.light,
+                                                                   .flags = record.flags });
+        load_stats.n_entities++;
+    }
+
+    // parents may be written after their children, so entities are only attached once all of them exist
+    for (size_t rec_idx = 0; rec_idx < records.size(); ++rec_idx) {
+        u32 parent = records[rec_idx].parent;
+        if (handles[rec_idx] != invalid_entity && parent != snapshot::invalid_record &&
+            handles[parent] != invalid_entity) {
+            entities.set_parent(entities.index(handles[rec_idx]), handles[parent]);
+        }
+    }
+
+    if (header.pt_caster < handles.size() && handles[header.pt_caster] != invalid_entity) {
+        entities.pt_caster = handles[header.pt_caster];
+    }
+
+    auto face_valid = [&](u32 face) { return face < header.n_paths; };
+    if (std::all_of(std::begin(header.skybox), std::end(header.skybox), face_valid)) {
+        skybox.load(manager, { paths[header.skybox[0]], paths[header.skybox[1]], paths[header.skybox[2]],
+                               paths[header.skybox[3]], paths[header.skybox[4]], paths[header.skybox[5]] });
+    }
+
+    load_stats.instance_ms = ms_since(phase_start);
+    load_stats.total_ms = ms_since(start);
+
+    if (import_err) {
+        return import_err.io("{} of {} models of snapshot {} could not be imported, their entities were skipped",
+                             load_stats.n_failed, load_stats.n_models, path.generic_string());
+    }
+    return {};
+}
@@ -0,0 +1,365 @@
+#include <rose/streaming.hpp>
+
+#include <algorithm>
+
+WorldStreamer::~WorldStreamer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    work_cv.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void WorldStreamer::init(u32 n_workers) {
+    for (u32 idx = 0; idx < std::max(n_workers, 1u); ++idx) {
+        workers.emplace_back(&WorldStreamer::worker_loop, this);
+    }
+}
+
+void WorldStreamer::worker_loop() {
+    while (true) {
+        ImportRequest request;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            work_cv.wait(lock, [this] { return stop || !requests.empty(); });
+            if (stop) {
+                return;
+            }
+            request = std::move(requests.front());
+            requests.pop_front();
+        }
+
+        ImportResult result;
+        result.model = request.model;
+        result.ok = result.prototype.import(request.path, result.tex_data);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        results.push_back(std::move(result));
+    }
+}
+
+void WorldStreamer::add(const EntityCtx& ent_def) {
+    glm::ivec2 coord = cell_coord(ent_def.pos);
+    auto [cell_it, new_cell] = cell_index.try_emplace(cell_key(coord), (u32)cells.size());
+    if (new_cell) {
+        cells.emplace_back().coord = coord;
+    }
+
+    auto [model_it, new_model] = model_index.try_emplace(ent_def.model_path, (u32)models.size());
+    if (new_model) {
+        models.emplace_back().path = ent_def.model_path;
+    }
+
+    WorldCell& cell = cells[cell_it->second];
+    if (std::find(cell.models.begin(), cell.models.end(), model_it->second) == cell.models.end()) {
+        cell.models.push_back(model_it->second);
+    }
+    cell.ents.push_back(ent_def);
+    cell.ent_models.push_back(model_it->second);
+}
+
+void WorldStreamer::clear(Entities& entities) {
+    for (u32 cell_idx = 0; cell_idx < cells.size(); ++cell_idx) {
+        unload_cell(cell_idx, entities);
+    }
+
+    // note: models are kept, imports still in flight refer to them by index
+    for (StreamModel& model : models) {
+        model.waiters.clear();
+    }
+    cells.clear();
+    cell_index.clear();
+}
+
+void WorldStreamer::reset_stats() {
+    stats = StreamStats();
+    latency_sum_us = 0;
+}
+
+void WorldStreamer::request_cell(u32 cell_idx) {
+
+    WorldCell& cell = cells[cell_idx];
+    cell.state = CellState::LOADING;
+    cell.load_id++;
+    cell.n_pending = 0;
+    cell.requested = std::chrono::steady_clock::now();
+
+    bool notify = false;
+    for (u32 model_idx : cell.models) {
+        StreamModel& model = models[model_idx];
+        model.n_users++;
+
+        if (model.state == StreamModelState::NONE) {
+            model.state = StreamModelState::IMPORTING;
+            std::lock_guard<std::mutex> lock(mutex);
+            requests.push_back({ .model = model_idx, .path = model.path });
+            notify = true;
+        }
+        if (model.state == StreamModelState::IMPORTING) {
+            model.waiters.push_back({ .cell = cell_idx, .load_id = cell.load_id });
+            cell.n_pending++;
+        }
+    }
+
+    if (notify) {
+        work_cv.notify_all();
+    }
+
+    if (cell.n_pending == 0) {
+        cell.state = CellState::READY;
+        ready_cells.push_back(cell_idx);
+    }
+}
+
+void WorldStreamer::release_model(u32 model_idx) {
+    StreamModel& model = models[model_idx];
+    if (--model.n_users > 0 || model.state != StreamModelState::RESIDENT) {
+        return;
+    }
+
+    cpu_resident -= model.cpu_bytes;
+    gpu_resident -= model.gpu_bytes;
+    model.prototype = Model();
+    model.state = StreamModelState::NONE;
+}
+
+void WorldStreamer::unload_cell(u32 cell_idx, Entities& entities) {
+
+    WorldCell& cell = cells[cell_idx];
+    if (cell.state == CellState::UNLOADED) {
+        return;
+    }
+
+    if (cell.state == CellState::LOADED) {
+        // note: entities the user deleted in the meantime are skipped
+        entities.del_objects(cell.handles);
+        cell.handles.clear();
+        cpu_resident -= cell.cpu_bytes;
+        stats.n_unloads++;
+    } else if (cell.state == CellState::READY) {
+        std::erase(ready_cells, cell_idx);
+    }
+
+    // models are released after the entities, so the last user frees them
+    for (u32 model_idx : cell.models) {
+        release_model(model_idx);
+    }
+    cell.state = CellState::UNLOADED;
+}
+
+void WorldStreamer::finish_model(ImportResult& result, TextureManager& manager) {
+
+    StreamModel& model = models[result.model];
+
+    if (!result.ok) {
+        model.state = StreamModelState::FAILED;
+    } else if (model.n_users == 0) {
+        // every cell that wanted the model was unloaded while it was imported
+        model.state = StreamModelState::NONE;
+        model.waiters.clear();
+        return;
+    } else {
+        model.prototype = std::move(result.prototype);
+        model.prototype.finalize(manager, result.tex_data);
+        model.cpu_bytes = model.prototype.geometry_bytes();
+        model.gpu_bytes = model.prototype.geometry_bytes() + model.prototype.texture_bytes();
+        cpu_resident += model.cpu_bytes;
+        gpu_resident += model.gpu_bytes;
+        model.state = StreamModelState::RESIDENT;
+    }
+
+    for (const StreamModel::Waiter& waiter : model.waiters) {
+        WorldCell& cell = cells[waiter.cell];
+        if (cell.state == CellState::LOADING && cell.load_id == waiter.load_id && --cell.n_pending == 0) {
+            cell.state = CellState::READY;
+            ready_cells.push_back(waiter.cell);
+        }
+    }
+    model.waiters.clear();
+}
+
+void WorldStreamer::instance_cell(u32 cell_idx, Entities& entities) {
+
+    WorldCell& cell = cells[cell_idx];
+    cell.cpu_bytes = 0;
+    cell.handles.reserve(cell.ents.size());
+
+    for (size_t ent_idx = 0; ent_idx < cell.ents.size(); ++ent_idx) {
+        StreamModel& model = models[cell.ent_models[ent_idx]];
+        if (model.state != StreamModelState::RESIDENT) {
+            continue;
+        }
+
+        // instances share the prototype's textures and GPU buffers, which are counted once for the model. only
+        // the CPU side geometry is duplicated
+        Model instance = model.prototype.copy();
+        cell.cpu_bytes += instance.geometry_bytes();
+        cell.handles.push_back(entities.add_object(std::move(instance), cell.ents[ent_idx]));
+    }
+
+    cpu_resident += cell.cpu_bytes;
+    cell.state = CellState::LOADED;
+
+    auto latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - cell.requested);
+    stats.n_loads++;
+    latency_sum_us += (u64)latency.count();
+    stats.last_latency_ms = latency.count() / 1000.0;
+    stats.avg_latency_ms = latency_sum_us / 1000.0 / stats.n_loads;
+    stats.max_latency_ms = std::max(stats.max_latency_ms, stats.last_latency_ms);
+}
+
+void WorldStreamer::update(const Camera& camera, Entities& entities, TextureManager& manager) {
+
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed_ms = [&start]() {
+        return std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& result : results) {
+            pending.push_back(std::move(result));
+        }
+        results.clear();
+    }
+
+    if (cells.empty() && pending.empty()) {
+        stats.update_ms = 0.0;
+        return;
+    }
+
+    // 1. distance of each cell from the camera on the xz plane, and whether it lies ahead of it
+    glm::vec2 cam_pos = { camera.position.x, camera.position.z };
+    glm::vec2 cam_dir = { camera.front.x, camera.front.z };
+    f32 dir_len = glm::length(cam_dir);
+    cam_dir = dir_len > 1e-4f ? cam_dir / dir_len : glm::vec2(0.0f, 0.0f);
+
+    for (WorldCell& cell : cells) {
+        glm::vec2 min_pt = glm::vec2(cell.coord) * cell_sz;
+        glm::vec2 max_pt = min_pt + cell_sz;
+        cell.dist = glm::length(cam_pos - glm::clamp(cam_pos, min_pt, max_pt));
+        // note: looking straight down counts every cell as ahead
+        cell.in_front = glm::dot((min_pt + max_pt) * 0.5f - cam_pos, cam_dir) >= -0.5f * cell_sz;
+    }
+
+    f32 hysteresis = std::max(unload_dist - load_dist, 0.0f);
+    auto wanted = [&](const WorldCell& cell) {
+        return cell.dist <= load_dist && (cell.in_front || cell.dist <= behind_dist);
+    };
+    auto kept = [&](const WorldCell& cell) {
+        return cell.dist <= unload_dist && (cell.in_front || cell.dist <= behind_dist + hysteresis);
+    };
+    // lower is more important, cells behind the camera come after every cell ahead of it
+    auto priority = [&](const WorldCell& cell) { return cell.dist + (cell.in_front ? 0.0f : unload_dist); };
+
+    // 2. unload cells the camera has moved away from
+    for (u32 cell_idx = 0; cell_idx < cells.size(); ++cell_idx) {
+        if (cells[cell_idx].state != CellState::UNLOADED && !kept(cells[cell_idx])) {
+            unload_cell(cell_idx, entities);
+        }
+    }
+
+    // 3. request the most important wanted cells, evicting less important ones if the budgets are full
+    std::vector<u32> candidates;
+    u32 n_in_flight = 0;
+    for (u32 cell_idx = 0; cell_idx < cells.size(); ++cell_idx) {
+        const WorldCell& cell = cells[cell_idx];
+        if (cell.state == CellState::LOADING || cell.state == CellState::READY) {
+            ++n_in_flight;
+        } else if (cell.state == CellState::UNLOADED && wanted(cell)) {
+            candidates.push_back(cell_idx);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [&](u32 a, u32 b) { return priority(cells[a]) < priority(cells[b]); });
+
+    // returns the least important loaded cell, or an invalid index if there is none
+    auto least_important = [&]() {
+        u32 worst = std::numeric_limits<u32>::max();
+        for (u32 cell_idx = 0; cell_idx < cells.size(); ++cell_idx) {
+            if (cells[cell_idx].state == CellState::LOADED &&
+                (worst == std::numeric_limits<u32>::max() || priority(cells[cell_idx]) > priority(cells[worst]))) {
+                worst = cell_idx;
+            }
+        }
+        return worst;
+    };
+
+    stats.budget_limited = false;
+    for (u32 cell_idx : candidates) {
+        if (n_in_flight >= budgets.max_in_flight) {
+            break;
+        }
+
+        // note: a cell that has never been loaded has no estimate, it is checked once loaded. the GPU memory of a
+        // cell is that of its models, which is only known once they are imported
+        WorldCell& cell = cells[cell_idx];
+        bool fits = true;
+        while (cpu_resident + cell.cpu_bytes > budgets.cpu_bytes || gpu_resident > budgets.gpu_bytes) {
+            u32 victim = least_important();
+            if (victim == std::numeric_limits<u32>::max() || priority(cells[victim]) <= priority(cell)) {
+                fits = false;
+                break;
+            }
+            unload_cell(victim, entities);
+            stats.n_evictions++;
+        }
+
+        if (!fits) {
+            stats.budget_limited = true;
+            break;
+        }
+
+        request_cell(cell_idx);
+        ++n_in_flight;
+    }
+
+    // 4. upload imported models and add the entities of ready cells, at least one of each per frame so
+    // streaming always makes progress
+    size_t n_finished = 0;
+    while (n_finished < pending.size() && (n_finished == 0 || elapsed_ms() < budgets.finalize_ms)) {
+        finish_model(pending[n_finished++], manager);
+    }
+    pending.erase(pending.begin(), pending.begin() + n_finished);
+
+    // note: a cell is added as a whole, so a cell with many entities can overrun the time slice
+    size_t n_instanced = 0;
+    while (n_instanced < ready_cells.size() && (n_instanced == 0 || elapsed_ms() < budgets.finalize_ms)) {
+        instance_cell(ready_cells[n_instanced++], entities);
+    }
+    ready_cells.erase(ready_cells.begin(), ready_cells.begin() + n_instanced);
+
+    // 5. new cells have no estimate until loaded, so they can push the totals over budget
+    while (cpu_resident > budgets.cpu_bytes || gpu_resident > budgets.gpu_bytes) {
+        u32 victim = least_important();
+        if (victim == std::numeric_limits<u32>::max() || cells[victim].dist == 0.0f) {
+            stats.budget_limited = true;
+            break;
+        }
+        unload_cell(victim, entities);
+        stats.n_evictions++;
+    }
+
+    stats.n_cells = (u32)cells.size();
+    stats.n_loaded = 0;
+    stats.n_loading = 0;
+    stats.n_entities = 0;
+    for (const WorldCell& cell : cells) {
+        if (cell.state == CellState::LOADED) {
+            stats.n_loaded++;
+            stats.n_entities += (u32)cell.handles.size();
+        } else if (cell.state != CellState::UNLOADED) {
+            stats.n_loading++;
+        }
+    }
+    stats.n_models = (u32)std::count_if(models.begin(), models.end(),
+                                        [](const StreamModel& model) { return model.state == StreamModelState::RESIDENT; });
+    stats.cpu_bytes = cpu_resident;
+    stats.gpu_bytes = gpu_resident;
+    stats.peak_cpu_bytes = std::max(stats.peak_cpu_bytes, cpu_resident);
+    stats.peak_gpu_bytes = std::max(stats.peak_gpu_bytes, gpu_resident);
+    stats.update_ms = elapsed_ms();
+}
\ No newline at end of file
@@ -125,37 +125,48 @@ TextureRef TextureManager::load_texture(const fs::path& path, TextureType ty) {
         return ref;
     }
 
+    TextureImage image;
+    decode_texture(path, ty, image);
+    return upload_texture(image);
+}
+
+void StbiDeleter::operator()(u8* data) const { stbi_image_free(data); }
+
+void decode_texture(const fs::path& path, TextureType ty, TextureImage& out) {
+    out.path = path;
+    out.ty = ty;
+    out.data.reset(stbi_load(path.generic_string().c_str(), &out.width, &out.height, &out.n_channels, STBI_rgb_alpha));
+}
+
+TextureRef TextureManager::upload_texture(const TextureImage& image) {
+
+    if (!image.data) {
+        return default_tex_ref;
+    }
+
     GL_Texture texture;
-    texture.ty = ty;
-    i32 width = 0, height = 0, n_channels = 0;
-    unsigned char* texture_data = stbi_load(path.generic_string().c_str(), &width, &height, &n_channels, STBI_rgb_alpha);
+    texture.ty = image.ty;
 
-    if (n_channels == 4) {
+    if (image.n_channels == 4) {
         // this texture has an alpha channel
         texture.flags = TextureFlags::TRANSPARENT;
     }
 
-    if (texture_data) {
-        i32 n_levels = 1 + (int)std::floor(std::log2((double)std::max(width, height)));
-        glCreateTextures(GL_TEXTURE_2D, 1, &texture.id);
-        glTextureParameteri(texture.id, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTextureParameteri(texture.id, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTextureParameteri(texture.id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTextureParameteri(texture.id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTextureStorage2D(texture.id, n_levels, GL_RGBA8, width, height);
-        glTextureSubImage2D(texture.id, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, texture_data);
-        glGenerateTextureMipmap(texture.id);
-        stbi_image_free(texture_data);
-    } 
-    else {
-        stbi_image_free(texture_data);
-        const char* err_msg = stbi_failure_reason();
-        texture.free();
-        return default_tex_ref;
-    }
+    i32 n_levels = 1 + (int)std::floor(std::log2((double)std::max(image.width, image.height)));
+    glCreateTextures(GL_TEXTURE_2D, 1, &texture.id);
+    glTextureParameteri(texture.id, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTextureParameteri(texture.id, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTextureParameteri(texture.id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTextureParameteri(texture.id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureStorage2D(texture.id, n_levels, GL_RGBA8, image.width, image.height);
+    glTextureSubImage2D(texture.id, 0, 0, 0, image.width, image.height, GL_RGBA, GL_UNSIGNED_BYTE, image.data.get());
+    glGenerateTextureMipmap(texture.id);
+
+    // note: a full mip chain adds a third to the size of the base level
+    texture.n_bytes = (u64)image.width * image.height * 4 * 4 / 3;
 
     loaded_textures[texture.id] = { texture, 1 };
-    textures_index[path] = texture.id;
+    textures_index[image.path] = texture.id;
     return TextureRef(&loaded_textures[texture.id].texture, this);
 }
 
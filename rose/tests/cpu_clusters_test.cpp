@@ -0,0 +1,146 @@
+// =============================================================================
+//   CPU light clusters: lists of a small grid against ones computed by hand,
+//   in both index layouts
+// =============================================================================
+
+#include <rose/cpu_clusters.hpp>
+#include <rose/lighting.hpp>
+
+#include <gtc/matrix_transform.hpp>
+
+#include <array>
+#include <print>
+#include <vector>
+
+// a 64 x 64 screen with 32 pixel tiles and two slices, split at a depth of 5, with a 90 degree field of view,
+// a near plane of 1 and a far plane of 20. the camera sits at the origin looking down -z, so view and world
+// space are the same. cluster x + 2y + 4z covers
+//
+//   0: x [-5, 0]   y [-5, 0]   z [-5, -1]      4: x [-20, 0]  y [-20, 0]  z [-20, -5]
+//   1: x [0, 5]    y [-5, 0]   z [-5, -1]      5: x [0, 20]   y [-20, 0]  z [-20, -5]
+//   2: x [-5, 0]   y [0, 5]    z [-5, -1]      6: x [-20, 0]  y [0, 20]   z [-20, -5]
+//   3: x [0, 5]    y [0, 5]    z [-5, -1]      7: x [0, 20]   y [0, 20]   z [-20, -5]
+static constexpr glm::uvec2 screen_dims = { 64, 64 };
+static constexpr f32 near_z = 1.0f;
+static constexpr f32 far_z = 20.0f;
+
+struct TestLight {
+    glm::vec3 pos;
+    f32 radius;
+    glm::vec3 direction = { 0.0f, -1.0f, 0.0f };
+    f32 outer_cos = -1.0f;
+};
+
+static const std::array<TestLight, 9> test_lights = { {
+    { { -2.0f, -2.0f, -3.0f }, 0.5f },                  // inside cluster 0
+    { { 0.0f, 0.0f, -3.0f }, 1.0f },                    // on the corner the near slice's clusters share
+    { { 3.0f, 3.0f, -5.0f }, 0.5f },                    // on the split between clusters 3 and 7
+    { { 10.0f, -10.0f, -15.0f }, 2.0f },                // inside cluster 5
+    { { 0.0f, 0.0f, -40.0f }, 5.0f },                   // beyond the far plane
+    { { 0.0f, 0.0f, 3.0f }, 1.0f },                     // behind the camera
+
+    // its sphere reaches every cluster, the cone pointing away from the camera misses cluster 1
+    { { -2.0f, 2.0f, -3.0f }, 4.0f, { 0.0f, 0.0f, -1.0f }, 0.866f },
+
+    // its sphere reaches every cluster but 2 and 6, the cone pointing along +x misses clusters 0, 3 and 4
+    { { 3.0f, -3.0f, -3.0f }, 4.0f, { 1.0f, 0.0f, 0.0f }, 0.866f },
+
+    // beyond the far plane, the only light of the second group of eight, next to seven lanes of padding
+    { { 0.0f, 0.0f, -40.0f }, 5.0f },
+} };
+
+static const std::array<std::vector<u32>, 8> expected = { {
+    { 0, 1, 6 },
+    { 1, 7 },
+    { 1, 6 },
+    { 1, 2, 6 },
+    { 6 },
+    { 3, 6, 7 },
+    { 6 },
+    { 2, 6, 7 },
+} };
+
+// checks the lists and header of the last cull, returns the number of failures
+static i32 check(const CpuClusters& cpu, const char* layout) {
+
+    i32 n_failed = 0;
+    if (cpu.grid.size() != expected.size()) {
+        std::println("{}: {} clusters, expected {}", layout, cpu.grid.size(), expected.size());
+        return 1;
+    }
+
+    u32 n_refs = 0;
+    u32 n_words = 0;
+    std::vector<u32> lights;
+    for (u32 cluster = 0; cluster < expected.size(); ++cluster) {
+
+        // lists follow each other in cluster order, packed ones starting on a whole uint
+        u32 first = cpu.packed ? n_words * 2 : n_words;
+        if (cpu.grid[cluster].x != first) {
+            std::println("{}: cluster {} starts at {}, expected {}", layout, cluster, cpu.grid[cluster].x, first);
+            ++n_failed;
+        }
+
+        lights.resize(0);
+        CpuClusters::decode(cpu.grid[cluster], cpu.indices, cpu.packed, lights);
+        if (lights != expected[cluster]) {
+            std::println("{}: cluster {} has {} lights, expected {}", layout, cluster, lights.size(),
+                         expected[cluster].size());
+            ++n_failed;
+        }
+
+        u32 count = (u32)expected[cluster].size();
+        n_refs += count;
+        n_words += cpu.packed ? (count + 1) / 2 : count;
+    }
+
+    // every list is non-empty and the longest holds three lights
+    if (cpu.indices.size() != CpuClusters::header_sz + n_words || cpu.indices[0] != n_words ||
+        cpu.indices[1] != expected.size() || cpu.indices[2] != n_refs || cpu.indices[3] != 3) {
+        std::println("{}: header [{}, {}, {}, {}] over {} uints, expected [{}, {}, {}, 3] over {}", layout,
+                     cpu.indices[0], cpu.indices[1], cpu.indices[2], cpu.indices[3], cpu.indices.size(), n_words,
+                     expected.size(), n_refs, CpuClusters::header_sz + n_words);
+        ++n_failed;
+    }
+
+    return n_failed;
+}
+
+int main() {
+
+    Clusters clusters;
+    clusters.grid_sz = { 2, 2, 2 };
+    clusters.tile_sz = 32;
+    clusters.split_z = 5.0f;
+
+    glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, near_z, far_z);
+
+    LightRegistry registry;
+    for (u32 idx = 0; idx < test_lights.size(); ++idx) {
+        const TestLight& light = test_lights[idx];
+        registry.add({ .radius = light.radius, .outer_cos = light.outer_cos,
+                       .direction = glm::vec4(light.direction, 0.0f) }, light.pos, idx);
+    }
+
+    ClusterLightSet lights;
+    lights.set(registry, glm::mat4(1.0f));
+
+    CpuClusters cpu;
+    cpu.build(clusters, screen_dims, projection, near_z, far_z);
+
+    i32 n_failed = 0;
+
+    cpu.cull(lights, false);
+    n_failed += check(cpu, "unpacked");
+
+    // the low half of a uint holds the first light of a pair
+    cpu.cull(lights, true);
+    n_failed += check(cpu, "packed");
+    if (cpu.indices.size() > CpuClusters::header_sz && cpu.indices[CpuClusters::header_sz] != (1u << 16)) {
+        std::println("packed: first uint of cluster 0 is {:#x}, expected 0x10000",
+                     cpu.indices[CpuClusters::header_sz]);
+        ++n_failed;
+    }
+
+    return n_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,113 @@
+// =============================================================================
+//   occlusion buffer: fixed occluders and boxes with known visibility, culled
+//   with different numbers of workers
+// =============================================================================
+
+#include <rose/culling.hpp>
+#include <rose/occlusion.hpp>
+#include <rose/core/thread_pool.hpp>
+
+#include <gtc/matrix_transform.hpp>
+
+#include <array>
+#include <print>
+#include <vector>
+
+// boxes tested against the occluders, in world space with the camera at the origin looking down -z
+struct TestBox {
+    glm::vec3 center;
+    glm::vec3 extent;
+    bool visible;
+};
+
+// with a 90 degree field of view, the first wall covers [-0.4, 0.4] of the screen on both axes and the second
+// [0.5, 0.9] horizontally and [-0.2, 0.2] vertically, both at a depth of 10
+static constexpr std::array<TestBox, 7> boxes = { {
+    { { 0.0f, 0.0f, -20.0f }, { 1.0f, 1.0f, 1.0f }, false },    // behind the first wall
+    { { 0.0f, 0.0f, -5.0f }, { 1.0f, 1.0f, 1.0f }, true },      // in front of the first wall
+    { { 0.0f, 8.0f, -20.0f }, { 1.0f, 1.0f, 1.0f }, true },     // sticks out above the first wall
+    { { -1.0f, 1.0f, -30.0f }, { 2.0f, 2.0f, 2.0f }, false },   // behind the first wall
+    { { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }, true },       // crosses the near plane
+    { { 14.0f, 0.0f, -20.0f }, { 0.5f, 0.5f, 0.5f }, false },   // behind the second wall
+    { { 9.0f, 0.0f, -20.0f }, { 0.5f, 0.5f, 0.5f }, true },     // in the gap between the walls
+} };
+
+// enough copies of the boxes that culling is split into several batches
+static constexpr u32 n_instances = 600;
+
+static constexpr u32 buffer_sz = 128;
+static constexpr f32 near_z = 0.1f;
+
+// renders the occluders and culls every instance, returning the instances that remain visible
+static std::vector<u32> run(ThreadPool* pool, std::vector<f32>& depth) {
+
+    static constexpr std::array<glm::vec3, 8> wall_pos = { {
+        { -4.0f, -4.0f, -10.0f }, { 4.0f, -4.0f, -10.0f }, { 4.0f, 4.0f, -10.0f }, { -4.0f, 4.0f, -10.0f },
+        { 5.0f, -2.0f, -10.0f }, { 9.0f, -2.0f, -10.0f }, { 9.0f, 2.0f, -10.0f }, { 5.0f, 2.0f, -10.0f },
+    } };
+    static constexpr std::array<u32, 12> wall_indices = { 0, 1, 2, 0, 2, 3, 4, 5, 6, 4, 6, 7 };
+
+    std::array<OccluderMesh, 2> occluders = { {
+        { .pos = wall_pos, .indices = std::span(wall_indices).first(6), .transform = glm::mat4(1.0f) },
+        { .pos = wall_pos, .indices = std::span(wall_indices).last(6), .transform = glm::mat4(1.0f) },
+    } };
+
+    glm::mat4 proj_view = glm::perspective(glm::radians(90.0f), 1.0f, near_z, 100.0f);
+
+    OcclusionBuffer buffer;
+    buffer.init(buffer_sz, buffer_sz, pool);
+    buffer.render(occluders, proj_view, near_z);
+    depth = buffer.depth;
+
+    CullBounds bounds;
+    std::vector<u32> visible;
+    for (u32 inst = 0; inst < n_instances; ++inst) {
+        const TestBox& box = boxes[inst % boxes.size()];
+        bounds.push({ .min_pt = box.center - box.extent, .max_pt = box.center + box.extent }, glm::mat4(1.0f));
+        visible.push_back(inst);
+    }
+
+    buffer.cull(bounds, visible);
+    return visible;
+}
+
+int main() {
+
+    std::vector<u32> expected;
+    for (u32 inst = 0; inst < n_instances; ++inst) {
+        if (boxes[inst % boxes.size()].visible) {
+            expected.push_back(inst);
+        }
+    }
+
+    // no pool runs every job on the calling thread, the rasterized depth of every other run must match it exactly
+    std::vector<f32> serial_depth;
+    std::vector<u32> serial_visible = run(nullptr, serial_depth);
+
+    i32 n_failed = 0;
+    if (serial_visible != expected) {
+        std::println("no pool: {} of {} instances visible, expected {}", serial_visible.size(), n_instances,
+                     expected.size());
+        ++n_failed;
+    }
+
+    for (u32 n_workers : { 1u, 2u, 3u, 7u }) {
+        ThreadPool pool;
+        pool.init(n_workers);
+
+        std::vector<f32> depth;
+        std::vector<u32> visible = run(&pool, depth);
+
+        if (visible != expected) {
+            std::println("{} workers: {} of {} instances visible, expected {}", n_workers, visible.size(),
+                         n_instances, expected.size());
+            ++n_failed;
+        }
+        if (depth != serial_depth) {
+            std::println("{} workers: depth buffer differs from the one rasterized without a pool", n_workers);
+            ++n_failed;
+        }
+    }
+
+    return n_failed == 0 ? 0 : 1;
+}